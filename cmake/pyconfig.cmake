@@ -3,12 +3,6 @@
 include(CheckIncludeFiles)
 include(CheckTypeSizeof)
 
-set(CMAKE_EXTRA_INCLUDE_FILES unordered_map)
-set(CMAKE_REQUIRED_FLAGS -std=c++11)
-check_type_sizeof("std::unordered_map<void*, void*>" SIZEOF_UNORDEREDMAP LANGUAGE CXX)
-set(CMAKE_EXTRA_INCLUDE_FILES)
-set(CMAKE_REQUIRED_FLAGS)
-
 check_include_files(alloca.h HAVE_ALLOCA_H)
 check_include_files(asm/types.h HAVE_ASM_TYPES_H)
 check_include_files(curses.h HAVE_CURSES_H)
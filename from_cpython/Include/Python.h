@@ -135,6 +135,10 @@ PyObject* PyGC_AddRoot(PyObject*) PYSTON_NOEXCEPT;
 // to reduce any chances of compiler reorderings or a GC somehow happening between the assignment
 // to the static slot and the call to PyGC_AddRoot.
 
+// Pyston addition:
+// Lets the GC know that a weakref is being attached to this object for the first time.
+void PyGC_RegisterWeaklyReferenced(PyObject*) PYSTON_NOEXCEPT;
+
 // Pyston change : expose these type objects
 extern PyTypeObject Pattern_Type;
 extern PyTypeObject Match_Type;
@@ -94,7 +94,8 @@ struct _dictobject {
 #endif
 typedef struct {
     PyObject_HEAD;
-    char _filler[SIZEOF_UNORDEREDMAP];
+    // Pyston change: this is the size of the DictMap in BoxedDict (see runtime/types.h)
+    void* _filler[4];
 } PyDictObject;
 
 // Pyston change: these are no longer static objects:
@@ -122,6 +123,11 @@ PyAPI_DATA(PyTypeObject*) dictitems_cls;
 PyAPI_DATA(PyTypeObject*) dictvalues_cls;
 #define PyDictValues_Type (*dictvalues_cls)
 
+// Pyston addition: the __dict__ of an object whose attributes are stored in its hidden class.
+// It supports the mapping protocol, but not the PyDict_* functions.
+PyAPI_DATA(PyTypeObject*) attrwrapper_cls;
+#define PyAttrWrapper_Check(op) (Py_TYPE(op) == attrwrapper_cls)
+
 #define PyDict_Check(op) \
                  PyType_FastSubclass(Py_TYPE(op), Py_TPFLAGS_DICT_SUBCLASS)
 #define PyDict_CheckExact(op) (Py_TYPE(op) == &PyDict_Type)
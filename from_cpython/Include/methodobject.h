@@ -19,6 +19,10 @@ PyAPI_DATA(PyTypeObject*) capifunc_cls;
 
 #define PyCFunction_Check(op) (Py_TYPE(op) == &PyCFunction_Type)
 
+// Pyston addition: builtin functions defined by the runtime itself (ex len) have a different
+// class from functions defined through PyMethodDef, though both are 'builtin_function_or_method'.
+PyAPI_DATA(PyTypeObject*) builtin_function_or_method_cls;
+
 typedef PyObject *(*PyCFunction)(PyObject *, PyObject *);
 typedef PyObject *(*PyCFunctionWithKeywords)(PyObject *, PyObject *,
 					     PyObject *);
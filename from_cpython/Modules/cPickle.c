@@ -153,8 +153,9 @@ Pdata_dealloc(Pdata *self)
     for (i = self->length, p = self->data; --i >= 0; p++) {
         Py_DECREF(*p);
     }
+    // Pyston change: the stack has to be GC-visible memory
     if (self->data)
-        free(self->data);
+        PyMem_FREE(self->data);
     PyObject_Del(self);
 }
 
@@ -175,7 +176,8 @@ Pdata_New(void)
         return NULL;
     self->size = 8;
     self->length = 0;
-    self->data = malloc(self->size * sizeof(PyObject*));
+    // Pyston change: the stack has to be GC-visible memory
+    self->data = PyMem_MALLOC(self->size * sizeof(PyObject*));
     if (self->data)
         return (PyObject*)self;
     Py_DECREF(self);
@@ -225,7 +227,7 @@ Pdata_grow(Pdata *self)
     if (bigger > (PY_SSIZE_T_MAX / sizeof(PyObject *)))
         goto nomemory;
     nbytes = bigger * sizeof(PyObject *);
-    tmp = realloc(self->data, nbytes);
+    tmp = PyMem_REALLOC(self->data, nbytes); // Pyston change: was realloc
     if (tmp == NULL)
         goto nomemory;
     self->data = tmp;
@@ -323,7 +325,7 @@ Pdata_popList(Pdata *self, Py_ssize_t start)
 }
 
 #define FREE_ARG_TUP(self) {                        \
-    if (Py_REFCNT(self->arg) > 1) {                 \
+    if (2 /*Pyston change, was: Py_REFCNT(self->arg)*/ > 1) { \
       Py_CLEAR(self->arg);                          \
     }                                               \
   }
@@ -800,7 +802,9 @@ get(Picklerobject *self, PyObject *id)
 static int
 put(Picklerobject *self, PyObject *ob)
 {
-    if (Py_REFCNT(ob) < 2 || self->fast)
+    // Pyston change: we don't have refcounts to tell us that an object can't be
+    // referenced a second time, so memoize everything.
+    if (self->fast)
         return 0;
 
     return put2(self, ob);
@@ -1994,7 +1998,8 @@ save_dict(Picklerobject *self, PyObject *args)
         goto finally;
 
     /* Get dict size, and bow out early if empty. */
-    if ((len = PyDict_Size(args)) < 0)
+    // Pyston change: this can be an attrwrapper, which doesn't support PyDict_Size
+    if ((len = PyObject_Size(args)) < 0)
         goto finally;
 
     if (len == 0) {
@@ -2087,7 +2092,9 @@ save_inst(Picklerobject *self, PyObject *args)
     }
 
     if (!self->bin) {
-        if (!( name = ((PyClassObject *)class)->cl_name ))  {
+        // Pyston change: our classobjs don't have the CPython layout
+        if (!( name = PyObject_GetAttr(class, __name___str) ))  {
+            PyErr_Clear();
             PyErr_SetString(PicklingError, "class has no name");
             goto finally;
         }
@@ -2634,7 +2641,7 @@ save(Picklerobject *self, PyObject *args, int pers_save)
 #endif
     }
 
-    if (Py_REFCNT(args) > 1) {
+    if (2 /*Pyston change, was: Py_REFCNT(args)*/ > 1) {
         if (!( py_ob_id = PyLong_FromVoidPtr(args)))
             goto finally;
 
@@ -2689,6 +2696,14 @@ save(Picklerobject *self, PyObject *args, int pers_save)
         }
         break;
 
+    // Pyston change: instance __dict__s are attrwrappers rather than dicts
+    case 'a':
+        if (PyAttrWrapper_Check(args)) {
+            res = save_dict(self, args);
+            goto finally;
+        }
+        break;
+
     case 'i':
         if (type == &PyInstance_Type) {
             res = save_inst(self, args);
@@ -2716,7 +2731,8 @@ save(Picklerobject *self, PyObject *args, int pers_save)
         break;
 
     case 'b':
-        if (type == &PyCFunction_Type) {
+        // Pyston change: our own builtin functions have a different type from extension functions
+        if (type == &PyCFunction_Type || type == builtin_function_or_method_cls) {
             res = save_global(self, args, NULL);
             goto finally;
         }
@@ -3014,11 +3030,48 @@ static struct PyMethodDef Pickler_methods[] =
 };
 
 
+// Pyston change: cPickle gets initialized along with the rest of the runtime, before sys.path
+// is set up, so we can't import copy_reg until the first pickler or unpickler gets created.
+static int
+init_copyreg(void)
+{
+    PyObject *copyreg;
+
+    if (dispatch_table)
+        return 0;
+
+    if (!( copyreg = PyImport_ImportModule("copy_reg")))
+        return -1;
+
+    /* This is special because we want to use a different
+       one in restricted mode. */
+    dispatch_table = PyGC_AddRoot(PyObject_GetAttr(copyreg, dispatch_table_str));
+    if (!dispatch_table) return -1;
+
+    extension_registry = PyGC_AddRoot(PyObject_GetAttrString(copyreg,
+                            "_extension_registry"));
+    if (!extension_registry) return -1;
+
+    inverted_registry = PyGC_AddRoot(PyObject_GetAttrString(copyreg,
+                            "_inverted_registry"));
+    if (!inverted_registry) return -1;
+
+    extension_cache = PyGC_AddRoot(PyObject_GetAttrString(copyreg,
+                            "_extension_cache"));
+    if (!extension_cache) return -1;
+
+    Py_DECREF(copyreg);
+    return 0;
+}
+
 static Picklerobject *
 newPicklerobject(PyObject *file, int proto)
 {
     Picklerobject *self;
 
+    if (init_copyreg() < 0)
+        return NULL;
+
     if (proto < 0)
         proto = HIGHEST_PROTOCOL;
     if (proto > HIGHEST_PROTOCOL) {
@@ -5457,6 +5510,9 @@ newUnpicklerobject(PyObject *f)
 {
     Unpicklerobject *self;
 
+    if (init_copyreg() < 0)
+        return NULL;
+
     if (!( self = PyObject_GC_New(Unpicklerobject, &Unpicklertype)))
         return NULL;
 
@@ -5861,7 +5917,7 @@ static struct PyMethodDef cPickle_methods[] = {
 static int
 init_stuff(PyObject *module_dict)
 {
-    PyObject *copyreg, *t, *r;
+    PyObject *t, *r;
 
 #define INIT_STR(S) if (!( S ## _str=PyString_InternFromString(#S)))  return -1;
 
@@ -5885,32 +5941,12 @@ init_stuff(PyObject *module_dict)
     INIT_STR(readline);
     INIT_STR(dispatch_table);
 
-    if (!( copyreg = PyImport_ImportModule("copy_reg")))
-        return -1;
-
-    /* This is special because we want to use a different
-       one in restricted mode. */
-    dispatch_table = PyObject_GetAttr(copyreg, dispatch_table_str);
-    if (!dispatch_table) return -1;
-
-    extension_registry = PyObject_GetAttrString(copyreg,
-                            "_extension_registry");
-    if (!extension_registry) return -1;
-
-    inverted_registry = PyObject_GetAttrString(copyreg,
-                            "_inverted_registry");
-    if (!inverted_registry) return -1;
-
-    extension_cache = PyObject_GetAttrString(copyreg,
-                            "_extension_cache");
-    if (!extension_cache) return -1;
-
-    Py_DECREF(copyreg);
+    // Pyston change: importing copy_reg got moved to init_copyreg()
 
-    if (!(empty_tuple = PyTuple_New(0)))
+    if (!(empty_tuple = PyGC_AddRoot(PyTuple_New(0))))
         return -1;
 
-    two_tuple = PyTuple_New(2);
+    two_tuple = PyGC_AddRoot(PyTuple_New(2));
     if (two_tuple == NULL)
         return -1;
     /* We use this temp container with no regard to refcounts, or to
@@ -5932,14 +5968,14 @@ init_stuff(PyObject *module_dict)
                    module_dict, t)  ))  return -1;
     Py_DECREF(r);
 
-    PickleError = PyErr_NewException("cPickle.PickleError", NULL, t);
+    PickleError = PyGC_AddRoot(PyErr_NewException("cPickle.PickleError", NULL, t));
     if (!PickleError)
         return -1;
 
     Py_DECREF(t);
 
-    PicklingError = PyErr_NewException("cPickle.PicklingError",
-                                       PickleError, NULL);
+    PicklingError = PyGC_AddRoot(PyErr_NewException("cPickle.PicklingError",
+                                       PickleError, NULL));
     if (!PicklingError)
         return -1;
 
@@ -5953,18 +5989,18 @@ init_stuff(PyObject *module_dict)
                    module_dict, t)  ))  return -1;
     Py_DECREF(r);
 
-    if (!( UnpickleableError = PyErr_NewException(
-                   "cPickle.UnpickleableError", PicklingError, t)))
+    if (!( UnpickleableError = PyGC_AddRoot(PyErr_NewException(
+                   "cPickle.UnpickleableError", PicklingError, t))))
         return -1;
 
     Py_DECREF(t);
 
-    if (!( UnpicklingError = PyErr_NewException("cPickle.UnpicklingError",
-                                                PickleError, NULL)))
+    if (!( UnpicklingError = PyGC_AddRoot(PyErr_NewException("cPickle.UnpicklingError",
+                                                PickleError, NULL))))
         return -1;
 
-    if (!( BadPickleGet = PyErr_NewException("cPickle.BadPickleGet",
-                                             UnpicklingError, NULL)))
+    if (!( BadPickleGet = PyGC_AddRoot(PyErr_NewException("cPickle.BadPickleGet",
+                                             UnpicklingError, NULL))))
         return -1;
 
     if (PyDict_SetItemString(module_dict, "PickleError",
@@ -6008,6 +6044,10 @@ initcPickle(void)
     Py_TYPE(&Unpicklertype) = &PyType_Type;
     Py_TYPE(&PdataType) = &PyType_Type;
 
+    // Pyston change: let the GC know about our type
+    if (PyType_Ready(&PdataType) < 0)
+        return;
+
     /* Initialize some pieces. We need to do this before module creation,
      * so we're forced to use a temporary dictionary. :(
      */
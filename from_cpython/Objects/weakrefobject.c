@@ -268,6 +268,10 @@ insert_head(PyWeakReference *newref, PyWeakReference **list)
     newref->wr_next = next;
     if (next != NULL)
         next->wr_prev = newref;
+    // Pyston change: the GC doesn't sweep every object eagerly, so it needs to know which ones
+    // have weakrefs that have to be cleared when they die.
+    if (next == NULL)
+        PyGC_RegisterWeaklyReferenced(newref->wr_object);
     *list = newref;
 }
 
@@ -1,2 +0,0 @@
-from pickle import *
-
@@ -1,5 +0,0 @@
-# Very simple stub for the marshal module.
-# - pickle imports marshal
-
-def loads(*args, **kw):
-    raise NotImplementedError()
@@ -0,0 +1,31 @@
+# Exceptions that are raised and caught without ever needing a C++ unwind:
+# dict misses inside a try block, and a callee raise caught by its caller,
+# both for plain calls and for method calls.
+
+def raiser(i):
+    raise KeyError(i)
+
+class C(object):
+    def raiser(self, i):
+        raise KeyError(i)
+
+def f(n):
+    d = {}
+    c = C()
+    caught = 0
+    for i in xrange(n):
+        try:
+            d[i]
+        except KeyError:
+            caught += 1
+        try:
+            raiser(i)
+        except KeyError:
+            caught += 1
+        try:
+            c.raiser(i)
+        except KeyError:
+            caught += 1
+    return caught
+
+print f(1000000)
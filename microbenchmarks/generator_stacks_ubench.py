@@ -0,0 +1,18 @@
+# Creates lots of generators that need stacks of their own (they yield inside of a try block),
+# with a bunch of them alive at a time.
+
+def g(n):
+    try:
+        for i in xrange(n):
+            yield i
+    finally:
+        pass
+
+def f():
+    total = 0
+    for i in xrange(20000):
+        gens = [g(5) for j in xrange(10)]
+        for x in gens:
+            total += sum(x)
+    print total
+f()
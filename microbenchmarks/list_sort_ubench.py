@@ -0,0 +1,20 @@
+# Sorts big lists that are mostly sorted already, the way ranking code tends to.
+
+def f():
+    base = range(100000)
+    total = 0
+    for i in xrange(20):
+        l = list(base)
+        for j in xrange(0, 100000, 1000):
+            l[j] = 100000 - j
+        l.sort()
+        total += l[500]
+
+        s = [str(x) for x in l[:20000]]
+        s.sort()
+        fl = [x * 0.5 for x in l[:20000]]
+        fl.sort(reverse=True)
+        k = sorted(l[:20000], key=lambda x: -x)
+        total += len(s[0]) + int(fl[0]) + k[0]
+    print total
+f()
@@ -0,0 +1,15 @@
+# Exceptions that travel through a lot of frames before getting caught, without anyone
+# looking at their traceback.
+
+def f(n):
+    if n == 0:
+        raise ValueError()
+    f(n - 1)
+
+def main():
+    for i in xrange(20000):
+        try:
+            f(30)
+        except ValueError:
+            pass
+main()
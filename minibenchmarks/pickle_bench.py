@@ -0,0 +1,49 @@
+# Pickle/unpickle throughput on RPC-style payloads: nested dicts and lists of ints, floats and strings,
+# plus some instances of new- and old-style classes.
+
+import cPickle
+import time
+
+class Point(object):
+    def __init__(self, x, y):
+        self.x = x
+        self.y = y
+
+class OldPoint:
+    def __init__(self, x, y):
+        self.x = x
+        self.y = y
+
+def make_payload(n):
+    rows = []
+    for i in xrange(n):
+        rows.append({
+            "id": i,
+            "name": "user%d" % i,
+            "email": "user%d@example.com" % i,
+            "score": i * 1.5,
+            "tags": ["a", "b", str(i % 10)],
+            "flags": (i % 2 == 0, i % 3 == 0, None),
+            "big": 10 ** 20 + i,
+            "location": Point(i, -i) if i % 2 else OldPoint(i, -i),
+        })
+    return {"status": "ok", "version": 3, "rows": rows}
+
+def run(payload, protocol, iterations):
+    nbytes = 0
+    for i in xrange(iterations):
+        s = cPickle.dumps(payload, protocol)
+        nbytes += len(s)
+        r = cPickle.loads(s)
+    assert len(r["rows"]) == len(payload["rows"])
+    return nbytes
+
+def main():
+    payload = make_payload(100)
+    for protocol, iterations in [(2, 1000), (0, 200)]:
+        start = time.time()
+        nbytes = run(payload, protocol, iterations)
+        elapsed = time.time() - start
+        print "protocol %d: %.1f MB/s" % (protocol, nbytes / elapsed / 1e6)
+
+main()
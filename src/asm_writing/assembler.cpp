@@ -671,6 +671,43 @@ void Assembler::decl(Immediate imm) {
     emitInt(imm.val, 4);
 }
 
+void Assembler::incq(Indirect mem) {
+    int src_idx = mem.base.regnum;
+
+    int rex = REX_W;
+    if (src_idx >= 8) {
+        rex |= REX_B;
+        src_idx -= 8;
+    }
+
+    assert(src_idx >= 0 && src_idx < 8);
+
+    emitRex(rex);
+    emitByte(0xff);
+
+    bool needssib = (src_idx == 0b100);
+
+    assert(-0x80 <= mem.offset && mem.offset < 0x80);
+    if (mem.offset == 0) {
+        emitModRM(0b00, 0, src_idx);
+        if (needssib)
+            emitSIB(0b00, 0b100, src_idx);
+    } else {
+        emitModRM(0b01, 0, src_idx);
+        if (needssib)
+            emitSIB(0b00, 0b100, src_idx);
+        emitByte(mem.offset);
+    }
+}
+
+void Assembler::incq(Immediate imm) {
+    emitRex(REX_W);
+    emitByte(0xff);
+    emitByte(0x04);
+    emitByte(0x25);
+    emitInt(imm.val, 4);
+}
+
 void Assembler::call(Immediate imm) {
     emitByte(0xe8);
     emitInt(imm.val, 4);
@@ -115,6 +115,8 @@ public:
 
     void nop() { emitByte(0x90); }
     void trap() { emitByte(0xcc); }
+    // Makes the next instruction atomic:
+    void lock() { emitByte(0xf0); }
 
     // emits a movabs if the immediate is a 64bit value or force_64bit_load = true otherwise it emits a 32bit mov
     void mov(Immediate imm, Register dest, bool force_64bit_load = false);
@@ -158,6 +160,9 @@ public:
     void incl(Immediate mem);
     void decl(Immediate mem);
 
+    void incq(Indirect mem);
+    void incq(Immediate mem);
+
     void call(Immediate imm); // the value is the offset
     void callq(Register reg);
     void retq();
@@ -14,6 +14,7 @@
 
 #include "asm_writing/icinfo.h"
 
+#include <algorithm>
 #include <cstring>
 #include <memory>
 
@@ -22,8 +23,10 @@
 #include "asm_writing/assembler.h"
 #include "asm_writing/mc_writer.h"
 #include "codegen/patchpoints.h"
+#include "codegen/profiling/perf_map.h"
 #include "core/common.h"
 #include "core/options.h"
+#include "core/threading.h"
 #include "core/types.h"
 
 namespace pyston {
@@ -33,6 +36,12 @@ using namespace pyston::assembler;
 #define MEGAMORPHIC_THRESHOLD 100
 #define MAX_RETRY_BACKOFF 1024
 
+// How many times rewrites have to fail for a given lack of space before we ask for a bigger IC,
+// and the largest IC that we'll ask for:
+#define GROW_THRESHOLD 4
+#define MAX_GROWN_NUM_SLOTS 8
+#define MAX_GROWN_SLOT_SIZE 4096
+
 // TODO not right place for this...
 int64_t ICInvalidator::version() {
     return cur_version;
@@ -73,6 +82,14 @@ void ICSlotRewrite::abort() {
     ic->retry_in = ic->retry_backoff;
 }
 
+void ICSlotRewrite::noteNoSpace(bool no_free_slot) {
+    ic->noteNoSpace(no_free_slot);
+}
+
+bool ICSlotRewrite::shouldCountHits() {
+    return ic->count_hits;
+}
+
 ICSlotInfo* ICSlotRewrite::prepareEntry() {
     this->ic_entry = ic->pickEntryForRewrite(debug_name);
     return this->ic_entry;
@@ -83,17 +100,18 @@ uint8_t* ICSlotRewrite::getSlotStart() {
     return (uint8_t*)ic->start_addr + ic_entry->idx * ic->getSlotSize();
 }
 
-void ICSlotRewrite::commit(CommitHook* hook) {
-    bool still_valid = true;
+bool ICSlotRewrite::dependenciesStillValid() {
     for (int i = 0; i < dependencies.size(); i++) {
         int orig_version = dependencies[i].second;
         ICInvalidator* invalidator = dependencies[i].first;
-        if (orig_version != invalidator->version()) {
-            still_valid = false;
-            break;
-        }
+        if (orig_version != invalidator->version())
+            return false;
     }
-    if (!still_valid) {
+    return true;
+}
+
+void ICSlotRewrite::commit(CommitHook* hook) {
+    if (!dependenciesStillValid()) {
         if (VERBOSITY() >= 3)
             printf("not committing %s icentry since a dependency got updated before commit\n", debug_name);
         return;
@@ -109,12 +127,45 @@ void ICSlotRewrite::commit(CommitHook* hook) {
 
     assert(!assembler.hasFailed());
 
+    // With the GRWL, other threads could be running the code in this slot, so wait for all of them to stop before
+    // overwriting it.  A thread could also have entered the slot since we picked it, in which case we can't use it.
+    // Other threads could also have invalidated one of our dependencies while we were waiting.
+    threading::GLPromoteRegion _gl;
+    if (ic_entry->num_inside) {
+        if (VERBOSITY() >= 3)
+            printf("not committing %s icentry since the slot got entered before commit\n", debug_name);
+        return;
+    }
+    if (!dependenciesStillValid()) {
+        if (VERBOSITY() >= 3)
+            printf("not committing %s icentry since a dependency got updated while promoting\n", debug_name);
+        return;
+    }
+
     for (int i = 0; i < dependencies.size(); i++) {
         ICInvalidator* invalidator = dependencies[i].first;
         invalidator->addDependent(ic_entry);
     }
 
-    ic->next_slot_to_try++;
+    if (ic_entry->occupied) {
+        static StatCounter ic_evictions("ic_evictions");
+        static StatCounter ic_hot_evictions("ic_hot_evictions");
+
+        ic_evictions.log();
+        ic->total_evictions++;
+        // If the slot we're replacing was still getting used, we probably would have liked to keep it:
+        if (ic_entry->num_hits > 0) {
+            ic_hot_evictions.log();
+            ic->num_hot_evictions++;
+        }
+
+        for (ICSlotInfo& slot : ic->slots)
+            slot.num_hits /= 2;
+    }
+    ic_entry->num_hits = 0;
+    ic_entry->occupied = true;
+    ic->next_slot_to_try = (ic_entry->idx + 1) % ic->getNumSlots();
+    ic->debug_name = debug_name;
 
     // if (VERBOSITY()) printf("Commiting to %p-%p\n", start, start + ic->slot_size);
     memcpy(slot_start, buf, ic->getSlotSize());
@@ -127,6 +178,15 @@ void ICSlotRewrite::commit(CommitHook* hook) {
     }
 
     llvm::sys::Memory::InvalidateInstructionCache(slot_start, ic->getSlotSize());
+
+    // Baseline JIT fragments come through here too, but they get registered by the JIT itself and have no name.
+    if (PERF_MAP && debug_name && debug_name[0]) {
+        char name[256];
+        snprintf(name, sizeof(name), "%s [ic slot %d]", debug_name, ic_entry->idx);
+        registerPerfMapRegion(slot_start, ic->getSlotSize(), name);
+    }
+
+    ic->maybeGrow();
 }
 
 void ICSlotRewrite::addDependenceOn(ICInvalidator& invalidator) {
@@ -162,6 +222,7 @@ std::unique_ptr<ICSlotRewrite> ICInfo::startRewrite(const char* debug_name) {
 
 ICSlotInfo* ICInfo::pickEntryForRewrite(const char* debug_name) {
     int num_slots = getNumSlots();
+    ICSlotInfo* best = NULL;
     for (int _i = 0; _i < num_slots; _i++) {
         int i = (_i + next_slot_to_try) % num_slots;
 
@@ -170,21 +231,72 @@ ICSlotInfo* ICInfo::pickEntryForRewrite(const char* debug_name) {
         if (sinfo.num_inside)
             continue;
 
-        if (VERBOSITY() >= 4) {
-            printf("picking %s icentry to in-use slot %d at %p\n", debug_name, i, start_addr);
+        // Empty slots are always the best choice:
+        if (!sinfo.occupied) {
+            best = &sinfo;
+            break;
         }
 
-        next_slot_to_try = i;
-        return &sinfo;
+        if (!best || sinfo.num_hits < best->num_hits)
+            best = &sinfo;
     }
-    if (VERBOSITY() >= 4)
-        printf("not committing %s icentry since there are no available slots\n", debug_name);
-    return NULL;
+
+    if (!best) {
+        if (VERBOSITY() >= 4)
+            printf("not committing %s icentry since there are no available slots\n", debug_name);
+        return NULL;
+    }
+
+    if (VERBOSITY() >= 4) {
+        printf("picking %s icentry to %s slot %d (%ld hits) at %p\n", debug_name,
+               best->occupied ? "in-use" : "empty", best->idx, best->num_hits, start_addr);
+    }
+
+    return best;
+}
+
+void ICInfo::noteNoSpace(bool no_free_slot) {
+    if (no_free_slot) {
+        num_no_free_slot++;
+        total_no_free_slot++;
+    } else {
+        num_too_large++;
+        total_too_large++;
+    }
+
+    maybeGrow();
+}
+
+void ICInfo::maybeGrow() {
+    if (!grow_hook)
+        return;
+
+    int new_num_slots = num_slots;
+    int new_slot_size = slot_size;
+    if (num_too_large >= GROW_THRESHOLD)
+        new_slot_size = std::max(slot_size, std::min(2 * slot_size, MAX_GROWN_SLOT_SIZE));
+    if (num_no_free_slot >= GROW_THRESHOLD || num_hot_evictions >= GROW_THRESHOLD)
+        new_num_slots = std::max(num_slots, std::min(2 * num_slots, MAX_GROWN_NUM_SLOTS));
+
+    if (new_num_slots == num_slots && new_slot_size == slot_size)
+        return;
+
+    static StatCounter ic_grows("ic_grows");
+    ic_grows.log();
+
+    if (VERBOSITY() >= 3)
+        printf("growing the IC at %p from %d slots of %d bytes to %d slots of %d bytes\n", start_addr, num_slots,
+               slot_size, new_num_slots, new_slot_size);
+
+    // The hook will replace us with a new IC, so we only get to do this once:
+    GrowHook hook = std::move(grow_hook);
+    grow_hook = GrowHook();
+    hook(new_num_slots, new_slot_size);
 }
 
 ICInfo::ICInfo(void* start_addr, void* slowpath_rtn_addr, void* continue_addr, StackInfo stack_info, int num_slots,
                int slot_size, llvm::CallingConv::ID calling_conv, const std::unordered_set<int>& live_outs,
-               assembler::GenericRegister return_register, TypeRecorder* type_recorder)
+               assembler::GenericRegister return_register, TypeRecorder* type_recorder, bool count_hits)
     : next_slot_to_try(0),
       stack_info(stack_info),
       num_slots(num_slots),
@@ -196,6 +308,14 @@ ICInfo::ICInfo(void* start_addr, void* slowpath_rtn_addr, void* continue_addr, S
       retry_in(0),
       retry_backoff(1),
       times_rewritten(0),
+      count_hits(count_hits),
+      debug_name(NULL),
+      num_too_large(0),
+      num_no_free_slot(0),
+      num_hot_evictions(0),
+      total_too_large(0),
+      total_no_free_slot(0),
+      total_evictions(0),
       start_addr(start_addr),
       slowpath_rtn_addr(slowpath_rtn_addr),
       continue_addr(continue_addr) {
@@ -246,8 +366,9 @@ std::unique_ptr<ICInfo> registerCompiledPatchpoint(uint8_t* start_addr, uint8_t*
         writer.jmp(JumpDestination::fromStart(slowpath_start_addr - start));
     }
 
-    ICInfo* icinfo = new ICInfo(start_addr, slowpath_rtn_addr, continue_addr, stack_info, ic->num_slots, ic->slot_size,
-                                ic->getCallingConvention(), live_outs, return_register, ic->type_recorder);
+    ICInfo* icinfo
+        = new ICInfo(start_addr, slowpath_rtn_addr, continue_addr, stack_info, ic->num_slots, ic->slot_size,
+                     ic->getCallingConvention(), live_outs, return_register, ic->type_recorder, true /* count_hits */);
 
     ics_by_return_addr[slowpath_rtn_addr] = icinfo;
 
@@ -267,6 +388,18 @@ ICInfo* getICInfo(void* rtn_addr) {
     return it->second;
 }
 
+void dumpICStats() {
+    std::vector<ICInfo*> ics;
+    for (auto&& p : ics_by_return_addr)
+        ics.push_back(p.second);
+    std::sort(ics.begin(), ics.end(), [](ICInfo* lhs, ICInfo* rhs) { return lhs->start_addr < rhs->start_addr; });
+
+    fprintf(stderr, "IC stats:\n");
+    for (ICInfo* ic : ics)
+        ic->dumpStats(stderr);
+    fprintf(stderr, "(End of IC stats)\n");
+}
+
 void ICInfo::clear(ICSlotInfo* icentry) {
     assert(icentry);
 
@@ -280,6 +413,9 @@ void ICInfo::clear(ICSlotInfo* icentry) {
     writer.jmp(JumpDestination::fromStart(getSlotSize()));
     assert(writer.bytesWritten() <= IC_INVALDITION_HEADER_SIZE);
 
+    icentry->occupied = false;
+    icentry->num_hits = 0;
+
     // std::unique_ptr<MCWriter> writer(createMCWriter(start, getSlotSize(), 0));
     // writer->emitNop();
     // writer->emitGuardFalse();
@@ -303,4 +439,19 @@ bool ICInfo::shouldAttempt() {
 bool ICInfo::isMegamorphic() {
     return times_rewritten >= MEGAMORPHIC_THRESHOLD;
 }
+
+void ICInfo::dumpStats(FILE* f) {
+    // One line per IC; an empty slot's hit count is printed as "-".  The name goes last since it's free-form.
+    fprintf(f, "ic %p slots=%d slot_size=%d rewrites=%d too_large=%ld no_free_slot=%ld evictions=%ld hits=", start_addr,
+            num_slots, slot_size, times_rewritten, total_too_large, total_no_free_slot, total_evictions);
+    for (int i = 0; i < slots.size(); i++) {
+        if (i)
+            fprintf(f, ",");
+        if (slots[i].occupied)
+            fprintf(f, "%ld", slots[i].num_hits);
+        else
+            fprintf(f, "-");
+    }
+    fprintf(f, " name=%s\n", debug_name ? debug_name : "");
+}
 }
@@ -15,6 +15,7 @@
 #ifndef PYSTON_ASMWRITING_ICINFO_H
 #define PYSTON_ASMWRITING_ICINFO_H
 
+#include <functional>
 #include <memory>
 #include <unordered_set>
 #include <vector>
@@ -35,11 +36,13 @@ class ICInvalidator;
 
 struct ICSlotInfo {
 public:
-    ICSlotInfo(ICInfo* ic, int idx) : ic(ic), idx(idx), num_inside(0) {}
+    ICSlotInfo(ICInfo* ic, int idx) : ic(ic), idx(idx), num_inside(0), num_hits(0), occupied(false) {}
 
     ICInfo* ic;
-    int idx;        // the index inside the ic
-    int num_inside; // the number of stack frames that are currently inside this slot
+    int idx;          // the index inside the ic
+    int num_inside;   // the number of stack frames that are currently inside this slot
+    int64_t num_hits; // incremented by the slot's code every time its guards pass; decays on evictions
+    bool occupied;    // whether the slot currently contains a rewrite
 
     void clear();
 };
@@ -64,6 +67,8 @@ private:
 
     ICSlotInfo* ic_entry;
 
+    bool dependenciesStillValid();
+
 public:
     ICSlotRewrite(ICInfo* ic, const char* debug_name);
     ~ICSlotRewrite();
@@ -83,6 +88,12 @@ public:
     void addDependenceOn(ICInvalidator&);
     void commit(CommitHook* hook);
     void abort();
+    // For when the rewrite got aborted because it didn't fit into a slot, or there was no slot we could use.
+    // The IC uses these to decide when it should ask for more or bigger slots.
+    void noteNoSpace(bool no_free_slot);
+
+    // Whether the rewrite should emit code to count the hits of its slot:
+    bool shouldCountHits();
 
     const ICInfo* getICInfo() { return ic; }
 
@@ -92,13 +103,16 @@ public:
 };
 
 class ICInfo {
+public:
+    // Called when rewrites keep failing for lack of space, with the number and size of slots that the
+    // IC would like to have.  Whoever created the patchpoint can regenerate it if they are able to.
+    typedef std::function<void(int num_slots, int slot_size)> GrowHook;
+
 private:
     std::vector<ICSlotInfo> slots;
-    // For now, just use a round-robin eviction policy.
-    // This is probably a bunch worse than LRU, but it's also
-    // probably a bunch better than the "always evict slot #0" policy
-    // that it's replacing.
-    // TODO: experiment with different IC eviction strategies.
+    // The slot code counts its hits, and we evict the least-frequently-used slot.  We halve all
+    // of the hit counts on every eviction so that slots that used to be hot eventually age out.
+    // Ties (ex between slots that have never been hit) go round-robin, starting at next_slot_to_try.
     int next_slot_to_try;
 
     const StackInfo stack_info;
@@ -110,18 +124,29 @@ private:
     TypeRecorder* const type_recorder;
     int retry_in, retry_backoff;
     int times_rewritten;
+    const bool count_hits;
+    const char* debug_name; // of the last committed rewrite
+
+    // Reasons that rewrites didn't find room, since we last asked to grow:
+    int num_too_large, num_no_free_slot, num_hot_evictions;
+    int64_t total_too_large, total_no_free_slot, total_evictions;
+    GrowHook grow_hook;
 
     // for ICSlotRewrite:
     ICSlotInfo* pickEntryForRewrite(const char* debug_name);
+    void noteNoSpace(bool no_free_slot);
+    void maybeGrow();
 
 public:
     ICInfo(void* start_addr, void* slowpath_rtn_addr, void* continue_addr, StackInfo stack_info, int num_slots,
            int slot_size, llvm::CallingConv::ID calling_conv, const std::unordered_set<int>& live_outs,
-           assembler::GenericRegister return_register, TypeRecorder* type_recorder);
+           assembler::GenericRegister return_register, TypeRecorder* type_recorder, bool count_hits);
     void* const start_addr, *const slowpath_rtn_addr, *const continue_addr;
 
     int getSlotSize() { return slot_size; }
     int getNumSlots() { return num_slots; }
+    const std::vector<ICSlotInfo>& getSlots() { return slots; }
+    void setGrowHook(GrowHook hook) { grow_hook = std::move(hook); }
     llvm::CallingConv::ID getCallingConvention() { return calling_conv; }
     const std::vector<int>& getLiveOuts() { return live_outs; }
 
@@ -131,6 +156,8 @@ public:
     bool shouldAttempt();
     bool isMegamorphic();
 
+    void dumpStats(FILE* f);
+
     friend class ICSlotRewrite;
 };
 
@@ -143,6 +170,9 @@ std::unique_ptr<ICInfo> registerCompiledPatchpoint(uint8_t* start_addr, uint8_t*
 void deregisterCompiledPatchpoint(ICInfo* ic);
 
 ICInfo* getICInfo(void* rtn_addr);
+
+// Prints the per-slot statistics of every live patchpoint, for tools/ic_stats.py to read.
+void dumpICStats();
 }
 
 #endif
@@ -843,8 +843,12 @@ void Rewriter::_setupCall(RewriterVar* result, bool has_side_effects, const Rewr
             if (isLargeConstant(counter_addr)) {
                 assembler::Register reg = allocReg(Location::any(), getReturnDestination());
                 assembler->mov(assembler::Immediate(counter_addr), reg);
+                if (THREADING_SAFE_DATASTRUCTURES)
+                    assembler->lock();
                 assembler->incl(assembler::Indirect(reg, 0));
             } else {
+                if (THREADING_SAFE_DATASTRUCTURES)
+                    assembler->lock();
                 assembler->incl(assembler::Immediate(counter_addr));
             }
 
@@ -1087,7 +1091,7 @@ void Rewriter::commit() {
         return;
     }
 
-    auto on_assemblyfail = [&]() {
+    auto on_assemblyfail = [&](bool no_free_slot) {
         ic_rewrites_aborted_assemblyfail.log();
 #if 0
         std::string per_name_stat_name = "ic_rewrites_aborted_assemblyfail_" + std::string(debugName());
@@ -1095,10 +1099,11 @@ void Rewriter::commit() {
         Stats::log(counter);
 #endif
         this->abort();
+        rewrite->noteNoSpace(no_free_slot);
     };
 
     if (assembler->hasFailed()) {
-        on_assemblyfail();
+        on_assemblyfail(false);
         return;
     }
 
@@ -1145,7 +1150,7 @@ void Rewriter::commit() {
 
     picked_slot = rewrite->prepareEntry();
     if (picked_slot == NULL) {
-        on_assemblyfail();
+        on_assemblyfail(true);
         return;
     }
 
@@ -1165,6 +1170,19 @@ void Rewriter::commit() {
         }
     }
 
+    if (rewrite->shouldCountHits()) {
+        assembler->comment("count ic hit");
+
+        uintptr_t counter_addr = (uintptr_t)(&picked_slot->num_hits);
+        if (isLargeConstant(counter_addr)) {
+            assembler::Register reg = allocReg(Location::any(), getReturnDestination());
+            assembler->mov(assembler::Immediate(counter_addr), reg);
+            assembler->incq(assembler::Indirect(reg, 0));
+        } else {
+            assembler->incq(assembler::Immediate(counter_addr));
+        }
+    }
+
     if (marked_inside_ic) {
         assembler->comment("mark inside ic");
 
@@ -1172,8 +1190,12 @@ void Rewriter::commit() {
         if (isLargeConstant(counter_addr)) {
             assembler::Register reg = allocReg(Location::any(), getReturnDestination());
             assembler->mov(assembler::Immediate(counter_addr), reg);
+            if (THREADING_SAFE_DATASTRUCTURES)
+                assembler->lock();
             assembler->decl(assembler::Indirect(reg, 0));
         } else {
+            if (THREADING_SAFE_DATASTRUCTURES)
+                assembler->lock();
             assembler->decl(assembler::Immediate(counter_addr));
         }
     }
@@ -1290,7 +1312,7 @@ void Rewriter::commit() {
 #endif
 
     if (assembler->hasFailed()) {
-        on_assemblyfail();
+        on_assemblyfail(false);
         return;
     }
 
@@ -1306,7 +1328,7 @@ void Rewriter::commit() {
     rewrite->commit(this);
 
     if (assembler->hasFailed()) {
-        on_assemblyfail();
+        on_assemblyfail(false);
         return;
     }
 
@@ -3002,7 +3002,27 @@ void commonClassSetup(BoxedClass* cls) {
 }
 
 extern "C" void PyType_Modified(PyTypeObject* type) noexcept {
-    // We don't cache anything yet that would need to be invalidated:
+    /* Invalidate any cached typeLookup() results for this type and its subclasses.
+
+       The invariant is that if a type has a valid version tag, then all of its bases do
+       too (see assignVersionTag() in objmodel.cpp), so we can stop recursing as soon as
+       we find a type that doesn't have one. */
+    if (!PyType_HasFeature(type, Py_TPFLAGS_VALID_VERSION_TAG))
+        return;
+
+    PyObject* raw = type->tp_subclasses;
+    if (raw != NULL) {
+        assert(PyList_Check(raw));
+        Py_ssize_t n = PyList_GET_SIZE(raw);
+        for (Py_ssize_t i = 0; i < n; i++) {
+            PyObject* ref = PyList_GET_ITEM(raw, i);
+            ref = PyWeakref_GET_OBJECT(ref);
+            if (ref != Py_None)
+                PyType_Modified((PyTypeObject*)ref);
+        }
+    }
+
+    type->tp_flags &= ~Py_TPFLAGS_VALID_VERSION_TAG;
 }
 
 static Box* tppProxyToTpCall(Box* self, CallRewriteArgs* rewrite_args, ArgPassSpec argspec, Box* arg1, Box* arg2,
@@ -3051,11 +3071,13 @@ extern "C" int PyType_Ready(PyTypeObject* cls) noexcept {
 
     // unhandled fields:
     int ALLOWABLE_FLAGS = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_GC | Py_TPFLAGS_CHECKTYPES
-                          | Py_TPFLAGS_HAVE_NEWBUFFER;
+                          | Py_TPFLAGS_HAVE_NEWBUFFER | Py_TPFLAGS_HAVE_VERSION_TAG;
     ALLOWABLE_FLAGS |= Py_TPFLAGS_INT_SUBCLASS | Py_TPFLAGS_LONG_SUBCLASS | Py_TPFLAGS_LIST_SUBCLASS
                        | Py_TPFLAGS_TUPLE_SUBCLASS | Py_TPFLAGS_STRING_SUBCLASS | Py_TPFLAGS_UNICODE_SUBCLASS
                        | Py_TPFLAGS_DICT_SUBCLASS | Py_TPFLAGS_BASE_EXC_SUBCLASS | Py_TPFLAGS_TYPE_SUBCLASS;
     RELEASE_ASSERT((cls->tp_flags & ~ALLOWABLE_FLAGS) == 0, "");
+    // Extensions can't modify our tp_dict behind our back (it's an attrwrapper), so it's always safe to cache lookups:
+    cls->tp_flags |= Py_TPFLAGS_HAVE_VERSION_TAG;
     if (cls->tp_as_number) {
         RELEASE_ASSERT(cls->tp_flags & Py_TPFLAGS_CHECKTYPES, "Pyston doesn't yet support non-checktypes behavior");
     }
@@ -14,6 +14,7 @@
 
 #include "codegen/ast_interpreter.h"
 
+#include <algorithm>
 #include <llvm/ADT/DenseMap.h>
 #include <llvm/ADT/StringMap.h>
 #include <unordered_map>
@@ -27,11 +28,11 @@
 #include "codegen/irgen/hooks.h"
 #include "codegen/irgen/irgenerator.h"
 #include "codegen/irgen/util.h"
+#include "codegen/jit_profile_cache.h"
 #include "codegen/osrentry.h"
 #include "core/ast.h"
 #include "core/cfg.h"
 #include "core/common.h"
-#include "core/contiguous_map.h"
 #include "core/stats.h"
 #include "core/thread_utils.h"
 #include "core/util.h"
@@ -52,6 +53,31 @@
 
 namespace pyston {
 
+AST_expr* getCapiExpr(AST_stmt* stmt) {
+    AST_expr* value;
+    if (stmt->type == AST_TYPE::Assign) {
+        AST_Assign* asgn = ast_cast<AST_Assign>(stmt);
+        if (asgn->targets[0]->type != AST_TYPE::Name)
+            return NULL;
+        value = asgn->value;
+    } else if (stmt->type == AST_TYPE::Expr) {
+        value = ast_cast<AST_Expr>(stmt)->value;
+    } else {
+        return NULL;
+    }
+
+    if (value->type == AST_TYPE::Subscript)
+        return value;
+
+    if (value->type != AST_TYPE::Call)
+        return NULL;
+
+    AST_Call* call = ast_cast<AST_Call>(value);
+    if (call->args.size() > 3 || call->keywords.size() || call->starargs || call->kwargs)
+        return NULL;
+    return call;
+}
+
 namespace {
 
 static BoxedClass* astinterpreter_cls;
@@ -62,7 +88,7 @@ class ASTInterpreter;
 // them. Used to look up information about that frame. This is used for getting tracebacks, for CPython introspection
 // (sys._getframe & co), and for GC scanning.
 static std::unordered_map<void*, ASTInterpreter*> s_interpreterMap;
-static_assert(THREADING_USE_GIL, "have to make the interpreter map thread safe!");
+static DS_DEFINE_MUTEX(s_interpreterMap_lock);
 
 class RegisterHelper {
 private:
@@ -84,9 +110,8 @@ public:
  */
 class ASTInterpreter : public Box {
 public:
-    typedef ContiguousMap<InternedString, Box*, llvm::SmallDenseMap<InternedString, int, 16>> SymMap;
-
     ASTInterpreter(CLFunction* clfunc);
+    ~ASTInterpreter() { delete[] vregs; }
 
     void initArguments(int nargs, BoxedClosure* closure, BoxedGenerator* generator, Box* arg1, Box* arg2, Box* arg3,
                        Box** args);
@@ -102,8 +127,15 @@ private:
     Box* createFunction(AST* node, AST_arguments* args, const std::vector<AST_stmt*>& body);
     Value doBinOp(Value left, Value right, int op, BinExpType exp_type);
     void doStore(AST_expr* node, Value value);
-    void doStore(InternedString name, Value value);
+    void doStore(InternedString name, ScopeInfo::VarScopeType vst, int vreg, Value value);
     Box* doOSR(AST_Jump* node);
+    ExcInfo doRaise(AST_Raise* node, bool caught);
+    // Run an invoke's statement so that the exception (if any) comes back as a NULL value instead of getting thrown.
+    Value doCapiInvoke(AST_Invoke* node, AST_expr* expr);
+    Value doCapiCall(AST_Invoke* node, AST_Call* call);
+    Value doCapiSubscript(AST_Invoke* node, AST_Subscript* sub);
+    Value doStacklessYield(AST_Assign* node);
+    void resumeGenerator(Box* value);
     Value getNone();
 
     Value visit_assert(AST_Assert* node);
@@ -154,6 +186,13 @@ private:
     void startJITing(CFGBlock* block, int exit_offset = 0);
     void abortJITing();
     void finishJITing(CFGBlock* continue_block = NULL);
+
+    // The two ways an exception can leave a statement without getting thrown any further: to the handler of the
+    // invoke that it happened in, or (with ExceptionStyle::CAPI) to our caller.
+    void catchInvokeException(AST_Invoke* node, ExcInfo exc_info);
+    void returnCapiException(AST_stmt* node, ExcInfo exc_info);
+    // Makes sure that last_exception is set when we get to a landingpad.
+    void fetchCapiInvokeException();
     // This method is not allowed to get inlined into 'executeInner' otherwise tracebacks are wrong.
     __attribute__((__no_inline__)) __attribute__((noinline)) Box* execJITedBlock(CFGBlock* b);
 
@@ -161,13 +200,15 @@ private:
     // instructions
     CFGBlock* next_block, *current_block;
     AST_stmt* current_inst;
+    // The values of the FAST and CLOSURE names, indexed by the vregs the CFG assigned to them. NULL means undefined.
+    Box** vregs;
 
     CLFunction* clfunc;
     SourceInfo* source_info;
     ScopeInfo* scope_info;
     PhiAnalysis* phis;
 
-    SymMap sym_table;
+    int num_vregs;
     ExcInfo last_exception;
     BoxedClosure* passed_closure, *created_closure;
     BoxedGenerator* generator;
@@ -177,7 +218,19 @@ private:
     // This is either a module or a dict
     Box* globals;
     void* frame_addr; // used to clear entry inside the s_interpreterMap on destruction
+    // The OSR entry that we handed to the background compiler, if any:
+    const OSREntryDescriptor* awaiting_osr_entry;
     std::unique_ptr<JitFragmentWriter> jit;
+    ExceptionStyle exception_style;
+
+    // Set while we are running a stackless generator.  Such a frame can't OSR, since the compiled code would switch
+    // stacks when it yields; it can use the baseline jit since we never jit blocks containing a yield for functions
+    // whose generators can be stackless (see startJITing()).
+    bool stackless;
+    // Where a suspended stackless generator continues, and where the value it gets resumed with gets stored:
+    CFGBlock* resume_block;
+    AST_stmt* resume_at;
+    AST_expr* resume_target;
 
 public:
     DEFAULT_CLASS_SIMPLE(astinterpreter_cls);
@@ -195,7 +248,8 @@ public:
     CLFunction* getCL() { return clfunc; }
     FrameInfo* getFrameInfo() { return &frame_info; }
     BoxedClosure* getPassedClosure() { return passed_closure; }
-    const SymMap& getSymbolTable() { return sym_table; }
+    Box** getVRegs() { return vregs; }
+    int getNumVRegs() { return num_vregs; }
     const ScopeInfo* getScopeInfo() { return scope_info; }
 
     void addSymbol(InternedString name, Box* value, bool allow_duplicates);
@@ -205,6 +259,7 @@ public:
     void setBoxedLocals(Box*);
     void setFrameInfo(const FrameInfo* frame_info);
     void setGlobals(Box* globals);
+    void setExceptionStyle(ExceptionStyle style) { exception_style = style; }
 
     static void gcHandler(GCVisitor* visitor, Box* box);
     static void simpleDestructor(Box* box) {
@@ -217,12 +272,21 @@ public:
 
     friend class RegisterHelper;
     friend struct pyston::ASTInterpreterJitInterface;
+    friend Box* pyston::astCreateStacklessGeneratorFrame(BoxedGenerator* generator);
+    friend bool pyston::astResumeStacklessGenerator(Box* frame, Box* value);
+    friend bool pyston::astStacklessGeneratorIsHot(Box* frame);
+    friend void pyston::astResumeGeneratorOnStack(Box* frame, Box* value);
 };
 
 void ASTInterpreter::addSymbol(InternedString name, Box* value, bool allow_duplicates) {
+    // Names that don't have a vreg (ex the is-defined flags of the compiled code) aren't needed by the interpreter:
+    int vreg = source_info->cfg->getVReg(name);
+    if (vreg == -1)
+        return;
+
     if (!allow_duplicates)
-        assert(sym_table.count(name) == 0);
-    sym_table[name] = value;
+        assert(vregs[vreg] == NULL);
+    vregs[vreg] = value;
 }
 
 void ASTInterpreter::setGenerator(Box* gen) {
@@ -260,8 +324,7 @@ void ASTInterpreter::gcHandler(GCVisitor* visitor, Box* box) {
     boxGCHandler(visitor, box);
 
     ASTInterpreter* interp = (ASTInterpreter*)box;
-    auto&& vec = interp->sym_table.vector();
-    visitor->visitRange((void* const*)&vec[0], (void* const*)&vec[vec.size()]);
+    visitor->visitRange((void* const*)interp->vregs, (void* const*)(interp->vregs + interp->num_vregs));
     visitor->visit(interp->passed_closure);
     visitor->visit(interp->created_closure);
     visitor->visit(interp->generator);
@@ -273,10 +336,12 @@ void ASTInterpreter::gcHandler(GCVisitor* visitor, Box* box) {
 ASTInterpreter::ASTInterpreter(CLFunction* clfunc)
     : current_block(0),
       current_inst(0),
+      vregs(NULL),
       clfunc(clfunc),
       source_info(clfunc->source.get()),
       scope_info(0),
       phis(NULL),
+      num_vregs(0),
       last_exception(NULL, NULL, NULL),
       passed_closure(0),
       created_closure(0),
@@ -284,11 +349,22 @@ ASTInterpreter::ASTInterpreter(CLFunction* clfunc)
       edgecount(0),
       frame_info(ExcInfo(NULL, NULL, NULL)),
       globals(0),
-      frame_addr(0) {
+      frame_addr(0),
+      awaiting_osr_entry(NULL),
+      exception_style(ExceptionStyle::CXX),
+      stackless(false),
+      resume_block(NULL),
+      resume_at(NULL),
+      resume_target(NULL) {
 
     scope_info = source_info->getScopeInfo();
 
     assert(scope_info);
+
+    assert(source_info->cfg);
+    num_vregs = source_info->cfg->getNumVRegs();
+    if (num_vregs)
+        vregs = new Box*[num_vregs]();
 }
 
 void ASTInterpreter::initArguments(int nargs, BoxedClosure* _closure, BoxedGenerator* _generator, Box* arg1, Box* arg2,
@@ -305,17 +381,23 @@ void ASTInterpreter::initArguments(int nargs, BoxedClosure* _closure, BoxedGener
 
     const ParamNames& param_names = clfunc->param_names;
 
+    auto store_arg = [&](llvm::StringRef name, Box* value) {
+        InternedString interned = source_info->getInternedStrings().get(name);
+        doStore(interned, scope_info->getScopeTypeOfName(interned), source_info->cfg->getVReg(interned),
+                Value(value, 0));
+    };
+
     int i = 0;
     for (auto& name : param_names.args) {
-        doStore(source_info->getInternedStrings().get(name), Value(argsArray[i++], 0));
+        store_arg(name, argsArray[i++]);
     }
 
     if (!param_names.vararg.str().empty()) {
-        doStore(source_info->getInternedStrings().get(param_names.vararg), Value(argsArray[i++], 0));
+        store_arg(param_names.vararg, argsArray[i++]);
     }
 
     if (!param_names.kwarg.str().empty()) {
-        doStore(source_info->getInternedStrings().get(param_names.kwarg), Value(argsArray[i++], 0));
+        store_arg(param_names.kwarg, argsArray[i++]);
     }
 }
 
@@ -335,26 +417,53 @@ void RegisterHelper::doRegister(void* frame_addr, ASTInterpreter* interpreter) {
     this->frame_addr = frame_addr;
     this->interpreter = interpreter;
     interpreter->frame_addr = frame_addr;
+
+    LOCK_REGION(&s_interpreterMap_lock);
     s_interpreterMap[frame_addr] = interpreter;
 }
 
 void RegisterHelper::deregister(void* frame_addr) {
     assert(frame_addr);
+
+    LOCK_REGION(&s_interpreterMap_lock);
     assert(s_interpreterMap.count(frame_addr));
     s_interpreterMap.erase(frame_addr);
 }
 
+static ASTInterpreter* getInterpreterForFrame(void* frame_ptr) {
+    LOCK_REGION(&s_interpreterMap_lock);
+    auto it = s_interpreterMap.find(frame_ptr);
+    assert(it != s_interpreterMap.end());
+    return it->second;
+}
+
+static bool isYieldStmt(AST_stmt* stmt) {
+    if (stmt->type == AST_TYPE::Invoke)
+        stmt = ast_cast<AST_Invoke>(stmt)->stmt;
+    // The cfg turns every yield into a "#name = yield value" statement:
+    return stmt->type == AST_TYPE::Assign && ast_cast<AST_Assign>(stmt)->value->type == AST_TYPE::Yield;
+}
+
 void ASTInterpreter::startJITing(CFGBlock* block, int exit_offset) {
     assert(ENABLE_BASELINEJIT);
     assert(!jit);
 
+    // Jitted code yields by switching stacks, so stackless generators have to interpret blocks which contain a yield.
+    // Since jitted blocks jump directly to each other, we can't ever jit those blocks for such functions.
+    if (clfunc->stackless_generator == CLFunction::StacklessGenerator::YES) {
+        for (AST_stmt* stmt : block->body) {
+            if (isYieldStmt(stmt))
+                return;
+        }
+    }
+
     auto& code_blocks = clfunc->code_blocks;
     JitCodeBlock* code_block = NULL;
     if (!code_blocks.empty())
         code_block = code_blocks[code_blocks.size() - 1].get();
 
     if (!code_block || code_block->shouldCreateNewBlock()) {
-        code_blocks.push_back(std::unique_ptr<JitCodeBlock>(new JitCodeBlock(source_info->getName())));
+        code_blocks.push_back(std::unique_ptr<JitCodeBlock>(new JitCodeBlock(source_info->getName(), source_info->fn)));
         code_block = code_blocks[code_blocks.size() - 1].get();
         exit_offset = 0;
     }
@@ -378,6 +487,41 @@ void ASTInterpreter::finishJITing(CFGBlock* continue_block) {
         startJITing(continue_block, exit_offset);
 }
 
+void ASTInterpreter::catchInvokeException(AST_Invoke* node, ExcInfo exc_info) {
+    exceptionCaughtInInterpreter(node, getCL(), &exc_info);
+
+    next_block = node->exc_dest;
+    last_exception = exc_info;
+}
+
+void ASTInterpreter::fetchCapiInvokeException() {
+    if (last_exception.type)
+        return;
+
+    // The baseline JIT's CAPI calls side-exit straight to the exc_dest block, and leave the exception in the thread
+    // state for us to pick up here.  Only one invoke can get us here, since exc_dest blocks have a single predecessor.
+    assert(current_block->predecessors.size() == 1);
+    AST_Invoke* node = ast_cast<AST_Invoke>(current_block->predecessors[0]->body.back());
+
+    PyObject* type, *value, *traceback;
+    PyErr_Fetch(&type, &value, &traceback);
+    assert(type);
+    ExcInfo exc_info(type, value, traceback);
+    exceptionCaughtInInterpreter(node, getCL(), &exc_info);
+    last_exception = exc_info;
+}
+
+void ASTInterpreter::returnCapiException(AST_stmt* node, ExcInfo exc_info) {
+    assert(exception_style == ExceptionStyle::CAPI);
+
+    // Add our line to the traceback, the same way that the unwinder would have if we had thrown:
+    exceptionCaughtInInterpreter(node, getCL(), &exc_info);
+
+    assert(!PyErr_Occurred());
+    setCAPIException(exc_info);
+    next_block = 0;
+}
+
 Box* ASTInterpreter::execJITedBlock(CFGBlock* b) {
     try {
         UNAVOIDABLE_STAT_TIMER(t0, "us_timer_in_baseline_jitted_code");
@@ -390,11 +534,7 @@ Box* ASTInterpreter::execJITedBlock(CFGBlock* b) {
         if (stmt->type != AST_TYPE::Invoke)
             throw e;
 
-        auto source = getCL()->source.get();
-        exceptionCaughtInInterpreter(LineInfo(stmt->lineno, stmt->col_offset, source->fn, source->getName()), &e);
-
-        next_block = ((AST_Invoke*)stmt)->exc_dest;
-        last_exception = e;
+        catchInvokeException((AST_Invoke*)stmt, e);
     }
     return nullptr;
 }
@@ -415,7 +555,8 @@ Value ASTInterpreter::executeInner(ASTInterpreter& interpreter, CFGBlock* start_
         start_block = interpreter.source_info->cfg->getStartingBlock();
         start_at = start_block->body[0];
 
-        if (ENABLE_BASELINEJIT && interpreter.clfunc->times_interpreted >= REOPT_THRESHOLD_INTERPRETER
+        if (ENABLE_BASELINEJIT
+            && (interpreter.clfunc->times_interpreted >= REOPT_THRESHOLD_INTERPRETER || start_block->jit_eagerly)
             && !start_block->code)
             should_jit = true;
     }
@@ -437,6 +578,8 @@ Value ASTInterpreter::executeInner(ASTInterpreter& interpreter, CFGBlock* start_
 
             interpreter.current_inst = s;
             v = interpreter.visit_stmt(s);
+            if (interpreter.resume_block)
+                return Value();
         }
     } else {
         if (should_jit)
@@ -460,7 +603,7 @@ Value ASTInterpreter::executeInner(ASTInterpreter& interpreter, CFGBlock* start_
             }
         }
 
-        if (ENABLE_BASELINEJIT && should_jit && !interpreter.jit) {
+        if (ENABLE_BASELINEJIT && (should_jit || interpreter.current_block->jit_eagerly) && !interpreter.jit) {
             assert(!interpreter.current_block->code);
             interpreter.startJITing(interpreter.current_block);
         }
@@ -470,6 +613,8 @@ Value ASTInterpreter::executeInner(ASTInterpreter& interpreter, CFGBlock* start_
             if (interpreter.jit)
                 interpreter.jit->emitSetCurrentInst(s);
             v = interpreter.visit_stmt(s);
+            if (interpreter.resume_block)
+                return Value();
         }
     }
     return v;
@@ -478,16 +623,6 @@ Value ASTInterpreter::executeInner(ASTInterpreter& interpreter, CFGBlock* start_
 Value ASTInterpreter::execute(ASTInterpreter& interpreter, CFGBlock* start_block, AST_stmt* start_at) {
     UNAVOIDABLE_STAT_TIMER(t0, "us_timer_in_interpreter");
 
-    // Note: due to some (avoidable) restrictions, this check is pretty constrained in where
-    // it can go, due to the fact that it can throw an exception.
-    // It can't go in the ASTInterpreter constructor, since that will cause the C++ runtime to
-    // delete the partially-constructed memory which we don't currently handle.  It can't go into
-    // executeInner since we want the SyntaxErrors to happen *before* the stack frame is entered.
-    // (For instance, throwing the exception will try to fetch the current statement, but we determine
-    // that by looking at the cfg.)
-    if (!interpreter.source_info->cfg)
-        interpreter.source_info->cfg = computeCFG(interpreter.source_info, interpreter.source_info->body);
-
     RegisterHelper frame_registerer;
     return executeInner(interpreter, start_block, start_at, &frame_registerer);
 }
@@ -506,8 +641,7 @@ Value ASTInterpreter::doBinOp(Value left, Value right, int op, BinExpType exp_ty
     return Value();
 }
 
-void ASTInterpreter::doStore(InternedString name, Value value) {
-    ScopeInfo::VarScopeType vst = scope_info->getScopeTypeOfName(name);
+void ASTInterpreter::doStore(InternedString name, ScopeInfo::VarScopeType vst, int vreg, Value value) {
     if (vst == ScopeInfo::VarScopeType::GLOBAL) {
         if (jit)
             jit->emitSetGlobal(globals, name.getBox(), value);
@@ -524,14 +658,15 @@ void ASTInterpreter::doStore(InternedString name, Value value) {
             if (!closure) {
                 bool is_live = source_info->getLiveness()->isLiveAtEnd(name, current_block);
                 if (is_live)
-                    jit->emitSetLocal(name, closure, value);
+                    jit->emitSetLocal(vreg, value);
                 else
                     jit->emitSetBlockLocal(name, value);
             } else
-                jit->emitSetLocal(name, closure, value);
+                jit->emitSetLocalClosure(vreg, scope_info->getClosureOffset(name), value);
         }
 
-        sym_table[name] = value.o;
+        assert(vreg >= 0 && vreg < num_vregs);
+        vregs[vreg] = value.o;
         if (closure) {
             created_closure->elts[scope_info->getClosureOffset(name)] = value.o;
         }
@@ -541,7 +676,9 @@ void ASTInterpreter::doStore(InternedString name, Value value) {
 void ASTInterpreter::doStore(AST_expr* node, Value value) {
     if (node->type == AST_TYPE::Name) {
         AST_Name* name = (AST_Name*)node;
-        doStore(name->id, value);
+        if (name->lookup_type == ScopeInfo::VarScopeType::UNKNOWN)
+            name->lookup_type = scope_info->getScopeTypeOfName(name->id);
+        doStore(name->id, name->lookup_type, name->vreg, value);
     } else if (node->type == AST_TYPE::Attribute) {
         AST_Attribute* attr = (AST_Attribute*)node;
         Value o = visit_expr(attr->value);
@@ -674,7 +811,9 @@ Value ASTInterpreter::visit_jump(AST_Jump* node) {
     if (ENABLE_BASELINEJIT && backedge && edgecount == OSR_THRESHOLD_INTERPRETER && !jit && !node->target->code)
         startJITing(node->target);
 
-    if (backedge && edgecount == OSR_THRESHOLD_BASELINE) {
+    bool osr_compile_ready = awaiting_osr_entry && awaiting_osr_entry->backedge == node
+                             && awaiting_osr_entry->background_compile_done.load(std::memory_order_acquire);
+    if (backedge && (edgecount == OSR_THRESHOLD_BASELINE || osr_compile_ready)) {
         Box* rtn = doOSR(node);
         if (rtn)
             return Value(rtn, NULL);
@@ -685,10 +824,20 @@ Value ASTInterpreter::visit_jump(AST_Jump* node) {
 }
 
 Box* ASTInterpreter::doOSR(AST_Jump* node) {
+    // The compiled code would want to switch stacks when it yields:
+    if (stackless)
+        return NULL;
+
     bool can_osr = ENABLE_OSR && !FORCE_INTERPRETER && source_info->scoping->areGlobalsFromModule();
     if (!can_osr)
         return NULL;
 
+    if (ENABLE_BACKGROUND_COMPILATION) {
+        if (awaiting_osr_entry && !awaiting_osr_entry->background_compile_done.load(std::memory_order_acquire))
+            return NULL;
+        awaiting_osr_entry = NULL;
+    }
+
     static StatCounter ast_osrs("num_ast_osrs");
     ast_osrs.log();
 
@@ -696,17 +845,19 @@ Box* ASTInterpreter::doOSR(AST_Jump* node) {
     std::unique_ptr<PhiAnalysis> phis
         = computeRequiredPhis(clfunc->param_names, source_info->cfg, liveness, scope_info);
 
-    std::vector<InternedString> dead_symbols;
-    for (auto& it : sym_table) {
-        if (!liveness->isLiveAtEnd(it.first, current_block)) {
-            dead_symbols.push_back(it.first);
-        } else if (phis->isRequiredAfter(it.first, current_block)) {
-            assert(scope_info->getScopeTypeOfName(it.first) != ScopeInfo::VarScopeType::GLOBAL);
+    const std::vector<InternedString>& vreg_names = source_info->cfg->vreg_sym_map;
+    for (int vreg = 0; vreg < num_vregs; vreg++) {
+        if (!vregs[vreg])
+            continue;
+
+        InternedString name = vreg_names[vreg];
+        if (!liveness->isLiveAtEnd(name, current_block)) {
+            vregs[vreg] = NULL;
+        } else if (phis->isRequiredAfter(name, current_block)) {
+            assert(scope_info->getScopeTypeOfName(name) != ScopeInfo::VarScopeType::GLOBAL);
         } else {
         }
     }
-    for (auto&& dead : dead_symbols)
-        sym_table.erase(dead);
 
     const OSREntryDescriptor* found_entry = nullptr;
     for (auto& p : clfunc->osr_versions) {
@@ -722,21 +873,22 @@ Box* ASTInterpreter::doOSR(AST_Jump* node) {
     static Box* const VAL_UNDEFINED = (Box*)-1;
 
     for (auto& name : phis->definedness.getDefinedNamesAtEnd(current_block)) {
-        auto it = sym_table.find(name);
         if (!liveness->isLiveAtEnd(name, current_block))
             continue;
 
+        int vreg = source_info->cfg->getVReg(name);
+        ASSERT(vreg != -1, "%s", name.c_str());
+        Box* val = vregs[vreg];
+
         if (phis->isPotentiallyUndefinedAfter(name, current_block)) {
-            bool is_defined = it != sym_table.end();
+            bool is_defined = val != NULL;
             // TODO only mangle once
             sorted_symbol_table[getIsDefinedName(name, source_info->getInternedStrings())] = (Box*)is_defined;
-            if (is_defined)
-                assert(sym_table.getMapped(it->second) != NULL);
-            sorted_symbol_table[name] = is_defined ? sym_table.getMapped(it->second) : VAL_UNDEFINED;
+            sorted_symbol_table[name] = is_defined ? val : VAL_UNDEFINED;
         } else {
-            ASSERT(it != sym_table.end(), "%s", name.c_str());
-            Box* v = sorted_symbol_table[it->first] = sym_table.getMapped(it->second);
-            assert(gc::isValidGCObject(v));
+            ASSERT(val, "%s", name.c_str());
+            sorted_symbol_table[name] = val;
+            assert(gc::isValidGCObject(val));
         }
     }
 
@@ -762,8 +914,10 @@ Box* ASTInterpreter::doOSR(AST_Jump* node) {
 
     sorted_symbol_table[source_info->getInternedStrings().get(FRAME_INFO_PTR_NAME)] = (Box*)&frame_info;
 
+    // Only set if we made a new descriptor here, in which case nothing else refers to it yet.
+    OSREntryDescriptor* new_entry = NULL;
     if (found_entry == nullptr) {
-        OSREntryDescriptor* entry = OSREntryDescriptor::create(clfunc, node);
+        OSREntryDescriptor* entry = new_entry = OSREntryDescriptor::create(clfunc, node);
 
         for (auto& it : sorted_symbol_table) {
             if (isIsDefinedName(it.first))
@@ -783,6 +937,18 @@ Box* ASTInterpreter::doOSR(AST_Jump* node) {
         found_entry = entry;
     }
 
+    if (ENABLE_BACKGROUND_COMPILATION) {
+        // Don't wait for the compile; we'll check back the next time we take this backedge.
+        auto it = clfunc->osr_versions.find(found_entry);
+        if (it == clfunc->osr_versions.end() || it->second == NULL) {
+            if (queueBackgroundOSRCompile(clfunc, found_entry, EffortLevel::MAXIMAL))
+                awaiting_osr_entry = found_entry;
+            else
+                delete new_entry;
+            return NULL;
+        }
+    }
+
     OSRExit exit(found_entry);
 
     std::vector<Box*, StlCompatAllocator<Box*>> arg_array;
@@ -800,9 +966,114 @@ Box* ASTInterpreter::doOSR(AST_Jump* node) {
     return r;
 }
 
+Value ASTInterpreter::doCapiCall(AST_Invoke* node, AST_Call* call) {
+    Value func;
+    InternedString attr;
+    bool is_callattr = false;
+    bool callattr_clsonly = false;
+    if (call->func->type == AST_TYPE::Attribute) {
+        is_callattr = true;
+        AST_Attribute* attr_ast = ast_cast<AST_Attribute>(call->func);
+        func = visit_expr(attr_ast->value);
+        attr = attr_ast->attr;
+    } else if (call->func->type == AST_TYPE::ClsAttribute) {
+        is_callattr = true;
+        callattr_clsonly = true;
+        AST_ClsAttribute* attr_ast = ast_cast<AST_ClsAttribute>(call->func);
+        func = visit_expr(attr_ast->value);
+        attr = attr_ast->attr;
+    } else {
+        func = visit_expr(call->func);
+    }
+
+    Value args[3];
+    llvm::SmallVector<RewriterVar*, 3> args_vars;
+    for (int i = 0; i < call->args.size(); i++) {
+        args[i] = visit_expr(call->args[i]);
+        args_vars.push_back(args[i]);
+    }
+
+    ArgPassSpec argspec(call->args.size());
+    Value v;
+    if (is_callattr) {
+        CallattrFlags callattr_flags{.cls_only = callattr_clsonly, .null_on_nonexistent = false, .argspec = argspec };
+        if (jit)
+            v.var = jit->emitCallattrCapi(func, attr.getBox(), callattr_flags, args_vars);
+        v.o = callattrCapi(func.o, attr.getBox(), callattr_flags, args[0].o, args[1].o, args[2].o);
+    } else {
+        if (jit)
+            v.var = jit->emitRuntimeCallCapi(func, argspec, args_vars);
+        v.o = runtimeCallCapi(func.o, argspec, args[0].o, args[1].o, args[2].o);
+    }
+    if (v.o && jit)
+        jit->emitSideExitIfNull(v, node->exc_dest);
+    return v;
+}
+
+Value ASTInterpreter::doCapiSubscript(AST_Invoke* node, AST_Subscript* sub) {
+    Value value = visit_expr(sub->value);
+    Value slice = visit_expr(sub->slice);
+
+    // Only exact dicts hand back their KeyErrors; anything else is better off with the getitem IC.
+    if (value.o->cls != dict_cls)
+        return Value(getitem(value.o, slice.o), jit ? jit->emitGetItem(value, slice) : NULL);
+
+    Value v;
+    if (jit)
+        v.var = jit->emitGetItemCapi(value, slice);
+    v.o = getitemCapi(value.o, slice.o);
+    if (v.o && jit)
+        jit->emitSideExitIfNull(v, node->exc_dest);
+    return v;
+}
+
+Value ASTInterpreter::doCapiInvoke(AST_Invoke* node, AST_expr* expr) {
+    Value v;
+    if (expr->type == AST_TYPE::Call)
+        v = doCapiCall(node, ast_cast<AST_Call>(expr));
+    else
+        v = doCapiSubscript(node, ast_cast<AST_Subscript>(expr));
+
+    if (!v.o) {
+        // The baseline JIT only emits the path that we take, and we want that to be the common one.
+        abortJITing();
+
+        PyObject* type, *value, *traceback;
+        PyErr_Fetch(&type, &value, &traceback);
+        catchInvokeException(node, ExcInfo(type, value, traceback));
+        return Value();
+    }
+
+    if (node->stmt->type == AST_TYPE::Assign) {
+        doStore(ast_cast<AST_Assign>(node->stmt)->targets[0], v);
+        v = Value();
+    }
+
+    next_block = node->normal_dest;
+    if (jit) {
+        jit->emitJump(next_block);
+        finishJITing(next_block);
+    }
+    return v;
+}
+
 Value ASTInterpreter::visit_invoke(AST_Invoke* node) {
     Value v;
     try {
+        if (ENABLE_CAPI_EXCEPTIONS) {
+            // An exception that gets raised directly inside of an invoke is handled in this frame, and an exception
+            // from a Python function that we call or from a dict lookup can come back as a return value; none of
+            // them need to get thrown.
+            if (node->stmt->type == AST_TYPE::Raise) {
+                ExcInfo exc_info = doRaise(ast_cast<AST_Raise>(node->stmt), true);
+                catchInvokeException(node, exc_info);
+                return v;
+            }
+
+            if (AST_expr* expr = getCapiExpr(node->stmt))
+                return doCapiInvoke(node, expr);
+        }
+
         v = visit_stmt(node->stmt);
         next_block = node->normal_dest;
 
@@ -812,12 +1083,7 @@ Value ASTInterpreter::visit_invoke(AST_Invoke* node) {
         }
     } catch (ExcInfo e) {
         abortJITing();
-
-        auto source = getCL()->source.get();
-        exceptionCaughtInInterpreter(LineInfo(node->lineno, node->col_offset, source->fn, source->getName()), &e);
-
-        next_block = node->exc_dest;
-        last_exception = e;
+        catchInvokeException(node, e);
     }
 
     return v;
@@ -883,7 +1149,7 @@ Value ASTInterpreter::visit_langPrimitive(AST_LangPrimitive* node) {
     } else if (node->opcode == AST_LangPrimitive::NONE) {
         v = getNone();
     } else if (node->opcode == AST_LangPrimitive::LANDINGPAD) {
-        assert(last_exception.type);
+        fetchCapiInvokeException();
         Box* type = last_exception.type;
         Box* value = last_exception.value ? last_exception.value : None;
         Box* traceback = last_exception.traceback ? last_exception.traceback : None;
@@ -930,6 +1196,23 @@ Value ASTInterpreter::visit_langPrimitive(AST_LangPrimitive* node) {
     return v;
 }
 
+Value ASTInterpreter::doStacklessYield(AST_Assign* node) {
+    assert(!jit);
+    AST_Yield* yield_node = ast_cast<AST_Yield>(node->value);
+    generator->returnValue = yield_node->value ? visit_expr(yield_node->value).o : None;
+
+    // The cfg never ends a block with a yield, so we can always continue inside this block:
+    auto it = std::find(current_block->body.begin(), current_block->body.end(), node);
+    assert(it != current_block->body.end() && it + 1 != current_block->body.end());
+    resume_block = current_block;
+    resume_at = *(it + 1);
+    resume_target = node->targets[0];
+
+    // Makes executeInner return:
+    next_block = NULL;
+    return Value();
+}
+
 Value ASTInterpreter::visit_yield(AST_Yield* node) {
     Value value = node->value ? visit_expr(node->value) : getNone();
     assert(generator && generator->cls == generator_cls);
@@ -1105,30 +1388,57 @@ Value ASTInterpreter::visit_makeClass(AST_MakeClass* mkclass) {
     return Value(classobj, NULL);
 }
 
-Value ASTInterpreter::visit_raise(AST_Raise* node) {
-    if (node->arg0 == NULL) {
+// Evaluates a raise statement and returns the exception that it raises.  'caught' says whether the statement is
+// inside of an invoke, in which case the jitted code hands the exception straight to the invoke's handler.
+ExcInfo ASTInterpreter::doRaise(AST_Raise* node, bool caught) {
+    Value arg0, arg1, arg2;
+    if (node->arg0) {
+        arg0 = visit_expr(node->arg0);
+        arg1 = node->arg1 ? visit_expr(node->arg1) : getNone();
+        arg2 = node->arg2 ? visit_expr(node->arg2) : getNone();
+    } else {
         assert(!node->arg1);
         assert(!node->arg2);
+    }
 
-        if (jit) {
-            jit->emitRaise0();
-            finishJITing();
+    // Creating the exception can itself throw, so the fragment has to be finished first.
+    if (jit) {
+        if (node->arg0) {
+            if (caught)
+                jit->emitCaughtRaise3(arg0, arg1, arg2);
+            else
+                jit->emitRaise3(arg0, arg1, arg2);
+        } else {
+            if (caught)
+                jit->emitCaughtRaise0();
+            else
+                jit->emitRaise0();
         }
 
-        raise0();
+        if (caught) {
+            AST_Invoke* invoke = (AST_Invoke*)getCurrentStatement();
+            jit->emitJump(invoke->exc_dest);
+            finishJITing(invoke->exc_dest);
+        } else {
+            finishJITing();
+        }
     }
 
-    Value arg0 = node->arg0 ? visit_expr(node->arg0) : getNone();
-    Value arg1 = node->arg1 ? visit_expr(node->arg1) : getNone();
-    Value arg2 = node->arg2 ? visit_expr(node->arg2) : getNone();
+    if (!node->arg0)
+        return excInfoForRaise0();
+    return excInfoForRaise3(arg0.o, arg1.o, arg2.o);
+}
 
-    if (jit) {
-        jit->emitRaise3(arg0, arg1, arg2);
-        finishJITing();
+Value ASTInterpreter::visit_raise(AST_Raise* node) {
+    ExcInfo exc_info = doRaise(node, false);
+
+    if (exception_style == ExceptionStyle::CAPI) {
+        returnCapiException(node, exc_info);
+        return Value();
     }
 
-    raise3(arg0.o, arg1.o, arg2.o);
-    return Value();
+    assert(!PyErr_Occurred());
+    throw exc_info;
 }
 
 Value ASTInterpreter::visit_assert(AST_Assert* node) {
@@ -1148,8 +1458,11 @@ Value ASTInterpreter::visit_assert(AST_Assert* node) {
 
 Value ASTInterpreter::visit_global(AST_Global* node) {
     abortJITing();
-    for (auto name : node->names)
-        sym_table.erase(name);
+    for (auto name : node->names) {
+        int vreg = source_info->cfg->getVReg(name);
+        if (vreg != -1)
+            vregs[vreg] = NULL;
+    }
     return Value();
 }
 
@@ -1193,12 +1506,13 @@ Value ASTInterpreter::visit_delete(AST_Delete* node) {
                 } else {
                     assert(vst == ScopeInfo::VarScopeType::FAST);
 
-                    if (sym_table.count(target->id) == 0) {
+                    assert(target->vreg != -1);
+                    if (vregs[target->vreg] == NULL) {
                         assertNameDefined(0, target->id.c_str(), NameError, true /* local_var_msg */);
                         return Value();
                     }
 
-                    sym_table.erase(target->id);
+                    vregs[target->vreg] = NULL;
                 }
                 break;
             }
@@ -1213,6 +1527,9 @@ Value ASTInterpreter::visit_delete(AST_Delete* node) {
 Value ASTInterpreter::visit_assign(AST_Assign* node) {
     assert(node->targets.size() == 1 && "cfg should have lowered it to a single target");
 
+    if (unlikely(stackless) && node->value->type == AST_TYPE::Yield)
+        return doStacklessYield(node);
+
     Value v = visit_expr(node->value);
     for (AST_expr* e : node->targets)
         doStore(e, v);
@@ -1452,14 +1769,15 @@ Value ASTInterpreter::visit_dict(AST_Dict* node) {
 Value ASTInterpreter::visit_set(AST_Set* node) {
     llvm::SmallVector<RewriterVar*, 8> items;
 
-    BoxedSet::Set set;
+    // A SetTable's storage is only visited through its BoxedSet, so insert straight into a live set.
+    BoxedSet* set = new BoxedSet();
     for (AST_expr* e : node->elts) {
         Value v = visit_expr(e);
-        set.insert(v.o);
+        set->s.insert(v.o);
         items.push_back(v);
     }
 
-    return Value(new BoxedSet(std::move(set)), jit ? jit->emitCreateSet(items) : NULL);
+    return Value(set, jit ? jit->emitCreateSet(items) : NULL);
 }
 
 Value ASTInterpreter::visit_str(AST_Str* node) {
@@ -1501,12 +1819,12 @@ Value ASTInterpreter::visit_name(AST_Name* node) {
                     is_live = source_info->getLiveness()->isLiveAtEnd(node->id, current_block);
 
                 if (is_live)
-                    v.var = jit->emitGetLocal(node->id);
+                    v.var = jit->emitGetLocal(node->vreg);
                 else
-                    v.var = jit->emitGetBlockLocal(node->id);
+                    v.var = jit->emitGetBlockLocal(node->id, node->vreg);
             }
 
-            v.o = ASTInterpreterJitInterface::getLocalHelper(this, node->id);
+            v.o = ASTInterpreterJitInterface::getLocalHelper(this, node->vreg);
             return v;
         }
         case ScopeInfo::VarScopeType::NAME: {
@@ -1572,6 +1890,23 @@ int ASTInterpreterJitInterface::getCurrentInstOffset() {
     return offsetof(ASTInterpreter, current_inst);
 }
 
+int ASTInterpreterJitInterface::getVRegsOffset() {
+    return offsetof(ASTInterpreter, vregs);
+}
+
+Box* ASTInterpreterJitInterface::caughtRaise0Helper(void* _interpreter) {
+    ASTInterpreter* interpreter = (ASTInterpreter*)_interpreter;
+    interpreter->catchInvokeException((AST_Invoke*)interpreter->getCurrentStatement(), excInfoForRaise0());
+    return None;
+}
+
+Box* ASTInterpreterJitInterface::caughtRaise3Helper(void* _interpreter, Box* arg0, Box* arg1, Box* arg2) {
+    ASTInterpreter* interpreter = (ASTInterpreter*)_interpreter;
+    interpreter->catchInvokeException((AST_Invoke*)interpreter->getCurrentStatement(),
+                                      excInfoForRaise3(arg0, arg1, arg2));
+    return None;
+}
+
 Box* ASTInterpreterJitInterface::derefHelper(void* _interpreter, InternedString s) {
     ASTInterpreter* interpreter = (ASTInterpreter*)_interpreter;
     DerefInfo deref_info = interpreter->scope_info->getDerefInfo(s);
@@ -1605,22 +1940,25 @@ Box* ASTInterpreterJitInterface::getBoxedLocalsHelper(void* _interpreter) {
     return interpreter->frame_info.boxedLocals;
 }
 
-Box* ASTInterpreterJitInterface::getLocalHelper(void* _interpreter, InternedString id) {
+Box* ASTInterpreterJitInterface::getLocalHelper(void* _interpreter, int vreg) {
     ASTInterpreter* interpreter = (ASTInterpreter*)_interpreter;
 
-    auto it = interpreter->sym_table.find(id);
-    if (it != interpreter->sym_table.end()) {
-        Box* v = interpreter->sym_table.getMapped(it->second);
+    assert(vreg >= 0 && vreg < interpreter->num_vregs);
+    Box* v = interpreter->vregs[vreg];
+    if (v) {
         assert(gc::isValidGCObject(v));
         return v;
     }
 
+    // Only look up the name once we know we have to throw:
+    InternedString id = interpreter->source_info->cfg->vreg_sym_map[vreg];
     assertNameDefined(0, id.c_str(), UnboundLocalError, true);
     return 0;
 }
 
 Box* ASTInterpreterJitInterface::landingpadHelper(void* _interpreter) {
     ASTInterpreter* interpreter = (ASTInterpreter*)_interpreter;
+    interpreter->fetchCapiInvokeException();
     ExcInfo& last_exception = interpreter->last_exception;
     Box* type = last_exception.type;
     Box* value = last_exception.value ? last_exception.value : None;
@@ -1630,6 +1968,38 @@ Box* ASTInterpreterJitInterface::landingpadHelper(void* _interpreter) {
     return rtn;
 }
 
+Box* ASTInterpreterJitInterface::raise0Helper(void* _interpreter) {
+    ASTInterpreter* interpreter = (ASTInterpreter*)_interpreter;
+    ExcInfo exc_info = excInfoForRaise0();
+    if (interpreter->exception_style == ExceptionStyle::CAPI) {
+        interpreter->returnCapiException(interpreter->getCurrentStatement(), exc_info);
+        return NULL;
+    }
+    throw exc_info;
+}
+
+Box* ASTInterpreterJitInterface::raise3Helper(void* _interpreter, Box* arg0, Box* arg1, Box* arg2) {
+    ASTInterpreter* interpreter = (ASTInterpreter*)_interpreter;
+    ExcInfo exc_info = excInfoForRaise3(arg0, arg1, arg2);
+    if (interpreter->exception_style == ExceptionStyle::CAPI) {
+        interpreter->returnCapiException(interpreter->getCurrentStatement(), exc_info);
+        return NULL;
+    }
+    throw exc_info;
+}
+
+Box* ASTInterpreterJitInterface::getitemCapiHelper(void* _interpreter, Box* value, Box* slice) {
+    ASTInterpreter* interpreter = (ASTInterpreter*)_interpreter;
+    Box* r = getitemCapi(value, slice);
+    if (!r) {
+        PyObject* type, *value, *traceback;
+        PyErr_Fetch(&type, &value, &traceback);
+        interpreter->catchInvokeException((AST_Invoke*)interpreter->getCurrentStatement(),
+                                          ExcInfo(type, value, traceback));
+    }
+    return r;
+}
+
 Box* ASTInterpreterJitInterface::setExcInfoHelper(void* _interpreter, Box* type, Box* value, Box* traceback) {
     ASTInterpreter* interpreter = (ASTInterpreter*)_interpreter;
     interpreter->getFrameInfo()->exc = ExcInfo(type, value, traceback);
@@ -1653,27 +2023,37 @@ void ASTInterpreterJitInterface::setItemNameHelper(void* _interpreter, Box* str,
     setitem(interpreter->frame_info.boxedLocals, str, val);
 }
 
-void ASTInterpreterJitInterface::setLocalClosureHelper(void* _interpreter, InternedString id, Box* v) {
+void ASTInterpreterJitInterface::setLocalClosureHelper(void* _interpreter, int vreg, int closure_offset, Box* v) {
     ASTInterpreter* interpreter = (ASTInterpreter*)_interpreter;
 
     assert(gc::isValidGCObject(v));
-    interpreter->sym_table[id] = v;
+    assert(vreg >= 0 && vreg < interpreter->num_vregs);
+    interpreter->vregs[vreg] = v;
 
-    interpreter->created_closure->elts[interpreter->scope_info->getClosureOffset(id)] = v;
-}
-
-void ASTInterpreterJitInterface::setLocalHelper(void* _interpreter, InternedString id, Box* v) {
-    ASTInterpreter* interpreter = (ASTInterpreter*)_interpreter;
-
-    assert(gc::isValidGCObject(v));
-    interpreter->sym_table[id] = v;
+    interpreter->created_closure->elts[closure_offset] = v;
 }
 
 
 const void* interpreter_instr_addr = (void*)&ASTInterpreter::executeInner;
 
-Box* astInterpretFunction(CLFunction* clfunc, int nargs, Box* closure, Box* generator, Box* globals, Box* arg1,
-                          Box* arg2, Box* arg3, Box** args) {
+// The ASTInterpreter constructor needs the cfg, since that's where the vregs get assigned.
+// Note: due to some (avoidable) restrictions, this check is pretty constrained in where
+// it can go, due to the fact that it can throw an exception.
+// It can't go in the ASTInterpreter constructor, since that will cause the C++ runtime to
+// delete the partially-constructed memory which we don't currently handle.  It can't go into
+// executeInner since we want the SyntaxErrors to happen *before* the stack frame is entered.
+// (For instance, throwing the exception will try to fetch the current statement, but we determine
+// that by looking at the cfg.)
+static void ensureCFG(SourceInfo* source_info) {
+    if (!source_info->cfg) {
+        source_info->cfg = computeCFG(source_info, source_info->body);
+        applyJITProfile(source_info);
+    }
+}
+
+template <ExceptionStyle S>
+static Box* astInterpretFunctionInternal(CLFunction* clfunc, int nargs, Box* closure, Box* generator, Box* globals,
+                                         Box* arg1, Box* arg2, Box* arg3, Box** args) {
     UNAVOIDABLE_STAT_TIMER(t0, "us_timer_in_interpreter");
 
     SourceInfo* source_info = clfunc->source.get();
@@ -1686,7 +2066,18 @@ Box* astInterpretFunction(CLFunction* clfunc, int nargs, Box* closure, Box* gene
     // function.
     int num_blocks = source_info->cfg ? source_info->cfg->blocks.size() : 10000;
     int threshold = num_blocks <= 20 ? (REOPT_THRESHOLD_BASELINE / 3) : REOPT_THRESHOLD_BASELINE;
-    if (unlikely(can_reopt && (FORCE_OPTIMIZE || !ENABLE_INTERPRETER || clfunc->times_interpreted > threshold))) {
+    bool compile_in_background = ENABLE_BACKGROUND_COMPILATION && ENABLE_INTERPRETER && !FORCE_OPTIMIZE;
+    if (unlikely(can_reopt && compile_in_background && clfunc->times_interpreted > threshold)) {
+        // Hand the function off to the compiler thread and keep on interpreting it in the meantime;
+        // a later call will pick up the compiled version.
+        clfunc->times_interpreted = 0;
+
+        FunctionSpecialization* spec
+            = new FunctionSpecialization(UNKNOWN, std::vector<ConcreteCompilerType*>(nargs, UNKNOWN));
+        if (!queueBackgroundCompile(clfunc, spec, EffortLevel::MODERATE, S))
+            delete spec;
+    } else if (unlikely(can_reopt
+                        && (FORCE_OPTIMIZE || !ENABLE_INTERPRETER || clfunc->times_interpreted > threshold))) {
         assert(!globals);
 
         clfunc->times_interpreted = 0;
@@ -1706,10 +2097,12 @@ Box* astInterpretFunction(CLFunction* clfunc, int nargs, Box* closure, Box* gene
         }
         FunctionSpecialization* spec = new FunctionSpecialization(UNKNOWN, arg_types);
 
-        // this also pushes the new CompiledVersion to the back of the version list:
-        CompiledFunction* optimized = compileFunction(clfunc, spec, new_effort, NULL);
+        // this also pushes the new CompiledVersion to the back of the version list (or of the CAPI version list; we
+        // compile the kind of version that our caller wants, since that is who made this function hot):
+        CompiledFunction* optimized = compileFunction(clfunc, spec, new_effort, NULL, S);
 
-        clfunc->dependent_interp_callsites.invalidateAll();
+        if (S == ExceptionStyle::CXX)
+            clfunc->dependent_interp_callsites.invalidateAll();
 
         UNAVOIDABLE_STAT_TIMER(t0, "us_timer_in_jitted_code");
         if (closure && generator)
@@ -1723,6 +2116,7 @@ Box* astInterpretFunction(CLFunction* clfunc, int nargs, Box* closure, Box* gene
     }
 
     ++clfunc->times_interpreted;
+    ensureCFG(source_info);
     ASTInterpreter* interpreter = new ASTInterpreter(clfunc);
 
     ScopeInfo* scope_info = clfunc->source->getScopeInfo();
@@ -1737,15 +2131,33 @@ Box* astInterpretFunction(CLFunction* clfunc, int nargs, Box* closure, Box* gene
         interpreter->setGlobals(source_info->parent_module);
     }
 
+    if (S == ExceptionStyle::CAPI)
+        interpreter->setExceptionStyle(S);
+
     interpreter->initArguments(nargs, (BoxedClosure*)closure, (BoxedGenerator*)generator, arg1, arg2, arg3, args);
     Value v = ASTInterpreter::execute(*interpreter);
 
+    if (S == ExceptionStyle::CAPI && !v.o && PyErr_Occurred())
+        return NULL;
     return v.o ? v.o : None;
 }
 
+Box* astInterpretFunction(CLFunction* clfunc, int nargs, Box* closure, Box* generator, Box* globals, Box* arg1,
+                          Box* arg2, Box* arg3, Box** args) {
+    return astInterpretFunctionInternal<ExceptionStyle::CXX>(clfunc, nargs, closure, generator, globals, arg1, arg2,
+                                                             arg3, args);
+}
+
+Box* astInterpretFunctionCapi(CLFunction* clfunc, int nargs, Box* closure, Box* globals, Box* arg1, Box* arg2,
+                              Box* arg3) {
+    return astInterpretFunctionInternal<ExceptionStyle::CAPI>(clfunc, nargs, closure, NULL, globals, arg1, arg2, arg3,
+                                                              NULL);
+}
+
 Box* astInterpretFunctionEval(CLFunction* clfunc, Box* globals, Box* boxedLocals) {
     ++clfunc->times_interpreted;
 
+    ensureCFG(clfunc->source.get());
     ASTInterpreter* interpreter = new ASTInterpreter(clfunc);
     interpreter->initArguments(0, NULL, NULL, NULL, NULL, NULL, NULL);
     interpreter->setBoxedLocals(boxedLocals);
@@ -1847,47 +2259,146 @@ Box* astInterpretDeopt(CLFunction* clfunc, AST_expr* after_expr, AST_stmt* enclo
     return v.o ? v.o : None;
 }
 
+bool canRunGeneratorStackless(CLFunction* clfunc) {
+    // Do this even if we aren't going to create a stackless generator right now, since it decides which blocks the
+    // baseline jit can handle, and that has to stay the same for all of the function's generators:
+    if (clfunc->stackless_generator == CLFunction::StacklessGenerator::UNKNOWN) {
+        SourceInfo* source_info = clfunc->source.get();
+        ensureCFG(source_info);
+
+        // If a yield is wrapped in an invoke, it's inside of a try block (or a with statement), and an exception
+        // thrown into the generator would have to get raised at the yield and handled in the function; we only do
+        // that on a stack.
+        bool can_run_stackless = true;
+        for (CFGBlock* block : source_info->cfg->blocks) {
+            for (AST_stmt* stmt : block->body) {
+                if (stmt->type == AST_TYPE::Invoke && isYieldStmt(stmt))
+                    can_run_stackless = false;
+            }
+        }
+        clfunc->stackless_generator
+            = can_run_stackless ? CLFunction::StacklessGenerator::YES : CLFunction::StacklessGenerator::NO;
+    }
+
+    if (!ENABLE_STACKLESS_GENERATORS || !ENABLE_INTERPRETER || FORCE_OPTIMIZE)
+        return false;
+
+    // Once the function gets hot, create its generators the normal way so that they go through
+    // astInterpretFunction() and get compiled:
+    if (!clfunc->versions.empty() || clfunc->times_interpreted > REOPT_THRESHOLD_BASELINE)
+        return false;
+
+    return clfunc->stackless_generator == CLFunction::StacklessGenerator::YES;
+}
+
+Box* astCreateStacklessGeneratorFrame(BoxedGenerator* generator) {
+    BoxedFunctionBase* func = generator->function;
+    CLFunction* clfunc = func->f;
+    SourceInfo* source_info = clfunc->source.get();
+    assert(clfunc->stackless_generator == CLFunction::StacklessGenerator::YES);
+
+    ++clfunc->times_interpreted;
+    ASTInterpreter* interpreter = new ASTInterpreter(clfunc);
+    interpreter->stackless = true;
+
+    if (unlikely(source_info->getScopeInfo()->usesNameLookup())) {
+        interpreter->setBoxedLocals(new BoxedDict());
+    }
+
+    assert((!func->globals) == source_info->scoping->areGlobalsFromModule());
+    if (func->globals) {
+        interpreter->setGlobals(func->globals);
+    } else {
+        interpreter->setGlobals(source_info->parent_module);
+    }
+
+    Box** args = generator->args ? &generator->args->elts[0] : nullptr;
+    interpreter->initArguments(clfunc->numReceivedArgs(), func->closure, generator, generator->arg1, generator->arg2,
+                               generator->arg3, args);
+    return interpreter;
+}
+
+void ASTInterpreter::resumeGenerator(Box* value) {
+    CFGBlock* start_block = resume_block;
+    AST_stmt* start_at = resume_at;
+    if (start_block) {
+        resume_block = NULL;
+        resume_at = NULL;
+        // This is the value of the yield expression we stopped at:
+        doStore(resume_target, Value(value, NULL));
+        resume_target = NULL;
+    }
+
+    execute(*this, start_block, start_at);
+}
+
+bool astResumeStacklessGenerator(Box* frame, Box* value) {
+    ASTInterpreter* interpreter = static_cast<ASTInterpreter*>(frame);
+    assert(interpreter->cls == astinterpreter_cls);
+    assert(interpreter->stackless);
+
+    interpreter->resumeGenerator(value);
+    return interpreter->resume_block != NULL;
+}
+
+bool astStacklessGeneratorIsHot(Box* frame) {
+    ASTInterpreter* interpreter = static_cast<ASTInterpreter*>(frame);
+    assert(interpreter->cls == astinterpreter_cls);
+    // Same point at which a normal frame would start using the baseline jit:
+    return interpreter->edgecount >= OSR_THRESHOLD_INTERPRETER;
+}
+
+void astResumeGeneratorOnStack(Box* frame, Box* value) {
+    ASTInterpreter* interpreter = static_cast<ASTInterpreter*>(frame);
+    assert(interpreter->cls == astinterpreter_cls);
+
+    // From here on this is a normal frame, which can get jitted or OSR'd like any other:
+    interpreter->stackless = false;
+    interpreter->edgecount = 0;
+    interpreter->resumeGenerator(value);
+}
+
 AST_stmt* getCurrentStatementForInterpretedFrame(void* frame_ptr) {
-    ASTInterpreter* interpreter = s_interpreterMap[frame_ptr];
-    assert(interpreter);
+    ASTInterpreter* interpreter = getInterpreterForFrame(frame_ptr);
     return interpreter->getCurrentStatement();
 }
 
 Box* getGlobalsForInterpretedFrame(void* frame_ptr) {
-    ASTInterpreter* interpreter = s_interpreterMap[frame_ptr];
-    assert(interpreter);
+    ASTInterpreter* interpreter = getInterpreterForFrame(frame_ptr);
     return interpreter->getGlobals();
 }
 
 CLFunction* getCLForInterpretedFrame(void* frame_ptr) {
-    ASTInterpreter* interpreter = s_interpreterMap[frame_ptr];
-    assert(interpreter);
+    ASTInterpreter* interpreter = getInterpreterForFrame(frame_ptr);
     return interpreter->getCL();
 }
 
 FrameInfo* getFrameInfoForInterpretedFrame(void* frame_ptr) {
-    ASTInterpreter* interpreter = s_interpreterMap[frame_ptr];
-    assert(interpreter);
+    ASTInterpreter* interpreter = getInterpreterForFrame(frame_ptr);
     return interpreter->getFrameInfo();
 }
 
 BoxedDict* localsForInterpretedFrame(void* frame_ptr, bool only_user_visible) {
-    ASTInterpreter* interpreter = s_interpreterMap[frame_ptr];
-    assert(interpreter);
+    ASTInterpreter* interpreter = getInterpreterForFrame(frame_ptr);
     BoxedDict* rtn = new BoxedDict();
-    for (auto& l : interpreter->getSymbolTable()) {
-        if (only_user_visible && (l.first.s()[0] == '!' || l.first.s()[0] == '#'))
+    Box** vregs = interpreter->getVRegs();
+    const std::vector<InternedString>& names = interpreter->getCL()->source->cfg->vreg_sym_map;
+    for (int i = 0; i < interpreter->getNumVRegs(); i++) {
+        if (!vregs[i])
             continue;
 
-        rtn->d[l.first.getBox()] = interpreter->getSymbolTable().getMapped(l.second);
+        InternedString name = names[i];
+        if (only_user_visible && (name.s()[0] == '!' || name.s()[0] == '#'))
+            continue;
+
+        rtn->d[name.getBox()] = vregs[i];
     }
 
     return rtn;
 }
 
 BoxedClosure* passedClosureForInterpretedFrame(void* frame_ptr) {
-    ASTInterpreter* interpreter = s_interpreterMap[frame_ptr];
-    assert(interpreter);
+    ASTInterpreter* interpreter = getInterpreterForFrame(frame_ptr);
     return interpreter->getPassedClosure();
 }
 
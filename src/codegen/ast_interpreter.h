@@ -29,6 +29,7 @@ class AST_Jump;
 class Box;
 class BoxedClosure;
 class BoxedDict;
+class BoxedGenerator;
 struct CLFunction;
 struct LineInfo;
 
@@ -37,19 +38,24 @@ extern const void* interpreter_instr_addr;
 struct ASTInterpreterJitInterface {
     static int getCurrentBlockOffset();
     static int getCurrentInstOffset();
+    static int getVRegsOffset();
 
+    static Box* caughtRaise0Helper(void* interp);
+    static Box* caughtRaise3Helper(void* interp, Box* arg0, Box* arg1, Box* arg2);
     static Box* derefHelper(void* interp, InternedString s);
     static Box* doOSRHelper(void* interp, AST_Jump* node);
     static Box* getBoxedLocalHelper(void* interp, BoxedString* s);
     static Box* getBoxedLocalsHelper(void* interp);
-    static Box* getLocalHelper(void* interp, InternedString id);
+    static Box* getitemCapiHelper(void* interp, Box* value, Box* slice);
+    static Box* getLocalHelper(void* interp, int vreg);
     static Box* landingpadHelper(void* interp);
+    static Box* raise0Helper(void* interp);
+    static Box* raise3Helper(void* interp, Box* arg0, Box* arg1, Box* arg2);
     static Box* setExcInfoHelper(void* interp, Box* type, Box* value, Box* traceback);
     static Box* uncacheExcInfoHelper(void* interp);
     static Box* yieldHelper(void* interp, Box* val);
     static void setItemNameHelper(void* interp, Box* str, Box* val);
-    static void setLocalClosureHelper(void* interp, InternedString id, Box* v);
-    static void setLocalHelper(void* interp, InternedString id, Box* v);
+    static void setLocalClosureHelper(void* interp, int vreg, int closure_offset, Box* v);
 };
 
 class RewriterVar;
@@ -74,10 +80,31 @@ struct Value {
 void setupInterpreter();
 Box* astInterpretFunction(CLFunction* f, int nargs, Box* closure, Box* generator, Box* globals, Box* arg1, Box* arg2,
                           Box* arg3, Box** args);
+// Like astInterpretFunction, but returns NULL with the exception set in the thread state if the function raises an
+// exception that it doesn't catch itself (ExceptionStyle::CAPI).  Only raise statements get handed on this way; an
+// exception that comes out of the runtime still gets thrown.
+Box* astInterpretFunctionCapi(CLFunction* f, int nargs, Box* closure, Box* globals, Box* arg1, Box* arg2, Box* arg3);
+// Returns the value of 'stmt' if it is an expression that can hand its exception back instead of throwing it, either
+// on its own or assigned to a name: a call that runtimeCallCapi or callattrCapi can make, or a subscript (see
+// getitemCapi).  irgen uses this to pick the calls that it emits the same way.
+AST_expr* getCapiExpr(AST_stmt* stmt);
 Box* astInterpretFunctionEval(CLFunction* cf, Box* globals, Box* boxedLocals);
 Box* astInterpretDeopt(CLFunction* cf, AST_expr* after_expr, AST_stmt* enclosing_stmt, Box* expr_val,
                        FrameStackState frame_state);
 
+// Stackless generators: the interpreter keeps all of a frame's state in the (heap-allocated) ASTInterpreter, so for
+// generators that never yield inside of a try block we can just return from the interpreter at every yield and
+// continue from the statement after it on the next resume, instead of giving the generator its own stack.
+// Can throw, since it might have to compute the cfg:
+bool canRunGeneratorStackless(CLFunction* f);
+Box* astCreateStacklessGeneratorFrame(BoxedGenerator* generator);
+// Runs the generator until it yields (returns true, the value is in generator->returnValue) or returns (returns false).
+// 'value' is what the pending yield evaluates to.
+bool astResumeStacklessGenerator(Box* frame, Box* value);
+// Generators which run for a long time get moved onto a stack so that they can tier up like any other frame:
+bool astStacklessGeneratorIsHot(Box* frame);
+void astResumeGeneratorOnStack(Box* frame, Box* value);
+
 AST_stmt* getCurrentStatementForInterpretedFrame(void* frame_ptr);
 Box* getGlobalsForInterpretedFrame(void* frame_ptr);
 CLFunction* getCLForInterpretedFrame(void* frame_ptr);
@@ -19,6 +19,7 @@
 
 #include "codegen/irgen/hooks.h"
 #include "codegen/memmgr.h"
+#include "codegen/profiling/perf_map.h"
 #include "codegen/type_recording.h"
 #include "core/cfg.h"
 #include "runtime/inline/list.h"
@@ -32,8 +33,10 @@ static llvm::DenseSet<CFGBlock*> blocks_aborted;
 static llvm::DenseMap<CFGBlock*, std::vector<void*>> block_patch_locations;
 
 
-JitCodeBlock::JitCodeBlock(llvm::StringRef name)
-    : frame_manager(false /* don't omit frame pointers */),
+JitCodeBlock::JitCodeBlock(llvm::StringRef name, llvm::StringRef filename)
+    : name(name),
+      filename(filename),
+      frame_manager(false /* don't omit frame pointers */),
       code(new uint8_t[code_size]),
       entry_offset(0),
       a(code.get(), code_size),
@@ -65,6 +68,9 @@ JitCodeBlock::JitCodeBlock(llvm::StringRef name)
     frame_manager.writeAndRegister(code.get(), code_size);
 
     g.func_addr_registry.registerFunction(("bjit_" + name).str(), code.get(), code_size, NULL);
+
+    if (PERF_MAP)
+        registerPerfMapRegion(code.get(), entry_offset, (name + " " + filename + " [bjit entry]").str());
 }
 
 std::unique_ptr<JitFragmentWriter> JitCodeBlock::newFragment(CFGBlock* block, int patch_jump_offset) {
@@ -81,7 +87,8 @@ std::unique_ptr<JitFragmentWriter> JitCodeBlock::newFragment(CFGBlock* block, in
     long fragment_offset = a.bytesWritten() - patch_jump_offset;
     long bytes_left = a.bytesLeft() + patch_jump_offset;
     std::unique_ptr<ICInfo> ic_info(new ICInfo(fragment_start, nullptr, nullptr, stack_info, 1, bytes_left,
-                                               llvm::CallingConv::C, live_outs, assembler::RAX, 0));
+                                               llvm::CallingConv::C, live_outs, assembler::RAX, 0,
+                                               false /* count_hits */));
     std::unique_ptr<ICSlotRewrite> rewrite(new ICSlotRewrite(ic_info.get(), ""));
 
     return std::unique_ptr<JitFragmentWriter>(new JitFragmentWriter(
@@ -192,6 +199,19 @@ RewriterVar* JitFragmentWriter::emitCallattr(AST_expr* node, RewriterVar* obj, B
 #endif
 }
 
+RewriterVar* JitFragmentWriter::emitCallattrCapi(RewriterVar* obj, BoxedString* attr, CallattrFlags flags,
+                                                 const llvm::ArrayRef<RewriterVar*> args) {
+    assert(args.size() == flags.argspec.num_args && args.size() <= 3);
+    RewriterVar::SmallVector call_args;
+    call_args.push_back(obj);
+    call_args.push_back(imm(attr));
+    call_args.push_back(imm(flags.asInt()));
+    call_args.append(args.begin(), args.end());
+
+    // Exceptions get handed back the same way as in emitRuntimeCallCapi.
+    return emitPPCall((void*)callattrCapi, call_args, 2, 640);
+}
+
 RewriterVar* JitFragmentWriter::emitCompare(RewriterVar* lhs, RewriterVar* rhs, int op_type) {
     // TODO: can directly emit the assembly for Is/IsNot
     return emitPPCall((void*)compare, { lhs, rhs, imm(op_type) }, 2, 240);
@@ -257,10 +277,10 @@ RewriterVar* JitFragmentWriter::emitGetAttr(RewriterVar* obj, BoxedString* s, AS
     return emitPPCall((void*)getattr, { obj, imm(s) }, 2, 512, getTypeRecorderForNode(node));
 }
 
-RewriterVar* JitFragmentWriter::emitGetBlockLocal(InternedString s) {
+RewriterVar* JitFragmentWriter::emitGetBlockLocal(InternedString s, int vreg) {
     auto it = local_syms.find(s);
     if (it == local_syms.end())
-        return emitGetLocal(s);
+        return emitGetLocal(vreg);
     return it->second;
 }
 
@@ -284,13 +304,12 @@ RewriterVar* JitFragmentWriter::emitGetItem(RewriterVar* value, RewriterVar* sli
     return emitPPCall((void*)getitem, { value, slice }, 2, 512);
 }
 
-RewriterVar* JitFragmentWriter::emitGetLocal(InternedString s) {
-    return call(false, (void*)ASTInterpreterJitInterface::getLocalHelper, getInterp(),
-#ifndef NDEBUG
-                imm(asUInt(s).first), imm(asUInt(s).second));
-#else
-                imm(asUInt(s)));
-#endif
+RewriterVar* JitFragmentWriter::emitGetItemCapi(RewriterVar* value, RewriterVar* slice) {
+    return call(false, (void*)ASTInterpreterJitInterface::getitemCapiHelper, getInterp(), value, slice);
+}
+
+RewriterVar* JitFragmentWriter::emitGetLocal(int vreg) {
+    return call(false, (void*)ASTInterpreterJitInterface::getLocalHelper, getInterp(), imm(vreg));
 }
 
 RewriterVar* JitFragmentWriter::emitGetPystonIter(RewriterVar* v) {
@@ -365,6 +384,19 @@ RewriterVar* JitFragmentWriter::emitRuntimeCall(AST_expr* node, RewriterVar* obj
 #endif
 }
 
+RewriterVar* JitFragmentWriter::emitRuntimeCallCapi(RewriterVar* obj, ArgPassSpec argspec,
+                                                    const llvm::ArrayRef<RewriterVar*> args) {
+    assert(args.size() == argspec.num_args && args.size() <= 3);
+    RewriterVar::SmallVector call_args;
+    call_args.push_back(obj);
+    call_args.push_back(imm(argspec.asInt()));
+    call_args.append(args.begin(), args.end());
+
+    // A NULL return leaves the exception in the thread state; the caller side-exits to the exc_dest block, whose
+    // landingpad picks it up (see landingpadHelper).
+    return emitPPCall((void*)runtimeCallCapi, call_args, 2, 640);
+}
+
 RewriterVar* JitFragmentWriter::emitUnaryop(RewriterVar* v, int op_type) {
     return emitPPCall((void*)unaryop, { v, imm(op_type) }, 2, 160);
 }
@@ -379,6 +411,14 @@ RewriterVar* JitFragmentWriter::emitYield(RewriterVar* v) {
 }
 
 
+void JitFragmentWriter::emitCaughtRaise0() {
+    call(false, (void*)ASTInterpreterJitInterface::caughtRaise0Helper, getInterp());
+}
+
+void JitFragmentWriter::emitCaughtRaise3(RewriterVar* arg0, RewriterVar* arg1, RewriterVar* arg2) {
+    call(false, (void*)ASTInterpreterJitInterface::caughtRaise3Helper, getInterp(), arg0, arg1, arg2);
+}
+
 void JitFragmentWriter::emitExec(RewriterVar* code, RewriterVar* globals, RewriterVar* locals, FutureFlags flags) {
     if (!globals)
         globals = imm(0ul);
@@ -407,11 +447,14 @@ void JitFragmentWriter::emitPrint(RewriterVar* dest, RewriterVar* var, bool nl)
 }
 
 void JitFragmentWriter::emitRaise0() {
-    call(false, (void*)raise0);
+    // The helper only returns if the interpreter wants the exception returned to its caller (ExceptionStyle::CAPI):
+    call(false, (void*)ASTInterpreterJitInterface::raise0Helper, getInterp());
+    emitReturn(imm(0ul));
 }
 
 void JitFragmentWriter::emitRaise3(RewriterVar* arg0, RewriterVar* arg1, RewriterVar* arg2) {
-    call(false, (void*)raise3, arg0, arg1, arg2);
+    call(false, (void*)ASTInterpreterJitInterface::raise3Helper, getInterp(), arg0, arg1, arg2);
+    emitReturn(imm(0ul));
 }
 
 void JitFragmentWriter::emitReturn(RewriterVar* v) {
@@ -446,17 +489,15 @@ void JitFragmentWriter::emitSetItemName(BoxedString* s, RewriterVar* v) {
     call(false, (void*)ASTInterpreterJitInterface::setItemNameHelper, getInterp(), imm(s), v);
 }
 
-void JitFragmentWriter::emitSetLocal(InternedString s, bool set_closure, RewriterVar* v) {
-    void* func = set_closure ? (void*)ASTInterpreterJitInterface::setLocalClosureHelper
-                             : (void*)ASTInterpreterJitInterface::setLocalHelper;
+void JitFragmentWriter::emitSetLocal(int vreg, RewriterVar* v) {
+    // Store directly into the interpreter's vregs array, no need to call out to a helper:
+    RewriterVar* vregs = getInterp()->getAttr(ASTInterpreterJitInterface::getVRegsOffset());
+    vregs->setAttr(vreg * sizeof(Box*), v);
+}
 
-    call(false, func, getInterp(),
-#ifndef NDEBUG
-         imm(asUInt(s).first), imm(asUInt(s).second),
-#else
-         imm(asUInt(s)),
-#endif
-         v);
+void JitFragmentWriter::emitSetLocalClosure(int vreg, int closure_offset, RewriterVar* v) {
+    call(false, (void*)ASTInterpreterJitInterface::setLocalClosureHelper, getInterp(), imm(vreg),
+         imm(closure_offset), v);
 }
 
 void JitFragmentWriter::emitSideExit(RewriterVar* v, Box* cmp_value, CFGBlock* next_block) {
@@ -466,6 +507,13 @@ void JitFragmentWriter::emitSideExit(RewriterVar* v, Box* cmp_value, CFGBlock* n
               ActionType::NORMAL);
 }
 
+void JitFragmentWriter::emitSideExitIfNull(RewriterVar* v, CFGBlock* next_block) {
+    RewriterVar* var = imm(0ul);
+    RewriterVar* next_block_var = imm(next_block);
+    addAction([=]() { _emitSideExit(v, var, next_block, next_block_var, assembler::COND_NOT_EQUAL); },
+              { v, var, next_block_var }, ActionType::NORMAL);
+}
+
 void JitFragmentWriter::emitUncacheExcInfo() {
     call(false, (void*)ASTInterpreterJitInterface::uncacheExcInfoHelper, getInterp());
 }
@@ -533,6 +581,25 @@ int JitFragmentWriter::finishCompilation() {
         pp.release();
     }
 
+    if (PERF_MAP) {
+        int lineno = 0;
+        for (AST_stmt* stmt : block->body) {
+            if (stmt->lineno > 0) {
+                lineno = stmt->lineno;
+                break;
+            }
+        }
+
+        std::string name;
+        llvm::raw_string_ostream os(name);
+        os << code_block.getName() << ' ' << code_block.getFilename() << ':' << lineno << " [bjit block "
+           << block->idx << ']';
+        os.flush();
+
+        PerfLineEntry line{ (uint64_t)block->code, lineno, code_block.getFilename() };
+        registerPerfMapRegion(block->code, assembler->bytesWritten(), name, line);
+    }
+
     void* next_fragment_start = (uint8_t*)block->code + assembler->bytesWritten();
     code_block.fragmentFinished(assembler->bytesWritten(), num_bytes_overlapping, next_fragment_start);
     return num_bytes_exit;
@@ -771,7 +838,7 @@ void JitFragmentWriter::_emitReturn(RewriterVar* return_val) {
 }
 
 void JitFragmentWriter::_emitSideExit(RewriterVar* var, RewriterVar* val_constant, CFGBlock* next_block,
-                                      RewriterVar* next_block_var) {
+                                      RewriterVar* next_block_var, assembler::ConditionCode stay_cond) {
     assert(val_constant->is_constant);
     assert(next_block_var->is_constant);
     uint64_t val = val_constant->constant_value;
@@ -785,7 +852,8 @@ void JitFragmentWriter::_emitSideExit(RewriterVar* var, RewriterVar* val_constan
     }
 
     {
-        assembler::ForwardJump jne(*assembler, assembler::COND_EQUAL);
+        // Skips over the exit if 'stay_cond' holds:
+        assembler::ForwardJump jne(*assembler, stay_cond);
         int exit_size = 0;
         _emitJump(next_block, next_block_var, exit_size);
         if (exit_size) {
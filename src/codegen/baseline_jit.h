@@ -131,6 +131,7 @@ public:
 
 
 private:
+    std::string name, filename; // of the Python function, for the perf map
     EHFrameManager frame_manager;
     std::unique_ptr<uint8_t[]> code;
     int entry_offset;
@@ -139,7 +140,10 @@ private:
     bool asm_failed;
 
 public:
-    JitCodeBlock(llvm::StringRef name);
+    JitCodeBlock(llvm::StringRef name, llvm::StringRef filename);
+
+    const std::string& getName() const { return name; }
+    const std::string& getFilename() const { return filename; }
 
     std::unique_ptr<JitFragmentWriter> newFragment(CFGBlock* block, int patch_jump_offset = 0);
     bool shouldCreateNewBlock() const { return asm_failed || a.bytesLeft() < 128; }
@@ -197,6 +201,8 @@ public:
     RewriterVar* emitBinop(RewriterVar* lhs, RewriterVar* rhs, int op_type);
     RewriterVar* emitCallattr(AST_expr* node, RewriterVar* obj, BoxedString* attr, CallattrFlags flags,
                               const llvm::ArrayRef<RewriterVar*> args, std::vector<BoxedString*>* keyword_names);
+    RewriterVar* emitCallattrCapi(RewriterVar* obj, BoxedString* attr, CallattrFlags flags,
+                                  const llvm::ArrayRef<RewriterVar*> args);
     RewriterVar* emitCompare(RewriterVar* lhs, RewriterVar* rhs, int op_type);
     RewriterVar* emitCreateDict(const llvm::ArrayRef<RewriterVar*> keys, const llvm::ArrayRef<RewriterVar*> values);
     RewriterVar* emitCreateList(const llvm::ArrayRef<RewriterVar*> values);
@@ -206,13 +212,14 @@ public:
     RewriterVar* emitDeref(InternedString s);
     RewriterVar* emitExceptionMatches(RewriterVar* v, RewriterVar* cls);
     RewriterVar* emitGetAttr(RewriterVar* obj, BoxedString* s, AST_expr* node);
-    RewriterVar* emitGetBlockLocal(InternedString s);
+    RewriterVar* emitGetBlockLocal(InternedString s, int vreg);
     RewriterVar* emitGetBoxedLocal(BoxedString* s);
     RewriterVar* emitGetBoxedLocals();
     RewriterVar* emitGetClsAttr(RewriterVar* obj, BoxedString* s);
     RewriterVar* emitGetGlobal(Box* global, BoxedString* s);
     RewriterVar* emitGetItem(RewriterVar* value, RewriterVar* slice);
-    RewriterVar* emitGetLocal(InternedString s);
+    RewriterVar* emitGetItemCapi(RewriterVar* value, RewriterVar* slice);
+    RewriterVar* emitGetLocal(int vreg);
     RewriterVar* emitGetPystonIter(RewriterVar* v);
     RewriterVar* emitHasnext(RewriterVar* v);
     RewriterVar* emitLandingpad();
@@ -221,10 +228,13 @@ public:
     RewriterVar* emitRepr(RewriterVar* v);
     RewriterVar* emitRuntimeCall(AST_expr* node, RewriterVar* obj, ArgPassSpec argspec,
                                  const llvm::ArrayRef<RewriterVar*> args, std::vector<BoxedString*>* keyword_names);
+    RewriterVar* emitRuntimeCallCapi(RewriterVar* obj, ArgPassSpec argspec, const llvm::ArrayRef<RewriterVar*> args);
     RewriterVar* emitUnaryop(RewriterVar* v, int op_type);
     RewriterVar* emitUnpackIntoArray(RewriterVar* v, uint64_t num);
     RewriterVar* emitYield(RewriterVar* v);
 
+    void emitCaughtRaise0();
+    void emitCaughtRaise3(RewriterVar* arg0, RewriterVar* arg1, RewriterVar* arg2);
     void emitExec(RewriterVar* code, RewriterVar* globals, RewriterVar* locals, FutureFlags flags);
     void emitJump(CFGBlock* b);
     void emitOSRPoint(AST_Jump* node);
@@ -239,8 +249,10 @@ public:
     void emitSetGlobal(Box* global, BoxedString* s, RewriterVar* v);
     void emitSetItemName(BoxedString* s, RewriterVar* v);
     void emitSetItem(RewriterVar* target, RewriterVar* slice, RewriterVar* value);
-    void emitSetLocal(InternedString s, bool set_closure, RewriterVar* v);
+    void emitSetLocal(int vreg, RewriterVar* v);
+    void emitSetLocalClosure(int vreg, int closure_offset, RewriterVar* v);
     void emitSideExit(RewriterVar* v, Box* cmp_value, CFGBlock* next_block);
+    void emitSideExitIfNull(RewriterVar* v, CFGBlock* next_block);
     void emitUncacheExcInfo();
 
     void abortCompilation();
@@ -278,7 +290,8 @@ private:
     void _emitPPCall(RewriterVar* result, void* func_addr, const RewriterVar::SmallVector& args, int num_slots,
                      int slot_size);
     void _emitReturn(RewriterVar* v);
-    void _emitSideExit(RewriterVar* var, RewriterVar* val_constant, CFGBlock* next_block, RewriterVar* false_path);
+    void _emitSideExit(RewriterVar* var, RewriterVar* val_constant, CFGBlock* next_block, RewriterVar* false_path,
+                       assembler::ConditionCode stay_cond = assembler::COND_EQUAL);
 };
 }
 
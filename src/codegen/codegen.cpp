@@ -29,7 +29,9 @@
 #include "analysis/scoping_analysis.h"
 #include "codegen/baseline_jit.h"
 #include "codegen/compvars.h"
+#include "codegen/jit_profile_cache.h"
 #include "core/ast.h"
+#include "core/options.h"
 #include "core/util.h"
 
 namespace pyston {
@@ -43,7 +45,8 @@ CLFunction::CLFunction(int num_args, int num_defaults, bool takes_varargs, bool
       param_names(this->source->ast, this->source->getInternedStrings()),
       always_use_version(NULL),
       code_obj(NULL),
-      times_interpreted(0) {
+      times_interpreted(0),
+      stackless_generator(StacklessGenerator::UNKNOWN) {
     assert(num_args >= num_defaults);
 }
 CLFunction::CLFunction(int num_args, int num_defaults, bool takes_varargs, bool takes_kwargs,
@@ -53,7 +56,8 @@ CLFunction::CLFunction(int num_args, int num_defaults, bool takes_varargs, bool
       param_names(param_names),
       always_use_version(NULL),
       code_obj(NULL),
-      times_interpreted(0) {
+      times_interpreted(0),
+      stackless_generator(StacklessGenerator::UNKNOWN) {
     assert(num_args >= num_defaults);
 }
 
@@ -86,6 +90,7 @@ SourceInfo::SourceInfo(BoxedModule* m, ScopingAnalysis* scoping, FutureFlags fut
 }
 
 SourceInfo::~SourceInfo() {
+    forgetJITProfile(this);
     // TODO: release memory..
 }
 
@@ -106,12 +111,17 @@ void FunctionAddressRegistry::dumpPerfMap() {
 
     FILE* index_f = fopen((out_path + "/index.txt").c_str(), "w");
 
-    char buf[80];
-    snprintf(buf, 80, "/tmp/perf-%d.map", getpid());
-    FILE* f = fopen(buf, "w");
+    // If -J is on, /tmp/perf-<pid>.map has been written incrementally and is more complete than what we have here.
+    FILE* f = NULL;
+    if (!PERF_MAP) {
+        char buf[80];
+        snprintf(buf, 80, "/tmp/perf-%d.map", getpid());
+        f = fopen(buf, "w");
+    }
     for (const auto& p : functions) {
         const FuncInfo& info = p.second;
-        fprintf(f, "%lx %x %s\n", (uintptr_t)p.first, info.length, info.name.c_str());
+        if (f)
+            fprintf(f, "%lx %x %s\n", (uintptr_t)p.first, info.length, info.name.c_str());
 
         if (info.length > 0) {
             fprintf(index_f, "%lx %s\n", (uintptr_t)p.first, info.name.c_str());
@@ -123,7 +133,8 @@ void FunctionAddressRegistry::dumpPerfMap() {
             fclose(data_f);
         }
     }
-    fclose(f);
+    if (f)
+        fclose(f);
 }
 
 llvm::Function* FunctionAddressRegistry::getLLVMFuncAtAddress(void* addr) {
@@ -39,6 +39,8 @@
 #include "llvm/Transforms/Utils/Cloning.h"
 
 #include "codegen/codegen.h"
+#include "codegen/irgen/hooks.h"
+#include "codegen/jit_profile_cache.h"
 #include "codegen/memmgr.h"
 #include "codegen/profiling/profiling.h"
 #include "codegen/stackmaps.h"
@@ -202,6 +204,31 @@ public:
     }
 };
 
+void cleanupCacheDirectory(llvm::StringRef cache_dir, int max_entries) {
+    // Find all files inside the cache directory, if the number of files is larger than
+    // max_entries, sort them by last modification time and remove the oldest excessive ones.
+    typedef std::pair<std::string, llvm::sys::TimeValue> CacheFileEntry;
+    std::vector<CacheFileEntry> cache_files;
+
+    std::error_code ec;
+    for (llvm::sys::fs::directory_iterator file(cache_dir, ec), end; !ec && file != end; file.increment(ec)) {
+        llvm::sys::fs::file_status status;
+        if (file->status(status))
+            continue; // ignore files where we can't retrieve the file status.
+        cache_files.emplace_back(std::make_pair(file->path(), status.getLastModificationTime()));
+    }
+
+    int num_expired = cache_files.size() - max_entries;
+    if (num_expired <= 0)
+        return;
+
+    std::stable_sort(cache_files.begin(), cache_files.end(),
+                     [](const CacheFileEntry& lhs, const CacheFileEntry& rhs) { return lhs.second < rhs.second; });
+
+    for (int i = 0; i < num_expired; ++i)
+        llvm::sys::fs::remove(cache_files[i].first);
+}
+
 class PystonObjectCache : public llvm::ObjectCache {
 private:
     // Stream which calculates the SHA256 hash of the data writen to.
@@ -247,7 +274,7 @@ public:
         llvm::sys::path::append(cache_dir, "pyston");
         llvm::sys::path::append(cache_dir, "object_cache");
 
-        cleanupCacheDirectory();
+        cleanupCacheDirectory(cache_dir.str(), MAX_OBJECT_CACHE_ENTRIES);
     }
 
 
@@ -322,32 +349,6 @@ public:
         jit_objectcache_hits.log();
         return mem_buff;
     }
-
-    void cleanupCacheDirectory() {
-        // Find all files inside the cache directory, if the number of files is larger than
-        // MAX_OBJECT_CACHE_ENTRIES,
-        // sort them by last modification time and remove the oldest excessive ones.
-        typedef std::pair<std::string, llvm::sys::TimeValue> CacheFileEntry;
-        std::vector<CacheFileEntry> cache_files;
-
-        std::error_code ec;
-        for (llvm::sys::fs::directory_iterator file(cache_dir.str(), ec), end; !ec && file != end; file.increment(ec)) {
-            llvm::sys::fs::file_status status;
-            if (file->status(status))
-                continue; // ignore files where we can't retrieve the file status.
-            cache_files.emplace_back(std::make_pair(file->path(), status.getLastModificationTime()));
-        }
-
-        int num_expired = cache_files.size() - MAX_OBJECT_CACHE_ENTRIES;
-        if (num_expired <= 0)
-            return;
-
-        std::stable_sort(cache_files.begin(), cache_files.end(),
-                         [](const CacheFileEntry& lhs, const CacheFileEntry& rhs) { return lhs.second < rhs.second; });
-
-        for (int i = 0; i < num_expired; ++i)
-            llvm::sys::fs::remove(cache_files[i].first);
-    }
 };
 
 static void handle_sigusr1(int signum) {
@@ -542,6 +543,9 @@ int joinRuntime() {
     if (PROFILE)
         g.func_addr_registry.dumpPerfMap();
 
+    stopBackgroundCompilation();
+    saveJITProfiles();
+
     teardownRuntime();
     teardownCodegen();
 
@@ -15,6 +15,8 @@
 #ifndef PYSTON_CODEGEN_ENTRY_H
 #define PYSTON_CODEGEN_ENTRY_H
 
+#include "llvm/ADT/StringRef.h"
+
 namespace pyston {
 
 class AST_Module;
@@ -24,6 +26,9 @@ void initCodegen();
 void teardownCodegen();
 void printAllIR();
 int joinRuntime();
+
+// Removes the least recently modified files from the directory until at most max_entries remain.
+void cleanupCacheDirectory(llvm::StringRef cache_dir, int max_entries);
 }
 
 #endif
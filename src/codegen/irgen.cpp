@@ -41,6 +41,7 @@
 #include "codegen/codegen.h"
 #include "codegen/compvars.h"
 #include "codegen/gcbuilder.h"
+#include "codegen/irgen/hooks.h"
 #include "codegen/irgen/irgenerator.h"
 #include "codegen/irgen/util.h"
 #include "codegen/opt/escape_analysis.h"
@@ -53,6 +54,7 @@
 #include "core/cfg.h"
 #include "core/options.h"
 #include "core/stats.h"
+#include "core/threading.h"
 #include "core/util.h"
 #include "runtime/objmodel.h"
 #include "runtime/types.h"
@@ -513,6 +515,8 @@ static void emitBBs(IRGenState* irstate, TypeAnalysis* types, const OSREntryDesc
         if (!blocks.count(block))
             continue;
 
+        backgroundCompileSafepoint();
+
         if (VERBOSITY("irgen") >= 2)
             printf("processing block %d\n", block->idx);
 
@@ -945,7 +949,7 @@ static std::string getUniqueFunctionName(std::string nameprefix, EffortLevel eff
 
 CompiledFunction* doCompile(CLFunction* clfunc, SourceInfo* source, ParamNames* param_names,
                             const OSREntryDescriptor* entry_descriptor, EffortLevel effort,
-                            FunctionSpecialization* spec, std::string nameprefix) {
+                            ExceptionStyle exception_style, FunctionSpecialization* spec, std::string nameprefix) {
     Timer _t("in doCompile");
     Timer _t2;
     long irgen_us = 0;
@@ -1009,7 +1013,7 @@ CompiledFunction* doCompile(CLFunction* clfunc, SourceInfo* source, ParamNames*
     }
 
 
-    CompiledFunction* cf = new CompiledFunction(NULL, spec, NULL, effort, entry_descriptor);
+    CompiledFunction* cf = new CompiledFunction(NULL, spec, NULL, effort, entry_descriptor, exception_style);
 
     // Make sure that the instruction memory keeps the module object alive.
     // TODO: implement this for real
@@ -1087,8 +1091,17 @@ CompiledFunction* doCompile(CLFunction* clfunc, SourceInfo* source, ParamNames*
     static StatCounter us_irgen("us_compiling_irgen");
     us_irgen.log(irgen_us);
 
-    if (ENABLE_LLVMOPTS)
-        optimizeIR(f, effort);
+    if (ENABLE_LLVMOPTS) {
+        if (inBackgroundCompileThread()) {
+            // The passes only look at the IR, so the background compiler doesn't need to keep the mutators
+            // waiting while they run.  The one exception is ConstClassesPass, which reads the classes that the
+            // IR refers to, and takes the GIL back for that.
+            threading::GLAllowThreadsReadRegion _allow;
+            optimizeIR(f, effort);
+        } else {
+            optimizeIR(f, effort);
+        }
+    }
 
     g.cur_module = NULL;
 
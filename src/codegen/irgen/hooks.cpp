@@ -14,6 +14,9 @@
 
 #include "codegen/irgen/hooks.h"
 
+#include <deque>
+#include <unordered_set>
+
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -27,6 +30,7 @@
 #include "codegen/irgen.h"
 #include "codegen/irgen/future.h"
 #include "codegen/irgen/util.h"
+#include "codegen/jit_profile_cache.h"
 #include "codegen/osrentry.h"
 #include "codegen/parser.h"
 #include "codegen/patchpoints.h"
@@ -37,6 +41,7 @@
 #include "core/common.h"
 #include "core/options.h"
 #include "core/stats.h"
+#include "core/threading.h"
 #include "core/types.h"
 #include "core/util.h"
 #include "runtime/objmodel.h"
@@ -169,15 +174,37 @@ static void compileIR(CompiledFunction* cf, EffortLevel effort) {
     delete stackmap;
 }
 
+// Only one thread can be generating code at a time (there is a single g.cur_module).  Holding the GIL
+// is usually enough to guarantee that, but the background compiler thread lets go of the GIL partway
+// through its compiles, so compileFunction also takes this lock.  Recursive so that a nested compile
+// still hits the g.cur_module assert rather than deadlocking.
+static pthread_mutex_t llvm_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+class LLVMLockRegion {
+public:
+    LLVMLockRegion() {
+        if (pthread_mutex_trylock(&llvm_lock) == 0)
+            return;
+
+        // The background compiler thread has the lock, and needs the GIL back to finish its compile:
+        threading::GLAllowThreadsReadRegion _allow;
+        pthread_mutex_lock(&llvm_lock);
+    }
+    ~LLVMLockRegion() { pthread_mutex_unlock(&llvm_lock); }
+};
+
 // Compiles a new version of the function with the given signature and adds it to the list;
 // should only be called after checking to see if the other versions would work.
 // The codegen_lock needs to be held in W mode before calling this function:
 CompiledFunction* compileFunction(CLFunction* f, FunctionSpecialization* spec, EffortLevel effort,
-                                  const OSREntryDescriptor* entry_descriptor) {
+                                  const OSREntryDescriptor* entry_descriptor, ExceptionStyle exception_style) {
     UNAVOIDABLE_STAT_TIMER(t0, "us_timer_compileFunction");
+    LLVMLockRegion _llvm_lock;
     Timer _t("for compileFunction()", 1000);
 
     assert((entry_descriptor != NULL) + (spec != NULL) == 1);
+    // A CAPI version signals an exception with a NULL return, so it has to return a boxed value:
+    assert(exception_style == ExceptionStyle::CXX || (spec && spec->boxed_return_value));
 
     SourceInfo* source = f->source.get();
     assert(source);
@@ -227,11 +254,13 @@ CompiledFunction* compileFunction(CLFunction* f, FunctionSpecialization* spec, E
     // Do the analysis now if we had deferred it earlier:
     if (source->cfg == NULL) {
         source->cfg = computeCFG(source, source->body);
+        applyJITProfile(source);
     }
 
 
 
-    CompiledFunction* cf = doCompile(f, source, &f->param_names, entry_descriptor, effort, spec, name);
+    CompiledFunction* cf
+        = doCompile(f, source, &f->param_names, entry_descriptor, effort, exception_style, spec, name);
     compileIR(cf, effort);
 
     f->addVersion(cf);
@@ -677,9 +706,10 @@ void CompiledFunction::speculationFailed() {
         assert(this != cl->always_use_version);
 
         bool found = false;
-        for (int i = 0; i < clfunc->versions.size(); i++) {
-            if (clfunc->versions[i] == this) {
-                clfunc->versions.erase(clfunc->versions.begin() + i);
+        FunctionList& versions = (this->exception_style == ExceptionStyle::CAPI) ? clfunc->capi_versions : clfunc->versions;
+        for (int i = 0; i < versions.size(); i++) {
+            if (versions[i] == this) {
+                versions.erase(versions.begin() + i);
                 this->dependent_callsites.invalidateAll();
                 found = true;
                 break;
@@ -707,13 +737,14 @@ void CompiledFunction::speculationFailed() {
 }
 
 CompiledFunction::CompiledFunction(llvm::Function* func, FunctionSpecialization* spec, void* code, EffortLevel effort,
-                                   const OSREntryDescriptor* entry_descriptor)
+                                   const OSREntryDescriptor* entry_descriptor, ExceptionStyle exception_style)
     : clfunc(NULL),
       func(func),
       spec(spec),
       entry_descriptor(entry_descriptor),
       code(code),
       effort(effort),
+      exception_style(exception_style),
       times_called(0),
       times_speculation_failed(0),
       location_map(nullptr) {
@@ -734,8 +765,6 @@ ConcreteCompilerType* CompiledFunction::getReturnType() {
 static CompiledFunction* _doReopt(CompiledFunction* cf, EffortLevel new_effort) {
     LOCK_REGION(codegen_rwlock.asWrite());
 
-    assert(cf->clfunc->versions.size());
-
     assert(cf);
     assert(cf->entry_descriptor == NULL && "We can't reopt an osr-entry compile!");
     assert(cf->spec);
@@ -745,14 +774,13 @@ static CompiledFunction* _doReopt(CompiledFunction* cf, EffortLevel new_effort)
 
     assert(new_effort > cf->effort);
 
-    FunctionList& versions = clfunc->versions;
+    FunctionList& versions = cf->exception_style == ExceptionStyle::CAPI ? clfunc->capi_versions : clfunc->versions;
     for (int i = 0; i < versions.size(); i++) {
         if (versions[i] == cf) {
             versions.erase(versions.begin() + i);
 
-            CompiledFunction* new_cf
-                = compileFunction(clfunc, cf->spec, new_effort,
-                                  NULL); // this pushes the new CompiledVersion to the back of the version list
+            // this pushes the new CompiledVersion to the back of the version list
+            CompiledFunction* new_cf = compileFunction(clfunc, cf->spec, new_effort, NULL, cf->exception_style);
 
             cf->dependent_callsites.invalidateAll();
 
@@ -804,7 +832,6 @@ extern "C" CompiledFunction* reoptCompiledFuncInternal(CompiledFunction* cf) {
     stat_reopt.log();
 
     assert(cf->effort < EffortLevel::MAXIMAL);
-    assert(cf->clfunc->versions.size());
 
     EffortLevel new_effort = EffortLevel::MAXIMAL;
 
@@ -817,6 +844,204 @@ extern "C" char* reoptCompiledFunc(CompiledFunction* cf) {
     return (char*)reoptCompiledFuncInternal(cf)->code;
 }
 
+struct CompileJob {
+    CLFunction* clfunc;
+    FunctionSpecialization* spec;
+    const OSREntryDescriptor* entry;
+    EffortLevel effort;
+    ExceptionStyle exception_style;
+};
+
+// Everything below is guarded by compile_queue_lock.  The compiler thread only ever waits on the queue
+// with the GIL released, and only ever compiles with the GIL held.
+static pthread_mutex_t compile_queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t compile_queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t compile_idle_cond = PTHREAD_COND_INITIALIZER;
+static std::deque<CompileJob> compile_queue;
+static std::unordered_set<CLFunction*> pending_compiles;
+static std::unordered_set<AST_Jump*> pending_osr_compiles;
+static bool compiler_thread_started = false;
+static bool compiler_thread_busy = false;
+static bool compiler_thread_stopping = false;
+
+static __thread bool is_compiler_thread = false;
+
+static StatCounter stat_background_compiles("num_background_compiles");
+static StatCounter stat_background_osr_compiles("num_background_osr_compiles");
+
+static void runCompileJob(const CompileJob& job) {
+    LOCK_REGION(codegen_rwlock.asWrite());
+
+    CLFunction* clfunc = job.clfunc;
+    if (job.entry) {
+        auto it = clfunc->osr_versions.find(job.entry);
+        if (it == clfunc->osr_versions.end() || it->second == NULL) {
+            compileFunction(clfunc, NULL, job.effort, job.entry);
+            stat_osr_compiles.log();
+            stat_background_osr_compiles.log();
+        }
+    } else {
+        compileFunction(clfunc, job.spec, job.effort, NULL, job.exception_style);
+        // Any patched call sites that point at the interpreter should go to the new version instead:
+        if (job.exception_style == ExceptionStyle::CXX)
+            clfunc->dependent_interp_callsites.invalidateAll();
+        stat_background_compiles.log();
+    }
+}
+
+static void* compilerThreadMain(Box*, Box*, Box*) {
+    is_compiler_thread = true;
+
+    while (true) {
+        CompileJob job;
+        {
+            threading::GLAllowThreadsReadRegion _allow;
+
+            pthread_mutex_lock(&compile_queue_lock);
+            while (compile_queue.empty() && !compiler_thread_stopping)
+                pthread_cond_wait(&compile_queue_cond, &compile_queue_lock);
+
+            if (compiler_thread_stopping) {
+                pthread_mutex_unlock(&compile_queue_lock);
+                break;
+            }
+
+            job = compile_queue.front();
+            compile_queue.pop_front();
+            compiler_thread_busy = true;
+            pthread_mutex_unlock(&compile_queue_lock);
+        }
+
+        runCompileJob(job);
+
+        // The new version is installed by now, so it's safe to stop telling the interpreter to wait for it:
+        pthread_mutex_lock(&compile_queue_lock);
+        if (job.entry) {
+            pending_osr_compiles.erase(job.entry->backedge);
+            job.entry->background_compile_done.store(true, std::memory_order_release);
+        } else
+            pending_compiles.erase(job.clfunc);
+        compiler_thread_busy = false;
+        pthread_cond_broadcast(&compile_idle_cond);
+        pthread_mutex_unlock(&compile_queue_lock);
+    }
+
+    return NULL;
+}
+
+static void forgetCompilerThread() {
+    // Only the thread that called fork() exists in the child, so any half-finished compile is gone.
+    pthread_mutex_init(&compile_queue_lock, NULL);
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&llvm_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    compile_queue.clear();
+    pending_compiles.clear();
+    pending_osr_compiles.clear();
+    compiler_thread_started = false;
+    compiler_thread_busy = false;
+    g.cur_module = NULL;
+}
+
+// Should be called with compile_queue_lock held.
+static bool queueCompileJob(const CompileJob& job) {
+    if (compiler_thread_stopping)
+        return false;
+
+    if (!compiler_thread_started) {
+        static bool registered_atfork = false;
+        if (!registered_atfork) {
+            pthread_atfork(NULL, NULL, forgetCompilerThread);
+            registered_atfork = true;
+        }
+
+        threading::start_thread(&compilerThreadMain, NULL, NULL, NULL);
+        compiler_thread_started = true;
+    }
+
+    if (VERBOSITY("irgen") >= 1) {
+        printf("Queueing a background compile of %s:%s\n", job.clfunc->source->fn.c_str(),
+               job.clfunc->source->getName().str().c_str());
+    }
+
+    compile_queue.push_back(job);
+    pthread_cond_signal(&compile_queue_cond);
+    return true;
+}
+
+bool queueBackgroundCompile(CLFunction* f, FunctionSpecialization* spec, EffortLevel effort,
+                            ExceptionStyle exception_style) {
+    assert(ENABLE_BACKGROUND_COMPILATION);
+
+    pthread_mutex_lock(&compile_queue_lock);
+    bool queued = false;
+    if (!pending_compiles.count(f)) {
+        queued = queueCompileJob(CompileJob{ f, spec, NULL, effort, exception_style });
+        if (queued)
+            pending_compiles.insert(f);
+    }
+    pthread_mutex_unlock(&compile_queue_lock);
+    return queued;
+}
+
+bool queueBackgroundOSRCompile(CLFunction* f, const OSREntryDescriptor* entry, EffortLevel effort) {
+    assert(ENABLE_BACKGROUND_COMPILATION);
+
+    pthread_mutex_lock(&compile_queue_lock);
+    bool queued = false;
+    if (!pending_osr_compiles.count(entry->backedge)) {
+        queued = queueCompileJob(CompileJob{ f, NULL, entry, effort, ExceptionStyle::CXX });
+        if (queued)
+            pending_osr_compiles.insert(entry->backedge);
+    }
+    pthread_mutex_unlock(&compile_queue_lock);
+    return queued;
+}
+
+bool isBackgroundCompilePending(CLFunction* f) {
+    pthread_mutex_lock(&compile_queue_lock);
+    bool r = pending_compiles.count(f);
+    pthread_mutex_unlock(&compile_queue_lock);
+    return r;
+}
+
+void stopBackgroundCompilation() {
+    pthread_mutex_lock(&compile_queue_lock);
+    if (!compiler_thread_started) {
+        pthread_mutex_unlock(&compile_queue_lock);
+        return;
+    }
+
+    compiler_thread_stopping = true;
+    compile_queue.clear();
+    pthread_cond_signal(&compile_queue_cond);
+    pthread_mutex_unlock(&compile_queue_lock);
+
+    // The in-progress compile (if any) needs the GIL to finish:
+    threading::GLAllowThreadsReadRegion _allow;
+    pthread_mutex_lock(&compile_queue_lock);
+    while (compiler_thread_busy)
+        pthread_cond_wait(&compile_idle_cond, &compile_queue_lock);
+    pthread_mutex_unlock(&compile_queue_lock);
+}
+
+bool inBackgroundCompileThread() {
+    return is_compiler_thread;
+}
+
+void backgroundCompileSafepoint() {
+#if THREADING_USE_GIL
+    if (!is_compiler_thread)
+        return;
+
+    if (threading::gil_drop_request.load(std::memory_order_relaxed))
+        threading::_allowGLReadPreemption();
+#endif
+}
+
 CLFunction* createRTFunction(int num_args, int num_defaults, bool takes_varargs, bool takes_kwargs,
                              const ParamNames& param_names) {
     return new CLFunction(num_args, num_defaults, takes_varargs, takes_kwargs, param_names);
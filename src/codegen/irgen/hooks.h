@@ -26,12 +26,27 @@ class CLFunction;
 class OSRExit;
 class Box;
 class BoxedDict;
+class AST_Jump;
 
 CompiledFunction* compilePartialFuncInternal(OSRExit* exit);
 void* compilePartialFunc(OSRExit*);
 extern "C" CompiledFunction* reoptCompiledFuncInternal(CompiledFunction*);
 extern "C" char* reoptCompiledFunc(CompiledFunction*);
 
+// Background compilation: when ENABLE_BACKGROUND_COMPILATION is set, the interpreter hands hot functions and
+// loops to a compiler thread instead of stopping to compile them itself.  The compiled version gets added to the
+// CLFunction once it's ready, and will be picked up by the next call (or the next time around the loop).
+// These return false if the request wasn't queued (ex because an identical one is already pending).
+bool queueBackgroundCompile(CLFunction* f, FunctionSpecialization* spec, EffortLevel effort,
+                            ExceptionStyle exception_style = ExceptionStyle::CXX);
+bool queueBackgroundOSRCompile(CLFunction* f, const OSREntryDescriptor* entry, EffortLevel effort);
+bool isBackgroundCompilePending(CLFunction* f);
+// Waits for any in-progress background compile to finish, and stops the compiler thread from taking new ones.
+void stopBackgroundCompilation();
+// Irgen calls this between blocks; on the compiler thread, it lets any mutator threads waiting on the GIL run.
+void backgroundCompileSafepoint();
+bool inBackgroundCompileThread();
+
 class AST_Module;
 class BoxedModule;
 void compileAndRunModule(AST_Module* m, BoxedModule* bm);
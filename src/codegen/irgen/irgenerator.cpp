@@ -20,6 +20,7 @@
 #include "analysis/function_analysis.h"
 #include "analysis/scoping_analysis.h"
 #include "analysis/type_analysis.h"
+#include "codegen/ast_interpreter.h"
 #include "codegen/codegen.h"
 #include "codegen/compvars.h"
 #include "codegen/irgen.h"
@@ -214,6 +215,36 @@ llvm::Value* IRGenState::getBoxedLocalsVar() {
     return this->boxed_locals;
 }
 
+IRGenState::CapiExcDest& IRGenState::getCapiExcDest(llvm::BasicBlock* exc_dest, AST_stmt* invoke) {
+    auto it = capi_exc_dests.find(exc_dest);
+    if (it != capi_exc_dests.end())
+        return it->second;
+
+    llvm::BasicBlock* block = llvm::BasicBlock::Create(g.context, "capi_exc", getLLVMFunction());
+    llvm::IRBuilder<true> builder(block);
+
+    // caughtCapiException takes the exception out of the thread state and gives it the same traceback entry for this
+    // frame that the unwinder would have added; we then read it just like the landingpad reads a thrown ExcInfo.
+    llvm::Value* exc_info
+        = builder.CreateBitCast(getScratchSpace(sizeof(ExcInfo)), g.llvm_excinfo_type->getPointerTo());
+    builder.CreateCall3(g.funcs.caughtCapiException, embedRelocatablePtr(invoke, g.llvm_aststmt_type_ptr),
+                        embedRelocatablePtr(getCL(), g.llvm_clfunction_type_ptr), exc_info);
+
+    CapiExcDest& dest = capi_exc_dests[exc_dest];
+    dest.block = block;
+    dest.exc_type = builder.CreateLoad(builder.CreateConstInBoundsGEP2_32(exc_info, 0, 0));
+    dest.exc_value = builder.CreateLoad(builder.CreateConstInBoundsGEP2_32(exc_info, 0, 1));
+    dest.exc_traceback = builder.CreateLoad(builder.CreateConstInBoundsGEP2_32(exc_info, 0, 2));
+    return dest;
+}
+
+IRGenState::CapiExcDest* IRGenState::findCapiExcDest(llvm::BasicBlock* exc_dest) {
+    auto it = capi_exc_dests.find(exc_dest);
+    if (it == capi_exc_dests.end())
+        return NULL;
+    return &it->second;
+}
+
 ScopeInfo* IRGenState::getScopeInfo() {
     return getSourceInfo()->getScopeInfo();
 }
@@ -614,6 +645,34 @@ private:
                 assert(exc_value->getType() == g.llvm_value_type_ptr);
                 assert(exc_traceback->getType() == g.llvm_value_type_ptr);
 
+                if (IRGenState::CapiExcDest* capi_exc_dest = irstate->findCapiExcDest(entry_blocks[myblock])) {
+                    // Join up with the exceptions that got handed back to us (see emitCapiCall).  They can't branch
+                    // here directly, since only unwind edges can go to a landingpad.
+                    llvm::BasicBlock* landed_block = curblock;
+                    llvm::BasicBlock* caught_block
+                        = llvm::BasicBlock::Create(g.context, "caught", irstate->getLLVMFunction());
+                    caught_block->moveAfter(landed_block);
+                    builder->CreateBr(caught_block);
+                    llvm::BranchInst::Create(caught_block, capi_exc_dest->block);
+
+                    builder->SetInsertPoint(caught_block);
+                    curblock = caught_block;
+
+                    llvm::PHINode* type_phi = builder->CreatePHI(g.llvm_value_type_ptr, 2);
+                    type_phi->addIncoming(exc_type, landed_block);
+                    type_phi->addIncoming(capi_exc_dest->exc_type, capi_exc_dest->block);
+                    llvm::PHINode* value_phi = builder->CreatePHI(g.llvm_value_type_ptr, 2);
+                    value_phi->addIncoming(exc_value, landed_block);
+                    value_phi->addIncoming(capi_exc_dest->exc_value, capi_exc_dest->block);
+                    llvm::PHINode* traceback_phi = builder->CreatePHI(g.llvm_value_type_ptr, 2);
+                    traceback_phi->addIncoming(exc_traceback, landed_block);
+                    traceback_phi->addIncoming(capi_exc_dest->exc_traceback, capi_exc_dest->block);
+
+                    exc_type = type_phi;
+                    exc_value = value_phi;
+                    exc_traceback = traceback_phi;
+                }
+
                 return makeTuple({ new ConcreteCompilerVariable(UNKNOWN, exc_type, true),
                                    new ConcreteCompilerVariable(UNKNOWN, exc_value, true),
                                    new ConcreteCompilerVariable(UNKNOWN, exc_traceback, true) });
@@ -826,6 +885,61 @@ private:
         return rtn;
     }
 
+    // Calls that make up a whole invoke statement (see getCapiExpr) hand their exception back instead of throwing it,
+    // the same way as in the interpreter.
+    bool isCapiCall(AST_Call* node, UnwindInfo unw_info) {
+        if (!ENABLE_CAPI_EXCEPTIONS || !ENABLE_ICCALLSITES || !unw_info.needsInvoke()
+            || unw_info.current_stmt->type != AST_TYPE::Invoke)
+            return false;
+        return getCapiExpr(ast_cast<AST_Invoke>(unw_info.current_stmt)->stmt) == node;
+    }
+
+    // Emits the runtimeCallCapi (or callattrCapi, if 'attr' is set) IC, and branches to the exc_dest on a NULL return
+    // without going through the unwinder.  It's still an invoke, since the callee can throw if it isn't a Python
+    // function.
+    ConcreteCompilerVariable* emitCapiCall(UnwindInfo unw_info, CompilerVariable* func, BoxedString* attr,
+                                           CallattrFlags flags, const std::vector<CompilerVariable*>& args) {
+        assert(args.size() == flags.argspec.num_args && args.size() <= 3);
+
+        std::vector<ConcreteCompilerVariable*> converted_args;
+        converted_args.push_back(func->makeConverted(emitter, func->getBoxType()));
+        for (CompilerVariable* a : args)
+            converted_args.push_back(a->makeConverted(emitter, a->getBoxType()));
+
+        void* func_addr;
+        std::vector<llvm::Value*> llvm_args;
+        llvm_args.push_back(converted_args[0]->getValue());
+        if (attr) {
+            func_addr = (void*)callattrCapi;
+            llvm_args.push_back(embedRelocatablePtr(attr, g.llvm_boxedstring_type_ptr));
+            llvm_args.push_back(getConstantInt(flags.asInt(), g.i64));
+        } else {
+            func_addr = (void*)runtimeCallCapi;
+            llvm_args.push_back(getConstantInt(flags.argspec.asInt(), g.i64));
+        }
+        for (int i = 1; i < converted_args.size(); i++)
+            llvm_args.push_back(converted_args[i]->getValue());
+
+        // No type recorder: what these return doesn't get speculated on.
+        ICSetupInfo* pp = createCallsiteIC(NULL, args.size());
+        llvm::Value* uncasted = emitter.createIC(pp, func_addr, llvm_args, unw_info);
+        llvm::Value* rtn = emitter.getBuilder()->CreateIntToPtr(uncasted, g.llvm_value_type_ptr);
+
+        for (ConcreteCompilerVariable* v : converted_args)
+            v->decvref(emitter);
+
+        IRGenState::CapiExcDest& exc_dest = irstate->getCapiExcDest(unw_info.exc_dest, unw_info.current_stmt);
+        llvm::BasicBlock* normal_dest
+            = llvm::BasicBlock::Create(g.context, curblock->getName(), irstate->getLLVMFunction());
+        normal_dest->moveAfter(curblock);
+        llvm::Value* is_null = emitter.getBuilder()->CreateICmpEQ(rtn, getNullPtr(g.llvm_value_type_ptr));
+        emitter.getBuilder()->CreateCondBr(is_null, exc_dest.block, normal_dest);
+
+        emitter.getBuilder()->SetInsertPoint(normal_dest);
+        curblock = normal_dest;
+        return new ConcreteCompilerVariable(UNKNOWN, rtn, true);
+    }
+
     CompilerVariable* evalCall(AST_Call* node, UnwindInfo unw_info) {
         bool is_callattr;
         bool callattr_clsonly = false;
@@ -876,7 +990,10 @@ private:
         //_addAnnotation("before_call");
 
         CompilerVariable* rtn;
-        if (is_callattr) {
+        if (isCapiCall(node, unw_info) && func->getType() == UNKNOWN) {
+            CallattrFlags flags = {.cls_only = callattr_clsonly, .null_on_nonexistent = false, .argspec = argspec };
+            rtn = emitCapiCall(unw_info, func, is_callattr ? attr.getBox() : NULL, flags, args);
+        } else if (is_callattr) {
             CallattrFlags flags = {.cls_only = callattr_clsonly, .null_on_nonexistent = false, .argspec = argspec };
             rtn = func->callattr(emitter, getOpInfoForNode(node, unw_info), attr.getBox(), flags, args, keyword_names);
         } else {
@@ -2192,14 +2309,40 @@ private:
         }
     }
 
+    // In a CAPI-style function, a raise that this function doesn't catch itself gets handed to the caller as a NULL
+    // return instead of getting thrown.
+    void doCapiRaise(AST_Raise* node, llvm::Value* callee, std::vector<llvm::Value*> args, UnwindInfo unw_info) {
+        assert(irstate->getExceptionStyle() == ExceptionStyle::CAPI && !unw_info.needsInvoke());
+
+        args.push_back(embedRelocatablePtr(node, g.llvm_aststmt_type_ptr));
+        args.push_back(embedRelocatablePtr(irstate->getCL(), g.llvm_clfunction_type_ptr));
+        emitter.createCall(unw_info, callee, args);
+
+        for (auto& p : symbol_table) {
+            p.second->decvref(emitter);
+        }
+        symbol_table.clear();
+
+        endBlock(DEAD);
+
+        emitter.getBuilder()->CreateRet(getNullPtr(g.llvm_value_type_ptr));
+    }
+
     void doRaise(AST_Raise* node, UnwindInfo unw_info) {
         // It looks like ommitting the second and third arguments are equivalent to passing None,
         // but ommitting the first argument is *not* the same as passing None.
 
+        bool capi = irstate->getExceptionStyle() == ExceptionStyle::CAPI && !unw_info.needsInvoke();
+
         if (node->arg0 == NULL) {
             assert(!node->arg1);
             assert(!node->arg2);
 
+            if (capi) {
+                doCapiRaise(node, g.funcs.raise0Capi, {}, unw_info);
+                return;
+            }
+
             emitter.createCall(unw_info, g.funcs.raise0, std::vector<llvm::Value*>());
             emitter.getBuilder()->CreateUnreachable();
 
@@ -2219,6 +2362,11 @@ private:
             }
         }
 
+        if (capi) {
+            doCapiRaise(node, g.funcs.raise3Capi, args, unw_info);
+            return;
+        }
+
         emitter.createCall(unw_info, g.funcs.raise3, args);
         emitter.getBuilder()->CreateUnreachable();
 
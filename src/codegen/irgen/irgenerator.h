@@ -33,6 +33,7 @@ class MDNode;
 
 namespace pyston {
 
+class AST_stmt;
 class CFGBlock;
 class GCBuilder;
 struct PatchpointInfo;
@@ -53,6 +54,14 @@ extern const std::string FRAME_INFO_PTR_NAME;
 // to the specific phase or pass we're in.
 // TODO this probably shouldn't be here
 class IRGenState {
+public:
+    // Where the calls that hand back their exception (see IRGeneratorImpl::evalCapiCall) in a try block go on a NULL
+    // return: 'block' fetches the exception, and gets its branch to the landingpad's successor once that's emitted.
+    struct CapiExcDest {
+        llvm::BasicBlock* block;
+        llvm::Value* exc_type, *exc_value, *exc_traceback;
+    };
+
 private:
     // Note: due to some not-yet-fixed behavior, cf->clfunc is NULL will only get set to point
     // to clfunc at the end of irgen.
@@ -70,6 +79,8 @@ private:
     llvm::Value* frame_info_arg;
     int scratch_size;
 
+    // Keyed by the exc_dest block that a thrown exception would land in.
+    std::unordered_map<llvm::BasicBlock*, CapiExcDest> capi_exc_dests;
 
 public:
     IRGenState(CLFunction* clfunc, CompiledFunction* cf, SourceInfo* source_info, std::unique_ptr<PhiAnalysis> phis,
@@ -82,6 +93,7 @@ public:
     llvm::Function* getLLVMFunction() { return cf->func; }
 
     EffortLevel getEffortLevel() { return cf->effort; }
+    ExceptionStyle getExceptionStyle() { return cf->exception_style; }
 
     GCBuilder* getGC() { return gc; }
 
@@ -89,6 +101,12 @@ public:
     llvm::Value* getFrameInfoVar();
     llvm::Value* getBoxedLocalsVar();
 
+    // Creates the CapiExcDest for 'exc_dest' the first time any call inside of 'invoke' asks for it; all of them share
+    // it, since only one invoke can unwind to a given exc_dest.
+    CapiExcDest& getCapiExcDest(llvm::BasicBlock* exc_dest, AST_stmt* invoke);
+    // Returns NULL if there weren't any.
+    CapiExcDest* findCapiExcDest(llvm::BasicBlock* exc_dest);
+
     ConcreteCompilerType* getReturnType() { return cf->getReturnType(); }
 
     SourceInfo* getSourceInfo() { return source_info; }
@@ -0,0 +1,324 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "codegen/jit_profile_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <openssl/evp.h>
+#include <sstream>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "codegen/entry.h"
+#include "codegen/type_recording.h"
+#include "core/ast.h"
+#include "core/cfg.h"
+#include "core/options.h"
+#include "core/stats.h"
+#include "core/types.h"
+#include "runtime/objmodel.h"
+#include "runtime/types.h"
+
+namespace pyston {
+
+static const char* PROFILE_HEADER = "pyston-jit-profile 1";
+
+struct TypePrediction {
+    int block_idx;
+    int node_idx; // index into the flattened body of the block
+    std::string cls_name;
+};
+
+struct FunctionProfile {
+    int num_blocks;
+    std::vector<int> hot_blocks;
+    std::vector<TypePrediction> types;
+};
+
+struct FileProfile {
+    std::string hash; // empty if we couldn't read the file
+    // The profiles we loaded from the cache, keyed by functionKey():
+    std::unordered_map<std::string, FunctionProfile> loaded;
+    // The functions we've run in this process:
+    std::vector<SourceInfo*> sources;
+};
+
+static std::unordered_map<std::string, FileProfile> file_profiles;
+
+static llvm::SmallString<128> getCacheDir() {
+    llvm::SmallString<128> cache_dir;
+    llvm::sys::path::home_directory(cache_dir);
+    llvm::sys::path::append(cache_dir, ".cache");
+    llvm::sys::path::append(cache_dir, "pyston");
+    llvm::sys::path::append(cache_dir, "jit_profiles");
+    return cache_dir;
+}
+
+static std::string hashContents(llvm::StringRef data) {
+    EVP_MD_CTX* md_ctx = EVP_MD_CTX_create();
+    RELEASE_ASSERT(md_ctx, "");
+    int ret = EVP_DigestInit_ex(md_ctx, EVP_sha256(), NULL);
+    RELEASE_ASSERT(ret == 1, "");
+    EVP_DigestUpdate(md_ctx, data.data(), data.size());
+
+    unsigned char md_value[EVP_MAX_MD_SIZE];
+    unsigned int md_len = 0;
+    ret = EVP_DigestFinal_ex(md_ctx, md_value, &md_len);
+    RELEASE_ASSERT(ret == 1, "");
+    EVP_MD_CTX_destroy(md_ctx);
+
+    std::string str;
+    llvm::raw_string_ostream stream(str);
+    for (int i = 0; i < md_len; ++i)
+        stream.write_hex(md_value[i]);
+    return stream.str();
+}
+
+// Identifies a function inside of its file.  The name isn't unique by itself (ex lambdas), so we
+// also use the position of its definition.
+static std::string functionKey(SourceInfo* source) {
+    std::ostringstream os;
+    os << (int)source->ast->type << ' ' << source->ast->lineno << ' ' << source->ast->col_offset << ' '
+       << source->getName().str();
+    return os.str();
+}
+
+static bool parseProfile(llvm::StringRef data, std::unordered_map<std::string, FunctionProfile>& functions) {
+    std::istringstream is(data.str());
+    std::string line;
+    if (!std::getline(is, line) || line != PROFILE_HEADER)
+        return false;
+
+    FunctionProfile* cur = NULL;
+    while (std::getline(is, line)) {
+        std::istringstream ls(line);
+        std::string kind;
+        ls >> kind;
+
+        if (kind == "function") {
+            // The rest of the line is the functionKey():
+            int num_blocks;
+            std::string key;
+            if (!(ls >> num_blocks) || !std::getline(ls >> std::ws, key))
+                return false;
+
+            cur = &functions[key];
+            cur->num_blocks = num_blocks;
+        } else if (kind == "hot" && cur) {
+            int idx;
+            if (!(ls >> idx))
+                return false;
+            cur->hot_blocks.push_back(idx);
+        } else if (kind == "type" && cur) {
+            TypePrediction p;
+            if (!(ls >> p.block_idx >> p.node_idx >> p.cls_name))
+                return false;
+            cur->types.push_back(p);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static FileProfile& getFileProfile(const std::string& fn) {
+    auto it = file_profiles.find(fn);
+    if (it != file_profiles.end())
+        return it->second;
+
+    FileProfile& file = file_profiles[fn];
+
+    auto source_buf = llvm::MemoryBuffer::getFile(fn);
+    if (!source_buf)
+        return file;
+    file.hash = hashContents((*source_buf)->getBuffer());
+
+    llvm::SmallString<128> profile_file = getCacheDir();
+    llvm::sys::path::append(profile_file, file.hash);
+    auto profile_buf = llvm::MemoryBuffer::getFile(profile_file.str());
+    if (!profile_buf)
+        return file;
+
+    static StatCounter num_loaded("num_jit_profiles_loaded");
+    if (parseProfile((*profile_buf)->getBuffer(), file.loaded))
+        num_loaded.log();
+    else
+        file.loaded.clear();
+
+    return file;
+}
+
+static BoxedClass* classFromName(const std::string& name) {
+    Box* b = builtins_module->getattr(internStringMortal(name));
+    if (!b || !isSubclass(b->cls, type_cls))
+        return NULL;
+    return static_cast<BoxedClass*>(b);
+}
+
+static bool isRememberableClass(BoxedClass* cls) {
+    if (cls->tp_flags & Py_TPFLAGS_HEAPTYPE)
+        return false;
+    return classFromName(cls->tp_name) == cls;
+}
+
+void applyJITProfile(SourceInfo* source) {
+    if (!ENABLE_JIT_PROFILE_CACHE || !source->ast)
+        return;
+
+    assert(source->cfg);
+
+    FileProfile& file = getFileProfile(source->fn);
+    if (file.hash.empty())
+        return;
+    file.sources.push_back(source);
+
+    auto it = file.loaded.find(functionKey(source));
+    if (it == file.loaded.end())
+        return;
+
+    // If the cfg doesn't line up, this isn't the function we saved the profile for:
+    const FunctionProfile& profile = it->second;
+    auto& blocks = source->cfg->blocks;
+    if (profile.num_blocks != blocks.size())
+        return;
+
+    if (ENABLE_BASELINEJIT) {
+        static StatCounter num_eager_blocks("num_jit_profile_eager_blocks");
+        for (int idx : profile.hot_blocks) {
+            if (idx >= 0 && idx < blocks.size()) {
+                blocks[idx]->jit_eagerly = true;
+                num_eager_blocks.log();
+            }
+        }
+    }
+
+    int prev_block_idx = -1;
+    std::vector<AST*> flattened;
+    for (const TypePrediction& p : profile.types) {
+        if (p.block_idx < 0 || p.block_idx >= blocks.size())
+            continue;
+
+        if (p.block_idx != prev_block_idx) {
+            flattened.clear();
+            flatten(blocks[p.block_idx]->body, flattened, false);
+            prev_block_idx = p.block_idx;
+        }
+
+        if (p.node_idx < 0 || p.node_idx >= flattened.size())
+            continue;
+
+        BoxedClass* cls = classFromName(p.cls_name);
+        if (cls)
+            getTypeRecorderForNode(flattened[p.node_idx])->seed(cls);
+    }
+}
+
+void forgetJITProfile(SourceInfo* source) {
+    auto it = file_profiles.find(source->fn);
+    if (it == file_profiles.end())
+        return;
+
+    auto& sources = it->second.sources;
+    sources.erase(std::remove(sources.begin(), sources.end(), source), sources.end());
+}
+
+static void writeFunctionProfile(llvm::raw_ostream& os, const std::string& key, const FunctionProfile& profile) {
+    os << "function " << profile.num_blocks << ' ' << key << '\n';
+    for (int idx : profile.hot_blocks)
+        os << "hot " << idx << '\n';
+    for (const TypePrediction& p : profile.types)
+        os << "type " << p.block_idx << ' ' << p.node_idx << ' ' << p.cls_name << '\n';
+}
+
+static FunctionProfile collectProfile(SourceInfo* source) {
+    FunctionProfile profile;
+    profile.num_blocks = source->cfg->blocks.size();
+
+    std::vector<AST*> flattened;
+    for (CFGBlock* block : source->cfg->blocks) {
+        if (block->code || block->jit_eagerly)
+            profile.hot_blocks.push_back(block->idx);
+
+        flattened.clear();
+        flatten(block->body, flattened, false);
+        for (int i = 0; i < flattened.size(); i++) {
+            BoxedClass* cls = predictClassFor(flattened[i]);
+            if (cls && isRememberableClass(cls))
+                profile.types.push_back(TypePrediction{ block->idx, i, cls->tp_name });
+        }
+    }
+    return profile;
+}
+
+void saveJITProfiles() {
+    if (!ENABLE_JIT_PROFILE_CACHE)
+        return;
+
+    llvm::SmallString<128> cache_dir = getCacheDir();
+    if (!llvm::sys::fs::exists(cache_dir.str()) && llvm::sys::fs::create_directories(cache_dir.str()))
+        return;
+
+    static StatCounter num_saved("num_jit_profiles_saved");
+
+    for (auto& p : file_profiles) {
+        FileProfile& file = p.second;
+        if (file.hash.empty() || file.sources.empty())
+            continue;
+
+        // Start from what we loaded, so that functions that didn't get run this time keep their profiles:
+        std::unordered_map<std::string, FunctionProfile> functions = file.loaded;
+        bool any_hot = false;
+        for (SourceInfo* source : file.sources) {
+            FunctionProfile profile = collectProfile(source);
+            if (profile.hot_blocks.empty() && profile.types.empty())
+                continue;
+            functions[functionKey(source)] = std::move(profile);
+            any_hot = true;
+        }
+        if (!any_hot)
+            continue;
+
+        std::string data;
+        llvm::raw_string_ostream os(data);
+        os << PROFILE_HEADER << '\n';
+        for (auto& f : functions)
+            writeFunctionProfile(os, f.first, f.second);
+        os.flush();
+
+        // Other processes might be writing the same profile, so write it to the side and then rename it into place:
+        llvm::SmallString<128> profile_file = cache_dir;
+        llvm::sys::path::append(profile_file, file.hash);
+        std::string tmp_file = (profile_file + "." + std::to_string(getpid()) + ".tmp").str();
+
+        FILE* f = fopen(tmp_file.c_str(), "w");
+        if (!f)
+            continue;
+        bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+        ok = (fclose(f) == 0) && ok;
+        if (ok && rename(tmp_file.c_str(), profile_file.c_str()) == 0)
+            num_saved.log();
+        else
+            unlink(tmp_file.c_str());
+    }
+
+    cleanupCacheDirectory(cache_dir.str(), MAX_OBJECT_CACHE_ENTRIES);
+}
+}
@@ -0,0 +1,39 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PYSTON_CODEGEN_JITPROFILECACHE_H
+#define PYSTON_CODEGEN_JITPROFILECACHE_H
+
+namespace pyston {
+
+class SourceInfo;
+
+// The jit profile cache remembers, from one run of a program to the next, which CFG blocks ended up
+// getting baseline-jitted and which classes the type recorders settled on.  A new process then jits
+// those blocks the first time it enters them, and starts out speculating on those classes, instead of
+// having to warm back up.
+//
+// Profiles don't contain any addresses: they are stored per source file, keyed by the SHA-256 of the
+// file contents, and then by function and CFG block index, so they stay valid until the file changes.
+// Only builtin classes get remembered, since those are the only ones we can find again by name.
+
+// Should be called once a function's CFG has been computed.
+void applyJITProfile(SourceInfo* source);
+void forgetJITProfile(SourceInfo* source);
+
+// Writes out the profile of every function that has been run.
+void saveJITProfiles();
+}
+
+#endif
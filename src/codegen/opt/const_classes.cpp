@@ -28,9 +28,11 @@
 #include "llvm/Target/TargetSubtargetInfo.h"
 
 #include "codegen/codegen.h"
+#include "codegen/irgen/hooks.h"
 #include "codegen/irgen/util.h"
 #include "core/common.h"
 #include "core/options.h"
+#include "core/threading.h"
 #include "runtime/objmodel.h"
 #include "runtime/types.h"
 
@@ -156,6 +158,17 @@ public:
     virtual void getAnalysisUsage(AnalysisUsage& info) const { info.setPreservesCFG(); }
 
     virtual bool runOnFunction(Function& F) {
+        // The background compiler runs the optimization passes with the GIL released, but this pass reads
+        // the classes themselves, so it needs the GIL back while it runs.
+        if (inBackgroundCompileThread()) {
+            threading::GLDisallowThreadsReadRegion _gil;
+            return constFoldClasses(F);
+        }
+        return constFoldClasses(F);
+    }
+
+private:
+    bool constFoldClasses(Function& F) {
         // F.dump();
         bool changed = false;
         for (inst_iterator inst_it = inst_begin(F), _inst_end = inst_end(F); inst_it != _inst_end; ++inst_it) {
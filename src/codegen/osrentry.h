@@ -15,6 +15,7 @@
 #ifndef PYSTON_CODEGEN_OSRENTRY_H
 #define PYSTON_CODEGEN_OSRENTRY_H
 
+#include <atomic>
 #include <map>
 #include <vector>
 
@@ -31,7 +32,10 @@ struct StackMap;
 
 class OSREntryDescriptor {
 private:
-    OSREntryDescriptor(CLFunction* clfunc, AST_Jump* backedge) : clfunc(clfunc), backedge(backedge) { assert(clfunc); }
+    OSREntryDescriptor(CLFunction* clfunc, AST_Jump* backedge)
+        : clfunc(clfunc), backedge(backedge), background_compile_done(false) {
+        assert(clfunc);
+    }
 
 public:
     CLFunction* clfunc;
@@ -39,6 +43,10 @@ public:
     typedef std::map<InternedString, ConcreteCompilerType*> ArgMap;
     ArgMap args;
 
+    // Set by the background compiler once it is done with this entry, so that the interpreter frame waiting
+    // for it can check on every backedge without taking any locks.
+    mutable std::atomic<bool> background_compile_done;
+
     static OSREntryDescriptor* create(CLFunction* clfunc, AST_Jump* backedge) {
         return new OSREntryDescriptor(clfunc, backedge);
     }
@@ -333,11 +333,11 @@ ICSetupInfo* createBinexpIC(TypeRecorder* type_recorder) {
 }
 
 ICSetupInfo* createNonzeroIC(TypeRecorder* type_recorder) {
-    return ICSetupInfo::initialize(true, 2, 64, ICSetupInfo::Nonzero, type_recorder);
+    return ICSetupInfo::initialize(true, 2, 72, ICSetupInfo::Nonzero, type_recorder);
 }
 
 ICSetupInfo* createHasnextIC(TypeRecorder* type_recorder) {
-    return ICSetupInfo::initialize(true, 2, 64, ICSetupInfo::Hasnext, type_recorder);
+    return ICSetupInfo::initialize(true, 2, 72, ICSetupInfo::Hasnext, type_recorder);
 }
 
 } // namespace pyston
@@ -0,0 +1,271 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "codegen/profiling/perf_map.h"
+
+#include <cstdio>
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "llvm/DebugInfo/DIContext.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "codegen/codegen.h"
+#include "codegen/profiling/profiling.h"
+#include "core/ast.h"
+#include "core/common.h"
+#include "core/options.h"
+#include "core/thread_utils.h"
+#include "core/types.h"
+
+namespace pyston {
+
+// From the jitdump specification:
+#define JITDUMP_MAGIC 0x4A695444
+#define JITDUMP_VERSION 1
+
+enum JitDumpRecordType {
+    JIT_CODE_LOAD = 0,
+    JIT_CODE_MOVE = 1,
+    JIT_CODE_DEBUG_INFO = 2,
+    JIT_CODE_CLOSE = 3,
+};
+
+struct JitDumpHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t total_size;
+    uint32_t elf_mach;
+    uint32_t pad1;
+    uint32_t pid;
+    uint64_t timestamp;
+    uint64_t flags;
+};
+
+struct JitDumpRecordHeader {
+    uint32_t id;
+    uint32_t total_size;
+    uint64_t timestamp;
+};
+
+// Followed by the null-terminated name, and then the code bytes:
+struct JitDumpCodeLoad {
+    JitDumpRecordHeader header;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t vma;
+    uint64_t code_addr;
+    uint64_t code_size;
+    uint64_t code_index;
+};
+
+// Followed by nr_entry entries, each of which is followed by its null-terminated filename:
+struct JitDumpDebugInfo {
+    JitDumpRecordHeader header;
+    uint64_t code_addr;
+    uint64_t nr_entry;
+};
+
+struct JitDumpDebugEntry {
+    uint64_t addr;
+    int32_t lineno;
+    int32_t discrim;
+};
+
+static threading::PthreadFastMutex perf_map_lock;
+static bool perf_map_initialized = false;
+static FILE* perf_map_file = NULL;
+static FILE* jitdump_file = NULL;
+static uint64_t jitdump_code_index = 0;
+
+// perf's jitdump support requires this clock (`perf record -k mono`):
+static uint64_t jitdumpTimestamp() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+static void openJitDump() {
+    char fn[80];
+    snprintf(fn, sizeof(fn), "/tmp/jit-%d.dump", getpid());
+    int fd = open(fn, O_CREAT | O_TRUNC | O_RDWR, 0666);
+    if (fd < 0) {
+        fprintf(stderr, "Warning: couldn't open %s for writing\n", fn);
+        return;
+    }
+
+    // perf record only finds out about the dump file by seeing that it got mapped executable, so we have to
+    // map it even though we don't use the mapping:
+    void* marker = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+    if (marker == MAP_FAILED) {
+        fprintf(stderr, "Warning: couldn't mmap %s; perf won't be able to find it\n", fn);
+        close(fd);
+        return;
+    }
+
+    jitdump_file = fdopen(fd, "w");
+    RELEASE_ASSERT(jitdump_file, "");
+
+    JitDumpHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = JITDUMP_MAGIC;
+    header.version = JITDUMP_VERSION;
+    header.total_size = sizeof(header);
+    header.elf_mach = EM_X86_64;
+    header.pid = getpid();
+    header.timestamp = jitdumpTimestamp();
+    fwrite(&header, sizeof(header), 1, jitdump_file);
+    fflush(jitdump_file);
+}
+
+static void initPerfMap() {
+    perf_map_initialized = true;
+
+    if (PERF_MAP >= 1) {
+        char fn[80];
+        snprintf(fn, sizeof(fn), "/tmp/perf-%d.map", getpid());
+        perf_map_file = fopen(fn, "w");
+        if (!perf_map_file)
+            fprintf(stderr, "Warning: couldn't open %s for writing\n", fn);
+    }
+
+    if (PERF_MAP >= 2)
+        openJitDump();
+}
+
+static void writeJitDumpDebugInfo(uint64_t code_addr, uint64_t timestamp, llvm::ArrayRef<PerfLineEntry> lines) {
+    JitDumpDebugInfo info;
+    info.header.id = JIT_CODE_DEBUG_INFO;
+    info.header.total_size = sizeof(info);
+    for (const PerfLineEntry& e : lines)
+        info.header.total_size += sizeof(JitDumpDebugEntry) + e.filename.size() + 1;
+    info.header.timestamp = timestamp;
+    info.code_addr = code_addr;
+    info.nr_entry = lines.size();
+    fwrite(&info, sizeof(info), 1, jitdump_file);
+
+    for (const PerfLineEntry& e : lines) {
+        JitDumpDebugEntry entry;
+        entry.addr = e.addr;
+        entry.lineno = e.line;
+        entry.discrim = 0;
+        fwrite(&entry, sizeof(entry), 1, jitdump_file);
+        fwrite(e.filename.c_str(), e.filename.size() + 1, 1, jitdump_file);
+    }
+}
+
+static void writeJitDumpCodeLoad(const void* addr, size_t size, llvm::StringRef name, uint64_t timestamp) {
+    JitDumpCodeLoad load;
+    load.header.id = JIT_CODE_LOAD;
+    load.header.total_size = sizeof(load) + name.size() + 1 + size;
+    load.header.timestamp = timestamp;
+    load.pid = getpid();
+    load.tid = syscall(SYS_gettid);
+    load.vma = load.code_addr = (uint64_t)addr;
+    load.code_size = size;
+    load.code_index = jitdump_code_index++;
+    fwrite(&load, sizeof(load), 1, jitdump_file);
+    fwrite(name.data(), name.size(), 1, jitdump_file);
+    fputc('\0', jitdump_file);
+    fwrite(addr, size, 1, jitdump_file);
+}
+
+void registerPerfMapRegion(const void* addr, size_t size, llvm::StringRef name, llvm::ArrayRef<PerfLineEntry> lines) {
+    if (!PERF_MAP || size == 0)
+        return;
+
+    LOCK_REGION(&perf_map_lock);
+
+    if (!perf_map_initialized)
+        initPerfMap();
+
+    // We flush after every entry, since the point is to be able to profile processes that never exit cleanly.
+    if (perf_map_file) {
+        fprintf(perf_map_file, "%lx %lx %.*s\n", (uintptr_t)addr, size, (int)name.size(), name.data());
+        fflush(perf_map_file);
+    }
+
+    if (jitdump_file) {
+        // The debug info has to come before the code it describes:
+        uint64_t timestamp = jitdumpTimestamp();
+        if (!lines.empty())
+            writeJitDumpDebugInfo((uint64_t)addr, timestamp, lines);
+        writeJitDumpCodeLoad(addr, size, name, timestamp);
+        fflush(jitdump_file);
+    }
+}
+
+// Names the functions that LLVM emits after the Python function that they were compiled from.
+class PerfMapJITEventListener : public llvm::JITEventListener {
+public:
+    virtual void NotifyObjectEmitted(const llvm::object::ObjectFile& Obj,
+                                     const llvm::RuntimeDyld::LoadedObjectInfo& L) {
+        std::unique_ptr<llvm::DIContext> context;
+        if (PERF_MAP >= 2)
+            context.reset(llvm::DIContext::getDWARFContext(Obj));
+
+        for (const auto& sym : Obj.symbols()) {
+            llvm::object::SymbolRef::Type sym_type;
+            if (sym.getType(sym_type) || sym_type != llvm::object::SymbolRef::ST_Function)
+                continue;
+
+            llvm::StringRef sym_name;
+            uint64_t size;
+            if (sym.getName(sym_name) || sym.getSize(size))
+                continue;
+
+            uint64_t addr = L.getSymbolLoadAddress(sym_name);
+            if (!addr)
+                continue;
+
+            std::string name;
+            llvm::raw_string_ostream os(name);
+            CompiledFunction* cf = g.cur_cf;
+            if (cf && cf->clfunc && cf->clfunc->source) {
+                SourceInfo* source = cf->clfunc->source.get();
+                os << source->getName() << ' ' << source->fn << ':' << source->ast->lineno << " [llvm O"
+                   << (int)cf->effort << (cf->entry_descriptor ? " osr" : "") << ']';
+            } else {
+                os << sym_name;
+            }
+            os.flush();
+
+            std::vector<PerfLineEntry> lines;
+            if (context) {
+                llvm::DILineInfoTable table = context->getLineInfoForAddressRange(
+                    addr, size,
+                    llvm::DILineInfoSpecifier(llvm::DILineInfoSpecifier::FileLineInfoKind::AbsoluteFilePath,
+                                              llvm::DILineInfoSpecifier::FunctionNameKind::None));
+                for (const auto& p : table)
+                    lines.push_back(PerfLineEntry{ p.first, (int)p.second.Line, p.second.FileName });
+            }
+
+            registerPerfMapRegion((void*)addr, size, name, lines);
+        }
+    }
+};
+
+llvm::JITEventListener* makePerfMapJITEventListener() {
+    if (PERF_MAP)
+        return new PerfMapJITEventListener();
+    return NULL;
+}
+static RegisterHelper X(makePerfMapJITEventListener);
+}
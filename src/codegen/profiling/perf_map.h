@@ -0,0 +1,48 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PYSTON_CODEGEN_PROFILING_PERFMAP_H
+#define PYSTON_CODEGEN_PROFILING_PERFMAP_H
+
+#include <cstdint>
+#include <string>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace pyston {
+
+// Tells perf(1) about the code that we generate, so that samples in it get attributed to the Python function,
+// CFG block or IC that it came from instead of showing up as anonymous addresses.
+//
+// With PERF_MAP >= 1 (-J), every region gets a line in /tmp/perf-<pid>.map as soon as it gets emitted.
+// With PERF_MAP >= 2 (-JJ), we also write /tmp/jit-<pid>.dump in the jitdump format (see
+// tools/perf/Documentation/jitdump-specification.txt in the Linux tree), which includes the code bytes and line
+// tables.  To use it, record with `perf record -k mono` and then run `perf inject --jit`.
+//
+// Regions can be registered again when their code gets rewritten (ex IC slots), and can be nested inside of
+// other regions (ex patchpoints inside of functions).  The perf map can't express either of those exactly, but
+// jitdump can, since every record is timestamped.
+
+struct PerfLineEntry {
+    uint64_t addr;
+    int line;
+    std::string filename;
+};
+
+void registerPerfMapRegion(const void* addr, size_t size, llvm::StringRef name,
+                           llvm::ArrayRef<PerfLineEntry> lines = llvm::None);
+}
+
+#endif
@@ -269,6 +269,11 @@ void initGlobalFuncs(GlobalState& g) {
     g.funcs.__cxa_end_catch = addFunc((void*)__cxa_end_catch, g.void_);
     GET(raise0);
     GET(raise3);
+    g.funcs.raise0Capi = addFunc((void*)raise0Capi, g.void_, g.llvm_aststmt_type_ptr, g.llvm_clfunction_type_ptr);
+    g.funcs.raise3Capi = addFunc((void*)raise3Capi, g.void_, g.llvm_value_type_ptr, g.llvm_value_type_ptr,
+                                 g.llvm_value_type_ptr, g.llvm_aststmt_type_ptr, g.llvm_clfunction_type_ptr);
+    g.funcs.caughtCapiException = addFunc((void*)caughtCapiException, g.void_, g.llvm_aststmt_type_ptr,
+                                          g.llvm_clfunction_type_ptr, g.llvm_excinfo_type->getPointerTo());
     GET(deopt);
 
     GET(div_float_float);
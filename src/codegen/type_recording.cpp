@@ -52,6 +52,14 @@ BoxedClass* predictClassFor(AST* node) {
     return r->predict();
 }
 
+void TypeRecorder::seed(BoxedClass* cls) {
+    if (last_seen)
+        return;
+
+    last_seen = cls;
+    last_count = SPECULATION_THRESHOLD + 1;
+}
+
 BoxedClass* TypeRecorder::predict() {
     if (!ENABLE_TYPE_FEEDBACK)
         return NULL;
@@ -41,6 +41,8 @@ public:
     constexpr TypeRecorder() : last_seen(nullptr), last_count(0) {}
 
     BoxedClass* predict();
+    // Start out predicting this class, as if we had already seen it enough times to speculate on it.
+    void seed(BoxedClass* cls);
 
     friend Box* recordType(TypeRecorder*, Box*);
 };
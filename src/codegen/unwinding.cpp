@@ -95,6 +95,9 @@ void parseEhFrame(uint64_t start_addr, uint64_t size, uint64_t func_addr, uint64
 }
 
 void registerDynamicEhFrame(uint64_t code_addr, size_t code_size, uint64_t eh_frame_addr, size_t eh_frame_size) {
+    // The address range might have belonged to code that has since been freed:
+    invalidateUnwindInfoCache(code_addr, code_size);
+
     unw_dyn_info_t* dyn_info = new unw_dyn_info_t();
     dyn_info->start_ip = code_addr;
     dyn_info->end_ip = code_addr + code_size;
@@ -518,13 +521,13 @@ public:
         stat.log(t.end());
     }
 
-    void addTraceback(const LineInfo& line_info) {
+    void addTraceback(AST_stmt* stmt, CLFunction* clfunc) {
         RELEASE_ASSERT(is_active, "");
         if (exc_info.reraise) {
             exc_info.reraise = false;
             return;
         }
-        BoxedTraceback::here(line_info, &exc_info.traceback);
+        BoxedTraceback::here(stmt, clfunc, &exc_info.traceback);
     }
 
     void logException() {
@@ -593,22 +596,20 @@ void throwingException(PythonUnwindSession* unwind) {
     unwind->logException();
 }
 
-static const LineInfo lineInfoForFrame(PythonFrameIteratorImpl* frame_it) {
-    AST_stmt* current_stmt = frame_it->getCurrentStatement();
+static void addTracebackForFrame(PythonFrameIteratorImpl* frame_it, Box** tb) {
     auto* cl = frame_it->getCL();
     assert(cl);
-
-    auto source = cl->source.get();
-
-    return LineInfo(current_stmt->lineno, current_stmt->col_offset, source->fn, source->getName());
+    BoxedTraceback::here(frame_it->getCurrentStatement(), cl, tb);
 }
 
-void exceptionCaughtInInterpreter(LineInfo line_info, ExcInfo* exc_info) {
+void exceptionCaughtInInterpreter(AST_stmt* stmt, CLFunction* clfunc, ExcInfo* exc_info) {
     // basically the same as PythonUnwindSession::addTraceback, but needs to
     // be callable after an PythonUnwindSession has ended.  The interpreter
     // will call this from catch blocks if it needs to ensure that a
-    // line is added.  Right now this only happens in
-    // ASTInterpreter::visit_invoke.
+    // line is added: when it catches an exception in visit_invoke,
+    // or when it returns one to its caller without throwing it.
+    // Compiled ExceptionStyle::CAPI functions call it (through
+    // raise0Capi/raise3Capi) for the same reason.
 
     // It's basically the same except for one thing: we don't have to
     // worry about the 'skip' (osr) state that PythonUnwindSession handles
@@ -620,7 +621,7 @@ void exceptionCaughtInInterpreter(LineInfo line_info, ExcInfo* exc_info) {
         exc_info->reraise = false;
         return;
     }
-    BoxedTraceback::here(line_info, &exc_info->traceback);
+    BoxedTraceback::here(stmt, clfunc, &exc_info->traceback);
 }
 
 void unwindingThroughFrame(PythonUnwindSession* unwind_session, unw_cursor_t* cursor) {
@@ -633,7 +634,7 @@ void unwindingThroughFrame(PythonUnwindSession* unwind_session, unw_cursor_t* cu
         unwind_session->setShouldSkipNextFrame(true);
     } else if (frameIsPythonFrame(ip, bp, cursor, &frame_iter)) {
         if (!unwind_session->shouldSkipFrame())
-            unwind_session->addTraceback(lineInfoForFrame(&frame_iter));
+            unwind_session->addTraceback(frame_iter.getCurrentStatement(), frame_iter.getCL());
 
         // frame_iter->cf->entry_descriptor will be non-null for OSR frames.
         bool was_osr = (frame_iter.getId().type == PythonFrameId::COMPILED) && (frame_iter.cf->entry_descriptor);
@@ -771,7 +772,7 @@ Box* getTraceback() {
 
     Box* tb = None;
     unwindPythonStack([&](PythonFrameIteratorImpl* frame_iter) {
-        BoxedTraceback::here(lineInfoForFrame(frame_iter), &tb);
+        addTracebackForFrame(frame_iter, &tb);
         return false;
     });
 
@@ -32,6 +32,9 @@ class BoxedTraceback;
 struct FrameInfo;
 
 void registerDynamicEhFrame(uint64_t code_addr, size_t code_size, uint64_t eh_frame_addr, size_t eh_frame_size);
+// Forget any cached unwind info for [addr, addr+size); has to be called whenever code there gets freed or gets new
+// unwind info.
+void invalidateUnwindInfoCache(uint64_t addr, size_t size);
 
 void setupUnwinding();
 BoxedModule* getCurrentModule();
@@ -49,7 +52,7 @@ void endPythonUnwindSession(PythonUnwindSession* unwind_session);
 void* getPythonUnwindSessionExceptionStorage(PythonUnwindSession* unwind_session);
 void unwindingThroughFrame(PythonUnwindSession* unwind_session, unw_cursor_t* cursor);
 
-void exceptionCaughtInInterpreter(LineInfo line_info, ExcInfo* exc_info);
+void exceptionCaughtInInterpreter(AST_stmt* stmt, CLFunction* clfunc, ExcInfo* exc_info);
 
 CLFunction* getTopPythonFunction();
 
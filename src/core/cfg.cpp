@@ -2471,6 +2471,84 @@ void CFG::print() {
         blocks[i]->print();
 }
 
+class AssignVRegsVisitor : public NoopASTVisitor {
+private:
+    ScopeInfo* scope_info;
+    CFG* cfg;
+
+public:
+    AssignVRegsVisitor(ScopeInfo* scope_info, CFG* cfg) : scope_info(scope_info), cfg(cfg) {}
+
+    int assignVReg(InternedString name) {
+        auto it = cfg->sym_vreg_map.find(name);
+        if (it != cfg->sym_vreg_map.end())
+            return it->second;
+
+        int vreg = cfg->vreg_sym_map.size();
+        cfg->sym_vreg_map[name] = vreg;
+        cfg->vreg_sym_map.push_back(name);
+        return vreg;
+    }
+
+    // Only the parts of nested scopes that get evaluated in this one:
+    bool visit_classdef(AST_ClassDef* node) {
+        for (auto e : node->bases)
+            e->accept(this);
+        for (auto e : node->decorator_list)
+            e->accept(this);
+        return true;
+    }
+
+    bool visit_functiondef(AST_FunctionDef* node) {
+        for (auto e : node->decorator_list)
+            e->accept(this);
+        for (auto e : node->args->defaults)
+            e->accept(this);
+        return true;
+    }
+
+    bool visit_lambda(AST_Lambda* node) {
+        for (auto e : node->args->defaults)
+            e->accept(this);
+        return true;
+    }
+
+    bool visit_name(AST_Name* node) {
+        if (node->lookup_type == ScopeInfo::VarScopeType::UNKNOWN)
+            node->lookup_type = scope_info->getScopeTypeOfName(node->id);
+
+        if (node->lookup_type == ScopeInfo::VarScopeType::FAST
+            || node->lookup_type == ScopeInfo::VarScopeType::CLOSURE)
+            node->vreg = assignVReg(node->id);
+        return true;
+    }
+};
+
+void CFG::assignVRegs(const ParamNames& param_names, ScopeInfo* scope_info, InternedStringPool& interned_strings) {
+    assert(vreg_sym_map.empty());
+
+    AssignVRegsVisitor visitor(scope_info, this);
+
+    // Give the parameters the first vregs, since they might not show up in the body:
+    auto assign_param = [&](llvm::StringRef name) {
+        InternedString interned = interned_strings.get(name);
+        auto vst = scope_info->getScopeTypeOfName(interned);
+        if (vst == ScopeInfo::VarScopeType::FAST || vst == ScopeInfo::VarScopeType::CLOSURE)
+            visitor.assignVReg(interned);
+    };
+    for (auto name : param_names.args)
+        assign_param(name);
+    if (!param_names.vararg.empty())
+        assign_param(param_names.vararg);
+    if (!param_names.kwarg.empty())
+        assign_param(param_names.kwarg);
+
+    for (CFGBlock* b : blocks) {
+        for (AST_stmt* stmt : b->body)
+            stmt->accept(&visitor);
+    }
+}
+
 CFG* computeCFG(SourceInfo* source, std::vector<AST_stmt*> body) {
     STAT_TIMER(t0, "us_timer_computecfg", 0);
 
@@ -2712,6 +2790,8 @@ CFG* computeCFG(SourceInfo* source, std::vector<AST_stmt*> body) {
         rtn->print();
     }
 
+    rtn->assignVRegs(ParamNames(source->ast, source->getInternedStrings()), source->getScopeInfo(),
+                     source->getInternedStrings());
 
     return rtn;
 }
@@ -29,6 +29,8 @@
 
 #include <vector>
 
+#include "llvm/ADT/DenseMap.h"
+
 #include "core/ast.h"
 #include "core/common.h"
 #include "core/stringpool.h"
@@ -37,6 +39,7 @@ namespace pyston {
 
 class AST_stmt;
 class Box;
+struct ParamNames;
 
 class CFG;
 class CFGBlock {
@@ -49,6 +52,8 @@ public:
     void* code;
     // contains the address of the entry function
     std::pair<CFGBlock*, Box*>(*entry_code)(void* interpeter, CFGBlock* block);
+    // set if a previous run of the program ended up JIT'ing this block (see codegen/jit_profile_cache.h)
+    bool jit_eagerly;
 
     std::vector<AST_stmt*> body;
     std::vector<CFGBlock*> predecessors, successors;
@@ -57,7 +62,8 @@ public:
 
     typedef std::vector<AST_stmt*>::iterator iterator;
 
-    CFGBlock(CFG* cfg, int idx) : cfg(cfg), code(NULL), entry_code(NULL), idx(idx), info(NULL) {}
+    CFGBlock(CFG* cfg, int idx)
+        : cfg(cfg), code(NULL), entry_code(NULL), jit_eagerly(false), idx(idx), info(NULL) {}
 
     void connectTo(CFGBlock* successor, bool allow_backedge = false);
     void unconnectFrom(CFGBlock* successor);
@@ -74,8 +80,24 @@ private:
 public:
     std::vector<CFGBlock*> blocks;
 
+    // Every name that gets stored in the frame (FAST and CLOSURE names, including the '#' temporaries) gets assigned
+    // a dense "virtual register" index, so that the interpreter can keep its locals in a flat array instead of a map.
+    // The index also gets cached in AST_Name::vreg.
+    llvm::DenseMap<InternedString, int> sym_vreg_map;
+    std::vector<InternedString> vreg_sym_map;
+
     CFG() : next_idx(0) {}
 
+    int getNumVRegs() const { return vreg_sym_map.size(); }
+    // Returns -1 if the name doesn't live in a vreg.
+    int getVReg(InternedString name) const {
+        auto it = sym_vreg_map.find(name);
+        if (it == sym_vreg_map.end())
+            return -1;
+        return it->second;
+    }
+    void assignVRegs(const ParamNames& param_names, ScopeInfo* scope_info, InternedStringPool& interned_strings);
+
     CFGBlock* getStartingBlock() { return blocks[0]; }
 
     CFGBlock* addBlock() {
@@ -30,12 +30,14 @@ int PYTHON_VERSION_HEX = version_hex(PYTHON_VERSION_MAJOR, PYTHON_VERSION_MINOR,
 int MAX_OPT_ITERATIONS = 1;
 
 bool ASSEMBLY_LOGGING = false;
+bool DUMP_IC_STATS = false;
 bool CONTINUE_AFTER_FATAL = false;
 bool FORCE_INTERPRETER = false;
 bool FORCE_OPTIMIZE = false;
 bool SHOW_DISASM = false;
 bool PROFILE = false;
 bool DUMPJIT = false;
+int PERF_MAP = 0;
 bool TRAP = false;
 bool USE_STRIPPED_STDLIB = true; // always true
 bool ENABLE_INTERPRETER = true;
@@ -44,6 +46,7 @@ bool ENABLE_PYPA_PARSER = true;
 bool USE_REGALLOC_BASIC = true;
 bool PAUSE_AT_ABORT = false;
 bool ENABLE_TRACEBACKS = true;
+bool ENABLE_BACKGROUND_COMPILATION = false;
 
 int OSR_THRESHOLD_INTERPRETER = 25;
 int REOPT_THRESHOLD_INTERPRETER = 25;
@@ -54,6 +57,8 @@ int REOPT_THRESHOLD_T2 = 10000;
 int SPECULATION_THRESHOLD = 100;
 
 int MAX_OBJECT_CACHE_ENTRIES = 500;
+// How many free generator stacks get to keep their memory; past that, we give the pages back to the OS.
+int MAX_CACHED_GENERATOR_STACKS = 32;
 
 static bool _GLOBAL_ENABLE = 1;
 bool ENABLE_ICS = 1 && _GLOBAL_ENABLE;
@@ -77,6 +82,9 @@ bool ENABLE_PYSTON_PASSES = 1 && _GLOBAL_ENABLE;
 bool ENABLE_TYPE_FEEDBACK = 1 && _GLOBAL_ENABLE;
 bool ENABLE_RUNTIME_ICS = 1 && _GLOBAL_ENABLE;
 bool ENABLE_JIT_OBJECT_CACHE = 1 && _GLOBAL_ENABLE;
+bool ENABLE_JIT_PROFILE_CACHE = 0 && _GLOBAL_ENABLE;
+bool ENABLE_STACKLESS_GENERATORS = 1 && _GLOBAL_ENABLE;
+bool ENABLE_CAPI_EXCEPTIONS = 1 && _GLOBAL_ENABLE;
 
 bool ENABLE_FRAME_INTROSPECTION = 1;
 bool BOOLS_AS_I64 = ENABLE_FRAME_INTROSPECTION;
@@ -14,11 +14,13 @@
 
 #include "core/threading.h"
 
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <err.h>
 #include <setjmp.h>
 #include <sys/syscall.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "Python.h"
@@ -473,15 +475,41 @@ extern "C" void endAllowThreads() noexcept {
     acquireGLRead();
 }
 
+static std::atomic<int> gil_switch_interval_us(5000);
+
+void setGILSwitchInterval(int us) {
+    assert(us > 0);
+    gil_switch_interval_us = us;
+}
+
+int getGILSwitchInterval() {
+    return gil_switch_interval_us;
+}
+
 #if THREADING_USE_GIL
 #if THREADING_USE_GRWL
 #error "Can't turn on both the GIL and the GRWL!"
 #endif
 
-static pthread_mutex_t gil = PTHREAD_MUTEX_INITIALIZER;
+// This is the "new GIL" from CPython 3.2: a thread that wants the GIL waits for at most one switch interval and then
+// asks the holder to drop it, instead of the holder giving it up every so many checks whether anyone has been waiting
+// long or not.  That keeps a thread that just came back from blocking on I/O from getting starved by CPU-bound ones.
+//
+// All of the state below is protected by gil_mutex; gil_drop_request and threads_waiting_on_gil are also read
+// without it as hints.
+static pthread_mutex_t gil_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Signaled whenever the GIL gets released:
+static pthread_cond_t gil_released = PTHREAD_COND_INITIALIZER;
+// Signaled whenever a thread takes the GIL, for the thread that was made to drop it:
+static pthread_cond_t gil_switched = PTHREAD_COND_INITIALIZER;
+static bool gil_locked = false;
+static pthread_t gil_last_holder;
+// Incremented every time the GIL goes to a different thread, so a waiter can tell whether it changed hands while
+// the waiter was asleep:
+static uint64_t gil_switch_number = 0;
 
 std::atomic<int> threads_waiting_on_gil(0);
-static pthread_cond_t gil_acquired = PTHREAD_COND_INITIALIZER;
+std::atomic<int> gil_drop_request(0);
 
 extern "C" void PyEval_ReInitThreads() noexcept {
     pthread_t current_thread = pthread_self();
@@ -506,44 +534,87 @@ extern "C" void PyEval_ReInitThreads() noexcept {
     threading_lock.unlock();
 
     num_starting_threads = 0;
+
+    // Some other thread could have been in the middle of waiting for the GIL when we forked:
+    pthread_mutex_init(&gil_mutex, NULL);
+    pthread_cond_init(&gil_released, NULL);
+    pthread_cond_init(&gil_switched, NULL);
     threads_waiting_on_gil = 0;
+    gil_drop_request = 0;
+    gil_last_holder = current_thread;
 
     // TODO we should clean up all created PerThreadSets, such as the one used in the heap for thread-local-caches.
 }
 
 void acquireGLWrite() {
-    threads_waiting_on_gil++;
-    pthread_mutex_lock(&gil);
-    threads_waiting_on_gil--;
+    pthread_mutex_lock(&gil_mutex);
+
+    if (gil_locked) {
+        Timer _t("waiting for the gil", /*min_usec=*/10000);
+
+        threads_waiting_on_gil++;
+        while (gil_locked) {
+            uint64_t switch_number = gil_switch_number;
 
-    pthread_cond_signal(&gil_acquired);
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += gil_switch_interval_us.load(std::memory_order_relaxed) * 1000L;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+
+            int r = pthread_cond_timedwait(&gil_released, &gil_mutex, &deadline);
+
+            // If the GIL stayed with the same thread for a whole interval, it's our turn:
+            if (r == ETIMEDOUT && gil_locked && gil_switch_number == switch_number)
+                gil_drop_request.store(1, std::memory_order_relaxed);
+        }
+        threads_waiting_on_gil--;
+
+        long wait_us = _t.end();
+        static thread_local StatPerThreadCounter sc_gil_wait_us("gil_wait_us");
+        sc_gil_wait_us.log(wait_us);
+    }
+
+    gil_locked = true;
+    if (!pthread_equal(gil_last_holder, pthread_self())) {
+        gil_last_holder = pthread_self();
+        gil_switch_number++;
+    }
+    gil_drop_request.store(0, std::memory_order_relaxed);
+
+    // Let a thread that was made to drop the GIL know that we have it now:
+    pthread_cond_signal(&gil_switched);
+    pthread_mutex_unlock(&gil_mutex);
 }
 
 void releaseGLWrite() {
-    pthread_mutex_unlock(&gil);
+    pthread_mutex_lock(&gil_mutex);
+    assert(gil_locked);
+    gil_locked = false;
+    pthread_cond_signal(&gil_released);
+    pthread_mutex_unlock(&gil_mutex);
 }
 
-int gil_check_count = 0;
-
-// TODO: this function is fair in that it forces a thread to give up the GIL
-// after a bounded amount of time, but currently we have no guarantees about
-// who it will release the GIL to.  So we could have two threads that are
-// switching back and forth, and a third that never gets run.
-// We could enforce fairness by having a FIFO of events (implementd with mutexes?)
-// and make sure to always wake up the longest-waiting one.
 void _allowGLReadPreemption() {
-    assert(gil_check_count >= GIL_CHECK_INTERVAL);
-    gil_check_count = 0;
+    pthread_mutex_lock(&gil_mutex);
 
-    // Double check this, since if we are wrong about there being a thread waiting on the gil,
-    // we're going to get stuck in the following pthread_cond_wait:
-    if (!threads_waiting_on_gil.load(std::memory_order_seq_cst))
+    // Double check this, since the callers only looked at it without the lock:
+    if (!gil_drop_request.load(std::memory_order_relaxed)) {
+        pthread_mutex_unlock(&gil_mutex);
         return;
+    }
+
+    assert(gil_locked);
+    gil_locked = false;
+    pthread_cond_signal(&gil_released);
+
+    // Don't try to take the GIL back until some other thread has had it, since otherwise we'd usually win:
+    while (threads_waiting_on_gil.load(std::memory_order_relaxed) && pthread_equal(gil_last_holder, pthread_self()))
+        pthread_cond_wait(&gil_switched, &gil_mutex);
 
-    threads_waiting_on_gil++;
-    pthread_cond_wait(&gil_acquired, &gil);
-    threads_waiting_on_gil--;
-    pthread_cond_signal(&gil_acquired);
+    pthread_mutex_unlock(&gil_mutex);
+
+    acquireGLWrite();
 }
 #elif THREADING_USE_GRWL
 static pthread_rwlock_t grwl = PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP;
@@ -89,11 +89,14 @@ void acquireGLWrite();
 void releaseGLWrite();
 void _allowGLReadPreemption();
 
-#define GIL_CHECK_INTERVAL 1000
-// Note: this doesn't need to be an atomic, since it should
-// only be accessed by the thread that holds the gil:
-extern int gil_check_count;
+// How long a thread gets to hold the GIL while others are waiting for it.  A thread that has waited this long
+// without anyone else getting the GIL sets gil_drop_request, and the holder then hands the GIL over at its next
+// allowGLReadPreemption() and can't take it back until the waiter has had it.
+void setGILSwitchInterval(int us);
+int getGILSwitchInterval();
+
 extern std::atomic<int> threads_waiting_on_gil;
+extern std::atomic<int> gil_drop_request;
 extern "C" inline void allowGLReadPreemption() __attribute__((visibility("default")));
 extern "C" inline void allowGLReadPreemption() {
 #if ENABLE_SAMPLING_PROFILER
@@ -109,11 +112,7 @@ extern "C" inline void allowGLReadPreemption() {
 #endif
 
     // Double-checked locking: first read with no ordering constraint:
-    if (!threads_waiting_on_gil.load(std::memory_order_relaxed))
-        return;
-
-    gil_check_count++;
-    if (likely(gil_check_count < GIL_CHECK_INTERVAL))
+    if (likely(!gil_drop_request.load(std::memory_order_relaxed)))
         return;
 
     _allowGLReadPreemption();
@@ -146,6 +145,13 @@ public:
     ~GLAllowThreadsReadRegion() { endAllowThreads(); }
 };
 
+// Takes the GL back for a while from inside a GLAllowThreadsReadRegion.
+class GLDisallowThreadsReadRegion {
+public:
+    GLDisallowThreadsReadRegion() { endAllowThreads(); }
+    ~GLDisallowThreadsReadRegion() { beginAllowThreads(); }
+};
+
 
 #if THREADING_USE_GIL
 inline void acquireGLRead() {
@@ -221,6 +221,13 @@ class ICInfo;
 class LocationMap;
 class JitCodeBlock;
 
+// How a function hands an exception to its caller: CXX throws an ExcInfo, CAPI returns NULL and leaves the exception
+// set in the thread state, like the CPython C API does.
+enum class ExceptionStyle {
+    CAPI,
+    CXX,
+};
+
 struct CompiledFunction {
 private:
 public:
@@ -240,6 +247,9 @@ public:
     int code_size;
 
     EffortLevel effort;
+    // CAPI versions only get called through runtimeCallCapi() and callattrCapi(), and live in
+    // CLFunction::capi_versions.
+    ExceptionStyle exception_style;
 
     int64_t times_called, times_speculation_failed;
     ICInvalidator dependent_callsites;
@@ -249,7 +259,7 @@ public:
     std::vector<ICInfo*> ics;
 
     CompiledFunction(llvm::Function* func, FunctionSpecialization* spec, void* code, EffortLevel effort,
-                     const OSREntryDescriptor* entry_descriptor);
+                     const OSREntryDescriptor* entry_descriptor, ExceptionStyle exception_style = ExceptionStyle::CXX);
 
     ConcreteCompilerType* getReturnType();
 
@@ -315,6 +325,9 @@ public:
         versions; // any compiled versions along with their type parameters; in order from most preferred to least
     CompiledFunction* always_use_version; // if this version is set, always use it (for unboxed cases)
     std::unordered_map<const OSREntryDescriptor*, CompiledFunction*> osr_versions;
+    // Versions that return NULL instead of throwing when a raise statement isn't caught in the function itself.
+    // They are kept apart from 'versions' since nothing else knows how to call them.
+    FunctionList capi_versions;
 
     // Please use codeForFunction() to access this:
     BoxedCode* code_obj;
@@ -323,6 +336,10 @@ public:
     int times_interpreted;
     std::vector<std::unique_ptr<JitCodeBlock>> code_blocks;
     ICInvalidator dependent_interp_callsites;
+    // Whether generators of this function can run without a stack of their own (see canRunGeneratorStackless()).
+    // Computed the first time we create one of them.
+    enum class StacklessGenerator : char { UNKNOWN, YES, NO };
+    StacklessGenerator stackless_generator;
 
     // Functions can provide an "internal" version, which will get called instead
     // of the normal dispatch through the functionlist.
@@ -346,7 +363,10 @@ public:
         assert(compiled->code);
         compiled->clfunc = this;
 
-        if (compiled->entry_descriptor == NULL) {
+        if (compiled->exception_style == ExceptionStyle::CAPI) {
+            assert(compiled->entry_descriptor == NULL);
+            capi_versions.push_back(compiled);
+        } else if (compiled->entry_descriptor == NULL) {
             bool could_have_speculations = (source.get() != NULL);
             if (!could_have_speculations && versions.size() == 0 && compiled->effort == EffortLevel::MAXIMAL
                 && compiled->spec->accepts_all_inputs && compiled->spec->boxed_return_value)
@@ -380,7 +400,8 @@ CLFunction* unboxRTFunction(Box*);
 // Compiles a new version of the function with the given signature and adds it to the list;
 // should only be called after checking to see if the other versions would work.
 CompiledFunction* compileFunction(CLFunction* f, FunctionSpecialization* spec, EffortLevel effort,
-                                  const OSREntryDescriptor* entry);
+                                  const OSREntryDescriptor* entry,
+                                  ExceptionStyle exception_style = ExceptionStyle::CXX);
 EffortLevel initialEffort();
 
 typedef bool i1;
@@ -14,9 +14,13 @@
 
 #include "gc/collector.h"
 
+#include <atomic>
 #include <cassert>
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "codegen/ast_interpreter.h"
 #include "codegen/codegen.h"
@@ -59,33 +63,142 @@ static std::unordered_set<GCRootHandle*>* getRootHandles() {
 
 static int ncollections = 0;
 
+static int64_t envInt(const char* name, int64_t default_value) {
+    const char* s = getenv(name);
+    if (!s || !*s)
+        return default_value;
+    char* end;
+    int64_t r = strtoll(s, &end, 10);
+    RELEASE_ASSERT(*end == '\0' && r >= 0, "%s should be a non-negative integer, got '%s'", name, s);
+    return r;
+}
+
+// When to collect.  After a collection, the next one happens once the program has allocated
+// gc_percent% of the heap that survived it (but at least min_trigger_bytes), so that programs with
+// a big live heap don't spend most of their time re-marking it.  If the heap grows past
+// max_heap_bytes, we collect more often instead, and only do full collections.
+// These can be set with PYSTON_GC_PERCENT, PYSTON_GC_MIN_TRIGGER_KB and PYSTON_GC_MAX_HEAP_MB, and
+// gc_percent through gc.set_growth_percent().
+static int gc_percent = envInt("PYSTON_GC_PERCENT", 100);
+static size_t min_trigger_bytes = envInt("PYSTON_GC_MIN_TRIGGER_KB", ALLOCBYTES_PER_COLLECTION / 1024) * 1024;
+static size_t max_heap_bytes = envInt("PYSTON_GC_MAX_HEAP_MB", 0) << 20; // 0 means no limit
+
+// The values last passed to gc.set_threshold(); see setGCThresholds() for what they mean here.
+static int gc_threshold0 = 700, gc_threshold1 = 8, gc_threshold2 = 1;
+
+// Our estimate of how many bytes are live: the bytes marked by the last full collection, plus the
+// ones marked by the minor collections since then.
+static size_t live_bytes = 0;
+static std::atomic<int64_t> marked_bytes;
+
+// Full collections also free old objects, so we fall back to one every so often.
+static int minor_collections_per_full = 8;
+static int minor_collections_since_full = 0;
+
+// gc handlers that only trace memory inside the GC heap; see registerHeapOnlyGCHandler().
+static std::vector<void (*)(GCVisitor*, Box*)> heap_only_gc_handlers;
+
 static bool gc_enabled = true;
 static bool should_not_reenter_gc = false;
 
+// The mark phase runs on the collecting thread plus up to MAX_MARKER_THREADS - 1 helper threads.
+// Every marker has its own TraceStack.  When a marker fills up a chunk of its stack while some other
+// marker is out of work, it hands the chunk over to the MarkingWorkPool, which is where idle markers
+// take their work from.  Marking is done once all markers are idle and the pool is empty.
+#define MAX_MARKER_THREADS 8
+
+class MarkingWorkPool {
+private:
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+    std::vector<void**> chunks;
+    int nmarkers;
+    std::atomic<int> nidle;
+    bool done;
+
+public:
+    void reset(int nmarkers) {
+        assert(chunks.empty());
+        this->nmarkers = nmarkers;
+        nidle = 0;
+        done = false;
+    }
+
+    // Checked without the lock, so this is only a hint.
+    bool hasIdleMarkers() { return nidle.load(std::memory_order_relaxed) > 0; }
+
+    void give(void** chunk) {
+        pthread_mutex_lock(&lock);
+        chunks.push_back(chunk);
+        pthread_cond_signal(&cond);
+        pthread_mutex_unlock(&lock);
+    }
+
+    // Blocks until there is a chunk to work on, or returns NULL once marking is finished.
+    void** take() {
+        pthread_mutex_lock(&lock);
+
+        nidle++;
+        while (chunks.empty() && !done) {
+            if (nidle == nmarkers) {
+                done = true;
+                pthread_cond_broadcast(&cond);
+                break;
+            }
+            pthread_cond_wait(&cond, &lock);
+        }
+
+        void** rtn = NULL;
+        if (done) {
+            assert(chunks.empty());
+        } else {
+            rtn = chunks.back();
+            chunks.pop_back();
+            nidle--;
+        }
+
+        pthread_mutex_unlock(&lock);
+        return rtn;
+    }
+};
+static MarkingWorkPool marking_pool;
+
 class TraceStack {
 private:
-    const int CHUNK_SIZE = 256;
-    const int MAX_FREE_CHUNKS = 50;
+    static const int CHUNK_SIZE = 256;
+    static const int MAX_FREE_CHUNKS = 50;
 
     std::vector<void**> chunks;
     static std::vector<void**> free_chunks;
+    static threading::PthreadFastMutex free_chunks_lock;
+
+    // NULL if this is the only marker:
+    MarkingWorkPool* pool;
 
     void** cur;
     void** start;
     void** end;
 
     void get_chunk() {
-        if (free_chunks.size()) {
-            start = free_chunks.back();
-            free_chunks.pop_back();
-        } else {
-            start = (void**)malloc(sizeof(void*) * CHUNK_SIZE);
+        {
+            LOCK_REGION(free_chunks_lock);
+            if (free_chunks.size()) {
+                start = free_chunks.back();
+                free_chunks.pop_back();
+            } else {
+                start = NULL;
+            }
         }
 
+        if (!start)
+            start = (void**)malloc(sizeof(void*) * CHUNK_SIZE);
+
         cur = start;
         end = start + CHUNK_SIZE;
     }
     void release_chunk(void** chunk) {
+        LOCK_REGION(free_chunks_lock);
         if (free_chunks.size() == MAX_FREE_CHUNKS)
             free(chunk);
         else
@@ -99,26 +212,24 @@ private:
     }
 
 public:
-    TraceStack() { get_chunk(); }
-    TraceStack(const std::unordered_set<void*>& rhs) {
-        get_chunk();
-        for (void* p : rhs) {
-            assert(!isMarked(GCAllocation::fromUserData(p)));
-            push(p);
-        }
+    TraceStack(MarkingWorkPool* pool = NULL) : pool(pool) { get_chunk(); }
+    ~TraceStack() {
+        assert(chunks.empty());
+        release_chunk(start);
     }
 
     void push(void* p) {
         GC_TRACE_LOG("Pushing %p\n", p);
         GCAllocation* al = GCAllocation::fromUserData(p);
-        if (isMarked(al))
+        if (testAndSetMark(al))
             return;
 
-        setMark(al);
-
         *cur++ = p;
         if (cur == end) {
-            chunks.push_back(start);
+            if (pool && pool->hasIdleMarkers())
+                pool->give(start);
+            else
+                chunks.push_back(start);
             get_chunk();
         }
     }
@@ -129,12 +240,21 @@ public:
             pop_chunk();
             assert(cur == end);
             return *--cur; // no need for any bounds checks here since we're guaranteed we're CHUNK_SIZE from the start
-        } else {
-            // We emptied the stack, but we should prepare a new chunk in case another item
-            // gets added onto the stack.
-            get_chunk();
-            return NULL;
         }
+
+        if (pool) {
+            if (void** stolen = pool->take()) {
+                start = stolen;
+                end = start + CHUNK_SIZE;
+                cur = end;
+                return *--cur;
+            }
+        }
+
+        // We emptied the stack, but we should prepare a new chunk in case another item
+        // gets added onto the stack.
+        get_chunk();
+        return NULL;
     }
 
 
@@ -146,6 +266,7 @@ public:
     }
 };
 std::vector<void**> TraceStack::free_chunks;
+threading::PthreadFastMutex TraceStack::free_chunks_lock;
 
 void registerPermanentRoot(void* obj, bool allow_duplicates) {
     assert(global_heap.getAllocationFromInteriorPointer(obj));
@@ -176,6 +297,10 @@ extern "C" PyObject* PyGC_AddRoot(PyObject* obj) noexcept {
     return obj;
 }
 
+extern "C" void PyGC_RegisterWeaklyReferenced(PyObject* obj) noexcept {
+    global_heap.registerWeaklyReferenced(obj);
+}
+
 void registerNonheapRootObject(void* obj, int size) {
     // I suppose that things could work fine even if this were true, but why would it happen?
     assert(global_heap.getAllocationFromInteriorPointer(obj) == NULL);
@@ -198,6 +323,28 @@ bool isValidGCMemory(void* p) {
     return isNonheapRoot(p) || (global_heap.getAllocationFromInteriorPointer(p)->user_data == p);
 }
 
+void registerHeapOnlyGCHandler(void (*handler)(GCVisitor*, Box*)) {
+    heap_only_gc_handlers.push_back(handler);
+}
+
+bool mustAlwaysRescan(GCAllocation* al) {
+    if (al->kind_id == GCKind::HIDDEN_CLASS)
+        return true; // hidden classes keep their children in std containers
+
+    if (al->kind_id != GCKind::PYTHON)
+        return false;
+
+    Box* b = (Box*)al->user_data;
+    if (!b->cls)
+        return true;
+
+    for (auto handler : heap_only_gc_handlers) {
+        if (b->cls->gc_visit == handler)
+            return false;
+    }
+    return true;
+}
+
 bool isValidGCObject(void* p) {
     if (isNonheapRoot(p))
         return true;
@@ -322,6 +469,99 @@ static __attribute__((always_inline)) void visitByGCKind(void* p, GCVisitor& vis
     }
 }
 
+// Root scanning that can be split up between the marker threads.  The thread stacks and root
+// handles are scanned by the collecting thread itself.
+struct RootTask {
+    enum Kind {
+        PERMANENT_ROOTS, // range of user pointers
+        POTENTIAL_RANGE, // range of memory to scan conservatively
+        OLD_OBJECTS,     // range of ObjLookupCache, see markOldObject()
+    } kind;
+    const void* start;
+    const void* end;
+
+    RootTask(Kind kind, const void* start, const void* end) : kind(kind), start(start), end(end) {}
+};
+
+static std::vector<RootTask> root_tasks;
+static std::atomic<size_t> next_root_task;
+static std::vector<void*> permanent_roots;
+static std::vector<ObjLookupCache> old_objects_to_rescan;
+
+// How many words of memory, or how many objects, a single RootTask covers:
+#define ROOT_TASK_SIZE 4096
+
+template <typename T> static void addRootTasks(RootTask::Kind kind, const T* start, const T* end) {
+    while (start < end) {
+        const T* task_end = std::min(end, start + ROOT_TASK_SIZE);
+        root_tasks.push_back(RootTask(kind, start, task_end));
+        start = task_end;
+    }
+}
+
+// In a minor collection, old objects are not traced, so the only way for a young object to be
+// reachable through one is if the old object was modified since the last collection.  Those get
+// treated as roots.
+static void markOldObject(const ObjLookupCache& e, GCVisitor& visitor) {
+    GCAllocation* al = (GCAllocation*)e.data;
+    assert(isMarked(al));
+
+    if (al->kind_id == GCKind::UNTRACKED) {
+        // Untracked memory (ex list or dict storage) is normally traced through the object that
+        // owns it, but the owner isn't necessarily on a dirty page itself.
+        uintptr_t end = ((uintptr_t)al + e.size) & ~(sizeof(void*) - 1);
+        visitor.visitPotentialRange((void**)al->user_data, (void**)end);
+    } else {
+        visitByGCKind(al->user_data, visitor);
+    }
+}
+
+static void prepareRootTasks(bool minor) {
+    static StatCounter sc_rescanned("gc_minor_rescanned_old_objects");
+
+    root_tasks.clear();
+    next_root_task = 0;
+
+    permanent_roots.assign(roots.begin(), roots.end());
+    addRootTasks(RootTask::PERMANENT_ROOTS, permanent_roots.data(), permanent_roots.data() + permanent_roots.size());
+
+    for (auto& e : potential_root_ranges) {
+        assert((uintptr_t)e.first % sizeof(void*) == 0);
+        addRootTasks(RootTask::POTENTIAL_RANGE, (void* const*)e.first, (void* const*)e.second);
+    }
+
+    old_objects_to_rescan.clear();
+    if (minor) {
+        global_heap.findOldObjectsToRescan(old_objects_to_rescan);
+        sc_rescanned.log(old_objects_to_rescan.size());
+        addRootTasks(RootTask::OLD_OBJECTS, old_objects_to_rescan.data(),
+                     old_objects_to_rescan.data() + old_objects_to_rescan.size());
+    }
+}
+
+static void runRootTasks(GCVisitor& visitor) {
+    while (true) {
+        size_t idx = next_root_task++;
+        if (idx >= root_tasks.size())
+            break;
+
+        RootTask& task = root_tasks[idx];
+        if (task.kind == RootTask::PERMANENT_ROOTS) {
+            for (void* const* p = (void* const*)task.start; p < task.end; p++) {
+                // In a minor collection, roots that are already old will be skipped here.
+                visitor.stack->push(*p);
+            }
+        } else if (task.kind == RootTask::POTENTIAL_RANGE) {
+            visitor.visitPotentialRange((void* const*)task.start, (void* const*)task.end);
+        } else {
+            assert(task.kind == RootTask::OLD_OBJECTS);
+            for (auto e = (const ObjLookupCache*)task.start; e < task.end; e++) {
+                markOldObject(*e, visitor);
+            }
+        }
+    }
+}
+
 static void markRoots(GCVisitor& visitor) {
     GC_TRACE_LOG("Looking at the stack\n");
     threading::visitAllStacks(&visitor);
@@ -331,21 +571,20 @@ static void markRoots(GCVisitor& visitor) {
         visitor.visit(h->value);
     }
 
-    GC_TRACE_LOG("Looking at potential root ranges\n");
-    for (auto& e : potential_root_ranges) {
-        visitor.visitPotentialRange((void* const*)e.first, (void* const*)e.second);
-    }
+    GC_TRACE_LOG("Looking at permanent roots and potential root ranges\n");
+    runRootTasks(visitor);
 }
 
-static void graphTraversalMarking(TraceStack& stack, GCVisitor& visitor) {
-    static StatCounter sc_us("us_gc_mark_phase_graph_traversal");
-    static StatCounter sc_marked_objs("gc_marked_object_count");
-    Timer _t("traversing", /*min_usec=*/10000);
+// Returns the number of objects that were traced.
+static int64_t traceReachable(TraceStack& stack, GCVisitor& visitor) {
+    int64_t nmarked = 0;
+    int64_t nbytes = 0;
 
     while (void* p = stack.pop()) {
-        sc_marked_objs.log();
+        nmarked++;
 
         GCAllocation* al = GCAllocation::fromUserData(p);
+        nbytes += global_heap.allocationSize(al);
 
 #if TRACE_GC_MARKING
         if (al->kind_id == GCKind::PYTHON || al->kind_id == GCKind::CONSERVATIVE_PYTHON)
@@ -358,12 +597,98 @@ static void graphTraversalMarking(TraceStack& stack, GCVisitor& visitor) {
         visitByGCKind(p, visitor);
     }
 
+    marked_bytes += nbytes;
+    return nmarked;
+}
+
+static std::atomic<int64_t> helpers_marked_objs;
+
+static void graphTraversalMarking(TraceStack& stack, GCVisitor& visitor) {
+    static StatCounter sc_us("us_gc_mark_phase_graph_traversal");
+    static StatCounter sc_marked_objs("gc_marked_object_count");
+    Timer _t("traversing", /*min_usec=*/10000);
+
+    sc_marked_objs.log(traceReachable(stack, visitor));
+
     long us = _t.end();
     sc_us.log(us);
 }
 
-static void markPhase() {
+// The helper marker threads are started on the first collection, and then wait for the collecting
+// thread to bump marking_epoch.  The gc handlers they call only ever read the objects they visit,
+// and the heap doesn't change while we're marking, so they don't need any further synchronization.
+static int num_marker_helpers = -1;
+static int marking_epoch = 0;
+static int helpers_running = 0;
+static pthread_mutex_t helpers_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t helpers_wakeup = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t helpers_finished = PTHREAD_COND_INITIALIZER;
+
+static void* markerHelperMain(void* arg) {
+    int seen_epoch = (int)(intptr_t)arg;
+
+    while (true) {
+        pthread_mutex_lock(&helpers_lock);
+        while (marking_epoch == seen_epoch)
+            pthread_cond_wait(&helpers_wakeup, &helpers_lock);
+        seen_epoch = marking_epoch;
+        pthread_mutex_unlock(&helpers_lock);
+
+        {
+            TraceStack stack(&marking_pool);
+            GCVisitor visitor(&stack);
+
+            runRootTasks(visitor);
+            helpers_marked_objs += traceReachable(stack, visitor);
+        }
+
+        pthread_mutex_lock(&helpers_lock);
+        if (--helpers_running == 0)
+            pthread_cond_signal(&helpers_finished);
+        pthread_mutex_unlock(&helpers_lock);
+    }
+
+    return NULL;
+}
+
+static void forgetMarkerHelpers() {
+    // Only the thread that called fork() exists in the child.
+    num_marker_helpers = -1;
+}
+
+static int startMarkerHelpers() {
+    if (num_marker_helpers >= 0)
+        return num_marker_helpers;
+
+    static bool registered_atfork = false;
+    if (!registered_atfork) {
+        pthread_atfork(NULL, NULL, forgetMarkerHelpers);
+        registered_atfork = true;
+    }
+
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int nhelpers = std::max(0L, std::min(ncpus, (long)MAX_MARKER_THREADS) - 1);
+#ifndef NVALGRIND
+    if (RUNNING_ON_VALGRIND)
+        nhelpers = 0;
+#endif
+
+    num_marker_helpers = 0;
+    for (int i = 0; i < nhelpers; i++) {
+        pthread_t thread;
+        int code = pthread_create(&thread, NULL, markerHelperMain, (void*)(intptr_t)marking_epoch);
+        if (code)
+            break;
+        pthread_detach(thread);
+        num_marker_helpers++;
+    }
+
+    return num_marker_helpers;
+}
+
+static void markPhase(bool minor) {
     static StatCounter sc_us("us_gc_mark_phase");
+    static StatCounter sc_helpers_marked_objs("gc_marked_object_count_helpers");
     Timer _t("markPhase", /*min_usec=*/10000);
 
 #ifndef NVALGRIND
@@ -374,13 +699,43 @@ static void markPhase() {
 
     GC_TRACE_LOG("Starting collection %d\n", ncollections);
 
-    GC_TRACE_LOG("Looking at roots\n");
-    TraceStack stack(roots);
-    GCVisitor visitor(&stack);
+    prepareRootTasks(minor);
 
-    markRoots(visitor);
+    int nhelpers = startMarkerHelpers();
+    marking_pool.reset(nhelpers + 1);
+    helpers_marked_objs = 0;
+    marked_bytes = 0;
 
-    graphTraversalMarking(stack, visitor);
+    if (nhelpers) {
+        pthread_mutex_lock(&helpers_lock);
+        helpers_running = nhelpers;
+        marking_epoch++;
+        pthread_cond_broadcast(&helpers_wakeup);
+        pthread_mutex_unlock(&helpers_lock);
+    }
+
+    {
+        GC_TRACE_LOG("Looking at roots\n");
+        TraceStack stack(nhelpers ? &marking_pool : NULL);
+        GCVisitor visitor(&stack);
+
+        markRoots(visitor);
+
+        graphTraversalMarking(stack, visitor);
+    }
+
+    if (nhelpers) {
+        pthread_mutex_lock(&helpers_lock);
+        while (helpers_running)
+            pthread_cond_wait(&helpers_finished, &helpers_lock);
+        pthread_mutex_unlock(&helpers_lock);
+
+        sc_helpers_marked_objs.log(helpers_marked_objs);
+    }
+
+    // The rest is little work, so just do it on this thread.
+    TraceStack stack;
+    GCVisitor visitor(&stack);
 
     // Some classes might be unreachable. Unfortunately, we have to keep them around for
     // one more collection, because during the sweep phase, instances of unreachable
@@ -431,6 +786,58 @@ static void sweepPhase(std::vector<Box*>& weakly_referenced) {
     sc_us.log(us);
 }
 
+static void updateCollectionTrigger() {
+    // Like in CPython, a threshold of 0 turns off automatic collections.
+    if (gc_threshold0 == 0) {
+        bytesAllocatedTrigger = SIZE_MAX;
+        return;
+    }
+
+    size_t trigger = std::max(live_bytes / 100 * gc_percent, min_trigger_bytes);
+
+    if (max_heap_bytes) {
+        if (live_bytes >= max_heap_bytes) {
+            // Minor collections can't get us back under the limit.
+            trigger = min_trigger_bytes;
+            minor_collections_since_full = minor_collections_per_full;
+        } else if (live_bytes + trigger > max_heap_bytes) {
+            trigger = std::max(max_heap_bytes - live_bytes, min_trigger_bytes);
+        }
+    }
+
+    bytesAllocatedTrigger = trigger;
+}
+
+void setGCThresholds(int threshold0, int threshold1, int threshold2) {
+    gc_threshold0 = threshold0;
+    gc_threshold1 = threshold1;
+    gc_threshold2 = threshold2;
+
+    // Our full collections are what CPython would do for its oldest generation, which it collects once every
+    // threshold1 * threshold2 collections of the youngest one.
+    int64_t minors = (int64_t)std::max(threshold1, 0) * std::max(threshold2, 0);
+    minor_collections_per_full = std::min(minors, (int64_t)INT_MAX);
+
+    // Apply the new settings right away, rather than after the next collection:
+    updateCollectionTrigger();
+}
+
+void getGCThresholds(int* threshold0, int* threshold1, int* threshold2) {
+    *threshold0 = gc_threshold0;
+    *threshold1 = gc_threshold1;
+    *threshold2 = gc_threshold2;
+}
+
+void setGCGrowthPercent(int percent) {
+    assert(percent >= 0);
+    gc_percent = percent;
+    updateCollectionTrigger();
+}
+
+int getGCGrowthPercent() {
+    return gc_percent;
+}
+
 bool gcIsEnabled() {
     return gc_enabled;
 }
@@ -453,17 +860,20 @@ void endGCUnexpectedRegion() {
     should_not_reenter_gc = false;
 }
 
-void runCollection() {
+static void collect(bool minor) {
     static StatCounter sc_us("us_gc_collections");
     static StatCounter sc("gc_collections");
+    static StatCounter sc_minor("gc_minor_collections");
     sc.log();
+    if (minor)
+        sc_minor.log();
 
     UNAVOIDABLE_STAT_TIMER(t0, "us_timer_gc_collection");
 
     ncollections++;
 
     if (VERBOSITY("gc") >= 2)
-        printf("Collection #%d\n", ncollections);
+        printf("%s collection #%d\n", minor ? "Minor" : "Full", ncollections);
 
     // The bulk of the GC work is not reentrant-safe.
     // In theory we should never try to reenter that section, but it's happened due to bugs,
@@ -488,7 +898,10 @@ void runCollection() {
 
     global_heap.prepareForCollection();
 
-    markPhase();
+    if (!minor)
+        global_heap.clearMarks();
+
+    markPhase(minor);
 
     // The sweep phase will not free weakly-referenced objects, so that we can inspect their
     // weakrefs_list.  We want to defer looking at those lists until the end of the sweep phase,
@@ -523,6 +936,11 @@ void runCollection() {
         global_heap.free(GCAllocation::fromUserData(o));
     }
 
+    // Every live object is old at this point, so this is where the next minor collection starts
+    // watching for modified objects.
+    if (global_heap.dirtyPageTrackingEnabled())
+        global_heap.resetDirtyPages();
+
 #if TRACE_GC_MARKING
     fclose(trace_fp);
     trace_fp = NULL;
@@ -543,6 +961,14 @@ void runCollection() {
 
     global_heap.cleanupAfterCollection();
 
+    static StatCounter sc_live_bytes("gc_live_bytes_estimate");
+    if (minor)
+        live_bytes += marked_bytes;
+    else
+        live_bytes = marked_bytes;
+    sc_live_bytes.log(live_bytes);
+    updateCollectionTrigger();
+
     if (VERBOSITY("gc") >= 2)
         printf("Collection #%d done\n\n", ncollections);
 
@@ -552,5 +978,20 @@ void runCollection() {
     // dumpHeapStatistics();
 }
 
+void runCollection() {
+    minor_collections_since_full = 0;
+    collect(false);
+}
+
+void runMinorCollection() {
+    if (!global_heap.dirtyPageTrackingEnabled() || minor_collections_since_full >= minor_collections_per_full) {
+        runCollection();
+        return;
+    }
+
+    minor_collections_since_full++;
+    collect(true);
+}
+
 } // namespace gc
 } // namespace pyston
@@ -58,7 +58,28 @@ public:
     Box* operator->() { return value; }
 };
 
+// Runs a full collection.
 void runCollection();
+// Runs a minor collection, which only frees objects allocated since the previous collection.
+// This turns into a full collection every few calls, or if minor collections aren't supported.
+void runMinorCollection();
+
+// Tells the collector that this gc handler only looks at memory inside the GC heap.  Minor
+// collections find the old objects that could point to young ones by looking for heap pages that
+// were written to; old objects with any other handler (which might store references in malloc'd
+// memory, a generator stack, etc) get rescanned by every minor collection.
+void registerHeapOnlyGCHandler(void (*handler)(GCVisitor*, Box*));
+
+// The arguments to gc.set_threshold(), which keep their CPython meanings as far as they can.  In CPython,
+// threshold0 is a number of allocations between collections; we trigger on the bytes allocated instead
+// (see setGCGrowthPercent()), so the only value of it that matters is 0, which disables automatic
+// collections.  Full collections happen once every threshold1 * threshold2 minor collections.
+void setGCThresholds(int threshold0, int threshold1, int threshold2);
+void getGCThresholds(int* threshold0, int* threshold1, int* threshold2);
+
+// How much the heap may grow between collections, as a percentage of what was live after the last one.
+void setGCGrowthPercent(int percent);
+int getGCGrowthPercent();
 
 // Python programs are allowed to pause the GC.  This is supposed to pause automatic GC,
 // but does not seem to pause manual calls to gc.collect().  So, callers should check gcIsEnabled(),
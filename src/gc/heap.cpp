@@ -16,7 +16,9 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <fcntl.h>
 #include <stdint.h>
+#include <unistd.h>
 
 #include "core/common.h"
 #include "core/util.h"
@@ -87,12 +89,15 @@ template <class ListT, typename Func> inline void forEach(ListT* list, Func func
 }
 
 template <class ListT, typename Free>
-inline void sweepList(ListT* head, std::vector<Box*>& weakly_referenced, Free free_func) {
+inline void sweepList(ListT* head, std::vector<Box*>& weakly_referenced, std::vector<GCAllocation*>& always_rescan,
+                      Free free_func) {
     auto cur = head;
     while (cur) {
         GCAllocation* al = cur->data;
         if (isMarked(al)) {
-            clearMark(al);
+            // Survivors keep their mark bit: they are old now.
+            if (mustAlwaysRescan(al))
+                always_rescan.push_back(al);
             cur = cur->next;
         } else {
             if (_doFree(al, &weakly_referenced)) {
@@ -108,7 +113,8 @@ inline void sweepList(ListT* head, std::vector<Box*>& weakly_referenced, Free fr
     }
 }
 
-unsigned bytesAllocatedSinceCollection;
+size_t bytesAllocatedSinceCollection;
+size_t bytesAllocatedTrigger = ALLOCBYTES_PER_COLLECTION;
 static StatCounter gc_registered_bytes("gc_registered_bytes");
 void _bytesAllocatedTripped() {
     gc_registered_bytes.log(bytesAllocatedSinceCollection);
@@ -119,7 +125,7 @@ void _bytesAllocatedTripped() {
 
     threading::GLPromoteRegion _lock;
 
-    runCollection();
+    runMinorCollection();
 }
 
 Heap global_heap;
@@ -162,6 +168,20 @@ __attribute__((always_inline)) bool _doFree(GCAllocation* al, std::vector<Box*>*
     return true;
 }
 
+#ifndef NDEBUG
+static bool hasWeakrefs(GCAllocation* al) {
+    if (al->kind_id != GCKind::PYTHON && al->kind_id != GCKind::CONSERVATIVE_PYTHON)
+        return false;
+
+    Box* b = (Box*)al->user_data;
+    if (!PyType_SUPPORTS_WEAKREFS(b->cls))
+        return false;
+
+    PyWeakReference** list = (PyWeakReference**)PyObject_GET_WEAKREFS_LISTPTR(b);
+    return list && *list;
+}
+#endif
+
 void Heap::destructContents(GCAllocation* al) {
     _doFree(al, NULL);
 }
@@ -196,12 +216,46 @@ struct HeapStatistics {
     TypeStats python, conservative, conservative_python, untracked, hcls, precise;
     TypeStats total;
 
+    // How much memory each arena holds on to.  "committed" excludes the pages we decommitted,
+    // and "resident" is what the kernel actually has backing the arena right now.
+    struct MemoryStats {
+        int64_t mapped;
+        int64_t committed;
+        int64_t resident;
+        MemoryStats() : mapped(0), committed(0), resident(0) {}
+
+        void print(const char* name) const {
+            fprintf(stderr, "%s: %.1f MB mapped, %.1f MB committed, %.1f MB resident\n", name,
+                    mapped * 1.0 / (1 << 20), committed * 1.0 / (1 << 20), resident * 1.0 / (1 << 20));
+        }
+    };
+
+    MemoryStats small_memory, large_memory, huge_memory;
+
+    SizeClassStats size_classes[NUM_BUCKETS];
+
     HeapStatistics(bool collect_cls_stats, bool collect_hcls_stats)
         : collect_cls_stats(collect_cls_stats), collect_hcls_stats(collect_hcls_stats), num_hcls_by_attrs_exceed(0) {
         memset(num_hcls_by_attrs, 0, sizeof(num_hcls_by_attrs));
     }
 };
 
+static int64_t residentBytes(void* start, size_t size) {
+    assert((uintptr_t)start % PAGE_SIZE == 0);
+    size_t npages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    std::vector<unsigned char> pages(npages);
+
+    int r = mincore(start, size, &pages[0]);
+    RELEASE_ASSERT(r == 0, "mincore failed");
+
+    int64_t nresident = 0;
+    for (unsigned char c : pages) {
+        if (c & 1)
+            nresident++;
+    }
+    return nresident * PAGE_SIZE;
+}
+
 void addStatistic(HeapStatistics* stats, GCAllocation* al, int nbytes) {
     stats->total.nallocs++;
     stats->total.nbytes += nbytes;
@@ -278,6 +332,9 @@ void Heap::dumpHeapStatistics(int level) {
 
     HeapStatistics stats(collect_cls_stats, collect_hcls_stats);
 
+    // Don't count the garbage that is still waiting to be swept:
+    small_arena.finishSweeping();
+
     small_arena.getStatistics(&stats);
     large_arena.getStatistics(&stats);
     huge_arena.getStatistics(&stats);
@@ -297,6 +354,18 @@ void Heap::dumpHeapStatistics(int level) {
 
     stats.total.print("Total");
 
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        const SizeClassStats& sc = stats.size_classes[i];
+        if (sc.nallocs == 0 && sc.nblocks == 0)
+            continue;
+        fprintf(stderr, "size class %ld: %ld allocations, %ld live objects in %ld blocks (%ld slots), %.1f%% fragmentation\n",
+                sc.size, sc.nallocs, sc.nlive, sc.nblocks, sc.nslots, sc.fragmentation() * 100);
+    }
+
+    stats.small_memory.print("small arena");
+    stats.large_memory.print("large arena");
+    stats.huge_memory.print("huge arena");
+
     if (collect_hcls_stats) {
         fprintf(stderr, "%ld hidden classes currently alive\n", stats.hcls.nallocs);
         fprintf(stderr, "%ld have at least one Box that uses them\n", stats.hcls_uses.size());
@@ -314,6 +383,129 @@ void dumpHeapStatistics(int level) {
     global_heap.dumpHeapStatistics(level);
 }
 
+double SizeClassStats::fragmentation() const {
+    if (nblocks == 0)
+        return 0;
+    return 1.0 - (double)(nlive * size) / (nblocks * SmallArena::BLOCK_SIZE);
+}
+
+void Heap::getSizeClassStatistics(std::vector<SizeClassStats>& stats) {
+    threading::GLPromoteRegion _lock;
+
+    small_arena.finishSweeping();
+
+    HeapStatistics heap_stats(false, false);
+    small_arena.getStatistics(&heap_stats);
+    stats.assign(heap_stats.size_classes, heap_stats.size_classes + NUM_BUCKETS);
+}
+
+void getSizeClassStatistics(std::vector<SizeClassStats>& stats) {
+    global_heap.getSizeClassStatistics(stats);
+}
+
+// Linux keeps a "soft-dirty" bit for every page, which gets set whenever the page is written to and
+// which can be reset for the whole process by writing "4" to /proc/self/clear_refs.  We use it as a
+// card table that the kernel maintains for us: this catches every store -- from JIT'd code, the
+// runtime, C extensions or syscalls -- without us having to emit write barriers anywhere.
+static int pagemap_fd = -1;
+static int clear_refs_fd = -1;
+
+static bool checkSoftDirtySupport() {
+    pagemap_fd = open("/proc/self/pagemap", O_RDONLY);
+    clear_refs_fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (pagemap_fd == -1 || clear_refs_fd == -1)
+        return false;
+
+    if (write(clear_refs_fd, "4", 1) != 1)
+        return false;
+
+    // Kernels without CONFIG_MEM_SOFT_DIRTY accept the write but never set the bit, so check
+    // that a write to a fresh page actually shows up.
+    void* page = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    RELEASE_ASSERT(page != MAP_FAILED, "failed to allocate memory from OS");
+    *(volatile char*)page = 1;
+
+    DirtyPageMap dirty(page, PAGE_SIZE);
+    bool supported = dirty.isDirty(page);
+
+    munmap(page, PAGE_SIZE);
+    return supported;
+}
+
+bool Heap::dirtyPageTrackingEnabled() {
+    static bool enabled = checkSoftDirtySupport();
+    return enabled;
+}
+
+void Heap::resetDirtyPages() {
+    assert(dirtyPageTrackingEnabled());
+    int r = pwrite(clear_refs_fd, "4", 1, 0);
+    RELEASE_ASSERT(r == 1, "failed to reset the soft-dirty bits");
+}
+
+DirtyPageMap::DirtyPageMap(void* start, size_t size) : start((uintptr_t)start) {
+    assert(pagemap_fd != -1);
+    assert(this->start % PAGE_SIZE == 0);
+
+    size_t npages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    entries.resize(npages);
+    if (!npages)
+        return;
+
+    size_t nbytes = npages * sizeof(uint64_t);
+    ssize_t r = pread(pagemap_fd, &entries[0], nbytes, this->start / PAGE_SIZE * sizeof(uint64_t));
+    RELEASE_ASSERT(r == nbytes, "failed to read /proc/self/pagemap");
+}
+
+void Heap::registerWeaklyReferenced(Box* b) {
+    // The large and huge arenas still sweep eagerly, and find their weakly-referenced objects then.
+    if (!small_arena.contains(b))
+        return;
+
+    LOCK_REGION(lock);
+    weakly_referenced_objects.insert(b);
+    setWeaklyReferenced(GCAllocation::fromUserData(b));
+}
+
+void Heap::forgetWeaklyReferenced(Box* b) {
+    LOCK_REGION(lock);
+    weakly_referenced_objects.erase(b);
+    clearWeaklyReferenced(GCAllocation::fromUserData(b));
+}
+
+void Heap::_findDeadWeaklyReferenced(std::vector<Box*>& weakly_referenced) {
+    for (auto it = weakly_referenced_objects.begin(); it != weakly_referenced_objects.end();) {
+        Box* b = *it;
+        if (isMarked(GCAllocation::fromUserData(b))) {
+            ++it;
+            continue;
+        }
+
+        // Dead objects whose weakrefs all went away in the meantime can just be swept normally.
+        PyWeakReference** list = (PyWeakReference**)PyObject_GET_WEAKREFS_LISTPTR(b);
+        if (*list)
+            weakly_referenced.push_back(b);
+        clearWeaklyReferenced(GCAllocation::fromUserData(b));
+        it = weakly_referenced_objects.erase(it);
+    }
+}
+
+void Heap::findOldObjectsToRescan(std::vector<ObjLookupCache>& rescan) {
+    assert(dirtyPageTrackingEnabled());
+
+    small_arena.findOldObjectsToRescan(rescan);
+    large_arena.findOldObjectsToRescan(rescan);
+    huge_arena.findOldObjectsToRescan(rescan);
+
+    // Objects in always_rescan might have been freed explicitly (and their memory reused for young
+    // objects) since the sweep that recorded them.  Their size doesn't matter, since they never
+    // get scanned conservatively.
+    for (GCAllocation* al : always_rescan) {
+        if (getAllocationFromInteriorPointer(al->user_data) == al && isMarked(al))
+            rescan.push_back(ObjLookupCache(al, 0));
+    }
+}
+
 //////
 /// Small Arena
 
@@ -342,9 +534,9 @@ GCAllocation* SmallArena::realloc(GCAllocation* al, size_t bytes) {
 void SmallArena::free(GCAllocation* alloc) {
     Block* b = Block::forPointer(alloc);
     size_t size = b->size;
-    int offset = (char*)alloc - (char*)b;
-    assert(offset % size == 0);
-    int atom_idx = offset / ATOM_SIZE;
+    int offset = (char*)alloc - (char*)&b->atoms[BLOCK_HEADER_ATOMS];
+    assert(offset >= 0 && offset % size == 0);
+    int atom_idx = b->atomIndex(offset / size);
 
     assert(!b->isfree.isSet(atom_idx));
     b->isfree.set(atom_idx);
@@ -357,13 +549,15 @@ void SmallArena::free(GCAllocation* alloc) {
 GCAllocation* SmallArena::allocationFrom(void* ptr) {
     Block* b = Block::forPointer(ptr);
     size_t size = b->size;
-    int offset = (char*)ptr - (char*)b;
-    int obj_idx = offset / size;
+    int offset = (char*)ptr - (char*)&b->atoms[BLOCK_HEADER_ATOMS];
+    if (offset < 0)
+        return NULL;
 
-    if (obj_idx < b->minObjIndex() || obj_idx >= b->numObjects())
+    int obj_idx = offset / size;
+    if (obj_idx >= b->numObjects())
         return NULL;
 
-    int atom_idx = obj_idx * b->atomsPerObj();
+    int atom_idx = b->atomIndex(obj_idx);
 
     if (b->isfree.isSet(atom_idx))
         return NULL;
@@ -371,8 +565,8 @@ GCAllocation* SmallArena::allocationFrom(void* ptr) {
     return reinterpret_cast<GCAllocation*>(&b->atoms[atom_idx]);
 }
 
-void SmallArena::freeUnmarked(std::vector<Box*>& weakly_referenced) {
-    thread_caches.forEachValue([this, &weakly_referenced](ThreadBlockCache* cache) {
+void SmallArena::freeUnmarked() {
+    thread_caches.forEachValue([this](ThreadBlockCache* cache) {
         for (int bidx = 0; bidx < NUM_BUCKETS; bidx++) {
             Block* h = cache->cache_free_heads[bidx];
             // Try to limit the amount of unused memory a thread can hold onto;
@@ -389,96 +583,223 @@ void SmallArena::freeUnmarked(std::vector<Box*>& weakly_referenced) {
             }
             if (h) {
                 removeFromLLAndNull(h);
-                insertIntoLL(&heads[bidx], h);
+                insertIntoLL(&unswept_heads[bidx], h);
             }
 
-            Block** chain_end = _freeChain(&cache->cache_free_heads[bidx], weakly_referenced);
-            _freeChain(&cache->cache_full_heads[bidx], weakly_referenced);
-
+            // The thread keeps its blocks, it just has to sweep them before using them again:
+            assert(cache->cache_unswept_heads[bidx] == NULL);
+            while (Block* b = cache->cache_free_heads[bidx]) {
+                removeFromLLAndNull(b);
+                insertIntoLL(&cache->cache_unswept_heads[bidx], b);
+            }
             while (Block* b = cache->cache_full_heads[bidx]) {
                 removeFromLLAndNull(b);
-                insertIntoLL(chain_end, b);
+                insertIntoLL(&cache->cache_unswept_heads[bidx], b);
             }
         }
     });
 
     for (int bidx = 0; bidx < NUM_BUCKETS; bidx++) {
-        Block** chain_end = _freeChain(&heads[bidx], weakly_referenced);
-        _freeChain(&full_heads[bidx], weakly_referenced);
-
+        while (Block* b = heads[bidx]) {
+            removeFromLLAndNull(b);
+            insertIntoLL(&unswept_heads[bidx], b);
+        }
         while (Block* b = full_heads[bidx]) {
             removeFromLLAndNull(b);
-            insertIntoLL(chain_end, b);
+            insertIntoLL(&unswept_heads[bidx], b);
+        }
+    }
+}
+
+void SmallArena::finishSweeping() {
+    thread_caches.forEachValue([this](ThreadBlockCache* cache) {
+        for (int bidx = 0; bidx < NUM_BUCKETS; bidx++) {
+            _finishSweepingChain(&cache->cache_unswept_heads[bidx], &cache->cache_free_heads[bidx]);
+        }
+    });
+
+    for (int bidx = 0; bidx < NUM_BUCKETS; bidx++) {
+        _finishSweepingChain(&unswept_heads[bidx], &heads[bidx]);
+    }
+}
+
+void SmallArena::_finishSweepingChain(Block** unswept_head, Block** free_head) {
+    while (Block* b = *unswept_head) {
+        removeFromLLAndNull(b);
+
+        // Blocks that turn out to be full go on the free list too; the allocator will move them
+        // over to the full list once it gets to them.
+        if (_sweepBlock(b, false))
+            insertIntoLL(free_head, b);
+        else
+            insertIntoLL(&empty_blocks, b);
+    }
+}
+
+template <typename Func> void SmallArena::_forEachBlock(Func func) {
+    thread_caches.forEachValue([&func](ThreadBlockCache* cache) {
+        for (int bidx = 0; bidx < NUM_BUCKETS; bidx++) {
+            forEach(cache->cache_free_heads[bidx], func);
+            forEach(cache->cache_full_heads[bidx], func);
         }
+    });
+
+    for (int bidx = 0; bidx < NUM_BUCKETS; bidx++) {
+        forEach(heads[bidx], func);
+        forEach(full_heads[bidx], func);
     }
 }
 
+void SmallArena::clearMarks() {
+    _forEachBlock([](Block* b) {
+        int atoms_per_obj = b->atomsPerObj();
+        int end_atom = b->atomIndex(b->numObjects());
+
+        for (int atom_idx = b->atomIndex(0); atom_idx < end_atom; atom_idx += atoms_per_obj) {
+            if (b->isfree.isSet(atom_idx))
+                continue;
+
+            GCAllocation* al = reinterpret_cast<GCAllocation*>(&b->atoms[atom_idx]);
+            if (isMarked(al))
+                clearMark(al);
+        }
+    });
+}
+
+void SmallArena::findOldObjectsToRescan(std::vector<ObjLookupCache>& rescan) {
+    DirtyPageMap dirty((void*)SMALL_ARENA_START, allocatedBytes());
+
+    _forEachBlock([&dirty, &rescan](Block* b) {
+        int size = b->size;
+        int next_obj = 0;
+        // Objects start right after the block header, so work with offsets relative to that:
+        const int objects_start = BLOCK_HEADER_ATOMS * ATOM_SIZE;
+
+        for (int page = 0; page < BLOCK_SIZE / PAGE_SIZE; page++) {
+            if (!dirty.isDirty(&b->atoms[page * (PAGE_SIZE / ATOM_SIZE)]))
+                continue;
+
+            // Objects can straddle page boundaries, so look at every object that overlaps the page
+            // (skipping the ones that we already added for the previous page).
+            int first_obj = std::max(next_obj, std::max(0, page * PAGE_SIZE - objects_start) / size);
+            int last_obj = std::min(b->numObjects() - 1, ((page + 1) * PAGE_SIZE - 1 - objects_start) / size);
+
+            for (int obj_idx = first_obj; obj_idx <= last_obj; obj_idx++) {
+                int atom_idx = b->atomIndex(obj_idx);
+                if (b->isfree.isSet(atom_idx))
+                    continue;
+
+                GCAllocation* al = reinterpret_cast<GCAllocation*>(&b->atoms[atom_idx]);
+                if (isMarked(al))
+                    rescan.push_back(ObjLookupCache(al, size));
+            }
+
+            next_obj = last_obj + 1;
+        }
+    });
+}
+
 // TODO: copy-pasted from freeUnmarked()
 void SmallArena::getStatistics(HeapStatistics* stats) {
     thread_caches.forEachValue([this, stats](ThreadBlockCache* cache) {
         for (int bidx = 0; bidx < NUM_BUCKETS; bidx++) {
-            Block* h = cache->cache_free_heads[bidx];
-
-            _getChainStatistics(stats, &cache->cache_free_heads[bidx]);
-            _getChainStatistics(stats, &cache->cache_full_heads[bidx]);
+            _getChainStatistics(stats, &cache->cache_free_heads[bidx], bidx);
+            _getChainStatistics(stats, &cache->cache_full_heads[bidx], bidx);
         }
     });
 
     for (int bidx = 0; bidx < NUM_BUCKETS; bidx++) {
-        _getChainStatistics(stats, &heads[bidx]);
-        _getChainStatistics(stats, &full_heads[bidx]);
+        _getChainStatistics(stats, &heads[bidx], bidx);
+        _getChainStatistics(stats, &full_heads[bidx], bidx);
+
+        stats->size_classes[bidx].size = sizes[bidx];
+        stats->size_classes[bidx].nallocs = allocs_by_bucket[bidx];
     }
+
+    stats->small_memory.mapped = mappedBytes();
+    stats->small_memory.committed = mappedBytes() - decommittedBytes();
+    stats->small_memory.resident = residentBytes((void*)SMALL_ARENA_START, mappedBytes());
 }
 
 
-SmallArena::Block** SmallArena::_freeChain(Block** head, std::vector<Box*>& weakly_referenced) {
-    while (Block* b = *head) {
-        int num_objects = b->numObjects();
-        int first_obj = b->minObjIndex();
-        int atoms_per_obj = b->atomsPerObj();
+// Frees the objects in the block that the last collection didn't mark, and returns whether there
+// are any live objects left.  Lazy sweeps happen while the program is running, so they have to
+// take the heap lock before touching shared state.
+bool SmallArena::_sweepBlock(Block* b, bool lazy) {
+    int atoms_per_obj = b->atomsPerObj();
+    int end_atom = b->atomIndex(b->numObjects());
+    bool any_live = false;
 
-        for (int atom_idx = first_obj * atoms_per_obj; atom_idx < num_objects * atoms_per_obj;
-             atom_idx += atoms_per_obj) {
+    for (int atom_idx = b->atomIndex(0); atom_idx < end_atom; atom_idx += atoms_per_obj) {
 
-            // Note(kmod): it seems like there's some optimizations that could happen in this
-            // function -- isSet() and set() do roughly the same computation, and set() will
-            // load the value again before or'ing it and storing it back.
-            // I tried looking into a bunch of that and it didn't seem to make that much
-            // of a difference; my guess is that this function is memory-bound so a few
-            // extra shifts doesn't hurt.
-            if (b->isfree.isSet(atom_idx))
-                continue;
+        // Note(kmod): it seems like there's some optimizations that could happen in this
+        // function -- isSet() and set() do roughly the same computation, and set() will
+        // load the value again before or'ing it and storing it back.
+        // I tried looking into a bunch of that and it didn't seem to make that much
+        // of a difference; my guess is that this function is memory-bound so a few
+        // extra shifts doesn't hurt.
+        if (b->isfree.isSet(atom_idx))
+            continue;
 
-            void* p = &b->atoms[atom_idx];
-            GCAllocation* al = reinterpret_cast<GCAllocation*>(p);
+        void* p = &b->atoms[atom_idx];
+        GCAllocation* al = reinterpret_cast<GCAllocation*>(p);
 
-            if (isMarked(al)) {
-                clearMark(al);
-            } else {
-                if (_doFree(al, &weakly_referenced)) {
-                    GC_TRACE_LOG("freeing %p\n", al->user_data);
-                    b->isfree.set(atom_idx);
-#ifndef NDEBUG
-                    memset(al->user_data, 0xbb, b->size - sizeof(GCAllocation));
-#endif
+        if (isMarked(al)) {
+            if (mustAlwaysRescan(al)) {
+                if (lazy) {
+                    LOCK_REGION(heap->lock);
+                    heap->always_rescan.push_back(al);
+                } else {
+                    heap->always_rescan.push_back(al);
                 }
             }
+            any_live = true;
+        } else {
+            // The collector already took care of the dead objects that had weakrefs pointing at
+            // them, and took them out of the registry (see Heap::_findDeadWeaklyReferenced), so
+            // everything left here can be freed.  This relies on every weakref going through
+            // PyGC_RegisterWeaklyReferenced:
+            assert(!isWeaklyReferenced(al));
+            assert(!hasWeakrefs(al) && "weakly referenced object missing from the weakref registry");
+            _doFree(al, NULL);
+
+            GC_TRACE_LOG("freeing %p\n", al->user_data);
+            b->isfree.set(atom_idx);
+#ifndef NDEBUG
+            memset(al->user_data, 0xbb, b->size - sizeof(GCAllocation));
+#endif
         }
+    }
 
-        head = &b->next;
+    return any_live;
+}
+
+void SmallArena::_decommitEmptyBlocks() {
+    while (Block* b = empty_blocks) {
+        removeFromLLAndNull(b);
+
+        // Keep the header page: conservative scanning can still find stale pointers into this
+        // block, and allocationFrom() needs to see a (completely free) header to reject them.
+        decommitPages(&b->atoms[PAGE_SIZE / ATOM_SIZE], BLOCK_SIZE - PAGE_SIZE);
+
+        insertIntoLL(&decommitted_blocks, b);
     }
-    return head;
 }
 
 
 SmallArena::Block* SmallArena::_allocBlock(uint64_t size, Block** prev) {
     Block* rtn = (Block*)allocFromArena(sizeof(Block));
     assert(rtn);
+    _initBlock(rtn, size);
+    rtn->prev = prev;
+    return rtn;
+}
+
+void SmallArena::_initBlock(Block* rtn, uint64_t size) {
     rtn->size = size;
-    rtn->num_obj = BLOCK_SIZE / size;
-    rtn->min_obj_index = (BLOCK_HEADER_SIZE + size - 1) / size;
+    rtn->num_obj = (BLOCK_SIZE - BLOCK_HEADER_ATOMS * ATOM_SIZE) / size;
     rtn->atoms_per_obj = size / ATOM_SIZE;
-    rtn->prev = prev;
+    rtn->prev = NULL;
     rtn->next = NULL;
 
 #ifndef NVALGRIND
@@ -493,18 +814,16 @@ SmallArena::Block* SmallArena::_allocBlock(uint64_t size, Block** prev) {
     rtn->next_to_check.reset();
 
     int num_objects = rtn->numObjects();
-    int num_lost = rtn->minObjIndex();
     int atoms_per_object = rtn->atomsPerObj();
-    for (int i = num_lost * atoms_per_object; i < num_objects * atoms_per_object; i += atoms_per_object) {
+    for (int i = rtn->atomIndex(0); i < rtn->atomIndex(num_objects); i += atoms_per_object) {
         rtn->isfree.set(i);
         // printf("%d %d\n", idx, bit);
     }
 
-    // printf("%d %d %d\n", num_objects, num_lost, atoms_per_object);
+    // printf("%d %d\n", num_objects, atoms_per_object);
     // for (int i =0; i < BITFIELD_ELTS; i++) {
     // printf("%d: %lx\n", i, rtn->isfree[i]);
     //}
-    return rtn;
 }
 
 SmallArena::ThreadBlockCache::~ThreadBlockCache() {
@@ -520,6 +839,11 @@ SmallArena::ThreadBlockCache::~ThreadBlockCache() {
             removeFromLLAndNull(b);
             insertIntoLL(&small->full_heads[i], b);
         }
+
+        while (Block* b = cache_unswept_heads[i]) {
+            removeFromLLAndNull(b);
+            insertIntoLL(&small->unswept_heads[i], b);
+        }
     }
 }
 
@@ -539,10 +863,27 @@ SmallArena::Block* SmallArena::_claimBlock(size_t rounded_size, Block** free_hea
         return free_block;
     }
 
+    // Reuse an empty block before growing the arena, preferring ones that are still resident.
+    // A decommitted block's pages get faulted back in by the allocations that follow.
+    if (Block* empty_block = empty_blocks) {
+        removeFromLLAndNull(empty_block);
+        _initBlock(empty_block, rounded_size);
+        return empty_block;
+    }
+
+    if (Block* empty_block = decommitted_blocks) {
+        removeFromLLAndNull(empty_block);
+        recommitPages(BLOCK_SIZE - PAGE_SIZE);
+        _initBlock(empty_block, rounded_size);
+        return empty_block;
+    }
+
     return _allocBlock(rounded_size, NULL);
 }
 
 GCAllocation* SmallArena::_alloc(size_t rounded_size, int bucket_idx) {
+    allocs_by_bucket[bucket_idx]++;
+
     Block** free_head = &heads[bucket_idx];
     Block** full_head = &full_heads[bucket_idx];
 
@@ -573,31 +914,53 @@ GCAllocation* SmallArena::_alloc(size_t rounded_size, int bucket_idx) {
         // static StatCounter sc_fallback("gc_allocs_cachemiss");
         // sc_fallback.log();
 
-        LOCK_REGION(heap->lock);
-
         assert(*cache_head == NULL);
 
-        // should probably be called allocBlock:
-        Block* myblock = _claimBlock(rounded_size, &heads[bucket_idx]);
+        // Blocks left over from the last collection get swept right before we start allocating
+        // from them again; prefer our own ones, then the global ones.
+        Block* myblock = cache->cache_unswept_heads[bucket_idx];
+        bool needs_sweep = (myblock != NULL);
+        if (myblock) {
+            removeFromLLAndNull(myblock);
+        } else {
+            LOCK_REGION(heap->lock);
+
+            myblock = unswept_heads[bucket_idx];
+            needs_sweep = (myblock != NULL);
+            if (myblock) {
+                removeFromLLAndNull(myblock);
+            } else {
+                // should probably be called allocBlock:
+                myblock = _claimBlock(rounded_size, &heads[bucket_idx]);
+            }
+        }
         assert(myblock);
         assert(!myblock->next);
         assert(!myblock->prev);
 
+        // This can run destructors, so it has to happen outside of the heap lock.  A block that
+        // ends up completely empty just stays in this size class.
+        if (needs_sweep)
+            _sweepBlock(myblock, true);
+
         // printf("%d claimed new block %p with %d objects\n", threading::gettid(), myblock, myblock->numObjects());
 
         insertIntoLL(cache_head, myblock);
     }
 }
 
-// TODO: copy-pasted from _freeChain
-void SmallArena::_getChainStatistics(HeapStatistics* stats, Block** head) {
+// TODO: copy-pasted from _sweepBlock
+void SmallArena::_getChainStatistics(HeapStatistics* stats, Block** head, int bucket_idx) {
+    SizeClassStats& size_class = stats->size_classes[bucket_idx];
+
     while (Block* b = *head) {
-        int num_objects = b->numObjects();
-        int first_obj = b->minObjIndex();
         int atoms_per_obj = b->atomsPerObj();
+        int end_atom = b->atomIndex(b->numObjects());
+
+        size_class.nblocks++;
+        size_class.nslots += b->numObjects();
 
-        for (int atom_idx = first_obj * atoms_per_obj; atom_idx < num_objects * atoms_per_obj;
-             atom_idx += atoms_per_obj) {
+        for (int atom_idx = b->atomIndex(0); atom_idx < end_atom; atom_idx += atoms_per_obj) {
 
             if (b->isfree.isSet(atom_idx))
                 continue;
@@ -606,6 +969,7 @@ void SmallArena::_getChainStatistics(HeapStatistics* stats, Block** head) {
             GCAllocation* al = reinterpret_cast<GCAllocation*>(p);
 
             addStatistic(stats, al, b->size);
+            size_class.nlive++;
         }
 
         head = &b->next;
@@ -697,11 +1061,33 @@ void LargeArena::cleanupAfterCollection() {
 }
 
 void LargeArena::freeUnmarked(std::vector<Box*>& weakly_referenced) {
-    sweepList(head, weakly_referenced, [this](LargeObj* ptr) { _freeLargeObj(ptr); });
+    sweepList(head, weakly_referenced, heap->always_rescan, [this](LargeObj* ptr) { _freeLargeObj(ptr); });
+
+    _releaseEmptyBlocks();
+}
+
+void LargeArena::clearMarks() {
+    forEach(head, [](LargeObj* obj) {
+        if (isMarked(obj->data))
+            clearMark(obj->data);
+    });
+}
+
+void LargeArena::findOldObjectsToRescan(std::vector<ObjLookupCache>& rescan) {
+    DirtyPageMap dirty((void*)LARGE_ARENA_START, allocatedBytes());
+
+    forEach(head, [&dirty, &rescan](LargeObj* obj) {
+        if (isMarked(obj->data) && dirty.anyDirty(obj->data, obj->size))
+            rescan.push_back(ObjLookupCache(obj->data, obj->size));
+    });
 }
 
 void LargeArena::getStatistics(HeapStatistics* stats) {
     forEach(head, [stats](LargeObj* obj) { addStatistic(stats, obj->data, obj->size); });
+
+    stats->large_memory.mapped = mappedBytes();
+    stats->large_memory.committed = mappedBytes() - decommittedBytes();
+    stats->large_memory.resident = residentBytes((void*)LARGE_ARENA_START, mappedBytes());
 }
 
 void LargeArena::add_free_chunk(LargeFreeChunk* free_chunks, size_t size) {
@@ -741,6 +1127,12 @@ LargeArena::LargeFreeChunk* LargeArena::get_from_size_list(LargeFreeChunk** list
 
     section = LARGE_BLOCK_FOR_OBJ(free_chunks);
 
+    section->idle = false;
+    if (section->decommitted) {
+        recommitPages(BLOCK_SIZE - 2 * CHUNK_SIZE);
+        section->decommitted = false;
+    }
+
     start_index = LARGE_CHUNK_INDEX(free_chunks, section);
     for (i = start_index; i < start_index + num_chunks; ++i) {
         assert(section->free_chunk_map[i]);
@@ -794,6 +1186,8 @@ retry:
     free_lists[0] = free_chunks;
 
     section->num_free_chunks = LARGE_BLOCK_NUM_CHUNKS;
+    section->idle = false;
+    section->decommitted = false;
 
     section->free_chunk_map = (unsigned char*)section + sizeof(LargeBlock);
     assert(sizeof(LargeBlock) + LARGE_BLOCK_NUM_CHUNKS + 1 <= CHUNK_SIZE);
@@ -827,7 +1221,7 @@ void LargeArena::_freeLargeObj(LargeObj* obj) {
     /*
      * We could free the LOS section here if it's empty, but we
      * can't unless we also remove its free chunks from the fast
-     * free lists.  Instead, we do it in los_sweep().
+     * free lists.  Instead, we do it in _releaseEmptyBlocks().
      */
 
     start_index = LARGE_CHUNK_INDEX(obj, section);
@@ -839,6 +1233,47 @@ void LargeArena::_freeLargeObj(LargeObj* obj) {
     add_free_chunk((LargeFreeChunk*)obj, size);
 }
 
+void LargeArena::_releaseEmptyBlocks() {
+    bool any_empty = false;
+    for (LargeBlock* section = blocks; section; section = section->next) {
+        if (section->num_free_chunks == LARGE_BLOCK_NUM_CHUNKS) {
+            any_empty = true;
+            break;
+        }
+    }
+
+    if (!any_empty)
+        return;
+
+    // Take the (possibly fragmented) free chunks of the empty blocks off the free lists;
+    // each empty block gets added back below as a single chunk covering all of it.
+    for (int i = 0; i < NUM_FREE_LISTS; i++) {
+        LargeFreeChunk** list = &free_lists[i];
+        while (LargeFreeChunk* free_chunks = *list) {
+            if (LARGE_BLOCK_FOR_OBJ(free_chunks)->num_free_chunks == LARGE_BLOCK_NUM_CHUNKS)
+                *list = free_chunks->next_size;
+            else
+                list = &free_chunks->next_size;
+        }
+    }
+
+    for (LargeBlock* section = blocks; section; section = section->next) {
+        if (section->num_free_chunks != LARGE_BLOCK_NUM_CHUNKS)
+            continue;
+
+        // The block was already free at the previous sweep and nothing has been allocated
+        // from it since.  Keep the header chunk and the first page of the free chunk (which
+        // holds the free list entry), and give the rest back to the OS.
+        if (section->idle && !section->decommitted) {
+            decommitPages((char*)section + 2 * CHUNK_SIZE, BLOCK_SIZE - 2 * CHUNK_SIZE);
+            section->decommitted = true;
+        }
+        section->idle = true;
+
+        add_free_chunk((LargeFreeChunk*)((char*)section + CHUNK_SIZE), BLOCK_SIZE - CHUNK_SIZE);
+    }
+}
+
 //////
 /// Huge Arena
 
@@ -908,11 +1343,37 @@ void HugeArena::cleanupAfterCollection() {
 }
 
 void HugeArena::freeUnmarked(std::vector<Box*>& weakly_referenced) {
-    sweepList(head, weakly_referenced, [this](HugeObj* ptr) { _freeHugeObj(ptr); });
+    sweepList(head, weakly_referenced, heap->always_rescan, [this](HugeObj* ptr) { _freeHugeObj(ptr); });
+}
+
+void HugeArena::clearMarks() {
+    forEach(head, [](HugeObj* obj) {
+        if (isMarked(obj->data))
+            clearMark(obj->data);
+    });
+}
+
+void HugeArena::findOldObjectsToRescan(std::vector<ObjLookupCache>& rescan) {
+    // The huge arena has holes where objects got unmapped, so look at each object separately.
+    forEach(head, [&rescan](HugeObj* obj) {
+        if (!isMarked(obj->data))
+            return;
+
+        DirtyPageMap dirty(obj, obj->mmap_size());
+        if (dirty.anyDirty(obj->data, obj->size))
+            rescan.push_back(ObjLookupCache(obj->data, obj->size));
+    });
 }
 
 void HugeArena::getStatistics(HeapStatistics* stats) {
-    forEach(head, [stats](HugeObj* obj) { addStatistic(stats, obj->data, obj->capacity()); });
+    // Huge objects are unmapped as soon as they die, so only the live ones hold any memory.
+    forEach(head, [stats](HugeObj* obj) {
+        addStatistic(stats, obj->data, obj->capacity());
+
+        stats->huge_memory.mapped += obj->mmap_size();
+        stats->huge_memory.committed += obj->mmap_size();
+        stats->huge_memory.resident += residentBytes(obj, obj->mmap_size());
+    });
 }
 
 void HugeArena::_freeHugeObj(HugeObj* lobj) {
@@ -19,6 +19,8 @@
 #include <cstdint>
 #include <list>
 #include <sys/mman.h>
+#include <unordered_set>
+#include <vector>
 
 #include "core/common.h"
 #include "core/threading.h"
@@ -75,7 +77,10 @@ class conservative_unordered_map
 
 namespace gc {
 
-extern unsigned bytesAllocatedSinceCollection;
+extern size_t bytesAllocatedSinceCollection;
+// How many bytes get allocated before the next collection; the collector recomputes this from the
+// size of the live heap after every collection.  ALLOCBYTES_PER_COLLECTION is the default minimum.
+extern size_t bytesAllocatedTrigger;
 #define ALLOCBYTES_PER_COLLECTION 10000000
 void _bytesAllocatedTripped();
 
@@ -86,7 +91,7 @@ void _bytesAllocatedTripped();
 // such as memory that will get freed by a gc destructor.
 inline void registerGCManagedBytes(size_t bytes) {
     bytesAllocatedSinceCollection += bytes;
-    if (unlikely(bytesAllocatedSinceCollection >= ALLOCBYTES_PER_COLLECTION)) {
+    if (unlikely(bytesAllocatedSinceCollection >= bytesAllocatedTrigger)) {
         _bytesAllocatedTripped();
     }
 }
@@ -95,6 +100,20 @@ inline void registerGCManagedBytes(size_t bytes) {
 class Heap;
 struct HeapStatistics;
 
+// Numbers for one of the small arena's size classes, to help with tuning the size classes.
+struct SizeClassStats {
+    size_t size;
+    int64_t nallocs; // allocations since startup
+    int64_t nblocks; // blocks currently holding objects of this size
+    int64_t nlive;   // objects currently allocated in those blocks
+    int64_t nslots;  // objects that those blocks have room for
+
+    SizeClassStats() : size(0), nallocs(0), nblocks(0), nlive(0), nslots(0) {}
+
+    // The fraction of those blocks' memory that isn't taken up by live objects.
+    double fragmentation() const;
+};
+
 typedef uint8_t kindid_t;
 struct GCAllocation {
     unsigned int gc_flags : 8;
@@ -128,18 +147,94 @@ inline void clearMark(GCAllocation* header) {
     header->gc_flags &= ~MARK_BIT;
 }
 
+// Sets the mark bit and returns whether it was already set.  This is safe to call from several
+// marker threads at once; it relies on gc_flags being the first byte of the header, and on nothing
+// else in that byte changing during a collection.
+inline bool testAndSetMark(GCAllocation* header) {
+    uint8_t* flags = reinterpret_cast<uint8_t*>(header);
+    if (__atomic_load_n(flags, __ATOMIC_RELAXED) & MARK_BIT)
+        return true;
+    return (__atomic_fetch_or(flags, MARK_BIT, __ATOMIC_RELAXED) & MARK_BIT) != 0;
+}
+
 #undef MARK_BIT
 
+#define WEAKLY_REFERENCED_BIT 0x2
+
+// Whether the object is in Heap::weakly_referenced_objects.  This lets the free paths skip the heap lock
+// for the (vast majority of) objects that never had a weakref.  Only changes outside of collections.
+inline bool isWeaklyReferenced(GCAllocation* header) {
+    return (header->gc_flags & WEAKLY_REFERENCED_BIT) != 0;
+}
+
+inline void setWeaklyReferenced(GCAllocation* header) {
+    header->gc_flags |= WEAKLY_REFERENCED_BIT;
+}
+
+inline void clearWeaklyReferenced(GCAllocation* header) {
+    header->gc_flags &= ~WEAKLY_REFERENCED_BIT;
+}
+
+#undef WEAKLY_REFERENCED_BIT
+
+// The collector is generational using "sticky" mark bits: objects that survive a collection stay
+// marked, and are considered old from then on.  Minor collections only trace the young (unmarked)
+// objects, treating the old objects that could have been modified since the last collection as
+// roots.  Full collections start by clearing all the mark bits.
+//
+// Whether the sweep should remember this old object as one that every minor collection has to
+// rescan, because its gc handler looks at memory that the dirty page tracking can't see.
+bool mustAlwaysRescan(GCAllocation* al);
+
 #define PAGE_SIZE 4096
 
+// A snapshot of which pages of part of the heap have been written to since the last collection,
+// taken from the kernel's soft-dirty page bits.  See Heap::dirtyPageTrackingEnabled().
+class DirtyPageMap {
+private:
+    uintptr_t start;
+    std::vector<uint64_t> entries;
+
+public:
+    DirtyPageMap(void* start, size_t size);
+
+    bool isDirty(void* p) const {
+        size_t idx = ((uintptr_t)p - start) / PAGE_SIZE;
+        assert(idx < entries.size());
+        return (entries[idx] >> 55) & 1;
+    }
+
+    bool anyDirty(void* p, size_t size) const {
+        uintptr_t first = (uintptr_t)p & ~(PAGE_SIZE - 1);
+        for (uintptr_t page = first; page < (uintptr_t)p + size; page += PAGE_SIZE) {
+            if (isDirty((void*)page))
+                return true;
+        }
+        return false;
+    }
+};
+
+struct ObjLookupCache {
+    void* data;
+    size_t size;
+
+    ObjLookupCache(void* data, size_t size) : data(data), size(size) {}
+};
+
 template <uintptr_t arena_start, uintptr_t arena_size, uintptr_t initial_mapsize, uintptr_t increment> class Arena {
 private:
     void* cur;
     void* frontier;
     void* arena_end;
 
+    size_t decommitted_bytes;
+
 protected:
-    Arena() : cur((void*)arena_start), frontier((void*)arena_start), arena_end((void*)(arena_start + arena_size)) {
+    Arena()
+        : cur((void*)arena_start),
+          frontier((void*)arena_start),
+          arena_end((void*)(arena_start + arena_size)),
+          decommitted_bytes(0) {
         if (initial_mapsize)
             extendMapping(initial_mapsize);
     }
@@ -169,8 +264,31 @@ protected:
         return rtn;
     }
 
+    // Gives the physical pages backing [start, start + size) back to the OS, while keeping the
+    // address range mapped.  Anonymous private pages read back as zeroes the next time they are
+    // touched, so there is nothing to do to recommit them other than using them again; callers
+    // report that with recommitPages() so that the accounting stays correct.
+    void decommitPages(void* start, size_t size) {
+        assert((uintptr_t)start % PAGE_SIZE == 0);
+        assert(size % PAGE_SIZE == 0);
+        assert(contains(start));
+
+        int r = madvise(start, size, MADV_DONTNEED);
+        RELEASE_ASSERT(r == 0, "madvise failed");
+        decommitted_bytes += size;
+    }
+
+    void recommitPages(size_t size) {
+        assert(decommitted_bytes >= size);
+        decommitted_bytes -= size;
+    }
+
 public:
     bool contains(void* addr) { return (void*)arena_start <= addr && addr < cur; }
+
+    size_t mappedBytes() { return (uint8_t*)frontier - (uint8_t*)arena_start; }
+    size_t allocatedBytes() { return (uint8_t*)cur - (uint8_t*)arena_start; }
+    size_t decommittedBytes() { return decommitted_bytes; }
 };
 
 constexpr uintptr_t ARENA_SIZE = 0x1000000000L;
@@ -185,16 +303,19 @@ constexpr uintptr_t HUGE_ARENA_START = 0x3270000000L;
 // it uses segregated-fit allocation, and each block contains a free
 // bitmap for objects of a given size (constant for the block)
 //
-static const size_t sizes[] = {
-    16,  32,  48,  64,  80,  96,  112, 128, 160, 192,
-    224, 256, 320, 384, 448, 512, 640, 768, 896, 1024 //, 1280, 1536, 1792, 2048, 2560, 3072, 3584, // 4096,
+// Objects are packed in right after the block header, so a block of the largest size class still
+// holds four objects.  (4096 wouldn't fit in atoms_per_obj, and would only get three per block.)
+static constexpr size_t sizes[] = {
+    16,  32,  48,  64,  80,  96,  112, 128,  160,  192,  224,  256,  320, 384,
+    448, 512, 640, 768, 896, 1024, 1280, 1536, 1792, 2048, 2560, 3072, 3584,
 };
 static constexpr size_t NUM_BUCKETS = sizeof(sizes) / sizeof(sizes[0]);
 
 
 class SmallArena : public Arena<SMALL_ARENA_START, ARENA_SIZE, 64 * 1024 * 1024, 16 * 1024 * 1024> {
 public:
-    SmallArena(Heap* heap) : Arena(), heap(heap), thread_caches(heap, this) {
+    SmallArena(Heap* heap)
+        : Arena(), empty_blocks(NULL), decommitted_blocks(NULL), heap(heap), thread_caches(heap, this) {
 #ifndef NDEBUG
         // Various things will crash if we instantiate multiple Heaps/Arenas
         static bool already_created = false;
@@ -223,11 +344,22 @@ public:
     void free(GCAllocation* al);
 
     GCAllocation* allocationFrom(void* ptr);
-    void freeUnmarked(std::vector<Box*>& weakly_referenced);
+    // Doesn't sweep anything by itself: it just queues up every block to be swept lazily.
+    void freeUnmarked();
+    // Sweeps all of the blocks that haven't been swept since the last collection.
+    void finishSweeping();
+
+    void clearMarks();
+    void findOldObjectsToRescan(std::vector<ObjLookupCache>& rescan);
 
     void getStatistics(HeapStatistics* stats);
 
-    void prepareForCollection() {}
+    void prepareForCollection() {
+        _decommitEmptyBlocks();
+        // Marking relies on every unmarked object having been freed, otherwise a conservative
+        // pointer to a dead object could bring it back to life.
+        finishSweeping();
+    }
     void cleanupAfterCollection() {}
 
 private:
@@ -286,9 +418,11 @@ private:
         }
     };
 
-
+public:
     static constexpr size_t BLOCK_SIZE = 4 * 4096;
 
+private:
+
 #define ATOM_SIZE 16
     static_assert(BLOCK_SIZE % ATOM_SIZE == 0, "");
 #define ATOMS_PER_BLOCK (BLOCK_SIZE / ATOM_SIZE)
@@ -310,7 +444,6 @@ public:
                 Block* next, **prev;
                 uint32_t size;
                 uint16_t num_obj;
-                uint8_t min_obj_index;
                 uint8_t atoms_per_obj;
                 Bitmap<ATOMS_PER_BLOCK> isfree;
                 Bitmap<ATOMS_PER_BLOCK>::Scanner next_to_check;
@@ -319,17 +452,22 @@ public:
             Atoms atoms[ATOMS_PER_BLOCK];
         };
 
-        inline int minObjIndex() const { return min_obj_index; }
-
         inline int numObjects() const { return num_obj; }
 
         inline int atomsPerObj() const { return atoms_per_obj; }
 
+        // Objects start at the first atom after the header (instead of at the first multiple of the
+        // object size that clears it, which would waste most of an object in the larger classes).
+        inline int atomIndex(int obj_idx) const { return BLOCK_HEADER_ATOMS + obj_idx * atoms_per_obj; }
+
         static Block* forPointer(void* ptr) { return (Block*)((uintptr_t)ptr & ~(BLOCK_SIZE - 1)); }
     };
     static_assert(sizeof(Block) == BLOCK_SIZE, "bad size");
     static_assert(offsetof(Block, _header_end) >= BLOCK_HEADER_SIZE, "bad header size");
     static_assert(offsetof(Block, _header_end) <= BLOCK_HEADER_SIZE, "bad header size");
+    // Decommitting an empty block keeps its first page, so the header has to fit in it:
+    static_assert(BLOCK_HEADER_SIZE <= PAGE_SIZE, "bad header size");
+    static_assert(sizes[NUM_BUCKETS - 1] / ATOM_SIZE <= UINT8_MAX, "size class too big for atoms_per_obj");
 
 private:
     struct ThreadBlockCache {
@@ -337,10 +475,12 @@ private:
         SmallArena* small;
         Block* cache_free_heads[NUM_BUCKETS];
         Block* cache_full_heads[NUM_BUCKETS];
+        Block* cache_unswept_heads[NUM_BUCKETS];
 
         ThreadBlockCache(Heap* heap, SmallArena* small) : heap(heap), small(small) {
             memset(cache_free_heads, 0, sizeof(cache_free_heads));
             memset(cache_full_heads, 0, sizeof(cache_full_heads));
+            memset(cache_unswept_heads, 0, sizeof(cache_unswept_heads));
         }
         ~ThreadBlockCache();
     };
@@ -348,6 +488,17 @@ private:
 
     Block* heads[NUM_BUCKETS];
     Block* full_heads[NUM_BUCKETS];
+    // Blocks that still contain the garbage found by the last collection.  Freeing it is deferred
+    // until some thread wants to allocate from the block (or until the next collection starts), so
+    // that the cost of sweeping is spread out instead of adding to the collection pause.
+    Block* unswept_heads[NUM_BUCKETS];
+
+    // Blocks that had no live objects left after a sweep.  They are not tied to a size class any
+    // more, and get reformatted by whichever bucket claims them next.  Blocks that are still on
+    // empty_blocks at the start of the next collection get their object pages decommitted and move
+    // to decommitted_blocks.
+    Block* empty_blocks;
+    Block* decommitted_blocks;
 
     friend struct ThreadBlockCache;
 
@@ -355,23 +506,22 @@ private:
     // TODO only use thread caches if we're in GRWL mode?
     threading::PerThreadSet<ThreadBlockCache, Heap*, SmallArena*> thread_caches;
 
+    template <typename Func> void _forEachBlock(Func func);
     Block* _allocBlock(uint64_t size, Block** prev);
+    void _initBlock(Block* b, uint64_t size);
+    void _decommitEmptyBlocks();
     GCAllocation* _allocFromBlock(Block* b);
     Block* _claimBlock(size_t rounded_size, Block** free_head);
-    Block** _freeChain(Block** head, std::vector<Box*>& weakly_referenced);
-    void _getChainStatistics(HeapStatistics* stats, Block** head);
+    bool _sweepBlock(Block* b, bool lazy);
+    void _finishSweepingChain(Block** unswept_head, Block** free_head);
+    void _getChainStatistics(HeapStatistics* stats, Block** head, int bucket_idx);
 
-    GCAllocation* __attribute__((__malloc__)) _alloc(size_t bytes, int bucket_idx);
-};
-
-struct ObjLookupCache {
-    void* data;
-    size_t size;
+    // Not synchronized, since it's only used for statistics.
+    int64_t allocs_by_bucket[NUM_BUCKETS];
 
-    ObjLookupCache(void* data, size_t size) : data(data), size(size) {}
+    GCAllocation* __attribute__((__malloc__)) _alloc(size_t bytes, int bucket_idx);
 };
 
-
 //
 // The LargeArena allocates objects where 3584 < size <1024*1024-CHUNK_SIZE-sizeof(LargeObject) bytes.
 //
@@ -380,6 +530,8 @@ struct ObjLookupCache {
 // size has no entries, we search the large free list.
 //
 // Blocks of 1meg are mmap'ed individually, and carved up as needed.
+// Blocks that end up completely free are coalesced back into a single
+// free chunk during the sweep, and decommitted if they stay unused.
 //
 class LargeArena : public Arena<LARGE_ARENA_START, ARENA_SIZE, 32 * 1024 * 1024, 16 * 1024 * 1024> {
 private:
@@ -387,6 +539,10 @@ private:
         LargeBlock* next;
         size_t num_free_chunks;
         unsigned char* free_chunk_map;
+        // Set by a sweep that finds the block completely free, and cleared by any allocation
+        // from it.  A block that is still idle at the following sweep gets decommitted.
+        bool idle;
+        bool decommitted;
     };
 
     struct LargeFreeChunk {
@@ -428,6 +584,7 @@ private:
     LargeFreeChunk* get_from_size_list(LargeFreeChunk** list, size_t size);
     LargeObj* _alloc(size_t size);
     void _freeLargeObj(LargeObj* obj);
+    void _releaseEmptyBlocks();
 
 public:
     LargeArena(Heap* heap) : heap(heap), head(NULL), blocks(NULL) {}
@@ -442,10 +599,15 @@ public:
     GCAllocation* allocationFrom(void* ptr);
     void freeUnmarked(std::vector<Box*>& weakly_referenced);
 
+    void clearMarks();
+    void findOldObjectsToRescan(std::vector<ObjLookupCache>& rescan);
+
     void getStatistics(HeapStatistics* stats);
 
     void prepareForCollection();
     void cleanupAfterCollection();
+
+    static size_t allocationSize(GCAllocation* alloc) { return LargeObj::fromAllocation(alloc)->size; }
 };
 
 // The HugeArena allocates objects where size > 1024*1024 bytes.
@@ -463,11 +625,16 @@ public:
     GCAllocation* allocationFrom(void* ptr);
     void freeUnmarked(std::vector<Box*>& weakly_referenced);
 
+    void clearMarks();
+    void findOldObjectsToRescan(std::vector<ObjLookupCache>& rescan);
+
     void getStatistics(HeapStatistics* stats);
 
     void prepareForCollection();
     void cleanupAfterCollection();
 
+    static size_t allocationSize(GCAllocation* alloc) { return HugeObj::fromAllocation(alloc)->size; }
+
 private:
     struct HugeObj {
         HugeObj* next, **prev;
@@ -511,6 +678,17 @@ private:
     // DS_DEFINE_MUTEX(lock);
     DS_DEFINE_SPINLOCK(lock);
 
+    // Old objects that minor collections rescan no matter whether their pages are dirty; rebuilt
+    // by every sweep.  See mustAlwaysRescan().
+    std::vector<GCAllocation*> always_rescan;
+
+    // Small-arena objects that have had a weakref pointed at them.  Dead weakly-referenced objects
+    // have to be found during the collection, but the small arena doesn't sweep until later, so the
+    // collector looks for them here instead.
+    std::unordered_set<Box*> weakly_referenced_objects;
+
+    void _findDeadWeaklyReferenced(std::vector<Box*>& weakly_referenced);
+
 public:
     Heap() : small_arena(this), large_arena(this), huge_arena(this) {}
 
@@ -559,9 +737,25 @@ public:
         }
 
         assert(small_arena.contains(alloc));
+        if (isWeaklyReferenced(alloc))
+            forgetWeaklyReferenced((Box*)alloc->user_data);
         small_arena.free(alloc);
     }
 
+    void registerWeaklyReferenced(Box* b);
+    void forgetWeaklyReferenced(Box* b);
+
+    // Only valid for the start of an allocation.
+    size_t allocationSize(GCAllocation* alloc) {
+        if (small_arena.contains(alloc))
+            return SmallArena::Block::forPointer(alloc)->size;
+        else if (large_arena.contains(alloc))
+            return LargeArena::allocationSize(alloc);
+        else if (huge_arena.contains(alloc))
+            return HugeArena::allocationSize(alloc);
+        return 0;
+    }
+
     // not thread safe:
     GCAllocation* getAllocationFromInteriorPointer(void* ptr) {
         if (large_arena.contains(ptr)) {
@@ -577,11 +771,31 @@ public:
 
     // not thread safe:
     void freeUnmarked(std::vector<Box*>& weakly_referenced) {
-        small_arena.freeUnmarked(weakly_referenced);
+        always_rescan.clear();
+        _findDeadWeaklyReferenced(weakly_referenced);
+        small_arena.freeUnmarked();
         large_arena.freeUnmarked(weakly_referenced);
         huge_arena.freeUnmarked(weakly_referenced);
     }
 
+    // not thread safe:
+    void clearMarks() {
+        small_arena.clearMarks();
+        large_arena.clearMarks();
+        huge_arena.clearMarks();
+    }
+
+    // not thread safe:
+    // Collects the old objects that may point to young ones: the ones on pages that were written
+    // to since the last collection, plus the ones in always_rescan.
+    void findOldObjectsToRescan(std::vector<ObjLookupCache>& rescan);
+
+    // Minor collections rely on the kernel tracking which pages got written to; if that isn't
+    // available, every collection has to be a full one.
+    bool dirtyPageTrackingEnabled();
+    // Start tracking writes from scratch; called at the end of each collection.
+    void resetDirtyPages();
+
     void prepareForCollection() {
         small_arena.prepareForCollection();
         large_arena.prepareForCollection();
@@ -595,10 +809,12 @@ public:
     }
 
     void dumpHeapStatistics(int level);
+    void getSizeClassStatistics(std::vector<SizeClassStats>& stats);
 };
 
 extern Heap global_heap;
 void dumpHeapStatistics(int level);
+void getSizeClassStatistics(std::vector<SizeClassStats>& stats);
 
 } // namespace gc
 } // namespace pyston
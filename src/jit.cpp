@@ -32,6 +32,7 @@
 #include "osdefs.h"
 
 #include "asm_writing/disassemble.h"
+#include "asm_writing/icinfo.h"
 #include "capi/types.h"
 #include "codegen/entry.h"
 #include "codegen/irgen/hooks.h"
@@ -202,6 +203,8 @@ int handleArg(char code) {
         PROFILE = true;
     } else if (code == 'j') {
         DUMPJIT = true;
+    } else if (code == 'J') {
+        PERF_MAP++;
     } else if (code == 's') {
         Stats::setEnabled(true);
     } else if (code == 'S') {
@@ -224,6 +227,12 @@ int handleArg(char code) {
         ENABLE_TRACEBACKS = false;
     } else if (code == 'G') {
         enableGdbSegfaultWatcher();
+    } else if (code == 'C') {
+        ENABLE_BACKGROUND_COMPILATION = true;
+    } else if (code == 'L') {
+        ENABLE_JIT_PROFILE_CACHE = true;
+    } else if (code == 'K') {
+        DUMP_IC_STATS = true;
     } else {
         fprintf(stderr, "Unknown option: -%c\n", code);
         return 2;
@@ -301,7 +310,7 @@ static int main(int argc, char** argv) {
 
         // Suppress getopt errors so we can throw them ourselves
         opterr = 0;
-        while ((code = getopt(argc, argv, "+:OqdIibpjtrsSvnxEac:FuPTGm:")) != -1) {
+        while ((code = getopt(argc, argv, "+:OqdIibpjJtrsSvnxEac:FuPTGCLKm:")) != -1) {
             if (code == 'c') {
                 assert(optarg);
                 command = optarg;
@@ -515,6 +524,9 @@ static int main(int argc, char** argv) {
         // Note: we will purposefully not release the GIL on exiting.
         threading::promoteGL();
 
+        if (DUMP_IC_STATS)
+            dumpICStats();
+
         _t.split("joinRuntime");
 
         joinRuntime();
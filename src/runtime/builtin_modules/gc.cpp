@@ -12,8 +12,12 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <climits>
+
 #include "core/types.h"
 #include "gc/collector.h"
+#include "gc/heap.h"
+#include "runtime/objmodel.h"
 #include "runtime/types.h"
 
 namespace pyston {
@@ -37,6 +41,78 @@ static Box* enable() {
     return None;
 }
 
+// Like the "i" format of PyArg_ParseTuple: any int or long, as long as it fits in a C int.
+static int intArg(Box* arg) {
+    if (!PyInt_Check(arg) && !PyLong_Check(arg))
+        raiseExcHelper(TypeError, "an integer is required");
+
+    long n = PyInt_AsLong(arg);
+    if (n == -1 && PyErr_Occurred())
+        throwCAPIException();
+    if (n > INT_MAX)
+        raiseExcHelper(OverflowError, "signed integer is greater than maximum");
+    if (n < INT_MIN)
+        raiseExcHelper(OverflowError, "signed integer is less than minimum");
+    return n;
+}
+
+// gc.set_threshold() takes CPython's thresholds, but our collector triggers on the number of bytes
+// allocated rather than the number of objects: threshold0 only turns automatic collections off (0) or on,
+// and full collections happen every threshold1 * threshold2 minor ones.  The trigger itself is set
+// with gc.set_growth_percent().
+static Box* setThreshold(Box* threshold0, Box* threshold1, Box* threshold2) {
+    int t0, t1, t2;
+    gc::getGCThresholds(&t0, &t1, &t2);
+
+    t0 = intArg(threshold0);
+    if (threshold1)
+        t1 = intArg(threshold1);
+    if (threshold2)
+        t2 = intArg(threshold2);
+
+    gc::setGCThresholds(t0, t1, t2);
+    return None;
+}
+
+static Box* getThreshold() {
+    int t0, t1, t2;
+    gc::getGCThresholds(&t0, &t1, &t2);
+    return BoxedTuple::create({ boxInt(t0), boxInt(t1), boxInt(t2) });
+}
+
+// Pyston addition: how much the heap may grow between collections, as a percentage of the heap that
+// was live after the last one (PYSTON_GC_PERCENT sets the starting value).
+static Box* setGrowthPercent(Box* percent) {
+    int p = intArg(percent);
+    if (p < 0)
+        raiseExcHelper(ValueError, "growth percent must not be negative");
+    gc::setGCGrowthPercent(p);
+    return None;
+}
+
+static Box* getGrowthPercent() {
+    return boxInt(gc::getGCGrowthPercent());
+}
+
+// Pyston addition: one dict per size class of the small object allocator.
+static Box* getSizeClassStats() {
+    std::vector<gc::SizeClassStats> stats;
+    gc::getSizeClassStatistics(stats);
+
+    BoxedList* rtn = new BoxedList();
+    for (const auto& sc : stats) {
+        BoxedDict* d = new BoxedDict();
+        d->d[boxString("size")] = boxInt(sc.size);
+        d->d[boxString("allocations")] = boxInt(sc.nallocs);
+        d->d[boxString("live_objects")] = boxInt(sc.nlive);
+        d->d[boxString("blocks")] = boxInt(sc.nblocks);
+        d->d[boxString("slots")] = boxInt(sc.nslots);
+        d->d[boxString("fragmentation")] = boxFloat(sc.fragmentation());
+        listAppendInternal(rtn, d);
+    }
+    return rtn;
+}
+
 void setupGC() {
     BoxedModule* gc_module = createModule("gc");
 
@@ -46,5 +122,19 @@ void setupGC() {
                         new BoxedBuiltinFunctionOrMethod(boxRTFunction((void*)isEnabled, BOXED_BOOL, 0), "isenabled"));
     gc_module->giveAttr("disable", new BoxedBuiltinFunctionOrMethod(boxRTFunction((void*)disable, NONE, 0), "disable"));
     gc_module->giveAttr("enable", new BoxedBuiltinFunctionOrMethod(boxRTFunction((void*)enable, NONE, 0), "enable"));
+    gc_module->giveAttr("set_threshold",
+                        new BoxedBuiltinFunctionOrMethod(boxRTFunction((void*)setThreshold, NONE, 3, 2, false, false),
+                                                         "set_threshold", { NULL, NULL }));
+    gc_module->giveAttr("get_threshold", new BoxedBuiltinFunctionOrMethod(
+                                             boxRTFunction((void*)getThreshold, BOXED_TUPLE, 0), "get_threshold"));
+    gc_module->giveAttr("set_growth_percent",
+                        new BoxedBuiltinFunctionOrMethod(boxRTFunction((void*)setGrowthPercent, NONE, 1),
+                                                         "set_growth_percent"));
+    gc_module->giveAttr("get_growth_percent",
+                        new BoxedBuiltinFunctionOrMethod(boxRTFunction((void*)getGrowthPercent, BOXED_INT, 0),
+                                                         "get_growth_percent"));
+    gc_module->giveAttr("get_size_class_stats",
+                        new BoxedBuiltinFunctionOrMethod(boxRTFunction((void*)getSizeClassStats, LIST, 0),
+                                                         "get_size_class_stats"));
 }
 }
@@ -0,0 +1,758 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A native implementation of the marshal module, which reads and writes the same format as CPython 2.7's.
+// Instead of going through the C API, it works directly on our boxed types: output gets written straight into the
+// string that we return, and loads() reads straight out of the buffer it was passed.
+
+#include <cstring>
+#include <gmp.h>
+#include <unordered_map>
+
+#include "Python.h"
+#include "marshal.h"
+
+#include "core/common.h"
+#include "core/types.h"
+#include "runtime/file.h"
+#include "runtime/long.h"
+#include "runtime/objmodel.h"
+#include "runtime/set.h"
+#include "runtime/types.h"
+
+namespace pyston {
+
+// When the object stack gets this deep, raise an exception instead of risking running out of stack:
+#define MAX_MARSHAL_STACK_DEPTH 2000
+
+#define TYPE_NULL '0'
+#define TYPE_NONE 'N'
+#define TYPE_FALSE 'F'
+#define TYPE_TRUE 'T'
+#define TYPE_STOPITER 'S'
+#define TYPE_ELLIPSIS '.'
+#define TYPE_INT 'i'
+#define TYPE_INT64 'I'
+#define TYPE_FLOAT 'f'
+#define TYPE_BINARY_FLOAT 'g'
+#define TYPE_COMPLEX 'x'
+#define TYPE_BINARY_COMPLEX 'y'
+#define TYPE_LONG 'l'
+#define TYPE_STRING 's'
+#define TYPE_INTERNED 't'
+#define TYPE_STRINGREF 'R'
+#define TYPE_TUPLE '('
+#define TYPE_LIST '['
+#define TYPE_DICT '{'
+#define TYPE_CODE 'c'
+#define TYPE_UNICODE 'u'
+#define TYPE_UNKNOWN '?'
+#define TYPE_SET '<'
+#define TYPE_FROZENSET '>'
+
+#define SIZE32_MAX 0x7FFFFFFF
+
+// Longs get marshalled as base 2**15 digits, least significant first, each stored in a 16-bit little-endian word.
+// This is exactly what mpz_export/mpz_import produce with 16-bit words and one nail bit.
+#define LONG_MARSHAL_SHIFT 15
+#define LONG_MARSHAL_MASK ((1 << LONG_MARSHAL_SHIFT) - 1)
+
+namespace {
+
+class Writer {
+private:
+    // We write straight into the string that dumps() returns, growing it as necessary:
+    BoxedString* str;
+    char* ptr;
+    char* end;
+
+    int depth;
+    int version;
+    // With version > 0, interned strings are only written out once, and then referred to by index:
+    std::unordered_map<BoxedString*, int> interned;
+
+    void grow(size_t needed) {
+        size_t size = ptr - str->data();
+        size_t capacity = end - str->data();
+        size_t new_capacity = capacity + std::max(capacity, needed) + 1024;
+
+        BoxedString* new_str = BoxedString::createUninitializedString(new_capacity);
+        memcpy(new_str->data(), str->data(), size);
+        str = new_str;
+        ptr = str->data() + size;
+        end = str->data() + new_capacity;
+    }
+
+    // Returns a pointer to the next n bytes of the output, which the caller has to fill in.
+    char* reserve(size_t n) {
+        if (unlikely(end - ptr < n))
+            grow(n);
+        char* rtn = ptr;
+        ptr += n;
+        return rtn;
+    }
+
+    void writeByte(char c) { *reserve(1) = c; }
+    void writeBytes(const char* s, size_t n) { memcpy(reserve(n), s, n); }
+
+    void writeShort(int x) {
+        char* p = reserve(2);
+        p[0] = (char)(x & 0xff);
+        p[1] = (char)((x >> 8) & 0xff);
+    }
+
+    void writeLong(int64_t x) {
+        char* p = reserve(4);
+        p[0] = (char)(x & 0xff);
+        p[1] = (char)((x >> 8) & 0xff);
+        p[2] = (char)((x >> 16) & 0xff);
+        p[3] = (char)((x >> 24) & 0xff);
+    }
+
+    void writeSize(size_t n) {
+        if (n > SIZE32_MAX)
+            raiseExcHelper(ValueError, "unmarshallable object");
+        writeLong(n);
+    }
+
+    void writePString(const char* s, size_t n) {
+        writeSize(n);
+        writeBytes(s, n);
+    }
+
+    void writeDouble(double d) {
+        if (_PyFloat_Pack8(d, (unsigned char*)reserve(8), 1) < 0)
+            throwCAPIException();
+    }
+
+    void writeDoubleString(double d) {
+        char* buf = PyOS_double_to_string(d, 'g', 17, 0, NULL);
+        if (!buf)
+            throwCAPIException();
+        size_t n = strlen(buf);
+        writeByte((char)n);
+        writeBytes(buf, n);
+        PyMem_Free(buf);
+    }
+
+    void writeBoxedLong(BoxedLong* l) {
+        writeByte(TYPE_LONG);
+        int sign = mpz_sgn(l->n);
+        if (sign == 0) {
+            writeLong(0);
+            return;
+        }
+
+        size_t ndigits = (mpz_sizeinbase(l->n, 2) + LONG_MARSHAL_SHIFT - 1) / LONG_MARSHAL_SHIFT;
+        if (ndigits > SIZE32_MAX)
+            raiseExcHelper(ValueError, "unmarshallable object");
+        writeLong(sign > 0 ? (int64_t)ndigits : -(int64_t)ndigits);
+
+        size_t count;
+        mpz_export(reserve(ndigits * 2), &count, -1, 2, -1, 16 - LONG_MARSHAL_SHIFT, l->n);
+        assert(count == ndigits);
+    }
+
+    void writeUnicode(Box* v) {
+        // Encode straight into the output, instead of creating a temporary utf-8 string first:
+        static_assert(Py_UNICODE_SIZE == 4, "");
+        const Py_UNICODE* s = PyUnicode_AS_UNICODE(v);
+        Py_ssize_t len = PyUnicode_GET_SIZE(v);
+
+        size_t utf8_len = 0;
+        for (Py_ssize_t i = 0; i < len; i++) {
+            Py_UCS4 c = s[i];
+            utf8_len += c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+        }
+
+        writeByte(TYPE_UNICODE);
+        writeSize(utf8_len);
+        unsigned char* p = (unsigned char*)reserve(utf8_len);
+        for (Py_ssize_t i = 0; i < len; i++) {
+            Py_UCS4 c = s[i];
+            if (c < 0x80) {
+                *p++ = c;
+            } else if (c < 0x800) {
+                *p++ = 0xc0 | (c >> 6);
+                *p++ = 0x80 | (c & 0x3f);
+            } else if (c < 0x10000) {
+                // Like CPython 2.7, lone surrogates just get encoded as if they were normal characters.
+                *p++ = 0xe0 | (c >> 12);
+                *p++ = 0x80 | ((c >> 6) & 0x3f);
+                *p++ = 0x80 | (c & 0x3f);
+            } else {
+                *p++ = 0xf0 | (c >> 18);
+                *p++ = 0x80 | ((c >> 12) & 0x3f);
+                *p++ = 0x80 | ((c >> 6) & 0x3f);
+                *p++ = 0x80 | (c & 0x3f);
+            }
+        }
+        assert((char*)p == ptr);
+    }
+
+    void writeString(BoxedString* s) {
+        if (version > 0 && PyString_CHECK_INTERNED(s)) {
+            auto it = interned.find(s);
+            if (it != interned.end()) {
+                writeByte(TYPE_STRINGREF);
+                writeLong(it->second);
+                return;
+            }
+            int idx = interned.size();
+            interned[s] = idx;
+            writeByte(TYPE_INTERNED);
+        } else {
+            writeByte(TYPE_STRING);
+        }
+        writePString(s->data(), s->size());
+    }
+
+public:
+    Writer(int version) : depth(0), version(version) {
+        str = BoxedString::createUninitializedString(64);
+        ptr = str->data();
+        end = ptr + 64;
+    }
+
+    void writeObject(Box* v) {
+        if (++depth > MAX_MARSHAL_STACK_DEPTH)
+            raiseExcHelper(ValueError, "object too deeply nested to marshal");
+
+        BoxedClass* cls = v ? v->cls : NULL;
+        if (v == NULL) {
+            writeByte(TYPE_NULL);
+        } else if (v == None) {
+            writeByte(TYPE_NONE);
+        } else if (v == StopIteration) {
+            writeByte(TYPE_STOPITER);
+        } else if (v == Py_Ellipsis) {
+            writeByte(TYPE_ELLIPSIS);
+        } else if (v == False) {
+            writeByte(TYPE_FALSE);
+        } else if (v == True) {
+            writeByte(TYPE_TRUE);
+        } else if (cls == int_cls) {
+            int64_t x = static_cast<BoxedInt*>(v)->n;
+            int64_t y = x >> 31;
+            if (y && y != -1) {
+                writeByte(TYPE_INT64);
+                writeLong(x);
+                writeLong(x >> 32);
+            } else {
+                writeByte(TYPE_INT);
+                writeLong(x);
+            }
+        } else if (cls == long_cls) {
+            writeBoxedLong(static_cast<BoxedLong*>(v));
+        } else if (cls == float_cls) {
+            double d = static_cast<BoxedFloat*>(v)->d;
+            if (version > 1) {
+                writeByte(TYPE_BINARY_FLOAT);
+                writeDouble(d);
+            } else {
+                writeByte(TYPE_FLOAT);
+                writeDoubleString(d);
+            }
+        } else if (cls == complex_cls) {
+            BoxedComplex* c = static_cast<BoxedComplex*>(v);
+            if (version > 1) {
+                writeByte(TYPE_BINARY_COMPLEX);
+                writeDouble(c->real);
+                writeDouble(c->imag);
+            } else {
+                writeByte(TYPE_COMPLEX);
+                writeDoubleString(c->real);
+                writeDoubleString(c->imag);
+            }
+        } else if (cls == str_cls) {
+            writeString(static_cast<BoxedString*>(v));
+        } else if (cls == unicode_cls) {
+            writeUnicode(v);
+        } else if (cls == tuple_cls) {
+            BoxedTuple* t = static_cast<BoxedTuple*>(v);
+            writeByte(TYPE_TUPLE);
+            writeSize(t->size());
+            for (Box* e : *t)
+                writeObject(e);
+        } else if (cls == list_cls) {
+            BoxedList* l = static_cast<BoxedList*>(v);
+            writeByte(TYPE_LIST);
+            writeSize(l->size);
+            // Writing the elements can't run any Python code, so the list can't change size on us:
+            for (Py_ssize_t i = 0; i < l->size; i++)
+                writeObject(l->elts->elts[i]);
+        } else if (cls == dict_cls) {
+            // Dicts don't have a length; they're terminated by a NULL key.
+            writeByte(TYPE_DICT);
+            for (auto& p : static_cast<BoxedDict*>(v)->d) {
+                writeObject(p.first);
+                writeObject(p.second);
+            }
+            writeObject(NULL);
+        } else if (cls == set_cls || cls == frozenset_cls) {
+            BoxedSet* s = static_cast<BoxedSet*>(v);
+            writeByte(cls == set_cls ? TYPE_SET : TYPE_FROZENSET);
+            writeSize(s->s.size());
+            for (Box* e : s->s)
+                writeObject(e);
+        } else if (cls != code_cls && PyObject_CheckReadBuffer(v)) {
+            // Write unknown buffer-style objects as a string:
+            const void* buf;
+            Py_ssize_t len;
+            if (PyObject_AsReadBuffer(v, &buf, &len) != 0)
+                throwCAPIException();
+            writeByte(TYPE_STRING);
+            writePString((const char*)buf, len);
+        } else {
+            // Code objects end up here too, since ours don't have any bytecode to write out.
+            raiseExcHelper(ValueError, "unmarshallable object");
+        }
+
+        depth--;
+    }
+
+    BoxedString* getString() {
+        PyObject* rtn = str;
+        if (_PyString_Resize(&rtn, ptr - str->data()) != 0)
+            throwCAPIException();
+        str = NULL;
+        return static_cast<BoxedString*>(rtn);
+    }
+
+    llvm::StringRef getData() { return llvm::StringRef(str->data(), ptr - str->data()); }
+};
+
+// Where a Reader gets its data from: either straight out of an in-memory buffer, or from a file.
+class MemorySource {
+private:
+    const char* ptr;
+    const char* end;
+
+public:
+    MemorySource(const char* ptr, const char* end) : ptr(ptr), end(end) {}
+
+    int readByte() { return ptr < end ? (unsigned char)*ptr++ : EOF; }
+
+    // Returns a pointer to the next n bytes, or NULL if there aren't that many left.
+    const char* read(size_t n, std::string& scratch) {
+        if (end - ptr < n)
+            return NULL;
+        const char* rtn = ptr;
+        ptr += n;
+        return rtn;
+    }
+
+    const char* position() const { return ptr; }
+};
+
+class FileSource {
+private:
+    FILE* fp;
+
+public:
+    FileSource(FILE* fp) : fp(fp) {}
+
+    int readByte() { return getc(fp); }
+
+    const char* read(size_t n, std::string& scratch) {
+        scratch.resize(n);
+        if (fread(&scratch[0], 1, n, fp) != n)
+            return NULL;
+        return scratch.data();
+    }
+};
+
+template <typename Source> class Reader {
+private:
+    Source& source;
+    int depth;
+    // The interned strings we've read so far, for TYPE_STRINGREF to refer to:
+    BoxedList* strings;
+    std::string scratch;
+
+    void raiseEOF() { raiseExcHelper((BoxedClass*)PyExc_EOFError, "EOF read where object expected"); }
+
+    // Returns a pointer to the next n bytes of the input.  The pointer is only valid until the next read.
+    const char* read(size_t n) {
+        const char* rtn = source.read(n, scratch);
+        if (!rtn)
+            raiseEOF();
+        return rtn;
+    }
+
+    int readByte() {
+        int c = source.readByte();
+        if (c == EOF)
+            raiseEOF();
+        return c;
+    }
+
+    int64_t readLong() {
+        const unsigned char* p = (const unsigned char*)read(4);
+        return (int32_t)(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+    }
+
+    Py_ssize_t readSize(const char* what) {
+        int64_t n = readLong();
+        if (n < 0 || n > SIZE32_MAX)
+            raiseExcHelper(ValueError, "bad marshal data (%s size out of range)", what);
+        return n;
+    }
+
+    double readDouble() {
+        double d = _PyFloat_Unpack8((const unsigned char*)read(8), 1);
+        if (d == -1.0 && PyErr_Occurred())
+            throwCAPIException();
+        return d;
+    }
+
+    double readDoubleString() {
+        char buf[256];
+        int n = readByte();
+        memcpy(buf, read(n), n);
+        buf[n] = '\0';
+        double d = PyOS_string_to_double(buf, NULL, NULL);
+        if (d == -1.0 && PyErr_Occurred())
+            throwCAPIException();
+        return d;
+    }
+
+    Box* readBoxedLong() {
+        int64_t n = readLong();
+        if (n < -SIZE32_MAX || n > SIZE32_MAX)
+            raiseExcHelper(ValueError, "bad marshal data (long size out of range)");
+
+        size_t ndigits = n < 0 ? -n : n;
+        const unsigned char* p = (const unsigned char*)read(ndigits * 2);
+        for (size_t i = 0; i < ndigits; i++) {
+            int digit = p[2 * i] | (p[2 * i + 1] << 8);
+            if (digit > LONG_MARSHAL_MASK)
+                raiseExcHelper(ValueError, "bad marshal data (digit out of range in long)");
+            if (digit == 0 && i == ndigits - 1)
+                raiseExcHelper(ValueError, "bad marshal data (unnormalized long data)");
+        }
+
+        BoxedLong* rtn = new BoxedLong();
+        mpz_init(rtn->n);
+        mpz_import(rtn->n, ndigits, -1, 2, -1, 16 - LONG_MARSHAL_SHIFT, p);
+        if (n < 0)
+            mpz_neg(rtn->n, rtn->n);
+        return rtn;
+    }
+
+    Box* readSequenceElement(const char* what) {
+        Box* v = readObject();
+        if (!v)
+            raiseExcHelper(TypeError, "NULL object in marshal data for %s", what);
+        return v;
+    }
+
+    // Returns NULL for TYPE_NULL, which is how dicts get terminated.
+    Box* readObject() {
+        if (++depth > MAX_MARSHAL_STACK_DEPTH)
+            raiseExcHelper(ValueError, "recursion limit exceeded");
+
+        Box* rtn;
+        int type = readByte();
+        switch (type) {
+            case TYPE_NULL:
+                rtn = NULL;
+                break;
+            case TYPE_NONE:
+                rtn = None;
+                break;
+            case TYPE_STOPITER:
+                rtn = StopIteration;
+                break;
+            case TYPE_ELLIPSIS:
+                rtn = Py_Ellipsis;
+                break;
+            case TYPE_FALSE:
+                rtn = False;
+                break;
+            case TYPE_TRUE:
+                rtn = True;
+                break;
+            case TYPE_INT:
+                rtn = boxInt(readLong());
+                break;
+            case TYPE_INT64: {
+                int64_t lo = readLong();
+                int64_t hi = readLong();
+                rtn = boxInt((hi << 32) | (lo & 0xFFFFFFFFL));
+                break;
+            }
+            case TYPE_LONG:
+                rtn = readBoxedLong();
+                break;
+            case TYPE_FLOAT:
+                rtn = boxFloat(readDoubleString());
+                break;
+            case TYPE_BINARY_FLOAT:
+                rtn = boxFloat(readDouble());
+                break;
+            case TYPE_COMPLEX: {
+                double real = readDoubleString();
+                double imag = readDoubleString();
+                rtn = new BoxedComplex(real, imag);
+                break;
+            }
+            case TYPE_BINARY_COMPLEX: {
+                double real = readDouble();
+                double imag = readDouble();
+                rtn = new BoxedComplex(real, imag);
+                break;
+            }
+            case TYPE_INTERNED:
+            case TYPE_STRING: {
+                Py_ssize_t n = readSize("string");
+                PyObject* s = boxString(llvm::StringRef(read(n), n));
+                if (type == TYPE_INTERNED) {
+                    PyString_InternInPlace(&s);
+                    listAppendInternal(strings, s);
+                }
+                rtn = s;
+                break;
+            }
+            case TYPE_STRINGREF: {
+                int64_t n = readLong();
+                if (n < 0 || n >= strings->size)
+                    raiseExcHelper(ValueError, "bad marshal data (string ref out of range)");
+                rtn = strings->elts->elts[n];
+                break;
+            }
+            case TYPE_UNICODE: {
+                Py_ssize_t n = readSize("unicode");
+                rtn = PyUnicode_DecodeUTF8(read(n), n, NULL);
+                if (!rtn)
+                    throwCAPIException();
+                break;
+            }
+            case TYPE_TUPLE: {
+                Py_ssize_t n = readSize("tuple");
+                BoxedTuple* t = BoxedTuple::create(n);
+                for (Py_ssize_t i = 0; i < n; i++)
+                    t->elts[i] = readSequenceElement("tuple");
+                rtn = t;
+                break;
+            }
+            case TYPE_LIST: {
+                Py_ssize_t n = readSize("list");
+                BoxedList* l = new BoxedList();
+                if (n)
+                    l->ensure(n);
+                for (Py_ssize_t i = 0; i < n; i++)
+                    listAppendInternal(l, readSequenceElement("list"));
+                rtn = l;
+                break;
+            }
+            case TYPE_DICT: {
+                BoxedDict* d = new BoxedDict();
+                while (Box* key = readObject()) {
+                    Box* value = readObject();
+                    if (value)
+                        d->d[key] = value;
+                }
+                rtn = d;
+                break;
+            }
+            case TYPE_SET:
+            case TYPE_FROZENSET: {
+                Py_ssize_t n = readSize("set");
+                BoxedSet* s = new (type == TYPE_SET ? set_cls : frozenset_cls) BoxedSet();
+                for (Py_ssize_t i = 0; i < n; i++)
+                    s->s.insert(readSequenceElement("set"));
+                rtn = s;
+                break;
+            }
+            case TYPE_CODE:
+                raiseExcHelper(ValueError, "bad marshal data (code objects are not supported)");
+            default:
+                raiseExcHelper(ValueError, "bad marshal data (unknown type code)");
+        }
+
+        depth--;
+        return rtn;
+    }
+
+public:
+    Reader(Source& source) : source(source), depth(0), strings(new BoxedList()) {}
+
+    Box* read() {
+        Box* rtn = readObject();
+        if (!rtn)
+            raiseExcHelper(TypeError, "NULL object in marshal data for object");
+        return rtn;
+    }
+};
+}
+
+static int versionArg(Box* version) {
+    if (!PyInt_Check(version))
+        raiseExcHelper(TypeError, "an integer is required");
+    return static_cast<BoxedInt*>(version)->n;
+}
+
+static FILE* fileArg(Box* f, const char* msg) {
+    if (!PyFile_Check(f))
+        raiseExcHelper(TypeError, "%s", msg);
+    FILE* fp = PyFile_AsFile(f);
+    if (!fp)
+        raiseExcHelper(ValueError, "I/O operation on closed file");
+    return fp;
+}
+
+static llvm::StringRef bufferArg(Box* data) {
+    if (PyString_Check(data))
+        return static_cast<BoxedString*>(data)->s();
+
+    const void* buf;
+    Py_ssize_t len;
+    if (PyObject_AsReadBuffer(data, &buf, &len) != 0)
+        throwCAPIException();
+    return llvm::StringRef((const char*)buf, len);
+}
+
+static Box* marshalDump(Box* value, Box* f, Box* version) {
+    FILE* fp = fileArg(f, "marshal.dump() 2nd arg must be file");
+    Writer writer(versionArg(version));
+    writer.writeObject(value);
+    llvm::StringRef data = writer.getData();
+    fwrite(data.data(), 1, data.size(), fp);
+    return None;
+}
+
+static Box* marshalLoad(Box* f) {
+    FileSource source(fileArg(f, "marshal.load() arg must be file"));
+    return Reader<FileSource>(source).read();
+}
+
+static Box* marshalDumps(Box* value, Box* version) {
+    Writer writer(versionArg(version));
+    writer.writeObject(value);
+    return writer.getString();
+}
+
+static Box* marshalLoads(Box* data) {
+    llvm::StringRef buf = bufferArg(data);
+    MemorySource source(buf.begin(), buf.end());
+    return Reader<MemorySource>(source).read();
+}
+
+// Pyston addition: reads one value starting at the given offset, and returns it along with the offset just past it.
+// This lets callers walk through a buffer of concatenated values without having to slice it up.
+static Box* marshalLoadsFrom(Box* data, Box* offset) {
+    llvm::StringRef buf = bufferArg(data);
+    if (!PyInt_Check(offset))
+        raiseExcHelper(TypeError, "an integer is required");
+    int64_t start = static_cast<BoxedInt*>(offset)->n;
+    if (start < 0 || start > buf.size())
+        raiseExcHelper(ValueError, "offset out of range");
+
+    MemorySource source(buf.begin() + start, buf.end());
+    Box* rtn = Reader<MemorySource>(source).read();
+    return BoxedTuple::create({ rtn, boxInt(source.position() - buf.begin()) });
+}
+
+extern "C" void PyMarshal_WriteLongToFile(long x, FILE* fp, int version) noexcept {
+    putc((char)(x & 0xff), fp);
+    putc((char)((x >> 8) & 0xff), fp);
+    putc((char)((x >> 16) & 0xff), fp);
+    putc((char)((x >> 24) & 0xff), fp);
+}
+
+extern "C" void PyMarshal_WriteObjectToFile(PyObject* x, FILE* fp, int version) noexcept {
+    try {
+        Writer writer(version);
+        writer.writeObject(x);
+        llvm::StringRef data = writer.getData();
+        fwrite(data.data(), 1, data.size(), fp);
+    } catch (ExcInfo e) {
+        setCAPIException(e);
+    }
+}
+
+extern "C" PyObject* PyMarshal_WriteObjectToString(PyObject* x, int version) noexcept {
+    try {
+        Writer writer(version);
+        writer.writeObject(x);
+        return writer.getString();
+    } catch (ExcInfo e) {
+        setCAPIException(e);
+        return NULL;
+    }
+}
+
+extern "C" long PyMarshal_ReadLongFromFile(FILE* fp) noexcept {
+    long x = getc(fp);
+    x |= (long)getc(fp) << 8;
+    x |= (long)getc(fp) << 16;
+    x |= (long)getc(fp) << 24;
+    // Sign extension for 64-bit machines:
+    x |= -(x & 0x80000000L);
+    return x;
+}
+
+extern "C" int PyMarshal_ReadShortFromFile(FILE* fp) noexcept {
+    short x = getc(fp);
+    x |= getc(fp) << 8;
+    // Sign-extension, in case short greater than 16 bits
+    x |= -(x & 0x8000);
+    return x;
+}
+
+extern "C" PyObject* PyMarshal_ReadObjectFromFile(FILE* fp) noexcept {
+    try {
+        FileSource source(fp);
+        return Reader<FileSource>(source).read();
+    } catch (ExcInfo e) {
+        setCAPIException(e);
+        return NULL;
+    }
+}
+
+extern "C" PyObject* PyMarshal_ReadLastObjectFromFile(FILE* fp) noexcept {
+    return PyMarshal_ReadObjectFromFile(fp);
+}
+
+extern "C" PyObject* PyMarshal_ReadObjectFromString(char* str, Py_ssize_t len) noexcept {
+    try {
+        MemorySource source(str, str + len);
+        return Reader<MemorySource>(source).read();
+    } catch (ExcInfo e) {
+        setCAPIException(e);
+        return NULL;
+    }
+}
+
+void setupMarshal() {
+    BoxedModule* marshal_module = createModule("marshal");
+
+    marshal_module->giveAttr("version", boxInt(Py_MARSHAL_VERSION));
+
+    marshal_module->giveAttr("dump", new BoxedBuiltinFunctionOrMethod(
+                                         boxRTFunction((void*)marshalDump, NONE, 3, 1, false, false), "dump",
+                                         { boxInt(Py_MARSHAL_VERSION) }));
+    marshal_module->giveAttr("load",
+                             new BoxedBuiltinFunctionOrMethod(boxRTFunction((void*)marshalLoad, UNKNOWN, 1), "load"));
+    marshal_module->giveAttr("dumps", new BoxedBuiltinFunctionOrMethod(
+                                          boxRTFunction((void*)marshalDumps, STR, 2, 1, false, false), "dumps",
+                                          { boxInt(Py_MARSHAL_VERSION) }));
+    marshal_module->giveAttr("loads",
+                             new BoxedBuiltinFunctionOrMethod(boxRTFunction((void*)marshalLoads, UNKNOWN, 1), "loads"));
+    marshal_module->giveAttr("loads_from", new BoxedBuiltinFunctionOrMethod(
+                                               boxRTFunction((void*)marshalLoadsFrom, BOXED_TUPLE, 2, 1, false, false),
+                                               "loads_from", { boxInt(0) }));
+}
+}
@@ -37,12 +37,16 @@ static Box* setOption(Box* option, Box* value) {
     CHECK(ENABLE_INTERPRETER);
     else CHECK(ENABLE_OSR);
     else CHECK(ENABLE_REOPT);
+    else CHECK(ENABLE_BACKGROUND_COMPILATION);
+    else CHECK(ENABLE_JIT_PROFILE_CACHE);
+    else CHECK(ENABLE_STACKLESS_GENERATORS);
     else CHECK(FORCE_INTERPRETER);
     else CHECK(REOPT_THRESHOLD_INTERPRETER);
     else CHECK(OSR_THRESHOLD_INTERPRETER);
     else CHECK(REOPT_THRESHOLD_BASELINE);
     else CHECK(OSR_THRESHOLD_BASELINE);
     else CHECK(SPECULATION_THRESHOLD);
+    else CHECK(MAX_CACHED_GENERATOR_STACKS);
     else CHECK(ENABLE_ICS);
     else CHECK(ENABLE_ICGETATTRS);
     else raiseExcHelper(ValueError, "unknown option name '%s", option_string->data());
@@ -22,6 +22,7 @@
 
 #include "capi/types.h"
 #include "codegen/unwinding.h"
+#include "core/threading.h"
 #include "core/types.h"
 #include "gc/collector.h"
 #include "runtime/file.h"
@@ -401,8 +402,34 @@ PyDoc_STRVAR(excepthook_doc, "excepthook(exctype, value, traceback) -> None\n"
                              "\n"
                              "Handle an exception by displaying it with a traceback on sys.stderr.\n");
 
+// CPython 2 counts the check interval in ticks, but we switch threads based on time (see threading.cpp), so we
+// treat each tick as 50us; the default of 100 ticks then matches Python 3's 5ms switch interval.
+#define SWITCH_INTERVAL_US_PER_TICK 50
+
+static PyObject* sys_setcheckinterval(PyObject* self, PyObject* args) noexcept {
+    int interval;
+    if (!PyArg_ParseTuple(args, "i:setcheckinterval", &interval))
+        return NULL;
+    threading::setGILSwitchInterval(std::max(interval, 1) * SWITCH_INTERVAL_US_PER_TICK);
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject* sys_getcheckinterval(PyObject* self, PyObject* args) noexcept {
+    return PyInt_FromLong(threading::getGILSwitchInterval() / SWITCH_INTERVAL_US_PER_TICK);
+}
+
+PyDoc_STRVAR(setcheckinterval_doc, "setcheckinterval(n)\n"
+                                   "\n"
+                                   "Tell the Python interpreter to check for asynchronous events every\n"
+                                   "n instructions.  This also affects how often thread switches occur.");
+
+PyDoc_STRVAR(getcheckinterval_doc, "getcheckinterval() -> current check interval; see setcheckinterval().");
+
 static PyMethodDef sys_methods[] = {
     { "excepthook", sys_excepthook, METH_VARARGS, excepthook_doc },
+    { "setcheckinterval", sys_setcheckinterval, METH_VARARGS, setcheckinterval_doc },
+    { "getcheckinterval", sys_getcheckinterval, METH_NOARGS, getcheckinterval_doc },
 };
 
 void setupSys() {
@@ -823,6 +823,8 @@ extern "C" void Py_Exit(int sts) noexcept {
 }
 
 extern "C" void PyErr_Restore(PyObject* type, PyObject* value, PyObject* traceback) noexcept {
+    // The caller might hold on to the traceback it passes in, so don't let later frames get appended to it.
+    BoxedTraceback::seal(traceback);
     cur_thread_state.curexc_type = type;
     cur_thread_state.curexc_value = value;
     cur_thread_state.curexc_traceback = traceback;
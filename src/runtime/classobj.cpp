@@ -807,6 +807,47 @@ extern "C" PyObject* PyClass_New(PyObject* bases, PyObject* dict, PyObject* name
     }
 }
 
+extern "C" PyObject* PyInstance_New(PyObject* klass, PyObject* arg, PyObject* kw) noexcept {
+    if (!PyClass_Check(klass)) {
+        PyErr_BadInternalCall();
+        return NULL;
+    }
+
+    try {
+        return classobjCall(klass, arg ? arg : EmptyTuple, kw ? kw : new BoxedDict());
+    } catch (ExcInfo e) {
+        setCAPIException(e);
+        return NULL;
+    }
+}
+
+extern "C" PyObject* PyInstance_NewRaw(PyObject* klass, PyObject* dict) noexcept {
+    if (!PyClass_Check(klass) || (dict && !PyDict_Check(dict))) {
+        PyErr_BadInternalCall();
+        return NULL;
+    }
+
+    try {
+        BoxedInstance* inst = new BoxedInstance(static_cast<BoxedClassobj*>(klass));
+
+        // Our instances keep their attributes in their hidden class rather than in a dict,
+        // so unlike CPython we copy the dict instead of using it as the instance's __dict__.
+        if (dict) {
+            for (auto& p : static_cast<BoxedDict*>(dict)->d) {
+                if (!PyString_Check(p.first))
+                    raiseExcHelper(TypeError, "attribute name must be string, not '%s'", getTypeName(p.first));
+                BoxedString* s = static_cast<BoxedString*>(p.first);
+                internStringMortalInplace(s);
+                inst->setattr(s, p.second, NULL);
+            }
+        }
+        return inst;
+    } catch (ExcInfo e) {
+        setCAPIException(e);
+        return NULL;
+    }
+}
+
 extern "C" PyObject* PyMethod_New(PyObject* func, PyObject* self, PyObject* klass) noexcept {
     try {
         return new BoxedInstanceMethod(self, func, klass);
@@ -12,11 +12,15 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <dlfcn.h> // dladdr
 #include <stddef.h>
 #include <stdint.h>
+#include <unordered_map>
 #include <unwind.h>
+#include <vector>
 
 #include "llvm/Support/LEB128.h" // for {U,S}LEB128 decoding
 
@@ -24,6 +28,7 @@
 #include "codegen/unwinding.h"       // getCFForAddress
 #include "core/ast.h"
 #include "core/stats.h"        // StatCounter
+#include "core/thread_utils.h" // PthreadFastMutex
 #include "core/types.h"        // for ExcInfo
 #include "core/util.h"         // Timer
 #include "runtime/generator.h" // generatorEntry
@@ -358,35 +363,113 @@ static void print_frame(unw_cursor_t* cursor, const unw_proc_info_t* pip) {
 
     if (frame_type == INTERPRETED && cf && cur_stmt) {
         auto source = cf->clfunc->source.get();
-        // FIXME: dup'ed from lineInfoForFrame
+        // FIXME: dup'ed from BoxedTraceback::getLineInfos
         LineInfo line(cur_stmt->lineno, cur_stmt->col_offset, source->fn, source->getName());
         printf("      File \"%s\", line %d, in %s\n", line.file.c_str(), line.line, line.func.c_str());
     }
 }
 
 
-// ---------- Helpers for unwind_loop ----------
-static inline bool find_call_site_entry(const lsda_info_t* info, const uint8_t* ip, call_site_entry_t* entry) {
-    const uint8_t* p = info->call_site_table;
-    while (p < info->action_table) { // The call site table ends where the action table begins.
-        p = parse_call_site_entry(p, info, entry);
+// ---------- Unwind info cache ----------
+// unw_get_proc_info is slow, and reparsing the LSDA and scanning its call site table on every throw adds up for code
+// that raises and catches in a loop.  So we decode each function's unwind info once, and map every return address that
+// we unwind through to it.
+//
+// Lookups don't take a lock: a slot gets written by clearing its ip, storing the function and then storing the ip
+// again, so a reader that sees the same ip before and after loading the function knows that the two belong together.
+// Misses and invalidations are serialized by unwind_cache_lock.
+struct unwind_func_info_t {
+    unw_proc_info_t pip;
+    lsda_info_t lsda_info;                     // only valid if pip.lsda is nonzero
+    std::vector<call_site_entry_t> call_sites; // sorted by instrs_start
+};
 
-        if (VERBOSITY("cxx_unwind") >= 5) {
-            printf("    start %p end %p landingpad %p action %lx\n", entry->instrs_start,
-                   entry->instrs_start + entry->instrs_len_bytes, entry->landing_pad, entry->action_offset_plus_one);
-        }
+struct unwind_cache_slot_t {
+    std::atomic<unw_word_t> ip; // 0 if empty
+    std::atomic<const unwind_func_info_t*> func;
+};
+
+#define UNWIND_CACHE_SIZE 4096 // must be a power of two
+static unwind_cache_slot_t unwind_cache[UNWIND_CACHE_SIZE];
+static threading::PthreadFastMutex unwind_cache_lock;
+static std::unordered_map<unw_word_t, unwind_func_info_t*> unwind_func_infos; // keyed by start_ip
+
+static inline unwind_cache_slot_t* unwind_cache_slot(unw_word_t ip) {
+    return &unwind_cache[(ip ^ (ip >> 12)) & (UNWIND_CACHE_SIZE - 1)];
+}
 
-        // If our IP is in the given range, we found the right entry!
-        if (entry->instrs_start <= ip && ip < entry->instrs_start + entry->instrs_len_bytes)
-            return true;
+static unwind_func_info_t* decode_unwind_func_info(const unw_proc_info_t* pip) {
+    unwind_func_info_t* func = new unwind_func_info_t();
+    func->pip = *pip;
+    if (!pip->lsda)
+        return func;
 
-        // The call-site table is in sorted order by start IP. If we've passed our current IP, we won't find an entry.
-        if (ip < entry->instrs_start + entry->instrs_len_bytes)
-            break;
+    lsda_info_t* info = &func->lsda_info;
+    parse_lsda_header(pip, info);
+
+    const uint8_t* p = info->call_site_table;
+    while (p < info->action_table) { // The call site table ends where the action table begins.
+        call_site_entry_t entry;
+        p = parse_call_site_entry(p, info, &entry);
+        // The call-site table is in sorted order by start IP, which is what lets us binary search it.
+        ASSERT(func->call_sites.empty() || func->call_sites.back().instrs_start <= entry.instrs_start,
+               "Malformed LSDA; call site table isn't sorted!");
+        func->call_sites.push_back(entry);
     }
 
     // If p actually overran *into* info.action_table, we have a malformed LSDA.
     ASSERT(!(p > info->action_table), "Malformed LSDA; call site entry overlaps action table!");
+    return func;
+}
+
+// ip is the return address of the frame that the cursor is on.
+static inline const unwind_func_info_t* get_unwind_func_info(unw_cursor_t* cursor, unw_word_t ip) {
+    unwind_cache_slot_t* slot = unwind_cache_slot(ip);
+    if (slot->ip.load() == ip) {
+        const unwind_func_info_t* func = slot->func.load();
+        if (slot->ip.load() == ip)
+            return func;
+    }
+
+    static StatCounter num_unwind_cache_misses("num_unwind_cache_misses");
+    num_unwind_cache_misses.log();
+
+    // NB. unw_get_proc_info is slow; a significant chunk of all time spent unwinding used to be spent here.
+    unw_proc_info_t pip;
+    check(unw_get_proc_info(cursor, &pip));
+
+    LOCK_REGION(&unwind_cache_lock);
+    unwind_func_info_t*& func = unwind_func_infos[pip.start_ip];
+    if (!func)
+        func = decode_unwind_func_info(&pip);
+
+    slot->ip.store(0);
+    slot->func.store(func);
+    slot->ip.store(ip);
+    return func;
+}
+
+// ---------- Helpers for unwind_loop ----------
+static inline bool find_call_site_entry(const unwind_func_info_t* func, const uint8_t* ip, call_site_entry_t* entry) {
+    const auto& call_sites = func->call_sites;
+
+    // Find the last entry that starts at or before ip; if ip is in any entry's range, it is in that one.
+    auto it = std::upper_bound(call_sites.begin(), call_sites.end(), ip,
+                               [](const uint8_t* ip, const call_site_entry_t& e) { return ip < e.instrs_start; });
+    if (it == call_sites.begin())
+        return false;
+    --it;
+
+    if (VERBOSITY("cxx_unwind") >= 5) {
+        printf("    start %p end %p landingpad %p action %lx\n", it->instrs_start,
+               it->instrs_start + it->instrs_len_bytes, it->landing_pad, it->action_offset_plus_one);
+    }
+
+    // If our IP is in the given range, we found the right entry!
+    if (ip < it->instrs_start + it->instrs_len_bytes) {
+        *entry = *it;
+        return true;
+    }
     return false;
 }
 
@@ -494,10 +577,11 @@ static inline void unwind_loop(ExcInfo* exc_data) {
     auto unwind_session = getActivePythonUnwindSession();
 
     while (unw_step(&cursor) > 0) {
-        unw_proc_info_t pip;
+        unw_word_t ip;
+        unw_get_reg(&cursor, UNW_REG_IP, &ip);
 
-        // NB. unw_get_proc_info is slow; a significant chunk of all time spent unwinding is spent here.
-        check(unw_get_proc_info(&cursor, &pip));
+        const unwind_func_info_t* func = get_unwind_func_info(&cursor, ip);
+        const unw_proc_info_t& pip = func->pip;
 
         assert((pip.lsda == 0) == (pip.handler == 0));
         assert(pip.flags == 0);
@@ -521,23 +605,18 @@ static inline void unwind_loop(ExcInfo* exc_data) {
                        "don't know how to unwind through non-C++ functions");
 
         // Don't call __gxx_personality_v0; we perform dispatch ourselves.
-        // 1. parse LSDA header
-        lsda_info_t info;
-        parse_lsda_header(&pip, &info);
+        // 1. get the parsed LSDA header
+        const lsda_info_t* info = &func->lsda_info;
 
         call_site_entry_t entry;
         {
             // 2. Find our current IP in the call site table.
-            unw_word_t ip;
-            unw_get_reg(&cursor, UNW_REG_IP, &ip);
             // ip points to the instruction *after* the instruction that caused the error - which is generally (always?)
             // a call instruction - UNLESS we're in a signal frame, in which case it points at the instruction that
             // caused the error. For now, we assume we're never in a signal frame. So, we decrement it by one.
             //
             // TODO: double-check that we never hit a signal frame.
-            --ip;
-
-            bool found = find_call_site_entry(&info, (const uint8_t*)ip, &entry);
+            bool found = find_call_site_entry(func, (const uint8_t*)(ip - 1), &entry);
             // If we didn't find an entry, an exception happened somewhere exceptions should never happen; terminate
             // immediately.
             if (!found) {
@@ -553,10 +632,10 @@ static inline void unwind_loop(ExcInfo* exc_data) {
         // After this point we are guaranteed to resume something rather than unwinding further.
 
         if (VERBOSITY("cxx_unwind") >= 4) {
-            print_lsda(&info);
+            print_lsda(info);
         }
 
-        int64_t switch_value = determine_action(&info, &entry);
+        int64_t switch_value = determine_action(info, &entry);
         if (switch_value != CLEANUP_ACTION) {
             // we're transfering control to a non-cleanup landing pad.
             // i.e. a catch block.  thus ends our unwind session.
@@ -595,6 +674,33 @@ static void unwind(ExcInfo* exc) {
 }
 
 } // extern "C"
+
+void invalidateUnwindInfoCache(uint64_t addr, size_t size) {
+    // Freeing the infos is only safe because nobody can be in the middle of a lookup; without the GIL this would need
+    // some form of deferred reclamation.
+    static_assert(THREADING_USE_GIL, "have to make unwind cache invalidation thread safe!");
+
+    LOCK_REGION(&unwind_cache_lock);
+
+    uint64_t end = addr + size;
+    auto overlaps = [=](const unwind_func_info_t* func) { return func->pip.start_ip < end && addr < func->pip.end_ip; };
+
+    for (unwind_cache_slot_t& slot : unwind_cache) {
+        unw_word_t ip = slot.ip.load();
+        // A return address can be one past the end of its function, if the function ends in a noreturn call.
+        if (ip && ((ip >= addr && ip <= end) || overlaps(slot.func.load())))
+            slot.ip.store(0);
+    }
+
+    for (auto it = unwind_func_infos.begin(); it != unwind_func_infos.end();) {
+        if (overlaps(it->second)) {
+            delete it->second;
+            it = unwind_func_infos.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
 } // namespace pyston
 
 
@@ -14,6 +14,8 @@
 
 #include "runtime/dict.h"
 
+#include <cstring>
+
 #include "capi/types.h"
 #include "core/ast.h"
 #include "core/common.h"
@@ -27,6 +29,164 @@
 
 namespace pyston {
 
+int64_t DictMap::findIndexSlot(size_t hash, int32_t ix) {
+    size_t perturb = hash;
+    size_t i = hash & mask;
+    while (indices[i] != ix) {
+        if (ix != IX_EMPTY && indices[i] == IX_EMPTY)
+            return -1;
+        perturb >>= 5;
+        i = (i * 5 + perturb + 1) & mask;
+    }
+    return i;
+}
+
+void DictMap::resize(size_t minslots) {
+    size_t newsize = MIN_SIZE;
+    while (newsize < minslots)
+        newsize <<= 1;
+    RELEASE_ASSERT(newsize <= (1UL << 31), "dict too large");
+
+    size_t newusable = newsize * 2 / 3;
+    size_t bytes = newsize * sizeof(int32_t) + newusable * sizeof(Entry);
+    int32_t* new_indices = (int32_t*)gc_alloc(bytes, gc::GCKind::UNTRACKED);
+    Entry* new_entries = (Entry*)(new_indices + newsize);
+    memset(new_indices, 0xff, newsize * sizeof(int32_t));
+    static_assert(IX_EMPTY == -1, "the memset relies on this");
+
+    int32_t* old_indices = indices;
+    Entry* old_entries = entries;
+    uint32_t old_nentries = nentries;
+
+    // Compact the live entries, and rebuild the index table from the cached hashes.
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < old_nentries; i++) {
+        if (old_entries[i].first == NULL)
+            continue;
+        new_entries[j] = old_entries[i];
+
+        size_t hash = new_entries[j].hash;
+        size_t perturb = hash;
+        size_t slot = hash & (newsize - 1);
+        while (new_indices[slot] != IX_EMPTY) {
+            perturb >>= 5;
+            slot = (slot * 5 + perturb + 1) & (newsize - 1);
+        }
+        new_indices[slot] = j;
+        j++;
+    }
+    assert(j == nused);
+
+    indices = new_indices;
+    entries = new_entries;
+    mask = newsize - 1;
+    nentries = nfill = j;
+
+    if (old_indices)
+        gc::gc_free(old_indices);
+}
+
+uint32_t DictMap::insertNew(Box* key, Box* value, size_t hash) {
+    if (nfill >= usable())
+        resize(nused * 3);
+
+    int64_t slot = findIndexSlot(hash, IX_EMPTY);
+    uint32_t ix = nentries++;
+    indices[slot] = ix;
+    entries[ix].first = key;
+    entries[ix].second = value;
+    entries[ix].hash = hash;
+    nused++;
+    nfill++;
+    return ix;
+}
+
+void DictMap::eraseAt(uint32_t ix) {
+    assert(ix < nentries && entries[ix].first);
+
+    int64_t slot = findIndexSlot(entries[ix].hash, ix);
+    assert(slot >= 0);
+    indices[slot] = IX_DUMMY;
+    entries[ix].first = NULL;
+    entries[ix].second = NULL;
+    nused--;
+
+    // Drop trailing deleted entries so that repeatedly popping the last item stays cheap.
+    // The index slots stay DUMMY, so nfill is unchanged.
+    while (nentries > 0 && entries[nentries - 1].first == NULL)
+        nentries--;
+}
+
+DictMap::Entry DictMap::popLast() {
+    assert(nused > 0);
+    // eraseAt() keeps the last entry live.
+    Entry rtn = entries[nentries - 1];
+    eraseAt(nentries - 1);
+    return rtn;
+}
+
+void DictMap::update(DictMap& other) {
+    if (&other == this || other.nused == 0)
+        return;
+
+    if (nused == 0 && nfill == 0 && other.nused == other.nentries) {
+        // Fast path for copies: nothing to compare against, so copy the table wholesale.
+        size_t newsize = other.mask + 1;
+        size_t newusable = newsize * 2 / 3;
+        size_t bytes = newsize * sizeof(int32_t) + newusable * sizeof(Entry);
+        int32_t* new_indices = (int32_t*)gc_alloc(bytes, gc::GCKind::UNTRACKED);
+        memcpy(new_indices, other.indices, newsize * sizeof(int32_t) + other.nentries * sizeof(Entry));
+
+        if (indices)
+            gc::gc_free(indices);
+        indices = new_indices;
+        entries = (Entry*)(new_indices + newsize);
+        mask = other.mask;
+        nentries = other.nentries;
+        nused = other.nused;
+        nfill = other.nfill;
+        return;
+    }
+
+    if (nfill + other.nused >= usable())
+        resize((nused + other.nused) * 3 / 2);
+
+    // Iterate by index, since comparisons could run arbitrary code that mutates other.
+    for (uint32_t i = 0; i < other.nentries; i++) {
+        Entry e = other.entries[i];
+        if (e.first == NULL)
+            continue;
+
+        int64_t ix = lookup(e.first, e.hash);
+        if (ix >= 0)
+            entries[ix].second = e.second;
+        else
+            insertNew(e.first, e.second, e.hash);
+    }
+}
+
+void DictMap::clear() {
+    if (indices)
+        gc::gc_free(indices);
+    indices = NULL;
+    entries = NULL;
+    mask = nentries = nused = nfill = 0;
+}
+
+void DictMap::gcVisit(GCVisitor* v) {
+    if (!indices)
+        return;
+
+    v->visit(indices);
+    for (uint32_t i = 0; i < nentries; i++) {
+        Entry& e = entries[i];
+        if (e.first) {
+            v->visit(e.first);
+            v->visitIf(e.second);
+        }
+    }
+}
+
 Box* dictRepr(BoxedDict* self) {
     std::vector<char> chars;
     chars.push_back('{');
@@ -62,7 +222,7 @@ Box* dictCopy(BoxedDict* self) {
         raiseExcHelper(TypeError, "descriptor 'copy' requires a 'dict' object but received a '%s'", getTypeName(self));
 
     BoxedDict* r = new BoxedDict();
-    r->d.insert(self->d.begin(), self->d.end());
+    r->d.update(self->d);
     return r;
 }
 
@@ -269,39 +429,14 @@ extern "C" int PyDict_Next(PyObject* op, Py_ssize_t* ppos, PyObject** pkey, PyOb
     assert(isSubclass(op->cls, dict_cls));
     BoxedDict* self = static_cast<BoxedDict*>(op);
 
-    // Callers of PyDict_New() provide a pointer to some storage for this function to use, in
-    // the form of a Py_ssize_t* -- ie they allocate a Py_ssize_t on their stack, and let us use
-    // it.
-    //
-    // We want to store an unordered_map::iterator in that.  In my glibc it would fit, but to keep
-    // things a little bit more portable, allocate separate storage for the iterator, and store the
-    // pointer to this storage in the Py_ssize_t slot.
-    //
-    // Results in lots of indirection unfortunately.  If it becomes an issue we can try to switch
-    // to storing the iterator directly in the stack slot.
-
-    typedef BoxedDict::DictMap::iterator iterator;
-
-    static_assert(sizeof(Py_ssize_t) == sizeof(iterator*), "");
-    iterator** it_ptr = reinterpret_cast<iterator**>(ppos);
-
-    // Clients are supposed to zero-initialize *ppos:
-    if (*it_ptr == NULL) {
-        *it_ptr = (iterator*)malloc(sizeof(iterator));
-        **it_ptr = self->d.begin();
-    }
-
-    iterator* it = *it_ptr;
-
-    if (*it == self->d.end()) {
-        free(it);
+    // Like in CPython, *ppos is a position in the entries array (clients zero-initialize it):
+    auto it = self->d.iteratorAt(*ppos);
+    if (it == self->d.end())
         return 0;
-    }
 
-    *pkey = (*it)->first;
-    *pvalue = (*it)->second;
-
-    ++(*it);
+    *pkey = it->first;
+    *pvalue = it->second;
+    *ppos = it.index() + 1;
 
     return 1;
 }
@@ -320,16 +455,7 @@ extern "C" PyObject* PyDict_GetItemString(PyObject* dict, const char* key) noexc
 }
 
 Box* dictSetitem(BoxedDict* self, Box* k, Box* v) {
-    // printf("Starting setitem\n");
-    Box*& pos = self->d[k];
-    // printf("Got the pos\n");
-
-    if (pos != NULL) {
-        pos = v;
-    } else {
-        pos = v;
-    }
-
+    self->d[k] = v;
     return None;
 }
 
@@ -392,16 +518,12 @@ Box* dictPopitem(BoxedDict* self) {
         raiseExcHelper(TypeError, "descriptor 'popitem' requires a 'dict' object but received a '%s'",
                        getTypeName(self));
 
-    auto it = self->d.begin();
-    if (it == self->d.end()) {
+    if (self->d.empty()) {
         raiseExcHelper(KeyError, "popitem(): dictionary is empty");
     }
 
-    Box* key = it->first;
-    Box* value = it->second;
-    self->d.erase(it);
-
-    auto rtn = BoxedTuple::create({ key, value });
+    auto e = self->d.popLast();
+    auto rtn = BoxedTuple::create({ e.first, e.second });
     return rtn;
 }
 
@@ -421,12 +543,10 @@ Box* dictSetdefault(BoxedDict* self, Box* k, Box* v) {
         raiseExcHelper(TypeError, "descriptor 'setdefault' requires a 'dict' object but received a '%s'",
                        getTypeName(self));
 
-    auto it = self->d.find(k);
-    if (it != self->d.end())
-        return it->second;
-
-    self->d.insert(it, std::make_pair(k, v));
-    return v;
+    Box*& slot = self->d[k];
+    if (!slot)
+        slot = v;
+    return slot;
 }
 
 Box* dictContains(BoxedDict* self, Box* k) {
@@ -519,8 +639,7 @@ extern "C" Box* dictNew(Box* _cls, BoxedTuple* args, BoxedDict* kwargs) {
 
 void dictMerge(BoxedDict* self, Box* other) {
     if (isSubclass(other->cls, dict_cls)) {
-        for (const auto& p : static_cast<BoxedDict*>(other)->d)
-            self->d[p.first] = p.second;
+        self->d.update(static_cast<BoxedDict*>(other)->d);
         return;
     }
 
@@ -615,8 +734,7 @@ extern "C" Box* dictInit(BoxedDict* self, BoxedTuple* args, BoxedDict* kwargs) {
     // handle keyword arguments by merging (possibly over positional entries per CPy)
     assert(kwargs->cls == dict_cls);
 
-    for (const auto& p : kwargs->d)
-        self->d[p.first] = p.second;
+    self->d.update(kwargs->d);
 
     return None;
 }
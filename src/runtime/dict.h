@@ -29,8 +29,8 @@ public:
     enum IteratorType { KeyIterator, ValueIterator, ItemIterator };
 
     BoxedDict* d;
-    BoxedDict::DictMap::iterator it;
-    const BoxedDict::DictMap::iterator itEnd;
+    DictMap::iterator it;
+    const DictMap::iterator itEnd;
     const IteratorType type;
 
     BoxedDictIterator(BoxedDict* d, IteratorType type);
@@ -20,10 +20,11 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstring>
-#include <deque>
 #include <sys/mman.h>
 #include <ucontext.h>
+#include <vector>
 
+#include "codegen/ast_interpreter.h"
 #include "core/ast.h"
 #include "core/common.h"
 #include "core/stats.h"
@@ -36,18 +37,45 @@
 
 namespace pyston {
 
-static uint64_t next_stack_addr = 0x4270000000L;
-static std::deque<uint64_t> available_addrs;
-
 // There should be a better way of getting this:
 #define PAGE_SIZE 4096
 
 #define INITIAL_STACK_SIZE (8 * PAGE_SIZE)
 #define STACK_REDZONE_SIZE PAGE_SIZE
 #define MAX_STACK_SIZE (4 * 1024 * 1024)
+// How many generator stacks we reserve address space for at a time:
+#define STACKS_PER_SLAB 16
+
+// Generator stacks get carved out of slabs of reserved address space, and never get unmapped: a freed stack goes
+// onto a free list, and once there are more than MAX_CACHED_GENERATOR_STACKS of those, we tell the OS it can have
+// the pages back (the address range stays ours, and gets zero-filled memory if we touch it again).
+// Everything here is protected by free_stacks_lock, which never gets held across anything that can allocate.
+static DS_DEFINE_MUTEX(free_stacks_lock);
+static uint64_t next_slab_addr = 0x4270000000L;
+static uint64_t slab_next = 0, slab_end = 0;
+// The stack_begin of each free stack, most recently freed last.  The first num_trimmed_stacks of them have
+// already had their memory released.
+static std::vector<uint64_t> free_stacks;
+static int num_trimmed_stacks = 0;
+
+static void trimGeneratorStack(uint64_t stack_high) {
+    static StatCounter generator_stack_trimmed("generator_stack_trimmed");
+    generator_stack_trimmed.log();
+
+    void* addr = (void*)(stack_high - MAX_STACK_SIZE + STACK_REDZONE_SIZE);
+    size_t size = MAX_STACK_SIZE - STACK_REDZONE_SIZE;
+#ifdef MADV_FREE
+    // MADV_FREE lets the kernel take the pages lazily, which is cheaper if we end up reusing the stack soon,
+    // but older kernels don't support it:
+    if (madvise(addr, size, MADV_FREE) == 0)
+        return;
+#endif
+    int r = madvise(addr, size, MADV_DONTNEED);
+    assert(r == 0);
+}
 
 static std::unordered_map<void*, BoxedGenerator*> s_generator_map;
-static_assert(THREADING_USE_GIL, "have to make the generator map thread safe!");
+static DS_DEFINE_MUTEX(s_generator_map_lock);
 
 class RegisterHelper {
 private:
@@ -55,9 +83,11 @@ private:
 
 public:
     RegisterHelper(BoxedGenerator* generator, void* frame_addr) : frame_addr(frame_addr) {
+        LOCK_REGION(&s_generator_map_lock);
         s_generator_map[frame_addr] = generator;
     }
     ~RegisterHelper() {
+        LOCK_REGION(&s_generator_map_lock);
         assert(s_generator_map.count(frame_addr));
         s_generator_map.erase(frame_addr);
     }
@@ -67,20 +97,24 @@ static void freeGeneratorStack(BoxedGenerator* g) {
     if (g->stack_begin == NULL)
         return;
 
-    available_addrs.push_back((uint64_t)g->stack_begin);
-    // Limit the number of generator stacks we keep around:
-    if (available_addrs.size() > 5) {
-        uint64_t addr = available_addrs.front();
-        available_addrs.pop_front();
-        int r = munmap((void*)(addr - MAX_STACK_SIZE), MAX_STACK_SIZE);
-        assert(r == 0);
+    LOCK_REGION(&free_stacks_lock);
+    free_stacks.push_back((uint64_t)g->stack_begin);
+    // Limit the number of free stacks that hold on to their memory; the ones that have been free the longest
+    // are the first to go:
+    while (free_stacks.size() - num_trimmed_stacks > std::max(MAX_CACHED_GENERATOR_STACKS, 0)) {
+        trimGeneratorStack(free_stacks[num_trimmed_stacks]);
+        num_trimmed_stacks++;
     }
 
     g->stack_begin = NULL;
 }
 
 Context* getReturnContextForGeneratorFrame(void* frame_addr) {
-    BoxedGenerator* generator = s_generator_map[frame_addr];
+    BoxedGenerator* generator;
+    {
+        LOCK_REGION(&s_generator_map_lock);
+        generator = s_generator_map[frame_addr];
+    }
     assert(generator);
     return generator->returnContext;
 }
@@ -94,12 +128,19 @@ void generatorEntry(BoxedGenerator* g) {
         try {
             RegisterHelper context_registerer(g, __builtin_frame_address(0));
 
-            // call body of the generator
-            BoxedFunctionBase* func = g->function;
-
-            Box** args = g->args ? &g->args->elts[0] : nullptr;
-            callCLFunc(func->f, nullptr, func->f->numReceivedArgs(), func->closure, g, func->globals, g->arg1, g->arg2,
-                       g->arg3, args);
+            if (g->stackless_frame) {
+                // A stackless generator that got moved onto this stack: continue where it left off.
+                Box* frame = g->stackless_frame;
+                g->stackless_frame = NULL;
+                astResumeGeneratorOnStack(frame, g->returnValue);
+            } else {
+                // call body of the generator
+                BoxedFunctionBase* func = g->function;
+
+                Box** args = g->args ? &g->args->elts[0] : nullptr;
+                callCLFunc(func->f, nullptr, func->f->numReceivedArgs(), func->closure, g, func->globals, g->arg1,
+                           g->arg2, g->arg3, args);
+            }
         } catch (ExcInfo e) {
             // unhandled exception: propagate the exception to the caller
             g->exception = e;
@@ -116,6 +157,30 @@ Box* generatorIter(Box* s) {
     return s;
 }
 
+static void initGeneratorStack(BoxedGenerator* self);
+
+static void resumeStacklessGenerator(BoxedGenerator* self) {
+    // A stackless generator never yields inside of a try block, so an exception that gets thrown into it
+    // just propagates back out:
+    if (self->exception.type) {
+        self->stackless_frame = NULL;
+        self->entryExited = true;
+        return;
+    }
+
+    try {
+        bool yielded = astResumeStacklessGenerator(self->stackless_frame, self->returnValue);
+        if (!yielded) {
+            self->stackless_frame = NULL;
+            self->entryExited = true;
+        }
+    } catch (ExcInfo e) {
+        self->stackless_frame = NULL;
+        self->exception = e;
+        self->entryExited = true;
+    }
+}
+
 // called from both generatorHasNext and generatorSend/generatorNext (but only if generatorHasNext hasn't been called)
 static void generatorSendInternal(BoxedGenerator* self, Box* v) {
     STAT_TIMER(t0, "us_timer_generator_switching", 0);
@@ -132,22 +197,37 @@ static void generatorSendInternal(BoxedGenerator* self, Box* v) {
     self->returnValue = v;
     self->running = true;
 
+    // Stackless generators don't have a context to switch to:
+    bool stackless = self->context == NULL;
+    if (stackless && !self->exception.type && astStacklessGeneratorIsHot(self->stackless_frame)) {
+        // This generator is going to stick around for a while; give it a stack, so that its frame can get jitted.
+        // generatorEntry() will pick up the frame from there.
+        static StatCounter generator_moved_to_stack("generator_moved_to_stack");
+        generator_moved_to_stack.log();
+        initGeneratorStack(self);
+        stackless = false;
+    }
+
+    if (stackless) {
+        resumeStacklessGenerator(self);
+    } else {
 #if STAT_TIMERS
-    if (!self->prev_stack)
-        self->prev_stack = StatTimer::createStack(self->my_timer);
-    else
-        self->prev_stack = StatTimer::swapStack(self->prev_stack);
+        if (!self->prev_stack)
+            self->prev_stack = StatTimer::createStack(self->my_timer);
+        else
+            self->prev_stack = StatTimer::swapStack(self->prev_stack);
 #endif
 
-    swapContext(&self->returnContext, self->context, (intptr_t)self);
+        swapContext(&self->returnContext, self->context, (intptr_t)self);
 
 #if STAT_TIMERS
-    self->prev_stack = StatTimer::swapStack(self->prev_stack);
-    if (self->entryExited) {
-        assert(self->prev_stack == &self->my_timer);
-        assert(self->my_timer.isPaused());
-    }
+        self->prev_stack = StatTimer::swapStack(self->prev_stack);
+        if (self->entryExited) {
+            assert(self->prev_stack == &self->my_timer);
+            assert(self->my_timer.isPaused());
+        }
 #endif
+    }
 
     self->running = false;
 
@@ -285,13 +365,89 @@ extern "C" Box* yield(BoxedGenerator* obj, Box* value) {
 extern "C" BoxedGenerator* createGenerator(BoxedFunctionBase* function, Box* arg1, Box* arg2, Box* arg3, Box** args) {
     assert(function);
     assert(function->cls == function_cls);
-    return new BoxedGenerator(function, arg1, arg2, arg3, args);
+    // This can throw, so check it before we start constructing the generator:
+    bool stackless = canRunGeneratorStackless(function->f);
+    return new BoxedGenerator(function, arg1, arg2, arg3, args, stackless);
+}
+
+static void initGeneratorStack(BoxedGenerator* self) {
+    assert(!self->context);
+
+    static StatCounter generator_stack_reused("generator_stack_reused");
+    static StatCounter generator_stack_created("generator_stack_created");
+
+#if !STACK_GROWS_DOWN
+#error "implement me"
+#endif
+
+    bool created = false;
+    {
+        LOCK_REGION(&free_stacks_lock);
+        if (free_stacks.empty()) {
+            created = true;
+
+            if (slab_next == slab_end) {
+                // Reserve the address space for a whole slab of stacks with a single mapping.  The kernel only gives
+                // us pages as the stacks touch them, so this doesn't use any memory up front.
+                uint64_t slab_size = (uint64_t)STACKS_PER_SLAB * MAX_STACK_SIZE;
+                void* p = mmap((void*)next_slab_addr, slab_size, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+                ASSERT(p == (void*)next_slab_addr, "%p %s", p, strerror(errno));
+
+                slab_next = next_slab_addr;
+                slab_end = next_slab_addr + slab_size;
+                next_slab_addr = slab_end;
+
+                if (VERBOSITY() >= 1)
+                    printf("Reserved generator stacks from %p-%p\n", (void*)slab_next, (void*)slab_end);
+            }
+
+            uint64_t stack_low = slab_next;
+            uint64_t stack_high = stack_low + MAX_STACK_SIZE;
+            slab_next = stack_high;
+
+            // Make the bottom of the stack an inaccessible redzone so that the generator stack won't run into the
+            // next one; going past it will segfault, same as overflowing the main stack.
+            int r = mprotect((void*)stack_low, STACK_REDZONE_SIZE, PROT_NONE);
+            ASSERT(r == 0, "%s", strerror(errno));
+
+            self->stack_begin = (void*)stack_high;
+
+            if (VERBOSITY() >= 1)
+                printf("Created new generator stack from %p-%p\n", (void*)stack_low, (void*)stack_high);
+        } else {
+            // Take the most recently freed stack, since it's the most likely to still be in the cache:
+            self->stack_begin = (void*)free_stacks.back();
+            free_stacks.pop_back();
+            num_trimmed_stacks = std::min(num_trimmed_stacks, (int)free_stacks.size());
+        }
+    }
+
+    if (created) {
+        generator_stack_created.log();
+
+        // we're registering memory that isn't in the gc heap here,
+        // which may sound wrong.  Generators, however, can represent
+        // a larger tax on system resources than just their GC
+        // allocation, so we try to encode that here as additional gc
+        // heap pressure.
+        // This can trigger a collection, so it has to happen outside of free_stacks_lock.
+        gc::registerGCManagedBytes(INITIAL_STACK_SIZE);
+    } else {
+        generator_stack_reused.log();
+    }
+
+    assert(((intptr_t)self->stack_begin & (~(intptr_t)(0xF))) == (intptr_t)self->stack_begin
+           && "stack must be aligned");
+
+    self->context = makeContext(self->stack_begin, (void (*)(intptr_t))generatorEntry);
 }
 
 #if STAT_TIMERS
 static uint64_t* generator_timer_counter = Stats::getStatCounter("us_timer_generator_toplevel");
 #endif
-extern "C" BoxedGenerator::BoxedGenerator(BoxedFunctionBase* function, Box* arg1, Box* arg2, Box* arg3, Box** args)
+extern "C" BoxedGenerator::BoxedGenerator(BoxedFunctionBase* function, Box* arg1, Box* arg2, Box* arg3, Box** args,
+                                          bool stackless)
     : function(function),
       arg1(arg1),
       arg2(arg2),
@@ -302,7 +458,9 @@ extern "C" BoxedGenerator::BoxedGenerator(BoxedFunctionBase* function, Box* arg1
       returnValue(nullptr),
       exception(nullptr, nullptr, nullptr),
       context(nullptr),
-      returnContext(nullptr)
+      returnContext(nullptr),
+      stack_begin(nullptr),
+      stackless_frame(nullptr)
 #if STAT_TIMERS
       ,
       prev_stack(NULL),
@@ -317,65 +475,13 @@ extern "C" BoxedGenerator::BoxedGenerator(BoxedFunctionBase* function, Box* arg1
         memcpy(&this->args->elts[0], args, numArgs * sizeof(Box*));
     }
 
-    static StatCounter generator_stack_reused("generator_stack_reused");
-    static StatCounter generator_stack_created("generator_stack_created");
-
-    void* initial_stack_limit;
-    if (available_addrs.size() == 0) {
-        generator_stack_created.log();
-
-        uint64_t stack_low = next_stack_addr;
-        uint64_t stack_high = stack_low + MAX_STACK_SIZE;
-        next_stack_addr = stack_high;
-
-#if STACK_GROWS_DOWN
-        this->stack_begin = (void*)stack_high;
-
-        initial_stack_limit = (void*)(stack_high - INITIAL_STACK_SIZE);
-        void* p = mmap(initial_stack_limit, INITIAL_STACK_SIZE, PROT_READ | PROT_WRITE,
-                       MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS | MAP_GROWSDOWN, -1, 0);
-        ASSERT(p == initial_stack_limit, "%p %s", p, strerror(errno));
-
-        // Create an inaccessible redzone so that the generator stack won't grow indefinitely.
-        // Looks like it throws a SIGBUS if we reach the redzone; it's unclear if that's better
-        // or worse than being able to consume all available memory.
-        void* p2
-            = mmap((void*)stack_low, STACK_REDZONE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS, -1, 0);
-        assert(p2 == (void*)stack_low);
-        // Interestingly, it seems like MAP_GROWSDOWN will leave a page-size gap between the redzone and the growable
-        // region.
-
-        if (VERBOSITY() >= 1) {
-            printf("Created new generator stack, starts at %p, currently extends to %p\n", (void*)stack_high,
-                   initial_stack_limit);
-            printf("Created a redzone from %p-%p\n", (void*)stack_low, (void*)(stack_low + STACK_REDZONE_SIZE));
-        }
-#else
-#error "implement me"
-#endif
-
-        // we're registering memory that isn't in the gc heap here,
-        // which may sound wrong.  Generators, however, can represent
-        // a larger tax on system resources than just their GC
-        // allocation, so we try to encode that here as additional gc
-        // heap pressure.
-        gc::registerGCManagedBytes(INITIAL_STACK_SIZE);
+    if (stackless) {
+        static StatCounter generator_stackless_created("generator_stackless_created");
+        generator_stackless_created.log();
+        stackless_frame = astCreateStacklessGeneratorFrame(this);
     } else {
-        generator_stack_reused.log();
-
-#if STACK_GROWS_DOWN
-        uint64_t stack_high = available_addrs.back();
-        this->stack_begin = (void*)stack_high;
-        initial_stack_limit = (void*)(stack_high - INITIAL_STACK_SIZE);
-        available_addrs.pop_back();
-#else
-#error "implement me"
-#endif
+        initGeneratorStack(this);
     }
-
-    assert(((intptr_t)stack_begin & (~(intptr_t)(0xF))) == (intptr_t)stack_begin && "stack must be aligned");
-
-    context = makeContext(stack_begin, (void (*)(intptr_t))generatorEntry);
 }
 
 extern "C" void generatorGCHandler(GCVisitor* v, Box* b) {
@@ -398,6 +504,8 @@ extern "C" void generatorGCHandler(GCVisitor* v, Box* b) {
                                reinterpret_cast<void* const*>(&g->args->elts[num_args - 3]));
     if (g->returnValue)
         v->visit(g->returnValue);
+    if (g->stackless_frame)
+        v->visit(g->stackless_frame);
     if (g->exception.type)
         v->visit(g->exception.type);
     if (g->exception.value)
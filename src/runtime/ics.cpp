@@ -23,6 +23,7 @@
 #include "codegen/compvars.h"
 #include "codegen/memmgr.h"
 #include "codegen/patchpoints.h"
+#include "codegen/profiling/perf_map.h"
 #include "codegen/stackmaps.h"
 #include "codegen/unwinding.h" // registerDynamicEhFrame
 #include "core/common.h"
@@ -177,6 +178,8 @@ static void writeTrivialEhFrame(void* eh_frame_addr, void* func_addr, uint64_t f
 
 void EHFrameManager::writeAndRegister(void* func_addr, uint64_t func_size) {
     assert(eh_frame_addr == NULL);
+    this->func_addr = func_addr;
+    this->func_size = func_size;
     const int size = omit_frame_pointer ? _eh_frame_template_ofp_size : _eh_frame_template_fp_size;
 #ifdef NVALGRIND
     eh_frame_addr = malloc(size);
@@ -196,6 +199,7 @@ EHFrameManager::~EHFrameManager() {
     if (eh_frame_addr) {
         const int size = omit_frame_pointer ? _eh_frame_template_ofp_size : _eh_frame_template_fp_size;
         deregisterEHFrames((uint8_t*)eh_frame_addr, (uint64_t)eh_frame_addr, size);
+        invalidateUnwindInfoCache((uint64_t)func_addr, func_size);
 #ifdef NVALGRIND
         free(eh_frame_addr);
 #else
@@ -212,120 +216,136 @@ EHFrameManager::~EHFrameManager() {
 #define SCRATCH_BYTES 0x30
 #endif
 
-RuntimeIC::RuntimeIC(void* func_addr, int num_slots, int slot_size) : eh_frame(RUNTIMEICS_OMIT_FRAME_PTR) {
+RuntimeIC::RuntimeIC(void* func_addr, int num_slots, int slot_size) : func_addr(func_addr) {
     static StatCounter sc("runtime_ics_num");
     sc.log();
 
     if (ENABLE_RUNTIME_ICS) {
-        assert(SCRATCH_BYTES >= 0);
-        assert(SCRATCH_BYTES < 0x80); // This would break both the instruction encoding and the dwarf encoding
-        assert(SCRATCH_BYTES % 8 == 0);
+        generate(num_slots, slot_size);
+    } else {
+        addr = func_addr;
+    }
+}
+
+void RuntimeIC::generate(int num_slots, int slot_size) {
+    versions.emplace_back(new Code(this, func_addr, num_slots, slot_size));
+    addr = versions.back()->addr;
+}
+
+RuntimeIC::Code::Code(RuntimeIC* runtime_ic, void* func_addr, int num_slots, int slot_size)
+    : eh_frame(RUNTIMEICS_OMIT_FRAME_PTR) {
+    assert(SCRATCH_BYTES >= 0);
+    assert(SCRATCH_BYTES < 0x80); // This would break both the instruction encoding and the dwarf encoding
+    assert(SCRATCH_BYTES % 8 == 0);
 
 #if RUNTIMEICS_OMIT_FRAME_PTR
-        /*
-         * prologue:
-         * sub $0x28, %rsp  # 48 83 ec 28
-         *
-         * epilogue:
-         * add $0x28, %rsp  # 48 83 c4 28
-         * retq             # c3
-         *
-         */
-        static const int PROLOGUE_SIZE = 4;
-        static const int EPILOGUE_SIZE = 5;
-        assert(SCRATCH_BYTES % 16 == 8);
+    /*
+     * prologue:
+     * sub $0x28, %rsp  # 48 83 ec 28
+     *
+     * epilogue:
+     * add $0x28, %rsp  # 48 83 c4 28
+     * retq             # c3
+     *
+     */
+    static const int PROLOGUE_SIZE = 4;
+    static const int EPILOGUE_SIZE = 5;
+    assert(SCRATCH_BYTES % 16 == 8);
 #else
-        /*
-         * The prologue looks like:
-         * push %rbp        # 55
-         * mov %rsp, %rbp   # 48 89 e5
-         * sub $0x30, %rsp  # 48 83 ec 30
-         *
-         * The epilogue is:
-         * add $0x30, %rsp  # 48 83 c4 30
-         * pop %rbp         # 5d
-         * retq             # c3
-         */
-        static const int PROLOGUE_SIZE = 8;
-        static const int EPILOGUE_SIZE = 6;
-        assert(SCRATCH_BYTES % 16 == 0);
+    /*
+     * The prologue looks like:
+     * push %rbp        # 55
+     * mov %rsp, %rbp   # 48 89 e5
+     * sub $0x30, %rsp  # 48 83 ec 30
+     *
+     * The epilogue is:
+     * add $0x30, %rsp  # 48 83 c4 30
+     * pop %rbp         # 5d
+     * retq             # c3
+     */
+    static const int PROLOGUE_SIZE = 8;
+    static const int EPILOGUE_SIZE = 6;
+    assert(SCRATCH_BYTES % 16 == 0);
 #endif
-        static const int CALL_SIZE = 13;
+    static const int CALL_SIZE = 13;
 
-        int patchable_size = num_slots * slot_size;
+    int patchable_size = num_slots * slot_size;
 
 #ifdef NVALGRIND
-        int total_size = PROLOGUE_SIZE + patchable_size + CALL_SIZE + EPILOGUE_SIZE;
-        addr = malloc(total_size);
+    int total_size = PROLOGUE_SIZE + patchable_size + CALL_SIZE + EPILOGUE_SIZE;
+    addr = malloc(total_size);
 #else
-        total_size = PROLOGUE_SIZE + patchable_size + CALL_SIZE + EPILOGUE_SIZE;
-        addr = mmap(NULL, (total_size + (PAGE_SIZE - 1)) & ~(PAGE_SIZE - 1), PROT_READ | PROT_WRITE | PROT_EXEC,
-                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-        RELEASE_ASSERT(addr != MAP_FAILED, "");
+    total_size = PROLOGUE_SIZE + patchable_size + CALL_SIZE + EPILOGUE_SIZE;
+    addr = mmap(NULL, (total_size + (PAGE_SIZE - 1)) & ~(PAGE_SIZE - 1), PROT_READ | PROT_WRITE | PROT_EXEC,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    RELEASE_ASSERT(addr != MAP_FAILED, "");
 #endif
 
-        // printf("Allocated runtime IC at %p\n", addr);
+    // printf("Allocated runtime IC at %p\n", addr);
 
-        std::unique_ptr<ICSetupInfo> setup_info(
-            ICSetupInfo::initialize(true, num_slots, slot_size, ICSetupInfo::Generic, NULL));
-        uint8_t* pp_start = (uint8_t*)addr + PROLOGUE_SIZE;
-        uint8_t* pp_end = pp_start + patchable_size + CALL_SIZE;
+    std::unique_ptr<ICSetupInfo> setup_info(
+        ICSetupInfo::initialize(true, num_slots, slot_size, ICSetupInfo::Generic, NULL));
+    uint8_t* pp_start = (uint8_t*)addr + PROLOGUE_SIZE;
+    uint8_t* pp_end = pp_start + patchable_size + CALL_SIZE;
 
 
-        SpillMap _spill_map;
-        PatchpointInitializationInfo initialization_info
-            = initializePatchpoint3(func_addr, pp_start, pp_end, 0 /* scratch_offset */, 0 /* scratch_size */,
-                                    std::unordered_set<int>(), _spill_map);
-        assert(_spill_map.size() == 0);
-        assert(initialization_info.slowpath_start == pp_start + patchable_size);
-        assert(initialization_info.slowpath_rtn_addr == pp_end);
-        assert(initialization_info.continue_addr == pp_end);
+    SpillMap _spill_map;
+    PatchpointInitializationInfo initialization_info
+        = initializePatchpoint3(func_addr, pp_start, pp_end, 0 /* scratch_offset */, 0 /* scratch_size */,
+                                std::unordered_set<int>(), _spill_map);
+    assert(_spill_map.size() == 0);
+    assert(initialization_info.slowpath_start == pp_start + patchable_size);
+    assert(initialization_info.slowpath_rtn_addr == pp_end);
+    assert(initialization_info.continue_addr == pp_end);
 
-        StackInfo stack_info(SCRATCH_BYTES, 0);
-        icinfo = registerCompiledPatchpoint(pp_start, pp_start + patchable_size, pp_end, pp_end, setup_info.get(),
-                                            stack_info, std::unordered_set<int>());
+    StackInfo stack_info(SCRATCH_BYTES, 0);
+    icinfo = registerCompiledPatchpoint(pp_start, pp_start + patchable_size, pp_end, pp_end, setup_info.get(),
+                                        stack_info, std::unordered_set<int>());
+    // Unlike patchpoints in compiled code, we're free to regenerate ourselves with more room:
+    icinfo->setGrowHook([runtime_ic](int num_slots, int slot_size) { runtime_ic->generate(num_slots, slot_size); });
 
-        assembler::Assembler prologue_assem((uint8_t*)addr, PROLOGUE_SIZE);
+    assembler::Assembler prologue_assem((uint8_t*)addr, PROLOGUE_SIZE);
 #if RUNTIMEICS_OMIT_FRAME_PTR
-        // If SCRATCH_BYTES is 8 or less, we could use more compact instruction encodings
-        // (push instead of sub), but it doesn't seem worth it for now.
-        prologue_assem.sub(assembler::Immediate(SCRATCH_BYTES), assembler::RSP);
+    // If SCRATCH_BYTES is 8 or less, we could use more compact instruction encodings
+    // (push instead of sub), but it doesn't seem worth it for now.
+    prologue_assem.sub(assembler::Immediate(SCRATCH_BYTES), assembler::RSP);
 #else
-        prologue_assem.push(assembler::RBP);
-        prologue_assem.mov(assembler::RSP, assembler::RBP);
-        prologue_assem.sub(assembler::Immediate(SCRATCH_BYTES), assembler::RSP);
+    prologue_assem.push(assembler::RBP);
+    prologue_assem.mov(assembler::RSP, assembler::RBP);
+    prologue_assem.sub(assembler::Immediate(SCRATCH_BYTES), assembler::RSP);
 #endif
-        assert(!prologue_assem.hasFailed());
-        assert(prologue_assem.isExactlyFull());
+    assert(!prologue_assem.hasFailed());
+    assert(prologue_assem.isExactlyFull());
 
-        assembler::Assembler epilogue_assem(pp_end, EPILOGUE_SIZE);
+    assembler::Assembler epilogue_assem(pp_end, EPILOGUE_SIZE);
 #if RUNTIMEICS_OMIT_FRAME_PTR
-        epilogue_assem.add(assembler::Immediate(SCRATCH_BYTES), assembler::RSP);
+    epilogue_assem.add(assembler::Immediate(SCRATCH_BYTES), assembler::RSP);
 #else
-        epilogue_assem.add(assembler::Immediate(SCRATCH_BYTES), assembler::RSP);
-        epilogue_assem.pop(assembler::RBP);
+    epilogue_assem.add(assembler::Immediate(SCRATCH_BYTES), assembler::RSP);
+    epilogue_assem.pop(assembler::RBP);
 #endif
-        epilogue_assem.retq();
-        assert(!epilogue_assem.hasFailed());
-        assert(epilogue_assem.isExactlyFull());
+    epilogue_assem.retq();
+    assert(!epilogue_assem.hasFailed());
+    assert(epilogue_assem.isExactlyFull());
 
-        // TODO: ideally would be more intelligent about allocation strategies.
-        // The code sections should be together and the eh sections together
-        eh_frame.writeAndRegister(addr, total_size);
-    } else {
-        addr = func_addr;
-    }
+    // TODO: ideally would be more intelligent about allocation strategies.
+    // The code sections should be together and the eh sections together
+    eh_frame.writeAndRegister(addr, total_size);
+
+    if (PERF_MAP)
+        registerPerfMapRegion(addr, total_size,
+                              g.func_addr_registry.getFuncNameAtAddress(func_addr, true) + " [runtime ic]");
 }
 
-RuntimeIC::~RuntimeIC() {
-    if (ENABLE_RUNTIME_ICS) {
-        deregisterCompiledPatchpoint(icinfo.get());
+RuntimeIC::Code::~Code() {
+    deregisterCompiledPatchpoint(icinfo.get());
 #ifdef NVALGRIND
-        free(addr);
+    free(addr);
 #else
-        munmap(addr, total_size);
+    munmap(addr, total_size);
 #endif
-    } else {
-    }
+}
+
+RuntimeIC::~RuntimeIC() {
 }
 }
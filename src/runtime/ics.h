@@ -25,23 +25,39 @@ class ICInfo;
 class EHFrameManager {
 private:
     void* eh_frame_addr;
+    void* func_addr;
+    uint64_t func_size;
     bool omit_frame_pointer;
 
 public:
-    EHFrameManager(bool omit_frame_pointer) : eh_frame_addr(NULL), omit_frame_pointer(omit_frame_pointer) {}
+    EHFrameManager(bool omit_frame_pointer)
+        : eh_frame_addr(NULL), func_addr(NULL), func_size(0), omit_frame_pointer(omit_frame_pointer) {}
     ~EHFrameManager();
     void writeAndRegister(void* func_addr, uint64_t func_size);
 };
 
 class RuntimeIC {
 private:
-    void* addr;
+    // One version of the IC's code.  If the IC asks for more space we generate a new version, but we
+    // have to keep the old ones around since there might still be frames inside of them.
+    struct Code {
+        void* addr;
 #ifndef NVALGRIND
-    size_t total_size;
+        size_t total_size;
 #endif
-    EHFrameManager eh_frame;
+        EHFrameManager eh_frame;
 
-    std::unique_ptr<ICInfo> icinfo;
+        std::unique_ptr<ICInfo> icinfo;
+
+        Code(RuntimeIC* runtime_ic, void* func_addr, int num_slots, int slot_size);
+        ~Code();
+    };
+
+    void* addr; // the entry point of the newest version
+    void* const func_addr;
+    std::vector<std::unique_ptr<Code>> versions;
+
+    void generate(int num_slots, int slot_size);
 
     RuntimeIC(const RuntimeIC&) = delete;
     void operator=(const RuntimeIC&) = delete;
@@ -86,7 +102,7 @@ public:
 
 class NonzeroIC : public RuntimeIC {
 public:
-    NonzeroIC() : RuntimeIC((void*)nonzero, 1, 40) {}
+    NonzeroIC() : RuntimeIC((void*)nonzero, 1, 48) {}
 
     bool call(Box* obj) { return call_bool(obj); }
 };
@@ -28,6 +28,7 @@
 #include "gc/roots.h"
 #include "runtime/inline/list.h"
 #include "runtime/objmodel.h"
+#include "runtime/timsort.h"
 #include "runtime/types.h"
 #include "runtime/util.h"
 
@@ -698,67 +699,154 @@ public:
     }
 };
 
-void listSort(BoxedList* self, Box* cmp, Box* key, Box* reverse) {
-    assert(isSubclass(self->cls, list_cls));
+namespace {
+// When there's a keyfunc, we call it once for each element up front, and then sort the elements together with their
+// keys.  Without one, we just sort the elements themselves.
+struct KeyedItem {
+    Box* key;
+    Box* value;
+};
+}
 
-    if (cmp == None)
-        cmp = NULL;
+static Box* sortKey(Box* item) {
+    return item;
+}
+static Box* sortKey(const KeyedItem& item) {
+    return item.key;
+}
+static Box* sortValue(Box* item) {
+    return item;
+}
+static Box* sortValue(const KeyedItem& item) {
+    return item.value;
+}
+static void setSortValue(Box*& item, Box* value) {
+    item = value;
+}
+static void setSortValue(KeyedItem& item, Box* value) {
+    item.key = NULL;
+    item.value = value;
+}
 
-    if (key == None)
-        key = NULL;
+static void computeSortKeys(Box** items, Py_ssize_t n, Box* key) {
+    assert(!key);
+}
+static void computeSortKeys(KeyedItem* items, Py_ssize_t n, Box* key) {
+    for (Py_ssize_t i = 0; i < n; i++)
+        items[i].key = runtimeCall(key, ArgPassSpec(1), items[i].value, NULL, NULL, NULL, NULL);
+}
 
-    RELEASE_ASSERT(!cmp || !key, "Specifying both the 'cmp' and 'key' keywords is currently not supported");
+template <typename T, typename KeyLt> struct SortKeyLt {
+    KeyLt lt;
+    bool operator()(const T& lhs, const T& rhs) { return lt(sortKey(lhs), sortKey(rhs)); }
+};
 
-    // TODO(kmod): maybe we should just switch to CPython's sort.  not sure how the algorithms compare,
-    // but they specifically try to support cases where __lt__ or the cmp function might end up inspecting
-    // the current list being sorted.
-    // I also don't know if std::stable_sort is exception-safe.
+template <typename T, typename KeyLt> static void sortByKey(T* items, Py_ssize_t n, KeyLt lt) {
+    timsort(items, n, SortKeyLt<T, KeyLt>{ lt });
+}
 
+template <typename T> static void sortItems(T* items, Py_ssize_t n, Box* cmp) {
     if (cmp) {
-        std::stable_sort<Box**, PyCmpComparer>(self->elts->elts, self->elts->elts + self->size, PyCmpComparer(cmp));
-    } else {
-        int num_keys_added = 0;
-        auto remove_keys = [&]() {
-            for (int i = 0; i < num_keys_added; i++) {
-                Box** obj_loc = &self->elts->elts[i];
-                assert((*obj_loc)->cls == tuple_cls);
-                *obj_loc = static_cast<BoxedTuple*>(*obj_loc)->elts[2];
-            }
-        };
-
-        try {
-            if (key) {
-                for (int i = 0; i < self->size; i++) {
-                    Box** obj_loc = &self->elts->elts[i];
-
-                    Box* key_val = runtimeCall(key, ArgPassSpec(1), *obj_loc, NULL, NULL, NULL, NULL);
-                    // Add the index as part of the new tuple so that the comparison never hits the
-                    // original object.
-                    // TODO we could potentially make this faster by copying the CPython approach of
-                    // creating special sortwrapper objects that compare only based on the key.
-                    Box* new_obj = BoxedTuple::create({ key_val, boxInt(i), *obj_loc });
-
-                    *obj_loc = new_obj;
-                    num_keys_added++;
-                }
-            }
+        sortByKey(items, n, PyCmpComparer(cmp));
+        return;
+    }
 
-            // We don't need to do a stable sort if there's a keyfunc, since we explicitly added the index
-            // as part of the sort key.
-            // But we might want to get rid of that approach?  CPython doesn't do that (they create special
-            // wrapper objects that compare only based on the key).
-            std::stable_sort<Box**, PyLt>(self->elts->elts, self->elts->elts + self->size, PyLt());
-        } catch (ExcInfo e) {
-            remove_keys();
-            throw e;
+    // If all of the keys are exactly ints, floats, or strs, we can compare them directly instead of going through
+    // the generic comparison machinery:
+    BoxedClass* cls = sortKey(items[0])->cls;
+    for (Py_ssize_t i = 1; i < n; i++) {
+        if (sortKey(items[i])->cls != cls) {
+            cls = NULL;
+            break;
         }
+    }
 
-        remove_keys();
+    if (cls == int_cls) {
+        static StatCounter num_sorts_int("num_list_sorts_int");
+        num_sorts_int.log();
+        sortByKey(items, n, [](Box* lhs, Box* rhs) {
+            return static_cast<BoxedInt*>(lhs)->n < static_cast<BoxedInt*>(rhs)->n;
+        });
+    } else if (cls == float_cls) {
+        static StatCounter num_sorts_float("num_list_sorts_float");
+        num_sorts_float.log();
+        sortByKey(items, n, [](Box* lhs, Box* rhs) {
+            return static_cast<BoxedFloat*>(lhs)->d < static_cast<BoxedFloat*>(rhs)->d;
+        });
+    } else if (cls == str_cls) {
+        static StatCounter num_sorts_str("num_list_sorts_str");
+        num_sorts_str.log();
+        sortByKey(items, n, [](Box* lhs, Box* rhs) {
+            return static_cast<BoxedString*>(lhs)->s() < static_cast<BoxedString*>(rhs)->s();
+        });
+    } else {
+        sortByKey(items, n, PyLt());
     }
+}
+
+template <typename T> static void sortList(BoxedList* self, Box* cmp, Box* key, bool reverse) {
+    Py_ssize_t size = self->size;
+    GCdArray* elts = self->elts;
+    Py_ssize_t capacity = self->capacity;
+
+    // Sort a copy of the elements, which the GC will scan conservatively.  Like CPython, we empty out the list while
+    // we sort it, so that key and comparison functions can't see it half-sorted or change it out from under us.
+    T* items = (T*)gc::gc_alloc(size * sizeof(T), gc::GCKind::CONSERVATIVE);
+    for (Py_ssize_t i = 0; i < size; i++)
+        setSortValue(items[i], elts->elts[i]);
+
+    self->size = 0;
+    self->capacity = 0;
+    self->elts = NULL;
+
+    // Puts the (possibly only partially sorted) elements back, and returns whether the list got modified.
+    auto restore = [&]() {
+        bool modified = self->capacity != 0;
+        self->size = size;
+        self->capacity = capacity;
+        self->elts = elts;
+        for (Py_ssize_t i = 0; i < size; i++)
+            elts->elts[i] = sortValue(items[i]);
+        gc::gc_free(items);
+        return modified;
+    };
 
-    if (nonzero(reverse)) {
-        listReverse(self);
+    try {
+        computeSortKeys(items, size, key);
+
+        // Reverse before and after sorting, so that reverse sorts are stable too:
+        if (reverse)
+            std::reverse(items, items + size);
+        sortItems(items, size, cmp);
+        if (reverse)
+            std::reverse(items, items + size);
+    } catch (ExcInfo e) {
+        restore();
+        throw e;
     }
+
+    if (restore())
+        raiseExcHelper(ValueError, "list modified during sort");
+}
+
+void listSort(BoxedList* self, Box* cmp, Box* key, Box* reverse) {
+    assert(isSubclass(self->cls, list_cls));
+
+    if (cmp == None)
+        cmp = NULL;
+
+    if (key == None)
+        key = NULL;
+
+    bool do_reverse = nonzero(reverse);
+
+    if (self->size == 0)
+        return;
+
+    if (key)
+        sortList<KeyedItem>(self, cmp, key, do_reverse);
+    else
+        sortList<Box*>(self, cmp, key, do_reverse);
 }
 
 Box* listSortFunc(BoxedList* self, Box* cmp, Box* key, Box** _args) {
@@ -125,11 +125,8 @@ size_t PyHasher::operator()(Box* b) const {
 #if EXPENSIVE_STAT_TIMERS
     ScopedStatTimer _st(pyhasher_timer_counter, 10);
 #endif
-    if (b->cls == str_cls) {
-        StringHash<char> H;
-        auto s = static_cast<BoxedString*>(b);
-        return H(s->data(), s->size());
-    }
+    if (b->cls == str_cls)
+        return strHashUnboxed(static_cast<BoxedString*>(b));
 
     return hashUnboxed(b);
 }
@@ -373,6 +370,7 @@ BoxedClass::BoxedClass(BoxedClass* base, gcvisit_func gc_visit, int attrs_offset
     tp_flags |= Py_TPFLAGS_CHECKTYPES;
     tp_flags |= Py_TPFLAGS_BASETYPE;
     tp_flags |= Py_TPFLAGS_HAVE_GC;
+    tp_flags |= Py_TPFLAGS_HAVE_VERSION_TAG;
 
     if (base && (base->tp_flags & Py_TPFLAGS_HAVE_NEWBUFFER))
         tp_flags |= Py_TPFLAGS_HAVE_NEWBUFFER;
@@ -555,12 +553,32 @@ void HiddenClass::addDependence(Rewriter* rewriter) {
     rewriter->addDependenceOn(dependent_getattrs);
 }
 
+// Protects the transitions between hidden classes, which objects on different threads can be taking at once.
+// Allocating can promote the GRWL to write mode, which waits for all the other readers -- one of which could be
+// waiting on this lock -- so we never allocate while holding it.
+static DS_DEFINE_MUTEX(hcls_transitions_lock);
+
 HiddenClass* HiddenClass::getOrMakeChild(BoxedString* attr) {
     STAT_TIMER(t0, "us_timer_hiddenclass_getOrMakeChild", 0);
 
     assert(attr->interned_state != SSTATE_NOT_INTERNED);
     assert(type == NORMAL);
 
+    {
+        LOCK_REGION(&hcls_transitions_lock);
+
+        auto it = children.find(attr);
+        if (it != children.end())
+            return children.getMapped(it->second);
+    }
+
+    HiddenClass* made = new HiddenClass(this);
+    made->attr_offsets[attr] = this->attributeArraySize();
+    assert(made->attributeArraySize() == this->attributeArraySize() + 1);
+
+    LOCK_REGION(&hcls_transitions_lock);
+
+    // Another thread could have made the same transition while we were allocating:
     auto it = children.find(attr);
     if (it != children.end())
         return children.getMapped(it->second);
@@ -568,24 +586,29 @@ HiddenClass* HiddenClass::getOrMakeChild(BoxedString* attr) {
     static StatCounter num_hclses("num_hidden_classes");
     num_hclses.log();
 
-    HiddenClass* rtn = new HiddenClass(this);
-    rtn->attr_offsets[attr] = this->attributeArraySize();
-    this->children[attr] = rtn;
-    assert(rtn->attributeArraySize() == this->attributeArraySize() + 1);
-    return rtn;
+    this->children[attr] = made;
+    return made;
 }
 
 HiddenClass* HiddenClass::getAttrwrapperChild() {
     assert(type == NORMAL);
     assert(attrwrapper_offset == -1);
 
-    if (!attrwrapper_child) {
-        HiddenClass* made = new HiddenClass(this);
-        made->attrwrapper_offset = this->attributeArraySize();
-        this->attrwrapper_child = made;
-        assert(made->attributeArraySize() == this->attributeArraySize() + 1);
+    {
+        LOCK_REGION(&hcls_transitions_lock);
+        if (attrwrapper_child)
+            return attrwrapper_child;
     }
 
+    HiddenClass* made = new HiddenClass(this);
+    made->attrwrapper_offset = this->attributeArraySize();
+    assert(made->attributeArraySize() == this->attributeArraySize() + 1);
+
+    LOCK_REGION(&hcls_transitions_lock);
+
+    if (!attrwrapper_child)
+        this->attrwrapper_child = made;
+
     return attrwrapper_child;
 }
 
@@ -853,6 +876,14 @@ void Box::setattr(BoxedString* attr, Box* val, SetattrRewriteArgs* rewrite_args)
 
     RELEASE_ASSERT(attr->s() != none_str || this == builtins_module, "can't assign to None");
 
+    // Changing a class's attributes invalidates the cached lookups on it and its subclasses.
+    // We guarded on the metaclass above, so any rewrite we emit will also be storing into a class:
+    if (PyType_Check(this)) {
+        PyType_Modified(static_cast<BoxedClass*>(this));
+        if (rewrite_args)
+            rewrite_args->rewriter->call(false, (void*)PyType_Modified, rewrite_args->obj);
+    }
+
     if (cls->instancesHaveHCAttrs()) {
         HCAttrs* attrs = getHCAttrsPtr();
         HiddenClass* hcls = attrs->hcls;
@@ -960,6 +991,90 @@ extern "C" PyObject* _PyType_Lookup(PyTypeObject* type, PyObject* name) noexcept
     }
 }
 
+// A process-wide cache of typeLookup() results, modeled on CPython's method cache.  Entries are keyed
+// by (class version tag, attribute name); the version tag is invalidated by PyType_Modified() whenever
+// the class or anything in its mro gets changed, so we never have to go and find stale entries.
+//
+// The names are interned (and our interned strings are immortal), and a version tag is never handed out
+// twice, so the cache doesn't need to keep any of the entries alive.
+#define TYPE_LOOKUP_CACHE_SIZE_EXP 12
+struct TypeLookupCacheEntry {
+    unsigned int version;
+    BoxedString* name;
+    Box* value;
+};
+static TypeLookupCacheEntry type_lookup_cache[1 << TYPE_LOOKUP_CACHE_SIZE_EXP];
+static unsigned int next_version_tag = 1;
+// Protects type_lookup_cache and next_version_tag, since readers on different threads probe and fill the cache at
+// the same time under the GRWL.  Only held for the probe or the fill themselves, never across a lookup.
+static DS_DEFINE_SPINLOCK(type_lookup_cache_lock);
+
+static inline TypeLookupCacheEntry& typeLookupCacheEntry(unsigned int version, BoxedString* name) {
+    unsigned int h = version ^ (unsigned int)((uintptr_t)name >> 4);
+    return type_lookup_cache[h & ((1 << TYPE_LOOKUP_CACHE_SIZE_EXP) - 1)];
+}
+
+static bool assignVersionTag(BoxedClass* cls) {
+    if (PyType_HasFeature(cls, Py_TPFLAGS_VALID_VERSION_TAG))
+        return true;
+    if (!PyType_HasFeature(cls, Py_TPFLAGS_HAVE_VERSION_TAG))
+        return false;
+
+    // Changes to a dict-backed class don't go through Box::setattr, so we can't tell when to invalidate it:
+    if (cls->attrs.hcls->type == HiddenClass::DICT_BACKED)
+        return false;
+
+    bool wrapped = false;
+    {
+        LOCK_REGION(&type_lookup_cache_lock);
+        cls->tp_version_tag = next_version_tag++;
+        if (cls->tp_version_tag == 0) {
+            // We wrapped around, so the old entries could now get confused with new ones:
+            for (auto& e : type_lookup_cache) {
+                e.version = 0;
+                e.name = NULL;
+                e.value = NULL;
+            }
+            next_version_tag = 1;
+            wrapped = true;
+        }
+    }
+    if (wrapped) {
+        PyType_Modified(object_cls);
+        return false;
+    }
+
+    // PyType_Modified only recurses into subclasses whose tags are valid, so the bases have to be valid as well:
+    assert(cls->tp_bases && cls->tp_bases->cls == tuple_cls);
+    for (auto b : *static_cast<BoxedTuple*>(cls->tp_bases)) {
+        if (!PyType_Check(b) || !assignVersionTag(static_cast<BoxedClass*>(b)))
+            return false;
+    }
+
+    cls->tp_flags |= Py_TPFLAGS_VALID_VERSION_TAG;
+    return true;
+}
+
+static Box* typeLookupUncached(BoxedClass* cls, BoxedString* attr) {
+    assert(cls->tp_mro);
+    assert(cls->tp_mro->cls == tuple_cls);
+    for (auto b : *static_cast<BoxedTuple*>(cls->tp_mro)) {
+        // object_cls will get checked very often, but it only
+        // has attributes that start with an underscore.
+        if (b == object_cls) {
+            if (attr->data()[0] != '_') {
+                assert(!b->getattr(attr, NULL));
+                continue;
+            }
+        }
+
+        Box* val = b->getattr(attr, NULL);
+        if (val)
+            return val;
+    }
+    return NULL;
+}
+
 Box* typeLookup(BoxedClass* cls, BoxedString* attr, GetattrRewriteArgs* rewrite_args) {
     Box* val;
 
@@ -1004,23 +1119,30 @@ Box* typeLookup(BoxedClass* cls, BoxedString* attr, GetattrRewriteArgs* rewrite_
     } else {
         assert(attr->interned_state != SSTATE_NOT_INTERNED);
 
-        assert(cls->tp_mro);
-        assert(cls->tp_mro->cls == tuple_cls);
-        for (auto b : *static_cast<BoxedTuple*>(cls->tp_mro)) {
-            // object_cls will get checked very often, but it only
-            // has attributes that start with an underscore.
-            if (b == object_cls) {
-                if (attr->data()[0] != '_') {
-                    assert(!b->getattr(attr, NULL));
-                    continue;
-                }
-            }
+        static StatCounter num_hits("num_type_lookup_cache_hits");
+        static StatCounter num_misses("num_type_lookup_cache_misses");
 
-            val = b->getattr(attr, NULL);
-            if (val)
-                return val;
+        if (!assignVersionTag(cls))
+            return typeLookupUncached(cls, attr);
+
+        unsigned int version = cls->tp_version_tag;
+        TypeLookupCacheEntry& entry = typeLookupCacheEntry(version, attr);
+        {
+            LOCK_REGION(&type_lookup_cache_lock);
+            if (entry.version == version && entry.name == attr) {
+                num_hits.log();
+                return entry.value;
+            }
         }
-        return NULL;
+
+        num_misses.log();
+        val = typeLookupUncached(cls, attr);
+
+        LOCK_REGION(&type_lookup_cache_lock);
+        entry.version = version;
+        entry.name = attr;
+        entry.value = val;
+        return val;
     }
 }
 
@@ -3634,6 +3756,212 @@ Box* callCLFunc(CLFunction* f, CallRewriteArgs* rewrite_args, int num_output_arg
     return r;
 }
 
+static Box* runtimeCallCapiInternal(Box* obj, CallRewriteArgs* rewrite_args, ArgPassSpec argspec, Box* arg1,
+                                    Box* arg2, Box* arg3) {
+    assert(!argspec.has_starargs && !argspec.has_kwargs && argspec.num_keywords == 0 && argspec.num_args <= 3);
+
+    // Only plain Python functions that take exactly what we pass them (plus defaults) get the fast path; everything
+    // else needs callFunc's argument handling, which can call arbitrary code that expects exceptions to get thrown.
+    if (obj->cls != function_cls)
+        return runtimeCallInternal(obj, rewrite_args, argspec, arg1, arg2, arg3, NULL, NULL);
+
+    BoxedFunction* func = static_cast<BoxedFunction*>(obj);
+    CLFunction* f = func->f;
+    ParamReceiveSpec paramspec = f->paramspec;
+    int num_args = argspec.num_args;
+    if (!f->source || f->isGenerator() || paramspec.takes_varargs || paramspec.takes_kwargs
+        || paramspec.num_args > 3 || num_args > paramspec.num_args
+        || num_args < paramspec.num_args - paramspec.num_defaults)
+        return runtimeCallInternal(obj, rewrite_args, argspec, arg1, arg2, arg3, NULL, NULL);
+
+    Box* oargs[3] = { arg1, arg2, arg3 };
+    for (int i = num_args; i < paramspec.num_args; i++)
+        oargs[i] = func->defaults->elts[i - (paramspec.num_args - paramspec.num_defaults)];
+
+    if (!f->capi_versions.empty()) {
+        assert(!func->globals);
+
+        // The last version is the most recent one, which is the most optimized.
+        CompiledFunction* cf = f->capi_versions.back();
+
+        if (rewrite_args) {
+            // Same as the call that callCLFunc rewrites to, except that we don't care what the callee returns: the
+            // NULL that it hands back for an exception is for our caller to check.
+            rewrite_args->obj->addGuard((intptr_t)func);
+            rewrite_args->rewriter->addDependenceOn(func->dependent_ics);
+            rewrite_args->rewriter->addDependenceOn(cf->dependent_callsites);
+
+            RewriterVar::SmallVector arg_vec;
+            if (func->closure)
+                arg_vec.push_back(rewrite_args->rewriter->loadConst((intptr_t)func->closure, Location::forArg(0)));
+            RewriterVar* r_args[3] = { rewrite_args->arg1, rewrite_args->arg2, rewrite_args->arg3 };
+            for (int i = 0; i < paramspec.num_args; i++) {
+                if (i < num_args)
+                    arg_vec.push_back(r_args[i]);
+                else
+                    arg_vec.push_back(rewrite_args->rewriter->loadConst((intptr_t)oargs[i]));
+            }
+
+            rewrite_args->out_rtn = rewrite_args->rewriter->call(true, (void*)cf->call, arg_vec);
+            rewrite_args->out_success = true;
+        }
+
+        UNAVOIDABLE_STAT_TIMER(t0, "us_timer_in_jitted_code");
+        return callChosenCF(cf, func->closure, NULL, oargs[0], oargs[1], oargs[2], NULL);
+    }
+
+    if (!f->versions.empty()) {
+        // The function got hot enough through its other callers to get compiled, but those versions throw.  Get a
+        // CAPI version of our own at the same effort level, and use the ones that throw until we have it.
+        static StatCounter capi_compiles("num_capi_version_compiles");
+
+        FunctionSpecialization* spec
+            = new FunctionSpecialization(UNKNOWN, std::vector<ConcreteCompilerType*>(paramspec.num_args, UNKNOWN));
+        EffortLevel effort = f->versions.back()->effort;
+        if (ENABLE_BACKGROUND_COMPILATION) {
+            if (queueBackgroundCompile(f, spec, effort, ExceptionStyle::CAPI))
+                capi_compiles.log();
+            else
+                delete spec;
+        } else {
+            compileFunction(f, spec, effort, NULL, ExceptionStyle::CAPI);
+            capi_compiles.log();
+            return runtimeCallCapiInternal(obj, rewrite_args, argspec, arg1, arg2, arg3);
+        }
+
+        return callCLFunc(f, NULL, paramspec.num_args, func->closure, NULL, func->globals, oargs[0], oargs[1],
+                          oargs[2], NULL);
+    }
+
+    return astInterpretFunctionCapi(f, paramspec.num_args, func->closure, func->globals, oargs[0], oargs[1], oargs[2]);
+}
+
+extern "C" Box* runtimeCallCapi(Box* obj, ArgPassSpec argspec, Box* arg1, Box* arg2, Box* arg3) {
+    STAT_TIMER(t0, "us_timer_slowpath_runtimecallcapi", 10);
+
+    static StatCounter slowpath_runtimecallcapi("slowpath_runtimecallcapi");
+    slowpath_runtimecallcapi.log();
+
+    int npassed_args = argspec.num_args;
+    std::unique_ptr<Rewriter> rewriter(Rewriter::createRewriter(
+        __builtin_extract_return_addr(__builtin_return_address(0)), 2 + npassed_args, "runtimeCallCapi"));
+    Box* rtn;
+
+    if (rewriter.get()) {
+        CallRewriteArgs rewrite_args(rewriter.get(), rewriter->getArg(0), rewriter->getReturnDestination());
+        if (npassed_args >= 1)
+            rewrite_args.arg1 = rewriter->getArg(2);
+        if (npassed_args >= 2)
+            rewrite_args.arg2 = rewriter->getArg(3);
+        if (npassed_args >= 3)
+            rewrite_args.arg3 = rewriter->getArg(4);
+        rtn = runtimeCallCapiInternal(obj, &rewrite_args, argspec, arg1, arg2, arg3);
+
+        // A NULL return is an exception that the callee handed back, which doesn't make the rewrite any less valid.
+        if (!rewrite_args.out_success)
+            rewriter.reset(NULL);
+        else
+            rewriter->commitReturning(rewrite_args.out_rtn);
+    } else {
+        rtn = runtimeCallCapiInternal(obj, NULL, argspec, arg1, arg2, arg3);
+    }
+    assert(rtn || PyErr_Occurred());
+
+    return rtn;
+}
+
+// Looks the method up the way that callattrInternal does, but makes the call through runtimeCallCapiInternal so that a
+// Python method can hand its exception back to us.
+static Box* callattrCapiInternal(Box* obj, BoxedString* attr, LookupScope scope, CallRewriteArgs* rewrite_args,
+                                 ArgPassSpec argspec, Box* arg1, Box* arg2, Box* arg3) {
+    Box* bind_obj = NULL;
+    RewriterVar* r_bind_obj = NULL;
+    Box* val;
+    RewriterVar* r_val = NULL;
+    if (rewrite_args) {
+        GetattrRewriteArgs grewrite_args(rewrite_args->rewriter, rewrite_args->obj, Location::any());
+        val = getattrInternalEx(obj, attr, &grewrite_args, scope == CLASS_ONLY, true, &bind_obj, &r_bind_obj);
+        if (!grewrite_args.out_success) {
+            rewrite_args = NULL;
+        } else if (val) {
+            r_val = grewrite_args.out_rtn;
+        }
+    } else {
+        val = getattrInternalEx(obj, attr, NULL, scope == CLASS_ONLY, true, &bind_obj, &r_bind_obj);
+    }
+
+    if (val == NULL)
+        raiseAttributeError(obj, attr->s());
+
+    if (rewrite_args)
+        rewrite_args->obj = r_val;
+
+    if (bind_obj == NULL)
+        return runtimeCallCapiInternal(val, rewrite_args, argspec, arg1, arg2, arg3);
+
+    if (rewrite_args) {
+        r_val->addGuard((int64_t)val);
+        rewrite_args->func_guarded = true;
+    }
+
+    if (argspec.num_args < 3) {
+        ArgPassSpec new_argspec
+            = bindObjIntoArgs(bind_obj, r_bind_obj, rewrite_args, argspec, arg1, arg2, arg3, NULL, NULL);
+        return runtimeCallCapiInternal(val, rewrite_args, new_argspec, arg1, arg2, arg3);
+    }
+
+    // With the object bound in, this is too many arguments for the CAPI fast path.
+    Box* new_args[1];
+    ArgPassSpec new_argspec
+        = bindObjIntoArgs(bind_obj, r_bind_obj, rewrite_args, argspec, arg1, arg2, arg3, NULL, new_args);
+    return runtimeCallInternal(val, rewrite_args, new_argspec, arg1, arg2, arg3, new_args, NULL);
+}
+
+extern "C" Box* callattrCapi(Box* obj, BoxedString* attr, CallattrFlags flags, Box* arg1, Box* arg2, Box* arg3) {
+    STAT_TIMER(t0, "us_timer_slowpath_callattrcapi", 10);
+
+    ArgPassSpec argspec(flags.argspec);
+    assert(!argspec.has_starargs && !argspec.has_kwargs && argspec.num_keywords == 0 && argspec.num_args <= 3);
+    assert(!flags.null_on_nonexistent);
+    int npassed_args = argspec.num_args;
+
+    static StatCounter slowpath_callattrcapi("slowpath_callattrcapi");
+    slowpath_callattrcapi.log();
+
+    std::unique_ptr<Rewriter> rewriter(Rewriter::createRewriter(
+        __builtin_extract_return_addr(__builtin_return_address(0)), 3 + npassed_args, "callattrCapi"));
+    Box* rtn;
+
+    LookupScope scope = flags.cls_only ? CLASS_ONLY : CLASS_OR_INST;
+
+    if (attr->data()[0] == '_' && attr->data()[1] == '_' && PyInstance_Check(obj)) {
+        // __enter__ and __exit__ need special treatment.
+        if (attr->s() == "__enter__" || attr->s() == "__exit__")
+            scope = CLASS_OR_INST;
+    }
+
+    if (rewriter.get()) {
+        CallRewriteArgs rewrite_args(rewriter.get(), rewriter->getArg(0), rewriter->getReturnDestination());
+        if (npassed_args >= 1)
+            rewrite_args.arg1 = rewriter->getArg(3);
+        if (npassed_args >= 2)
+            rewrite_args.arg2 = rewriter->getArg(4);
+        if (npassed_args >= 3)
+            rewrite_args.arg3 = rewriter->getArg(5);
+        rtn = callattrCapiInternal(obj, attr, scope, &rewrite_args, argspec, arg1, arg2, arg3);
+
+        // As in runtimeCallCapi, a NULL return doesn't make the rewrite any less valid.
+        if (!rewrite_args.out_success)
+            rewriter.reset(NULL);
+        else
+            rewriter->commitReturning(rewrite_args.out_rtn);
+    } else {
+        rtn = callattrCapiInternal(obj, attr, scope, NULL, argspec, arg1, arg2, arg3);
+    }
+    assert(rtn || PyErr_Occurred());
+
+    return rtn;
+}
 
 Box* runtimeCallInternal(Box* obj, CallRewriteArgs* rewrite_args, ArgPassSpec argspec, Box* arg1, Box* arg2, Box* arg3,
                          Box** args, const std::vector<BoxedString*>* keyword_names) {
@@ -4443,6 +4771,21 @@ extern "C" Box* getitem(Box* value, Box* slice) {
     return rtn;
 }
 
+Box* getitemCapi(Box* value, Box* slice) {
+    // A lookup in a dict that misses is the usual way to get a KeyError that gets caught right away, so it's worth not
+    // throwing that one.  Subclasses could have a __missing__ or __getitem__ of their own, so they don't count.
+    if (value->cls != dict_cls)
+        return getitem(value, slice);
+
+    Box* r = static_cast<BoxedDict*>(value)->getOrNull(slice);
+    if (!r) {
+        Box* exc_obj = runtimeCall(KeyError, ArgPassSpec(1), slice, NULL, NULL, NULL, NULL);
+        assert(!PyErr_Occurred());
+        setCAPIException(ExcInfo(KeyError, exc_obj, None));
+    }
+    return r;
+}
+
 // target[slice] = value
 extern "C" void setitem(Box* target, Box* slice, Box* value) {
     STAT_TIMER(t0, "us_timer_slowpath_setitem", 10);
@@ -4517,6 +4860,10 @@ extern "C" void delitem(Box* target, Box* slice) {
 
 void Box::delattr(BoxedString* attr, DelattrRewriteArgs* rewrite_args) {
     assert(attr->interned_state != SSTATE_NOT_INTERNED);
+
+    if (PyType_Check(this))
+        PyType_Modified(static_cast<BoxedClass*>(this));
+
     if (cls->instancesHaveHCAttrs()) {
         // as soon as the hcls changes, the guard on hidden class won't pass.
         HCAttrs* attrs = getHCAttrsPtr();
@@ -5141,11 +5488,7 @@ Box* getFromGlobals(Box* globals, BoxedString* name) {
     if (globals->cls == module_cls) {
         return globals->getattr(name);
     } else if (globals->cls == dict_cls) {
-        auto d = static_cast<BoxedDict*>(globals)->d;
-        auto it = d.find(name);
-        if (it != d.end())
-            return it->second;
-        return NULL;
+        return static_cast<BoxedDict*>(globals)->getOrNull(name);
     } else {
         RELEASE_ASSERT(0, "%s", globals->cls->tp_name);
     }
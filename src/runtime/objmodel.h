@@ -30,11 +30,22 @@ class BoxedList;
 class BoxedString;
 class BoxedGenerator;
 class BoxedTuple;
+class AST_stmt;
 
 // user-level raise functions that implement python-level semantics
 ExcInfo excInfoForRaise(Box*, Box*, Box*);
+// The exceptions that raise0() and raise3() throw, for callers that want to hand them on some other way:
+ExcInfo excInfoForRaise0();
+ExcInfo excInfoForRaise3(Box*, Box*, Box*);
 extern "C" void raise0() __attribute__((__noreturn__));
 extern "C" void raise3(Box*, Box*, Box*) __attribute__((__noreturn__));
+// What a raise statement in a compiled ExceptionStyle::CAPI function calls: instead of throwing, these add the
+// statement's line to the traceback and set the exception in the thread state, and the function then returns NULL.
+extern "C" void raise0Capi(AST_stmt* stmt, CLFunction* clfunc);
+extern "C" void raise3Capi(Box*, Box*, Box*, AST_stmt* stmt, CLFunction* clfunc);
+// Takes the exception that a CAPI call inside of 'stmt' handed back out of the thread state, and adds the traceback
+// entry that unwinding through the catching frame would have.
+extern "C" void caughtCapiException(AST_stmt* stmt, CLFunction* clfunc, ExcInfo* exc_info_out);
 void raiseExc(Box* exc_obj) __attribute__((__noreturn__));
 void _printStacktrace();
 
@@ -72,6 +83,7 @@ extern "C" Box* strOrUnicode(Box* obj);
 extern "C" bool exceptionMatches(Box* obj, Box* cls);
 extern "C" BoxedInt* hash(Box* obj);
 extern "C" int64_t hashUnboxed(Box* obj);
+extern "C" size_t strHashUnboxed(BoxedString* self);
 extern "C" Box* abs_(Box* obj);
 // extern "C" Box* chr(Box* arg);
 extern "C" Box* compare(Box*, Box*, int);
@@ -81,6 +93,9 @@ extern "C" i64 unboxedLen(Box* obj);
 extern "C" Box* binop(Box* lhs, Box* rhs, int op_type);
 extern "C" Box* augbinop(Box* lhs, Box* rhs, int op_type);
 extern "C" Box* getitem(Box* value, Box* slice);
+// Like getitem, but a dict that doesn't have the key returns NULL with a KeyError set in the thread state instead of
+// throwing it.  Other exceptions still get thrown.
+Box* getitemCapi(Box* value, Box* slice);
 extern "C" void setitem(Box* target, Box* slice, Box* value);
 extern "C" void delitem(Box* target, Box* slice);
 extern "C" Box* getclsattr(Box* obj, BoxedString* attr);
@@ -163,6 +178,12 @@ Box* processDescriptorOrNull(Box* obj, Box* inst, Box* owner);
 
 Box* callCLFunc(CLFunction* f, CallRewriteArgs* rewrite_args, int num_output_args, BoxedClosure* closure,
                 BoxedGenerator* generator, Box* globals, Box* oarg1, Box* oarg2, Box* oarg3, Box** oargs);
+// Like runtimeCall with up to three positional arguments, but uses ExceptionStyle::CAPI when calling into a Python
+// function: an exception that escapes the callee comes back as a NULL return with the exception set in the thread
+// state.  Exceptions from anywhere else still get thrown.  Both of these can be called from a patchpoint.
+extern "C" Box* runtimeCallCapi(Box* obj, ArgPassSpec argspec, Box* arg1, Box* arg2, Box* arg3);
+// The same for a method call; flags.null_on_nonexistent isn't supported.
+extern "C" Box* callattrCapi(Box* obj, BoxedString* attr, CallattrFlags flags, Box* arg1, Box* arg2, Box* arg3);
 
 static const char* objectNewParameterTypeErrorMsg() {
     if (PYTHON_VERSION_HEX >= version_hex(2, 7, 4)) {
@@ -14,6 +14,7 @@
 
 #include "runtime/set.h"
 
+#include <cstring>
 #include <llvm/Support/raw_ostream.h>
 
 #include "gc/collector.h"
@@ -23,6 +24,124 @@ namespace pyston {
 
 BoxedClass* set_iterator_cls;
 
+void SetTable::resize(size_t minused) {
+    size_t newsize = MIN_SIZE;
+    while (newsize <= minused)
+        newsize <<= 1;
+    RELEASE_ASSERT(newsize <= (1UL << 31), "set too large");
+
+    Entry* new_table = (Entry*)gc_alloc(newsize * sizeof(Entry), gc::GCKind::UNTRACKED);
+    memset(new_table, 0, newsize * sizeof(Entry));
+
+    // The cached hashes are enough to place the live entries; no comparisons are needed since the keys
+    // are already known to be distinct.
+    Entry* old_table = table;
+    size_t old_size = old_table ? mask + 1 : 0;
+    for (size_t i = 0; i < old_size; i++) {
+        Entry& e = old_table[i];
+        if (!isLive(e.key))
+            continue;
+
+        size_t perturb = e.hash;
+        size_t slot = e.hash & (newsize - 1);
+        while (new_table[slot].key != NULL) {
+            perturb >>= 5;
+            slot = (slot * 5 + perturb + 1) & (newsize - 1);
+        }
+        new_table[slot] = e;
+    }
+
+    table = new_table;
+    mask = newsize - 1;
+    fill = used;
+    finger = 0;
+
+    if (old_table)
+        gc::gc_free(old_table);
+}
+
+bool SetTable::insert(Box* key, size_t hash) {
+    if (unlikely(!table))
+        resize(0);
+
+    int64_t free_slot;
+    if (lookup(key, hash, &free_slot) >= 0)
+        return false;
+
+    if (unlikely(free_slot < 0)) {
+        // A comparison cleared the table out from under us.
+        resize(0);
+        lookup(key, hash, &free_slot);
+    }
+
+    Entry& e = table[free_slot];
+    if (e.key == NULL)
+        fill++;
+    e.key = key;
+    e.hash = hash;
+    used++;
+
+    if (fill * 3 >= (mask + 1) * 2)
+        resize(used > 50000 ? used * 2 : used * 4);
+    return true;
+}
+
+Box* SetTable::pop() {
+    assert(used > 0);
+
+    uint32_t i = finger & mask;
+    while (!isLive(table[i].key))
+        i = (i + 1) & mask;
+
+    Box* rtn = table[i].key;
+    eraseSlot(i);
+    finger = i + 1;
+    return rtn;
+}
+
+void SetTable::update(SetTable& other) {
+    if (&other == this || other.used == 0)
+        return;
+
+    if (fill == 0) {
+        // Nothing to compare against, so copy the table wholesale.
+        size_t size = other.mask + 1;
+        Entry* new_table = (Entry*)gc_alloc(size * sizeof(Entry), gc::GCKind::UNTRACKED);
+        memcpy(new_table, other.table, size * sizeof(Entry));
+
+        if (table)
+            gc::gc_free(table);
+        table = new_table;
+        mask = other.mask;
+        fill = other.fill;
+        used = other.used;
+        finger = 0;
+        return;
+    }
+
+    reserve(other.used);
+    for (auto it = other.begin(), end = other.end(); it != end; ++it)
+        insert(*it, it.hash());
+}
+
+void SetTable::clear() {
+    if (table)
+        gc::gc_free(table);
+    table = NULL;
+    mask = fill = used = finger = 0;
+}
+
+void SetTable::gcVisit(GCVisitor* v) {
+    if (!table)
+        return;
+
+    v->visit(table);
+    for (size_t i = 0; i <= mask; i++) {
+        if (isLive(table[i].key))
+            v->visit(table[i].key);
+    }
+}
+
 extern "C" Box* createSet() {
     return new BoxedSet();
 }
@@ -32,7 +151,7 @@ namespace set {
 class BoxedSetIterator : public Box {
 public:
     BoxedSet* s;
-    decltype(BoxedSet::s)::iterator it;
+    SetTable::iterator it;
 
     BoxedSetIterator(BoxedSet* s) : s(s), it(s->s.begin()) {}
 
@@ -88,6 +207,11 @@ Box* setNew(Box* _cls, Box* container) {
     if (container == None)
         return rtn;
 
+    if (PyAnySet_Check(container)) {
+        rtn->s.update(static_cast<BoxedSet*>(container)->s);
+        return rtn;
+    }
+
     for (Box* e : container->pyElements()) {
         rtn->s.insert(e);
     }
@@ -122,18 +246,44 @@ Box* frozensetRepr(BoxedSet* self) {
     return _setRepr(self, "frozenset");
 }
 
+// Set-algebra kernels between two tables; they use the cached hashes, so PyHasher is never called.
+static void setIntersectionInto(BoxedSet* rtn, BoxedSet* lhs, BoxedSet* rhs) {
+    // Probe the larger set with the elements of the smaller one, like CPython does.
+    if (lhs->s.size() > rhs->s.size())
+        std::swap(lhs, rhs);
+
+    for (auto it = lhs->s.begin(), end = lhs->s.end(); it != end; ++it) {
+        if (rhs->s.contains(*it, it.hash()))
+            rtn->s.insert(*it, it.hash());
+    }
+}
+
+static void setDifferenceInto(BoxedSet* rtn, BoxedSet* lhs, BoxedSet* rhs) {
+    for (auto it = lhs->s.begin(), end = lhs->s.end(); it != end; ++it) {
+        if (!rhs->s.contains(*it, it.hash()))
+            rtn->s.insert(*it, it.hash());
+    }
+}
+
+static bool setIsSubsetOf(BoxedSet* lhs, BoxedSet* rhs) {
+    if (lhs->s.size() > rhs->s.size())
+        return false;
+
+    for (auto it = lhs->s.begin(), end = lhs->s.end(); it != end; ++it) {
+        if (!rhs->s.contains(*it, it.hash()))
+            return false;
+    }
+    return true;
+}
+
 Box* setOrSet(BoxedSet* lhs, BoxedSet* rhs) {
     RELEASE_ASSERT(PyAnySet_Check(lhs), "");
     RELEASE_ASSERT(PyAnySet_Check(rhs), "");
 
     BoxedSet* rtn = new (lhs->cls) BoxedSet();
 
-    for (Box* elt : lhs->s) {
-        rtn->s.insert(elt);
-    }
-    for (Box* elt : rhs->s) {
-        rtn->s.insert(elt);
-    }
+    rtn->s.update(lhs->s);
+    rtn->s.update(rhs->s);
     return rtn;
 }
 
@@ -142,11 +292,7 @@ Box* setAndSet(BoxedSet* lhs, BoxedSet* rhs) {
     RELEASE_ASSERT(PyAnySet_Check(rhs), "");
 
     BoxedSet* rtn = new (lhs->cls) BoxedSet();
-
-    for (Box* elt : lhs->s) {
-        if (rhs->s.count(elt))
-            rtn->s.insert(elt);
-    }
+    setIntersectionInto(rtn, lhs, rhs);
     return rtn;
 }
 
@@ -155,13 +301,7 @@ Box* setSubSet(BoxedSet* lhs, BoxedSet* rhs) {
     RELEASE_ASSERT(PyAnySet_Check(rhs), "");
 
     BoxedSet* rtn = new (lhs->cls) BoxedSet();
-
-    for (Box* elt : lhs->s) {
-        // TODO if len(rhs) << len(lhs), it might be more efficient
-        // to delete the elements of rhs from lhs?
-        if (rhs->s.count(elt) == 0)
-            rtn->s.insert(elt);
-    }
+    setDifferenceInto(rtn, lhs, rhs);
     return rtn;
 }
 
@@ -170,17 +310,8 @@ Box* setXorSet(BoxedSet* lhs, BoxedSet* rhs) {
     RELEASE_ASSERT(PyAnySet_Check(rhs), "");
 
     BoxedSet* rtn = new (lhs->cls) BoxedSet();
-
-    for (Box* elt : lhs->s) {
-        if (rhs->s.count(elt) == 0)
-            rtn->s.insert(elt);
-    }
-
-    for (Box* elt : rhs->s) {
-        if (lhs->s.count(elt) == 0)
-            rtn->s.insert(elt);
-    }
-
+    setDifferenceInto(rtn, lhs, rhs);
+    setDifferenceInto(rtn, rhs, lhs);
     return rtn;
 }
 
@@ -222,22 +353,16 @@ extern "C" int PySet_Add(PyObject* set, PyObject* key) noexcept {
 Box* setRemove(BoxedSet* self, Box* v) {
     RELEASE_ASSERT(isSubclass(self->cls, set_cls), "");
 
-    auto it = self->s.find(v);
-    if (it == self->s.end()) {
+    if (!self->s.erase(v)) {
         raiseExcHelper(KeyError, v);
     }
-
-    self->s.erase(it);
     return None;
 }
 
 Box* setDiscard(BoxedSet* self, Box* v) {
     RELEASE_ASSERT(isSubclass(self->cls, set_cls), "");
 
-    auto it = self->s.find(v);
-    if (it != self->s.end())
-        self->s.erase(it);
-
+    self->s.erase(v);
     return None;
 }
 
@@ -263,9 +388,8 @@ Box* setUpdate(BoxedSet* self, BoxedTuple* args) {
     assert(args->cls == tuple_cls);
 
     for (auto l : *args) {
-        if (l->cls == set_cls) {
-            BoxedSet* s2 = static_cast<BoxedSet*>(l);
-            self->s.insert(s2->s.begin(), s2->s.end());
+        if (PyAnySet_Check(l)) {
+            self->s.update(static_cast<BoxedSet*>(l)->s);
         } else {
             for (auto e : l->pyElements()) {
                 self->s.insert(e);
@@ -281,9 +405,14 @@ Box* setUnion(BoxedSet* self, BoxedTuple* args) {
         raiseExcHelper(TypeError, "descriptor 'union' requires a 'set' object but received a '%s'", getTypeName(self));
 
     BoxedSet* rtn = new BoxedSet();
-    rtn->s.insert(self->s.begin(), self->s.end());
+    rtn->s.update(self->s);
 
     for (auto container : args->pyElements()) {
+        if (PyAnySet_Check(container)) {
+            rtn->s.update(static_cast<BoxedSet*>(container)->s);
+            continue;
+        }
+
         for (auto elt : container->pyElements()) {
             rtn->s.insert(elt);
         }
@@ -292,19 +421,28 @@ Box* setUnion(BoxedSet* self, BoxedTuple* args) {
     return rtn;
 }
 
+static void setDifferenceUpdateInternal(BoxedSet* self, BoxedTuple* args) {
+    for (auto container : args->pyElements()) {
+        if (PyAnySet_Check(container)) {
+            BoxedSet* rhs = static_cast<BoxedSet*>(container);
+            for (auto it = rhs->s.begin(), end = rhs->s.end(); it != end; ++it)
+                self->s.erase(*it, it.hash());
+            continue;
+        }
+
+        for (auto elt : container->pyElements()) {
+            self->s.erase(elt);
+        }
+    }
+}
+
 Box* setDifference(BoxedSet* self, BoxedTuple* args) {
     if (!PyAnySet_Check(self))
         raiseExcHelper(TypeError, "descriptor 'difference' requires a 'set' object but received a '%s'",
                        getTypeName(self));
 
     BoxedSet* rtn = (BoxedSet*)setNew(self->cls, self);
-
-    for (auto container : args->pyElements()) {
-        for (auto elt : container->pyElements()) {
-            rtn->s.erase(elt);
-        }
-    }
-
+    setDifferenceUpdateInternal(rtn, args);
     return rtn;
 }
 
@@ -313,12 +451,7 @@ Box* setDifferenceUpdate(BoxedSet* self, BoxedTuple* args) {
         raiseExcHelper(TypeError, "descriptor 'difference' requires a 'set' object but received a '%s'",
                        getTypeName(self));
 
-    for (auto container : args->pyElements()) {
-        for (auto elt : container->pyElements()) {
-            self->s.erase(elt);
-        }
-    }
-
+    setDifferenceUpdateInternal(self, args);
     return None;
 }
 
@@ -330,12 +463,7 @@ static Box* setIssubset(BoxedSet* self, Box* container) {
     }
     assert(PyAnySet_Check(container));
 
-    BoxedSet* rhs = static_cast<BoxedSet*>(container);
-    for (auto e : self->s) {
-        if (rhs->s.find(e) == rhs->s.end())
-            return False;
-    }
-    return True;
+    return boxBool(setIsSubsetOf(self, static_cast<BoxedSet*>(container)));
 }
 
 static Box* setIssuperset(BoxedSet* self, Box* container) {
@@ -346,19 +474,14 @@ static Box* setIssuperset(BoxedSet* self, Box* container) {
     }
     assert(PyAnySet_Check(container));
 
-    BoxedSet* rhs = static_cast<BoxedSet*>(container);
-    for (auto e : rhs->s) {
-        if (self->s.find(e) == self->s.end())
-            return False;
-    }
-    return True;
+    return boxBool(setIsSubsetOf(static_cast<BoxedSet*>(container), self));
 }
 
 static Box* setIsdisjoint(BoxedSet* self, Box* container) {
     RELEASE_ASSERT(PyAnySet_Check(self), "");
 
     for (auto e : container->pyElements()) {
-        if (self->s.find(e) != self->s.end())
+        if (self->s.contains(e))
             return False;
     }
     return True;
@@ -368,6 +491,11 @@ static BoxedSet* setIntersection2(BoxedSet* self, Box* container) {
     RELEASE_ASSERT(PyAnySet_Check(self), "");
 
     BoxedSet* rtn = new BoxedSet();
+    if (PyAnySet_Check(container)) {
+        setIntersectionInto(rtn, self, static_cast<BoxedSet*>(container));
+        return rtn;
+    }
+
     for (auto elt : container->pyElements()) {
         if (self->s.count(elt))
             rtn->s.insert(elt);
@@ -391,7 +519,7 @@ Box* setCopy(BoxedSet* self) {
     RELEASE_ASSERT(PyAnySet_Check(self), "");
 
     BoxedSet* rtn = new BoxedSet();
-    rtn->s.insert(self->s.begin(), self->s.end());
+    rtn->s.update(self->s);
     return rtn;
 }
 
@@ -401,15 +529,12 @@ Box* setPop(BoxedSet* self) {
     if (!self->s.size())
         raiseExcHelper(KeyError, "pop from an empty set");
 
-    auto it = self->s.begin();
-    Box* rtn = *it;
-    self->s.erase(it);
-    return rtn;
+    return self->s.pop();
 }
 
 Box* setContains(BoxedSet* self, Box* v) {
     RELEASE_ASSERT(PyAnySet_Check(self), "");
-    return boxBool(self->s.find(v) != self->s.end());
+    return boxBool(self->s.contains(v));
 }
 
 Box* setEq(BoxedSet* self, BoxedSet* rhs) {
@@ -420,11 +545,7 @@ Box* setEq(BoxedSet* self, BoxedSet* rhs) {
     if (self->s.size() != rhs->s.size())
         return False;
 
-    for (auto e : self->s) {
-        if (!rhs->s.count(e))
-            return False;
-    }
-    return True;
+    return boxBool(setIsSubsetOf(self, rhs));
 }
 
 Box* setNe(BoxedSet* self, BoxedSet* rhs) {
@@ -15,8 +15,6 @@
 #ifndef PYSTON_RUNTIME_SET_H
 #define PYSTON_RUNTIME_SET_H
 
-#include <unordered_set>
-
 #include "core/types.h"
 #include "runtime/types.h"
 
@@ -27,16 +25,170 @@ void teardownSet();
 
 extern "C" Box* createSet();
 
+// The storage for BoxedSet: a flat open-addressing hash table in the style of CPython's setobject.c.  Every
+// slot caches the hash of its key, so resizing and set-to-set operations never call __hash__ again; the
+// set algebra in set.cpp goes through the overloads that take a precomputed hash.
+//
+// The interface mirrors the parts of std::unordered_set that the runtime uses.
+class SetTable {
+public:
+    struct Entry {
+        Box* key; // NULL for a never-used slot, or dummy() for a deleted one
+        size_t hash;
+    };
+
+    class iterator {
+    private:
+        SetTable* set;
+        uint32_t idx;
+
+        bool atEnd() const { return !set->table || idx > set->mask; }
+        void skipUnused() {
+            while (!atEnd() && !isLive(set->table[idx].key))
+                idx++;
+        }
+
+    public:
+        iterator(SetTable* set, uint32_t idx) : set(set), idx(idx) { skipUnused(); }
+
+        Box* operator*() const { return set->table[idx].key; }
+        size_t hash() const { return set->table[idx].hash; }
+
+        iterator& operator++() {
+            idx++;
+            skipUnused();
+            return *this;
+        }
+
+        bool operator==(const iterator& rhs) const {
+            bool end = atEnd();
+            if (end || rhs.atEnd())
+                return end == rhs.atEnd();
+            return idx == rhs.idx;
+        }
+        bool operator!=(const iterator& rhs) const { return !(*this == rhs); }
+    };
+
+private:
+    static const size_t MIN_SIZE = 8;
+
+    Entry* table; // UNTRACKED, or NULL if nothing has been inserted yet
+    uint32_t mask;
+    uint32_t fill;   // live + deleted slots
+    uint32_t used;   // live slots
+    uint32_t finger; // where pop() resumes its search
+
+    static Box* dummy() { return reinterpret_cast<Box*>(1); }
+    static bool isLive(Box* key) { return reinterpret_cast<uintptr_t>(key) > 1; }
+
+    // Returns the slot holding key, or -1.  In the latter case, *free_slot is set to the slot that an
+    // insertion of key should use.
+    int64_t lookup(Box* key, size_t hash, int64_t* free_slot) {
+    restart:
+        if (unlikely(!table)) {
+            // Only possible if a comparison cleared the set.
+            *free_slot = -1;
+            return -1;
+        }
+
+        size_t perturb = hash;
+        size_t i = hash & mask;
+        int64_t freeslot = -1;
+        while (true) {
+            Entry* e = &table[i];
+            if (e->key == NULL) {
+                *free_slot = freeslot >= 0 ? freeslot : i;
+                return -1;
+            }
+
+            if (e->key == key)
+                return i;
+
+            if (e->key == dummy()) {
+                if (freeslot < 0)
+                    freeslot = i;
+            } else if (e->hash == hash) {
+                Entry* orig_table = table;
+                Box* orig_key = e->key;
+                bool eq = PyEq()(orig_key, key);
+                // The comparison could have run arbitrary code that mutated this set:
+                if (unlikely(table != orig_table || table[i].key != orig_key))
+                    goto restart;
+                if (eq)
+                    return i;
+            }
+
+            perturb >>= 5;
+            i = (i * 5 + perturb + 1) & mask;
+        }
+    }
+
+    void resize(size_t minused);
+    void eraseSlot(int64_t i) {
+        table[i].key = dummy();
+        used--;
+    }
+
+public:
+    SetTable() : table(NULL), mask(0), fill(0), used(0), finger(0) {}
+    SetTable(const SetTable&) = delete;
+    SetTable& operator=(const SetTable&) = delete;
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, UINT32_MAX); }
+
+    size_t size() const { return used; }
+    bool empty() const { return used == 0; }
+
+    bool contains(Box* key, size_t hash) {
+        if (used == 0)
+            return false;
+        int64_t free_slot;
+        return lookup(key, hash, &free_slot) >= 0;
+    }
+    bool contains(Box* key) { return contains(key, PyHasher()(key)); }
+    size_t count(Box* key) { return contains(key) ? 1 : 0; }
+
+    // Returns whether the key was newly added.
+    bool insert(Box* key, size_t hash);
+    bool insert(Box* key) { return insert(key, PyHasher()(key)); }
+
+    // Returns whether the key was present.
+    bool erase(Box* key, size_t hash) {
+        if (used == 0)
+            return false;
+        int64_t free_slot;
+        int64_t i = lookup(key, hash, &free_slot);
+        if (i < 0)
+            return false;
+        eraseSlot(i);
+        return true;
+    }
+    bool erase(Box* key) { return erase(key, PyHasher()(key)); }
+
+    // Removes and returns an arbitrary element; the set must not be empty.
+    Box* pop();
+
+    // Adds every element of other, reusing its cached hashes.
+    void update(SetTable& other);
+
+    void reserve(size_t n) {
+        if ((fill + n) * 3 >= (mask + 1) * 2)
+            resize(used + n);
+    }
+
+    void clear();
+
+    void gcVisit(GCVisitor* v);
+};
+
 class BoxedSet : public Box {
 public:
-    typedef std::unordered_set<Box*, PyHasher, PyEq, StlCompatAllocator<Box*>> Set;
-    Set s;
+    SetTable s;
     Box** weakreflist; /* List of weak references */
 
     BoxedSet() __attribute__((visibility("default"))) {}
 
-    template <typename T> __attribute__((visibility("default"))) BoxedSet(T&& s) : s(std::forward<T>(s)) {}
-
     DEFAULT_CLASS(set_cls);
 };
 }
@@ -177,7 +177,7 @@ extern "C" void exit(int code) {
 }
 #endif
 
-extern "C" void raise0() {
+ExcInfo excInfoForRaise0() {
     ExcInfo* exc_info = getFrameExcInfo();
     assert(exc_info->type);
 
@@ -186,8 +186,32 @@ extern "C" void raise0() {
         raiseExcHelper(TypeError, "exceptions must be old-style classes or derived from BaseException, not NoneType");
 
     exc_info->reraise = true;
+    // The traceback has already been handed out (eg through sys.exc_info), so it can't grow in place anymore.
+    BoxedTraceback::seal(exc_info->traceback);
+    return *exc_info;
+}
+
+extern "C" void raise0() {
+    ExcInfo exc_info = excInfoForRaise0();
     assert(!PyErr_Occurred());
-    throw * exc_info;
+    throw exc_info;
+}
+
+extern "C" void raise0Capi(AST_stmt* stmt, CLFunction* clfunc) {
+    ExcInfo exc_info = excInfoForRaise0();
+    exceptionCaughtInInterpreter(stmt, clfunc, &exc_info);
+    assert(!PyErr_Occurred());
+    setCAPIException(exc_info);
+}
+
+extern "C" void caughtCapiException(AST_stmt* stmt, CLFunction* clfunc, ExcInfo* exc_info_out) {
+    PyObject* type, *value, *traceback;
+    PyErr_Fetch(&type, &value, &traceback);
+    assert(type);
+
+    ExcInfo exc_info(type, value ? value : None, traceback ? traceback : None);
+    exceptionCaughtInInterpreter(stmt, clfunc, &exc_info);
+    *exc_info_out = exc_info;
 }
 
 #ifndef NDEBUG
@@ -217,6 +241,7 @@ ExcInfo excInfoForRaise(Box* type, Box* value, Box* tb) {
     } else if (tb != NULL && !PyTraceBack_Check(tb)) {
         raiseExcHelper(TypeError, "raise: arg 3 must be a traceback or None");
     }
+    BoxedTraceback::seal(tb);
 
 
     /* Next, repeatedly, replace a tuple exception with its first item */
@@ -263,15 +288,27 @@ ExcInfo excInfoForRaise(Box* type, Box* value, Box* tb) {
     return ExcInfo(type, value, tb);
 }
 
-extern "C" void raise3(Box* arg0, Box* arg1, Box* arg2) {
+ExcInfo excInfoForRaise3(Box* arg0, Box* arg1, Box* arg2) {
     bool reraise = arg2 != NULL && arg2 != None;
     auto exc_info = excInfoForRaise(arg0, arg1, arg2);
 
     exc_info.reraise = reraise;
+    return exc_info;
+}
+
+extern "C" void raise3(Box* arg0, Box* arg1, Box* arg2) {
+    auto exc_info = excInfoForRaise3(arg0, arg1, arg2);
     assert(!PyErr_Occurred());
     throw exc_info;
 }
 
+extern "C" void raise3Capi(Box* arg0, Box* arg1, Box* arg2, AST_stmt* stmt, CLFunction* clfunc) {
+    auto exc_info = excInfoForRaise3(arg0, arg1, arg2);
+    exceptionCaughtInInterpreter(stmt, clfunc, &exc_info);
+    assert(!PyErr_Occurred());
+    setCAPIException(exc_info);
+}
+
 void raiseExcHelper(BoxedClass* cls, Box* arg) {
     Box* exc_obj = runtimeCall(cls, ArgPassSpec(1), arg, NULL, NULL, NULL, NULL);
     raiseExc(exc_obj);
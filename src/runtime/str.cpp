@@ -17,6 +17,7 @@
 #include <sstream>
 #include <unordered_map>
 
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/raw_ostream.h"
@@ -56,33 +57,33 @@ namespace pyston {
 BoxedString* EmptyString;
 BoxedString* characters[UCHAR_MAX + 1];
 
-BoxedString::BoxedString(const char* s, size_t n) : interned_state(SSTATE_NOT_INTERNED) {
+BoxedString::BoxedString(const char* s, size_t n) : hash(-1), interned_state(SSTATE_NOT_INTERNED) {
     assert(s);
     RELEASE_ASSERT(n != llvm::StringRef::npos, "");
     memmove(data(), s, n);
     data()[n] = 0;
 }
 
-BoxedString::BoxedString(llvm::StringRef lhs, llvm::StringRef rhs) : interned_state(SSTATE_NOT_INTERNED) {
+BoxedString::BoxedString(llvm::StringRef lhs, llvm::StringRef rhs) : hash(-1), interned_state(SSTATE_NOT_INTERNED) {
     RELEASE_ASSERT(lhs.size() + rhs.size() != llvm::StringRef::npos, "");
     memmove(data(), lhs.data(), lhs.size());
     memmove(data() + lhs.size(), rhs.data(), rhs.size());
     data()[lhs.size() + rhs.size()] = 0;
 }
 
-BoxedString::BoxedString(llvm::StringRef s) : interned_state(SSTATE_NOT_INTERNED) {
+BoxedString::BoxedString(llvm::StringRef s) : hash(-1), interned_state(SSTATE_NOT_INTERNED) {
     RELEASE_ASSERT(s.size() != llvm::StringRef::npos, "");
     memmove(data(), s.data(), s.size());
     data()[s.size()] = 0;
 }
 
-BoxedString::BoxedString(size_t n, char c) : interned_state(SSTATE_NOT_INTERNED) {
+BoxedString::BoxedString(size_t n, char c) : hash(-1), interned_state(SSTATE_NOT_INTERNED) {
     RELEASE_ASSERT(n != llvm::StringRef::npos, "");
     memset(data(), c, n);
     data()[n] = 0;
 }
 
-BoxedString::BoxedString(size_t n) : interned_state(SSTATE_NOT_INTERNED) {
+BoxedString::BoxedString(size_t n) : hash(-1), interned_state(SSTATE_NOT_INTERNED) {
     RELEASE_ASSERT(n != llvm::StringRef::npos, "");
     // Note: no memset.  add the null-terminator for good measure though
     // (CPython does the same thing).
@@ -1537,15 +1538,43 @@ extern "C" size_t unicodeHashUnboxed(PyUnicodeObject* self) {
 
     Py_ssize_t len = PyUnicode_GET_SIZE(self);
     Py_UNICODE* p = PyUnicode_AS_UNICODE(self);
-    pyston::StringHash<Py_UNICODE> H;
-    return H(p, len);
+
+    long hash;
+    if (std::all_of(p, p + len, [](Py_UNICODE c) { return c < 128; })) {
+        // An ascii unicode object compares equal to the corresponding str, so it has to hash the same way:
+        llvm::SmallString<256> narrowed;
+        narrowed.reserve(len);
+        for (Py_ssize_t i = 0; i < len; i++)
+            narrowed.push_back((char)p[i]);
+        hash = hashStringBytes(narrowed.data(), len);
+    } else {
+        pyston::StringHash<Py_UNICODE> H;
+        hash = H(p, len);
+    }
+
+    if (hash == -1)
+        hash = -2;
+    self->hash = hash;
+    return hash;
+}
+
+extern "C" size_t strHashUnboxed(BoxedString* self) {
+    assert(PyString_Check(self));
+
+    if (self->hash != -1)
+        return self->hash;
+
+    long hash = hashStringBytes(self->data(), self->size());
+    if (hash == -1)
+        hash = -2;
+    self->hash = hash;
+    return hash;
 }
 
 extern "C" Box* strHash(BoxedString* self) {
     assert(PyString_Check(self));
 
-    StringHash<char> H;
-    return boxInt(H(self->data(), self->size()));
+    return boxInt(strHashUnboxed(self));
 }
 
 extern "C" Box* strNonzero(BoxedString* self) {
@@ -2390,6 +2419,7 @@ extern "C" int _PyString_Resize(PyObject** pv, Py_ssize_t newsize) noexcept {
         // XXX resize the box (by reallocating) smaller if it makes sense
         s->ob_size = newsize;
         s->data()[newsize] = 0;
+        s->hash = -1;
         return 0;
     }
 
@@ -0,0 +1,523 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PYSTON_RUNTIME_TIMSORT_H
+#define PYSTON_RUNTIME_TIMSORT_H
+
+#include <algorithm>
+#include <cstring>
+
+#include "core/types.h"
+
+namespace pyston {
+
+// A port of CPython's list sort (see Objects/listsort.txt in the CPython sources): a stable, adaptive mergesort
+// that picks out the runs that are already in the data and merges them, switching to galloping when one run keeps
+// winning.  Partially-sorted input takes far fewer than n*log(n) comparisons.
+//
+// T has to be a trivially-copyable type made up of Box*'s: elements get moved through a temporary buffer, which
+// the GC scans conservatively.  The comparison function is allowed to throw; the array is left holding some
+// permutation of its original elements if it does.
+template <typename T, typename Compare> class TimSort {
+private:
+    static const int MIN_GALLOP = 7;
+    // Enough for any array that fits in memory, given the invariants that mergeCollapse() keeps on the run lengths:
+    static const int MAX_MERGE_PENDING = 85;
+
+    struct Run {
+        T* base;
+        Py_ssize_t len;
+    };
+
+    Compare lt;
+    int min_gallop;
+
+    T* temp;
+    Py_ssize_t temp_size;
+
+    Run pending[MAX_MERGE_PENDING];
+    int num_pending;
+
+    static void copy(T* dest, const T* src, Py_ssize_t n) { memcpy(dest, src, n * sizeof(T)); }
+    static void move(T* dest, const T* src, Py_ssize_t n) { memmove(dest, src, n * sizeof(T)); }
+
+    void ensureTemp(Py_ssize_t need) {
+        if (need <= temp_size)
+            return;
+        if (temp)
+            gc::gc_free(temp);
+        temp = NULL;
+        temp_size = 0;
+        temp = (T*)gc::gc_alloc(need * sizeof(T), gc::GCKind::CONSERVATIVE);
+        temp_size = need;
+    }
+
+    // Sorts [lo, hi) with a binary insertion sort, given that [lo, start) is already sorted.
+    void binarySort(T* lo, T* hi, T* start) {
+        if (lo == start)
+            ++start;
+        for (; start < hi; ++start) {
+            T pivot = *start;
+            T* l = lo;
+            T* r = start;
+            while (l < r) {
+                T* p = l + ((r - l) >> 1);
+                if (lt(pivot, *p))
+                    r = p;
+                else
+                    l = p + 1;
+            }
+            move(l + 1, l, start - l);
+            *l = pivot;
+        }
+    }
+
+    // Returns the length of the run starting at lo.  A run is either non-descending, or strictly descending (so that
+    // reversing it keeps the sort stable).
+    Py_ssize_t countRun(T* lo, T* hi, bool& descending) {
+        descending = false;
+        ++lo;
+        if (lo == hi)
+            return 1;
+
+        Py_ssize_t n = 2;
+        if (lt(*lo, *(lo - 1))) {
+            descending = true;
+            for (++lo; lo < hi && lt(*lo, *(lo - 1)); ++lo)
+                ++n;
+        } else {
+            for (++lo; lo < hi && !lt(*lo, *(lo - 1)); ++lo)
+                ++n;
+        }
+        return n;
+    }
+
+    // Locates the position to insert key into the sorted array a[0, n), to the left of any equal elements: returns
+    // the k such that a[k-1] < key <= a[k].  Starts searching at a[hint] and gallops outwards from there.
+    Py_ssize_t gallopLeft(const T& key, T* a, Py_ssize_t n, Py_ssize_t hint) {
+        Py_ssize_t ofs = 1, lastofs = 0;
+        a += hint;
+        if (lt(*a, key)) {
+            // a[hint] < key: gallop right until a[hint + lastofs] < key <= a[hint + ofs]
+            const Py_ssize_t maxofs = n - hint;
+            while (ofs < maxofs && lt(a[ofs], key)) {
+                lastofs = ofs;
+                ofs = (ofs << 1) + 1;
+                if (ofs <= 0) // overflow
+                    ofs = maxofs;
+            }
+            ofs = std::min(ofs, maxofs);
+            lastofs += hint;
+            ofs += hint;
+        } else {
+            // key <= a[hint]: gallop left until a[hint - ofs] < key <= a[hint - lastofs]
+            const Py_ssize_t maxofs = hint + 1;
+            while (ofs < maxofs && !lt(*(a - ofs), key)) {
+                lastofs = ofs;
+                ofs = (ofs << 1) + 1;
+                if (ofs <= 0)
+                    ofs = maxofs;
+            }
+            ofs = std::min(ofs, maxofs);
+            Py_ssize_t k = lastofs;
+            lastofs = hint - ofs;
+            ofs = hint - k;
+        }
+        a -= hint;
+
+        // Now a[lastofs] < key <= a[ofs], so binary search the space in between:
+        ++lastofs;
+        while (lastofs < ofs) {
+            Py_ssize_t m = lastofs + ((ofs - lastofs) >> 1);
+            if (lt(a[m], key))
+                lastofs = m + 1;
+            else
+                ofs = m;
+        }
+        return ofs;
+    }
+
+    // Like gallopLeft, but goes to the right of any equal elements: returns the k such that a[k-1] <= key < a[k].
+    Py_ssize_t gallopRight(const T& key, T* a, Py_ssize_t n, Py_ssize_t hint) {
+        Py_ssize_t ofs = 1, lastofs = 0;
+        a += hint;
+        if (lt(key, *a)) {
+            // key < a[hint]: gallop left until a[hint - ofs] <= key < a[hint - lastofs]
+            const Py_ssize_t maxofs = hint + 1;
+            while (ofs < maxofs && lt(key, *(a - ofs))) {
+                lastofs = ofs;
+                ofs = (ofs << 1) + 1;
+                if (ofs <= 0)
+                    ofs = maxofs;
+            }
+            ofs = std::min(ofs, maxofs);
+            Py_ssize_t k = lastofs;
+            lastofs = hint - ofs;
+            ofs = hint - k;
+        } else {
+            // a[hint] <= key: gallop right until a[hint + lastofs] <= key < a[hint + ofs]
+            const Py_ssize_t maxofs = n - hint;
+            while (ofs < maxofs && !lt(key, a[ofs])) {
+                lastofs = ofs;
+                ofs = (ofs << 1) + 1;
+                if (ofs <= 0)
+                    ofs = maxofs;
+            }
+            ofs = std::min(ofs, maxofs);
+            lastofs += hint;
+            ofs += hint;
+        }
+        a -= hint;
+
+        ++lastofs;
+        while (lastofs < ofs) {
+            Py_ssize_t m = lastofs + ((ofs - lastofs) >> 1);
+            if (lt(key, a[m]))
+                ofs = m;
+            else
+                lastofs = m + 1;
+        }
+        return ofs;
+    }
+
+    // While merging, the elements of one of the runs live in the temporary buffer, and there's a hole in the array
+    // exactly as big as what's left of them.  These copy them back into the hole once we're done, whether that's
+    // because the merge finished or because a comparison threw.
+    struct FillHoleLo {
+        // The hole is [dest, dest + na), and the rest of the first run is at [pa, pa + na).
+        T*& dest;
+        T*& pa;
+        Py_ssize_t& na;
+        ~FillHoleLo() {
+            if (na)
+                copy(dest, pa, na);
+        }
+    };
+    struct FillHoleHi {
+        // The hole is [dest - nb + 1, dest], and the rest of the second run is at [baseb, baseb + nb).
+        T*& dest;
+        T* baseb;
+        Py_ssize_t& nb;
+        ~FillHoleHi() {
+            if (nb)
+                copy(dest - (nb - 1), baseb, nb);
+        }
+    };
+
+    // Merges the adjacent runs [pa, pa + na) and [pb, pb + nb), where na <= nb.  Expects that pb[0] belongs before
+    // all of the first run, and pa[na - 1] belongs after all of the second.
+    void mergeLo(T* pa, Py_ssize_t na, T* pb, Py_ssize_t nb) {
+        assert(na > 0 && nb > 0 && pa + na == pb);
+        ensureTemp(na);
+        copy(temp, pa, na);
+        T* dest = pa;
+        pa = temp;
+        FillHoleLo fill_hole{ dest, pa, na };
+
+        *dest++ = *pb++;
+        --nb;
+        if (nb == 0)
+            return;
+        if (na == 1)
+            goto copy_b;
+
+        for (;;) {
+            Py_ssize_t acount = 0, bcount = 0;
+
+            // Do the straightforward thing until one run appears to win consistently:
+            for (;;) {
+                if (lt(*pb, *pa)) {
+                    *dest++ = *pb++;
+                    ++bcount;
+                    acount = 0;
+                    --nb;
+                    if (nb == 0)
+                        return;
+                    if (bcount >= min_gallop)
+                        break;
+                } else {
+                    *dest++ = *pa++;
+                    ++acount;
+                    bcount = 0;
+                    --na;
+                    if (na == 1)
+                        goto copy_b;
+                    if (acount >= min_gallop)
+                        break;
+                }
+            }
+
+            // Then gallop, until neither run is winning consistently anymore:
+            ++min_gallop;
+            do {
+                min_gallop -= min_gallop > 1;
+
+                Py_ssize_t k = gallopRight(*pb, pa, na, 0);
+                acount = k;
+                if (k) {
+                    copy(dest, pa, k);
+                    dest += k;
+                    pa += k;
+                    na -= k;
+                    if (na == 1)
+                        goto copy_b;
+                    // This can only happen if the comparison function is inconsistent:
+                    if (na == 0)
+                        return;
+                }
+                *dest++ = *pb++;
+                --nb;
+                if (nb == 0)
+                    return;
+
+                k = gallopLeft(*pa, pb, nb, 0);
+                bcount = k;
+                if (k) {
+                    move(dest, pb, k);
+                    dest += k;
+                    pb += k;
+                    nb -= k;
+                    if (nb == 0)
+                        return;
+                }
+                *dest++ = *pa++;
+                --na;
+                if (na == 1)
+                    goto copy_b;
+            } while (acount >= MIN_GALLOP || bcount >= MIN_GALLOP);
+            ++min_gallop; // penalize it for leaving galloping mode
+        }
+
+    copy_b:
+        // The last element of the first run goes after all that's left of the second:
+        assert(na == 1 && nb > 0);
+        move(dest, pb, nb);
+        dest += nb;
+        // (fill_hole puts the remaining element of the first run at dest)
+    }
+
+    // Like mergeLo, but for when na >= nb: merges from the right, keeping the second run in the temporary buffer.
+    void mergeHi(T* pa, Py_ssize_t na, T* pb, Py_ssize_t nb) {
+        assert(na > 0 && nb > 0 && pa + na == pb);
+        ensureTemp(nb);
+        copy(temp, pb, nb);
+        T* const basea = pa;
+        T* const baseb = temp;
+        T* dest = pb + nb - 1;
+        pb = temp + nb - 1;
+        pa += na - 1;
+        FillHoleHi fill_hole{ dest, baseb, nb };
+
+        *dest-- = *pa--;
+        --na;
+        if (na == 0)
+            return;
+        if (nb == 1)
+            goto copy_a;
+
+        for (;;) {
+            Py_ssize_t acount = 0, bcount = 0;
+
+            for (;;) {
+                if (lt(*pb, *pa)) {
+                    *dest-- = *pa--;
+                    ++acount;
+                    bcount = 0;
+                    --na;
+                    if (na == 0)
+                        return;
+                    if (acount >= min_gallop)
+                        break;
+                } else {
+                    *dest-- = *pb--;
+                    ++bcount;
+                    acount = 0;
+                    --nb;
+                    if (nb == 1)
+                        goto copy_a;
+                    if (bcount >= min_gallop)
+                        break;
+                }
+            }
+
+            ++min_gallop;
+            do {
+                min_gallop -= min_gallop > 1;
+
+                Py_ssize_t k = na - gallopRight(*pb, basea, na, na - 1);
+                acount = k;
+                if (k) {
+                    dest -= k;
+                    pa -= k;
+                    move(dest + 1, pa + 1, k);
+                    na -= k;
+                    if (na == 0)
+                        return;
+                }
+                *dest-- = *pb--;
+                --nb;
+                if (nb == 1)
+                    goto copy_a;
+                // This can only happen if the comparison function is inconsistent:
+                if (nb == 0)
+                    return;
+
+                k = nb - gallopLeft(*pa, baseb, nb, nb - 1);
+                bcount = k;
+                if (k) {
+                    dest -= k;
+                    pb -= k;
+                    copy(dest + 1, pb + 1, k);
+                    nb -= k;
+                    if (nb == 1)
+                        goto copy_a;
+                    if (nb == 0)
+                        return;
+                }
+                *dest-- = *pa--;
+                --na;
+                if (na == 0)
+                    return;
+            } while (acount >= MIN_GALLOP || bcount >= MIN_GALLOP);
+            ++min_gallop;
+        }
+
+    copy_a:
+        // The first element of the second run goes before all that's left of the first:
+        assert(nb == 1 && na > 0);
+        dest -= na;
+        pa -= na;
+        move(dest + 1, pa + 1, na);
+        // (fill_hole puts the remaining element of the second run at dest)
+    }
+
+    // Merges the runs at pending[i] and pending[i + 1].
+    void mergeAt(int i) {
+        assert(num_pending >= 2 && i >= 0 && (i == num_pending - 2 || i == num_pending - 3));
+
+        T* pa = pending[i].base;
+        Py_ssize_t na = pending[i].len;
+        T* pb = pending[i + 1].base;
+        Py_ssize_t nb = pending[i + 1].len;
+        assert(pa + na == pb);
+
+        pending[i].len = na + nb;
+        if (i == num_pending - 3)
+            pending[i + 1] = pending[i + 2];
+        --num_pending;
+
+        // Elements of the first run that are already in place don't have to get merged:
+        Py_ssize_t k = gallopRight(*pb, pa, na, 0);
+        pa += k;
+        na -= k;
+        if (na == 0)
+            return;
+
+        // Same for the elements at the end of the second run:
+        nb = gallopLeft(pa[na - 1], pb, nb, nb - 1);
+        if (nb == 0)
+            return;
+
+        if (na <= nb)
+            mergeLo(pa, na, pb, nb);
+        else
+            mergeHi(pa, na, pb, nb);
+    }
+
+    // Merges runs until the lengths on the stack satisfy len[i - 2] > len[i - 1] + len[i] and len[i - 1] > len[i].
+    // (This checks the invariant one level deeper than CPython 2.7 does, which is needed for it to actually hold.)
+    void mergeCollapse() {
+        while (num_pending > 1) {
+            int n = num_pending - 2;
+            Run* p = pending;
+            if ((n > 0 && p[n - 1].len <= p[n].len + p[n + 1].len)
+                || (n > 1 && p[n - 2].len <= p[n - 1].len + p[n].len)) {
+                if (p[n - 1].len < p[n + 1].len)
+                    --n;
+                mergeAt(n);
+            } else if (p[n].len <= p[n + 1].len) {
+                mergeAt(n);
+            } else {
+                break;
+            }
+        }
+    }
+
+    void mergeForceCollapse() {
+        while (num_pending > 1) {
+            int n = num_pending - 2;
+            if (n > 0 && pending[n - 1].len < pending[n + 1].len)
+                --n;
+            mergeAt(n);
+        }
+    }
+
+    // Picks a minimum run length so that n / minrun is a power of two, or a bit less than one.
+    static Py_ssize_t computeMinRun(Py_ssize_t n) {
+        Py_ssize_t r = 0;
+        while (n >= 64) {
+            r |= n & 1;
+            n >>= 1;
+        }
+        return n + r;
+    }
+
+public:
+    TimSort(Compare lt) : lt(lt), min_gallop(MIN_GALLOP), temp(NULL), temp_size(0), num_pending(0) {}
+    ~TimSort() {
+        if (temp)
+            gc::gc_free(temp);
+    }
+
+    void sort(T* a, Py_ssize_t n) {
+        if (n < 2)
+            return;
+
+        Py_ssize_t min_run = computeMinRun(n);
+        T* lo = a;
+        Py_ssize_t remaining = n;
+        do {
+            bool descending;
+            Py_ssize_t run_len = countRun(lo, lo + remaining, descending);
+            if (descending)
+                std::reverse(lo, lo + run_len);
+
+            // Extend short runs with a binary insertion sort:
+            if (run_len < min_run) {
+                Py_ssize_t force = std::min(remaining, min_run);
+                binarySort(lo, lo + force, lo + run_len);
+                run_len = force;
+            }
+
+            assert(num_pending < MAX_MERGE_PENDING);
+            pending[num_pending].base = lo;
+            pending[num_pending].len = run_len;
+            ++num_pending;
+            mergeCollapse();
+
+            lo += run_len;
+            remaining -= run_len;
+        } while (remaining);
+
+        mergeForceCollapse();
+        assert(num_pending == 1 && pending[0].base == a && pending[0].len == n);
+    }
+};
+
+template <typename T, typename Compare> void timsort(T* a, Py_ssize_t n, Compare lt) {
+    TimSort<T, Compare>(lt).sort(a, n);
+}
+}
+
+#endif
@@ -53,12 +53,9 @@ void printTraceback(Box* b) {
         return;
     assert(b->cls == traceback_cls);
 
-    BoxedTraceback* tb = static_cast<BoxedTraceback*>(b);
-
     fprintf(stderr, "Traceback (most recent call last):\n");
 
-    for (; tb && tb != None; tb = static_cast<BoxedTraceback*>(tb->tb_next)) {
-        auto& line = tb->line;
+    for (auto& line : BoxedTraceback::getLineInfos(b)) {
         fprintf(stderr, "  File \"%s\", line %d, in %s:\n", line.file.c_str(), line.line, line.func.c_str());
 
         if (line.line < 0)
@@ -95,6 +92,28 @@ void printTraceback(Box* b) {
     }
 }
 
+std::vector<LineInfo> BoxedTraceback::getLineInfos(Box* b) {
+    seal(b);
+
+    std::vector<LineInfo> lines;
+    for (BoxedTraceback* tb = static_cast<BoxedTraceback*>(b); tb && tb != None;
+         tb = static_cast<BoxedTraceback*>(tb->tb_next)) {
+        assert(tb->cls == traceback_cls);
+
+        if (tb->num_entries == 0) {
+            lines.push_back(tb->line);
+            continue;
+        }
+
+        for (int i = tb->num_entries - 1; i >= 0; i--) {
+            auto& entry = tb->entries[i];
+            auto source = entry.clfunc->source.get();
+            lines.push_back(LineInfo(entry.stmt->lineno, entry.stmt->col_offset, source->fn, source->getName()));
+        }
+    }
+    return lines;
+}
+
 Box* BoxedTraceback::getLines(Box* b) {
     assert(b->cls == traceback_cls);
 
@@ -102,8 +121,7 @@ Box* BoxedTraceback::getLines(Box* b) {
 
     if (!tb->py_lines) {
         BoxedList* lines = new BoxedList();
-        for (BoxedTraceback* wtb = tb; wtb && wtb != None; wtb = static_cast<BoxedTraceback*>(wtb->tb_next)) {
-            auto& line = wtb->line;
+        for (auto& line : getLineInfos(tb)) {
             auto l = BoxedTuple::create({ boxString(line.file), boxString(line.func), boxInt(line.line) });
             listAppendInternal(lines, l);
         }
@@ -117,6 +135,30 @@ void BoxedTraceback::here(LineInfo lineInfo, Box** tb) {
     *tb = new BoxedTraceback(lineInfo, *tb);
 }
 
+static StatCounter num_traceback_entries_buffered("num_traceback_entries_buffered");
+void BoxedTraceback::here(AST_stmt* stmt, CLFunction* clfunc, Box** tb) {
+    assert(stmt && clfunc && clfunc->source);
+
+    if (*tb && *tb != None) {
+        BoxedTraceback* cur = static_cast<BoxedTraceback*>(*tb);
+        assert(cur->cls == traceback_cls);
+        if (!cur->sealed && cur->num_entries < NUM_INLINE_ENTRIES) {
+            cur->entries[cur->num_entries++] = Entry{ stmt, clfunc };
+            num_traceback_entries_buffered.log();
+            return;
+        }
+    }
+
+    *tb = new BoxedTraceback(stmt, clfunc, *tb);
+}
+
+void BoxedTraceback::seal(Box* b) {
+    if (b && b != None) {
+        assert(b->cls == traceback_cls);
+        static_cast<BoxedTraceback*>(b)->sealed = true;
+    }
+}
+
 void setupTraceback() {
     traceback_cls = BoxedHeapClass::create(type_cls, object_cls, BoxedTraceback::gcHandler, 0, 0,
                                            sizeof(BoxedTraceback), false, "traceback");
@@ -27,20 +27,56 @@ class GCVisitor;
 extern "C" BoxedClass* traceback_cls;
 class BoxedTraceback : public Box {
 public:
-    Box* tb_next;
+    // An entry gets added for every frame that an exception passes through, but most exceptions get caught without
+    // anyone looking at their traceback.  So an entry only records the statement the frame was at, and the line
+    // info (which means copying out the filename and function name) gets computed when someone asks for it.
+    struct Entry {
+        AST_stmt* stmt;
+        CLFunction* clfunc;
+    };
+
+    // How many entries get buffered in one traceback object before we chain on a new one.
+    static const int NUM_INLINE_ENTRIES = 8;
+
+private:
+    // Entries are in the order that they were added, ie innermost frame first.
+    Entry entries[NUM_INLINE_ENTRIES];
+    int num_entries;
+
+    // Once a traceback can be seen from outside the unwind that is building it (it got re-raised, handed back
+    // through the C API, or its lines got read), later frames have to go into a new traceback object in front of
+    // it instead of being appended here.
+    bool sealed;
+
+    // Only used for tracebacks that were created from an explicit LineInfo, which have no entries.
     LineInfo line;
+
+public:
+    Box* tb_next;
     Box* py_lines;
 
-    BoxedTraceback(LineInfo line, Box* tb_next) : tb_next(tb_next), line(line), py_lines(NULL) {}
+    BoxedTraceback(LineInfo line, Box* tb_next)
+        : num_entries(0), sealed(true), line(line), tb_next(tb_next), py_lines(NULL) {}
+    BoxedTraceback(AST_stmt* stmt, CLFunction* clfunc, Box* tb_next)
+        : num_entries(1), sealed(false), line(-1, -1, "", ""), tb_next(tb_next), py_lines(NULL) {
+        entries[0] = Entry{ stmt, clfunc };
+    }
 
     DEFAULT_CLASS(traceback_cls);
 
+    // Returns the line info for every frame in the chain starting at b, outermost frame first.
+    static std::vector<LineInfo> getLineInfos(Box* b);
+
     static Box* getLines(Box* b);
 
     static void gcHandler(gc::GCVisitor* v, Box* b);
 
     // somewhat equivalent to PyTraceBack_Here
     static void here(LineInfo lineInfo, Box** tb);
+    static void here(AST_stmt* stmt, CLFunction* clfunc, Box** tb);
+
+    // Stop any more entries from being appended to this traceback object; b can be NULL or None.
+    static void seal(Box* b);
 };
 
 void printTraceback(Box* b);
@@ -77,17 +77,18 @@ extern "C" void _PyUnicode_Init();
 extern "C" void initunicodedata();
 extern "C" void init_weakref();
 extern "C" void initcStringIO();
+extern "C" void initcPickle();
 extern "C" void init_io();
 extern "C" void initzipimport();
 extern "C" void init_csv();
 extern "C" void init_ssl();
 extern "C" void init_sqlite3();
-extern "C" void PyMarshal_Init();
 extern "C" void initstrop();
 
 namespace pyston {
 
 void setupGC();
+void setupMarshal();
 
 bool IN_SHUTDOWN = false;
 
@@ -1069,6 +1070,10 @@ static void typeSubSetDict(Box* obj, Box* val, void* context) {
 
         HCAttrs* hcattrs = obj->getHCAttrsPtr();
 
+        // A dict-backed class can't have its lookups cached, so drop any that we had:
+        if (PyType_Check(obj))
+            PyType_Modified(static_cast<BoxedClass*>(obj));
+
         hcattrs->hcls = HiddenClass::dict_backed;
         hcattrs->attr_list = new_attr_list;
         return;
@@ -1141,15 +1146,7 @@ extern "C" void setGCHandler(GCVisitor* v, Box* b) {
     boxGCHandler(v, b);
 
     BoxedSet* s = (BoxedSet*)b;
-
-    // This feels like a cludge, but we need to find anything that
-    // the unordered_map might have allocated.
-    // Another way to handle this would be to rt_alloc the unordered_map
-    // as well, though that incurs extra memory dereferences which would
-    // be nice to avoid.
-    void** start = (void**)&s->s;
-    void** end = start + (sizeof(s->s) / 8);
-    v->visitPotentialRange(start, end);
+    s->s.gcVisit(v);
 }
 
 extern "C" void sliceGCHandler(GCVisitor* v, Box* b) {
@@ -1191,15 +1188,7 @@ extern "C" void dictGCHandler(GCVisitor* v, Box* b) {
     boxGCHandler(v, b);
 
     BoxedDict* d = (BoxedDict*)b;
-
-    // This feels like a cludge, but we need to find anything that
-    // the unordered_map might have allocated.
-    // Another way to handle this would be to rt_alloc the unordered_map
-    // as well, though that incurs extra memory dereferences which would
-    // be nice to avoid.
-    void** start = (void**)&d->d;
-    void** end = start + (sizeof(d->d) / 8);
-    v->visitPotentialRange(start, end);
+    d->d.gcVisit(v);
 }
 
 extern "C" void closureGCHandler(GCVisitor* v, Box* b) {
@@ -2133,6 +2122,9 @@ public:
         HCAttrs* attrs = self->b->getHCAttrsPtr();
         RELEASE_ASSERT(attrs->hcls->type == HiddenClass::NORMAL || attrs->hcls->type == HiddenClass::SINGLETON, "");
 
+        if (PyType_Check(self->b))
+            PyType_Modified(static_cast<BoxedClass*>(self->b));
+
         // Clear the attrs array:
         new ((void*)attrs) HCAttrs(root_hcls);
         // Add the existing attrwrapper object (ie self) back as the attrwrapper:
@@ -3033,6 +3025,11 @@ static void setupDefaultClassGCParticipation() {
 
 bool TRACK_ALLOCATIONS = false;
 void setupRuntime() {
+    // These gc handlers only trace references stored inside the GC heap:
+    for (auto handler : { &boxGCHandler, &functionGCHandler, &instancemethodGCHandler, &listGCHandler, &setGCHandler,
+                          &sliceGCHandler, &tupleGCHandler, &dictGCHandler, &closureGCHandler }) {
+        gc::registerHeapOnlyGCHandler(handler);
+    }
 
     root_hcls = HiddenClass::makeRoot();
     gc::registerPermanentRoot(root_hcls);
@@ -3504,12 +3501,13 @@ void setupRuntime() {
     init_socket();
     initunicodedata();
     initcStringIO();
+    initcPickle();
     init_io();
     initzipimport();
     init_csv();
     init_ssl();
     init_sqlite3();
-    PyMarshal_Init();
+    setupMarshal();
     initstrop();
 
     setupDefaultClassGCParticipation();
@@ -472,6 +472,9 @@ public:
     // optimizations and inlining, creating a new one each time shouldn't have any cost.
     llvm::StringRef s() const { return llvm::StringRef(s_data, ob_size); };
 
+    // Like CPython's ob_shash: the hash of the string, or -1 if it hasn't been computed yet.
+    // This means that a string can't be modified once something has hashed it.
+    long hash;
     char interned_state;
 
     char* data() { return s_data; }
@@ -561,6 +564,37 @@ template <> struct StringHash<std::string> {
     }
 };
 
+// The hash function for str objects.  It consumes the string eight bytes at a time, so it is a lot
+// cheaper than StringHash for long strings, and it only depends on the contents of the string, so
+// hashes (and therefore dict orderings) are the same from one run to the next.
+inline size_t hashStringBytes(const char* s, size_t len) {
+    const uint64_t mul = 0x9e3779b97f4a7c15ULL;
+
+    uint64_t h = len * mul;
+    while (len >= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, s, sizeof(word));
+        h = (h ^ word) * mul;
+        h ^= h >> 29;
+        s += sizeof(uint64_t);
+        len -= sizeof(uint64_t);
+    }
+    if (len) {
+        uint64_t word = 0;
+        memcpy(&word, s, len);
+        h = (h ^ word) * mul;
+        h ^= h >> 29;
+    }
+
+    // Final avalanche, from MurmurHash3's fmix64:
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
 
 class BoxedInstanceMethod : public Box {
 public:
@@ -783,22 +817,181 @@ struct PyLt {
     bool operator()(Box*, Box*) const;
 };
 
-class BoxedDict : public Box {
+// The storage for BoxedDict: an insertion-ordered open-addressing hash table, laid out like CPython 3.6's
+// "compact dict".  Entries (key, value, cached hash) live densely in insertion order, and a sparse power-of-two
+// index table maps hash slots to entry positions.  Caching the hashes means that resizing and dict-to-dict
+// merges never call back into Python, and lookups check pointer identity before falling back to PyEq.
+//
+// The interface mirrors the parts of std::unordered_map that the runtime uses.  Note that unlike with
+// unordered_map, references to values are invalidated by any insertion that grows the table.
+class DictMap {
 public:
-    typedef std::unordered_map<Box*, Box*, PyHasher, PyEq, StlCompatAllocator<std::pair<Box*, Box*>>> DictMap;
+    struct Entry {
+        Box* first;  // the key, or NULL for a deleted entry
+        Box* second; // the value
+        size_t hash;
+    };
+
+    class iterator {
+    private:
+        DictMap* map;
+        uint32_t idx;
+
+        bool atEnd() const { return idx >= map->nentries; }
+        void skipDeleted() {
+            while (idx < map->nentries && map->entries[idx].first == NULL)
+                idx++;
+        }
+
+    public:
+        iterator(DictMap* map, uint32_t idx) : map(map), idx(idx) { skipDeleted(); }
 
+        // Position of this iterator in the entries array; used by PyDict_Next.
+        uint32_t index() const { return idx; }
+
+        Entry& operator*() const { return map->entries[idx]; }
+        Entry* operator->() const { return &map->entries[idx]; }
+
+        iterator& operator++() {
+            idx++;
+            skipDeleted();
+            return *this;
+        }
+
+        // The table might have shrunk since an end iterator was created, so all positions past the
+        // last entry compare equal.
+        bool operator==(const iterator& rhs) const {
+            bool end = atEnd();
+            if (end || rhs.atEnd())
+                return end == rhs.atEnd();
+            return idx == rhs.idx;
+        }
+        bool operator!=(const iterator& rhs) const { return !(*this == rhs); }
+    };
+
+private:
+    static const int32_t IX_EMPTY = -1;
+    static const int32_t IX_DUMMY = -2;
+    static const size_t MIN_SIZE = 8;
+
+    // A single UNTRACKED allocation holding the index table followed by the entries array (which has room
+    // for usable() entries), or NULL if nothing has been inserted yet.  It is fine for a BoxedDict to be
+    // zero-initialized.
+    int32_t* indices;
+    Entry* entries;
+    uint32_t mask;     // number of index slots minus one
+    uint32_t nentries; // number of entries in use, including deleted ones
+    uint32_t nused;    // number of live entries
+    uint32_t nfill;    // number of index slots that are not IX_EMPTY
+
+    size_t usable() const { return indices ? (mask + 1) * 2 / 3 : 0; }
+
+    // Returns the entry index for key, or -1.  The hash must already have been computed.
+    int64_t lookup(Box* key, size_t hash) {
+    restart:
+        if (nused == 0)
+            return -1;
+
+        size_t perturb = hash;
+        size_t i = hash & mask;
+        while (true) {
+            int32_t ix = indices[i];
+            if (ix == IX_EMPTY)
+                return -1;
+
+            if (ix >= 0) {
+                Entry* e = &entries[ix];
+                if (e->first == key)
+                    return ix;
+                if (e->hash == hash) {
+                    Entry* orig_entries = entries;
+                    Box* orig_key = e->first;
+                    bool eq = PyEq()(orig_key, key);
+                    // The comparison could have run arbitrary code that mutated this dict:
+                    if (unlikely(entries != orig_entries || entries[ix].first != orig_key))
+                        goto restart;
+                    if (eq)
+                        return ix;
+                }
+            }
+
+            perturb >>= 5;
+            i = (i * 5 + perturb + 1) & mask;
+        }
+    }
+
+    int64_t findIndexSlot(size_t hash, int32_t ix);
+    uint32_t insertNew(Box* key, Box* value, size_t hash);
+    void resize(size_t minslots);
+    void eraseAt(uint32_t ix);
+
+public:
+    DictMap() : indices(NULL), entries(NULL), mask(0), nentries(0), nused(0), nfill(0) {}
+    DictMap(const DictMap&) = delete;
+    DictMap& operator=(const DictMap&) = delete;
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, UINT32_MAX); }
+    // The first live entry at or after position idx.
+    iterator iteratorAt(size_t idx) { return iterator(this, std::min(idx, (size_t)UINT32_MAX)); }
+
+    size_t size() const { return nused; }
+    bool empty() const { return nused == 0; }
+
+    iterator find(Box* key) {
+        int64_t ix = lookup(key, PyHasher()(key));
+        if (ix < 0)
+            return end();
+        return iterator(this, ix);
+    }
+
+    size_t count(Box* key) { return lookup(key, PyHasher()(key)) >= 0 ? 1 : 0; }
+
+    Box* getOrNull(Box* key) {
+        int64_t ix = lookup(key, PyHasher()(key));
+        if (ix < 0)
+            return NULL;
+        return entries[ix].second;
+    }
+
+    // Like unordered_map, inserts a NULL value if the key is not present.
+    Box*& operator[](Box* key) {
+        size_t hash = PyHasher()(key);
+        int64_t ix = lookup(key, hash);
+        if (ix < 0)
+            ix = insertNew(key, NULL, hash);
+        return entries[ix].second;
+    }
+
+    void erase(iterator it) { eraseAt(it.index()); }
+    size_t erase(Box* key) {
+        int64_t ix = lookup(key, PyHasher()(key));
+        if (ix < 0)
+            return 0;
+        eraseAt(ix);
+        return 1;
+    }
+
+    // Removes and returns the most recently inserted entry; the table must not be empty.
+    Entry popLast();
+
+    // Inserts or overwrites every entry of other, reusing its cached hashes.
+    void update(DictMap& other);
+
+    void clear();
+
+    void gcVisit(GCVisitor* v);
+};
+
+class BoxedDict : public Box {
+public:
     DictMap d;
 
     BoxedDict() __attribute__((visibility("default"))) {}
 
     DEFAULT_CLASS_SIMPLE(dict_cls);
 
-    Box* getOrNull(Box* k) {
-        const auto& p = d.find(k);
-        if (p != d.end())
-            return p->second;
-        return NULL;
-    }
+    Box* getOrNull(Box* k) { return d.getOrNull(k); }
 };
 static_assert(sizeof(BoxedDict) == sizeof(PyDictObject), "");
 
@@ -1017,12 +1210,16 @@ public:
     struct Context* context, *returnContext;
     void* stack_begin;
 
+    // If set, the generator doesn't have a stack (yet): its interpreter frame returns at every yield, and we resume it
+    // by calling back into it.  See canRunGeneratorStackless().
+    Box* stackless_frame;
+
 #if STAT_TIMERS
     StatTimer* prev_stack;
     StatTimer my_timer;
 #endif
 
-    BoxedGenerator(BoxedFunctionBase* function, Box* arg1, Box* arg2, Box* arg3, Box** args);
+    BoxedGenerator(BoxedFunctionBase* function, Box* arg1, Box* arg2, Box* arg3, Box** args, bool stackless);
 
     DEFAULT_CLASS(generator_cls);
 };
@@ -0,0 +1,46 @@
+# Exercise handing hot functions and loops off to the background compiler,
+# while the main thread keeps running them in the interpreter.
+
+try:
+    import __pyston__
+    __pyston__.setOption("ENABLE_BACKGROUND_COMPILATION", 1)
+    __pyston__.setOption("OSR_THRESHOLD_BASELINE", 50)
+    __pyston__.setOption("REOPT_THRESHOLD_BASELINE", 50)
+except ImportError:
+    pass
+
+def f(x):
+    return x * 2 + 1
+
+total = 0
+for i in xrange(20000):
+    total += f(i)
+print total
+
+def loop(n):
+    t = 0
+    for i in xrange(n):
+        t += i % 7
+    return t
+
+for n in (10, 1000, 100000):
+    print loop(n)
+
+def gen(n):
+    for i in xrange(n):
+        yield i * i
+
+print sum(gen(50000))
+
+import threading
+
+results = []
+def worker(k):
+    results.append(sum(f(i) for i in xrange(k)))
+
+threads = [threading.Thread(target=worker, args=(5000 * (i + 1),)) for i in xrange(4)]
+for t in threads:
+    t.start()
+for t in threads:
+    t.join()
+print sorted(results)
@@ -0,0 +1,132 @@
+# Make sure that the native cPickle works with our object model, and that it can read what pickle writes and
+# vice versa.
+import cPickle
+import pickle
+
+print cPickle.HIGHEST_PROTOCOL, cPickle.format_version
+
+# Shared and recursive references have to survive:
+l = [[], (123,)]
+l.append(l)
+shared = [1, 2]
+for proto in range(3):
+    l2 = cPickle.loads(cPickle.dumps(l, proto))
+    l3 = l2.pop()
+    print l2, l3 is l2
+    a, b = cPickle.loads(cPickle.dumps([shared, shared], proto))
+    print a, a is b
+
+values = [None, True, False, 0, -1, 2 ** 31, 2 ** 70, -2 ** 70, 1.5, -0.0, 1j, "", "hello\nworld", u"", u"caf\xe9",
+          (), (1,), (1, 2), (1, 2, 3), (1, 2, 3, 4), [], range(2000), {}, {"a": [1, 2]}, set([1]), frozenset([2]),
+          len, pickle.dumps, object, Exception]
+for proto in range(3):
+    for v in values:
+        for dumps, loads in [(cPickle.dumps, cPickle.loads), (cPickle.dumps, pickle.loads),
+                             (pickle.dumps, cPickle.loads)]:
+            r = loads(dumps(v, proto))
+            assert r == v and type(r) is type(v), (proto, v, r)
+print "values ok"
+
+# Builtin functions from us and from extension modules get pickled by name:
+import operator
+print repr(cPickle.dumps(len))
+print repr(cPickle.dumps(operator.and_))
+print cPickle.loads(cPickle.dumps(operator.and_)) is operator.and_
+
+class C(object):
+    pass
+
+class Old:
+    def __init__(self, x):
+        self.x = x
+
+class OldWithInitArgs:
+    def __init__(self, x):
+        self.x = x
+    def __getinitargs__(self):
+        return (self.x,)
+
+class Slotted(object):
+    __slots__ = ("a", "b")
+
+class Reduced(object):
+    def __init__(self, x):
+        self.x = x
+    def __reduce__(self):
+        return (Reduced, (self.x * 2,))
+
+class State(object):
+    def __getstate__(self):
+        return {"state": 1}
+    def __setstate__(self, state):
+        self.restored = state
+
+for proto in range(3):
+    c = C()
+    c.a = 1
+    c.b = [c]
+    c2 = cPickle.loads(cPickle.dumps(c, proto))
+    print type(c2).__name__, c2.a, c2.b[0] is c2, sorted(c2.__dict__.keys())
+
+    o = Old(5)
+    o.y = "y"
+    o2 = cPickle.loads(cPickle.dumps(o, proto))
+    print o2.__class__.__name__, o2.x, o2.y
+    print cPickle.loads(cPickle.dumps(OldWithInitArgs(6), proto)).x
+    print cPickle.loads(pickle.dumps(o, proto)).y, pickle.loads(cPickle.dumps(o, proto)).y
+
+    if proto == 2:
+        s = Slotted()
+        s.a = 1
+        s2 = cPickle.loads(cPickle.dumps(s, proto))
+        print s2.a, hasattr(s2, "b")
+
+    print cPickle.loads(cPickle.dumps(Reduced(3), proto)).x
+    print cPickle.loads(cPickle.dumps(State(), proto)).restored
+
+# Pickler and Unpickler objects, with files and with the memo carried across dumps:
+import cStringIO
+f = cStringIO.StringIO()
+p = cPickle.Pickler(f, 2)
+p.dump(shared)
+p.dump(shared)
+f.seek(0)
+u = cPickle.Unpickler(f)
+x = u.load()
+y = u.load()
+print x, x is y
+
+import tempfile, os
+fd, fn = tempfile.mkstemp()
+os.close(fd)
+with open(fn, "wb") as f:
+    cPickle.dump({"k": (1, 2L)}, f, 2)
+    cPickle.dump(u"second", f)
+with open(fn, "rb") as f:
+    print cPickle.load(f)
+    print cPickle.load(f)
+    try:
+        cPickle.load(f)
+    except EOFError:
+        print "EOFError"
+os.unlink(fn)
+
+# Errors:
+try:
+    cPickle.dumps(lambda: 0)
+except (cPickle.PicklingError, TypeError) as e:
+    print "can't pickle lambdas"
+try:
+    cPickle.loads("garbage")
+except cPickle.UnpicklingError as e:
+    print type(e).__name__, e
+except Exception as e:
+    print type(e).__name__
+print issubclass(cPickle.PicklingError, cPickle.PickleError)
+
+# Lots of objects, to give the GC a chance to run while the unpickler's stack is holding them:
+big = [C() for i in xrange(10000)]
+for i, c in enumerate(big):
+    c.i = str(i)
+big2 = cPickle.loads(cPickle.dumps(big, 2))
+print len(big2), big2[-1].i, sum(int(c.i) for c in big2)
@@ -0,0 +1,61 @@
+# Exercise the insert / delete / resize paths of the dict hash table.
+
+d = {}
+for i in xrange(10000):
+    d[i] = i * 2
+print len(d), d[0], d[9999], sum(d.itervalues())
+
+for i in xrange(0, 10000, 2):
+    del d[i]
+print len(d), 0 in d, 1 in d, sum(d)
+
+# Reinserting deleted keys after lots of deletions:
+for i in xrange(0, 10000, 4):
+    d[i] = -i
+print len(d), d[4], d.get(6)
+
+c = d.copy()
+print len(c), c == d
+c.update({1: None, "a": 5})
+print len(c), c[1], c["a"], c == d
+
+n = 0
+while d:
+    k, v = d.popitem()
+    n += 1
+print n, len(d), d
+
+d = dict.fromkeys("abcdef")
+for k in "ace":
+    del d[k]
+d["x"] = 1
+print sorted(d.items())
+d.clear()
+print d, len(d)
+d["y"] = 2
+print d
+
+# A key whose __eq__ mutates the dict being probed:
+class Mutator(object):
+    def __init__(self, d):
+        self.d = d
+
+    def __hash__(self):
+        return 1
+
+    def __eq__(self, rhs):
+        self.d.clear()
+        return False
+
+d = {}
+d[Mutator(d)] = 1
+d[Mutator(d)] = 2
+print len(d)
+
+# Strings with colliding hashes in a small table:
+d = {}
+for i in xrange(100):
+    d[str(i)] = i
+for i in xrange(100):
+    assert d[str(i)] == i
+print len(d), d.setdefault("5", 0), d.setdefault("500", 0), len(d)
@@ -27,7 +27,7 @@ d.__setitem__(c2, 2)
 # there is an entry from C(1) to 3
 d.__setitem__(c3, 3)
 
-print d
+print sorted(d.items(), key=lambda p: p[0].n)
 
 
 # dicts need to check identify and not just equality.
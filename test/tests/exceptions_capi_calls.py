@@ -0,0 +1,139 @@
+# Exceptions that get raised and caught within Python code, with the calls in between
+# made by the interpreter, the baseline jit or the llvm tiers.
+
+import sys
+import traceback
+
+def raises(d, k):
+    return d[k]
+
+def raises_directly(n):
+    raise ValueError(n)
+
+def with_defaults(a, b=1, c=2):
+    if a < 0:
+        raise IndexError(a, b, c)
+    return a + b + c
+
+def reraises(n):
+    try:
+        raises_directly(n)
+    except ValueError:
+        raise
+
+def nothing():
+    pass
+
+def f(n):
+    caught = 0
+    total = 0
+    for i in xrange(n):
+        try:
+            raises({}, i)
+        except KeyError as e:
+            caught += 1
+            assert e.args == (i,)
+
+        try:
+            raises_directly(i)
+        except ValueError:
+            caught += 1
+
+        try:
+            total += with_defaults(i)
+            total += with_defaults(i, 10)
+            with_defaults(-i - 1)
+        except IndexError as e:
+            caught += 1
+            assert e.args == (-i - 1, 1, 2), e.args
+
+        try:
+            x = nothing()
+            assert x is None
+            raise KeyError(i)
+        except KeyError:
+            caught += 1
+
+        try:
+            # A raise with bad arguments throws a TypeError instead:
+            raise KeyError, 1, 2
+        except TypeError:
+            caught += 1
+    return caught, total
+
+print f(5)
+print f(2000)
+
+def tb_lines(func, *args):
+    try:
+        func(*args)
+    except Exception:
+        return [(t[2], t[3]) for t in traceback.extract_tb(sys.exc_info()[2])]
+
+for i in xrange(500):
+    r = tb_lines(raises, {}, 1)
+    r2 = tb_lines(reraises, 1)
+    r3 = tb_lines(with_defaults, -1)
+print r
+print r2
+print r3
+
+def not_caught():
+    raises_directly(5)
+
+try:
+    not_caught()
+except ValueError as e:
+    print repr(e)
+    print [t[2] for t in traceback.extract_tb(sys.exc_info()[2])]
+
+class C(object):
+    def method(self, n):
+        if n % 3 == 0:
+            raise KeyError(n)
+        return n
+
+    @staticmethod
+    def static(n):
+        raise ValueError(n)
+
+    def __call__(self, n):
+        raise IndexError(n)
+
+def methods(n):
+    # Enough iterations for this to get to the llvm tier, where the calls and the method calls
+    # at the top of these try blocks branch to the handler when they get an exception back.
+    c = C()
+    caught = 0
+    total = 0
+    for i in xrange(n):
+        try:
+            total += c.method(i)
+        except KeyError as e:
+            caught += 1
+            assert e.args == (i,)
+        try:
+            c.static(i)
+        except ValueError:
+            caught += 1
+        try:
+            c(i)
+        except IndexError:
+            caught += 1
+        try:
+            x = C.method(c, i, 1)
+        except TypeError:
+            caught += 1
+    return caught, total
+
+print methods(30000)
+
+def method_tb_lines():
+    c = C()
+    for i in xrange(30000):
+        try:
+            c.method(0)
+        except KeyError:
+            r = [t[2] for t in traceback.extract_tb(sys.exc_info()[2])]
+    return r
+print method_tb_lines()
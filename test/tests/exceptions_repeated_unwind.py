@@ -0,0 +1,45 @@
+# Raise through the same call sites many times, while the functions involved get
+# recompiled at higher tiers, to make sure cached unwind info stays correct.
+
+def thrower(i):
+    if i % 3 == 0:
+        raise ValueError(i)
+    if i % 3 == 1:
+        raise KeyError(i)
+    return i
+
+def middle(i):
+    try:
+        return thrower(i)
+    finally:
+        pass
+
+def catcher(n):
+    counts = [0, 0, 0]
+    for i in xrange(n):
+        try:
+            middle(i)
+            counts[2] += 1
+        except ValueError:
+            counts[0] += 1
+        except KeyError:
+            counts[1] += 1
+    return counts
+
+for n in (10, 100, 1000, 20000):
+    print n, catcher(n)
+
+def nested(depth):
+    if depth == 0:
+        raise IndexError("bottom")
+    try:
+        nested(depth - 1)
+    except KeyError:
+        print "wrong handler"
+
+for i in xrange(2000):
+    try:
+        nested(i % 20)
+    except IndexError as e:
+        pass
+print e
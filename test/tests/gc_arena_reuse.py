@@ -0,0 +1,22 @@
+# Spike the heap, drop everything and collect twice so that the emptied arena
+# blocks get decommitted, then reuse that memory with objects of different sizes
+# and make sure nothing got mixed up.
+import gc
+
+def spike(n, size):
+    return [" " * size for i in xrange(n)]
+
+for size in (10, 200, 900, 5000, 50000):
+    l = spike(20000 if size < 1000 else 200, size)
+    del l
+    gc.collect()
+    gc.collect()
+
+l1 = [(i, str(i)) for i in xrange(20000)]
+l2 = ["x" * 3000 for i in xrange(100)]
+l3 = [range(i % 50) for i in xrange(5000)]
+gc.collect()
+
+print sum(t[0] for t in l1), all(t[1] == str(t[0]) for t in l1)
+print sum(len(s) for s in l2)
+print sum(len(l) for l in l3), all(l == range(len(l)) for l in l3)
@@ -0,0 +1,51 @@
+# Objects that survive a collection are old, and minor collections only trace
+# young objects.  Make sure that young objects that are only reachable through
+# old objects (modified in all sorts of ways) survive the automatic collections.
+import gc
+
+class C(object):
+    pass
+
+def gen():
+    l = []
+    while True:
+        x = yield len(l)
+        l.append(x)
+        if len(l) > 10:
+            yield l
+
+old_list = []
+old_dict = {}
+old_set = set()
+old_obj = C()
+old_gen = gen()
+old_gen.next()
+def make_closure():
+    cell = [None]
+    def f(v=None):
+        if v is not None:
+            cell[0] = v
+        return cell[0]
+    return f
+old_closure = make_closure()
+
+gc.collect()
+
+for i in xrange(200000):
+    # Lots of garbage to trigger a bunch of collections:
+    junk = [str(i)] * 10
+    if i % 20000 == 0:
+        n = i // 20000
+        old_list.append(str(n) * 3)
+        old_dict[str(n)] = [n] * 3
+        old_set.add((n, str(n)))
+        setattr(old_obj, "a%d" % n, {n: str(n)})
+        old_closure([n, str(n)])
+        r = old_gen.send(["gen", str(n)])
+
+print old_list
+print sorted(old_dict.items())
+print sorted(old_set)
+print sorted((k, v) for k, v in old_obj.__dict__.items())
+print old_closure()
+print r
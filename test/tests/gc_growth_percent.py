@@ -0,0 +1,26 @@
+# gc.set_growth_percent() is a Pyston addition: how much the heap may grow between collections,
+# separately from the CPython-style counts that gc.set_threshold() takes.
+import gc
+
+old = gc.get_growth_percent()
+threshold = gc.get_threshold()
+
+gc.set_growth_percent(50)
+print gc.get_growth_percent()
+print gc.get_threshold() == threshold
+
+for bad in (-1, "a", 2 ** 40):
+    try:
+        gc.set_growth_percent(bad)
+    except (ValueError, TypeError, OverflowError) as e:
+        print type(e).__name__
+print gc.get_growth_percent()
+
+l = []
+for i in xrange(100000):
+    l.append([i] * 10)
+    if len(l) > 100:
+        l = []
+
+gc.set_growth_percent(old)
+print gc.get_growth_percent() == old
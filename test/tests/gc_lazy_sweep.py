@@ -0,0 +1,44 @@
+# Small objects that die get swept lazily, sometime after the collection that
+# found them.  Weakrefs to them still have to be cleared (and their callbacks
+# called) by that collection, and the memory has to be reusable afterwards.
+import gc
+import weakref
+
+class C(object):
+    pass
+
+callbacks = []
+def cb(wr):
+    callbacks.append(wr)
+
+def make(n):
+    objs = [C() for i in xrange(n)]
+    refs = [weakref.ref(o, cb) for o in objs]
+    plain = [weakref.ref(o) for o in objs]
+    return objs, refs, plain
+
+objs, refs, plain = make(1000)
+keep = objs[::2]
+del objs
+gc.collect()
+
+# Conservative scanning might keep a few of them alive:
+print len(callbacks) >= 400
+print len(callbacks) == sum(1 for r in refs if r() is None) == sum(1 for r in plain if r() is None)
+print all(r() is not None for r in refs[::2])
+
+# Weakrefs that were created and then dropped before the object died:
+o = C()
+wr = weakref.ref(o)
+del wr
+del o
+gc.collect()
+
+# Lots of allocation to make the allocator sweep the leftover blocks:
+for i in xrange(100000):
+    l = [C(), str(i)]
+
+del keep
+gc.collect()
+print len(callbacks) >= 900
+print len(callbacks) == sum(1 for r in refs if r() is None)
@@ -0,0 +1,17 @@
+# Objects between 1KB and 3.5KB are allocated from the small arena, and the gc
+# module reports statistics for each of its size classes.
+import gc
+
+stats = gc.get_size_class_stats()
+print [s['size'] for s in stats]
+
+l = ["a" * 2000 + str(i) for i in xrange(1000)]
+stats = gc.get_size_class_stats()
+print sum(s['allocations'] for s in stats if 2000 < s['size'] <= 2560) >= 1000
+print sum(s['live_objects'] for s in stats if 2000 < s['size'] <= 2560) >= 1000
+
+for s in stats:
+    assert s['live_objects'] <= s['slots']
+    assert 0 <= s['fragmentation'] <= 1
+    if s['blocks'] == 0:
+        assert s['live_objects'] == 0
@@ -0,0 +1,39 @@
+import gc
+
+old = gc.get_threshold()
+print len(old)
+
+gc.set_threshold(200, 4)
+print gc.get_threshold()[:2], gc.get_threshold()[2] == old[2]
+
+gc.set_threshold(50, 2, 3)
+print gc.get_threshold()
+
+try:
+    gc.set_threshold("a")
+except TypeError:
+    print "TypeError"
+
+# Automatic collections are off, but explicit ones still work:
+gc.set_threshold(0)
+l = []
+for i in xrange(100000):
+    l.append([i] * 10)
+    if len(l) > 100:
+        l = []
+gc.collect()
+print gc.get_threshold()[0]
+
+gc.set_threshold(*old)
+print gc.get_threshold() == old
+
+# Longs work, as long as they fit in a C int:
+gc.set_threshold(100000L, 10, 10)
+print gc.get_threshold()
+for bad in (2 ** 31, -2 ** 31 - 1):
+    try:
+        gc.set_threshold(bad)
+    except OverflowError:
+        print "OverflowError"
+print gc.get_threshold()
+gc.set_threshold(*old)
@@ -0,0 +1,48 @@
+# Exercise reusing and trimming the stacks of generators that can't run stackless.
+
+try:
+    import __pyston__
+    __pyston__.setOption("MAX_CACHED_GENERATOR_STACKS", 2)
+except ImportError:
+    pass
+
+def g(n):
+    # Yielding inside of a try block means this generator runs on its own stack:
+    try:
+        for i in xrange(n):
+            yield i
+    finally:
+        pass
+
+def deep(n):
+    if n == 0:
+        return 0
+    return deep(n - 1) + 1
+
+def g2():
+    try:
+        # Use a good amount of the stack, so that trimming it actually has to release memory:
+        yield deep(300)
+        yield deep(200)
+    except GeneratorExit:
+        raise
+
+# More generators than fit in one slab of stacks, all alive at the same time:
+gens = [g(3) for i in xrange(50)]
+print sum(sum(x) for x in gens)
+del gens
+
+# After those stacks got freed (and most of them trimmed), reusing them should work the same:
+for rep in xrange(3):
+    gens = [g2() for i in xrange(40)]
+    total = 0
+    for x in gens:
+        total += x.next()
+    for x in gens[::2]:
+        total += x.next()
+    print total
+    del gens, x
+
+for i in xrange(1000):
+    l = list(g(2))
+print l
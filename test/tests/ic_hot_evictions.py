@@ -0,0 +1,27 @@
+# statcheck: noninit_count('ic_evictions') >= 10
+# statcheck: noninit_count('ic_hot_evictions') <= 5
+
+# A hot monomorphic site that keeps seeing a stream of other classes.  There are more cold classes
+# than IC slots, so every cold lookup needs a rewrite, but those should only ever evict each other
+# and never the entry that all the hits are going to.
+
+class Hot(object):
+    def __init__(self):
+        self.x = 1
+
+class Cold(object):
+    def __init__(self, n):
+        self.x = n
+
+colds = [type("Cold%d" % i, (Cold,), {})(i) for i in xrange(10)]
+
+def f(o):
+    return o.x
+
+hot = Hot()
+total = 0
+for i in xrange(20000):
+    total += f(hot)
+    if i % 250 == 0:
+        total += f(colds[(i / 250) % len(colds)])
+print total
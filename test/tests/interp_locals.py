@@ -0,0 +1,79 @@
+# Test the different ways the interpreter's locals get read and written.
+
+def f(a, b, c, *args, **kw):
+    d = a + b + c
+    print sorted(locals().items())
+    del d
+    print sorted(locals().items())
+    try:
+        print d
+    except NameError as e:
+        print e
+    try:
+        del d
+    except NameError as e:
+        print e
+    d = 5
+    return d, args, kw
+print f(1, 2, 3, 4, x=5)
+
+def tuple_args(a, (b, c)):
+    return a, b, c
+print tuple_args(1, (2, 3))
+
+def unbound(x):
+    if x:
+        y = 1
+    return y
+print unbound(1)
+try:
+    unbound(0)
+except UnboundLocalError as e:
+    print e
+
+def closures():
+    x = 1
+    def inner():
+        return x
+    print inner()
+    x = 2
+    print inner()
+    l = lambda y=x: y + x
+    x = 3
+    print l(), l(10)
+closures()
+
+def gen(n):
+    total = 0
+    for i in xrange(n):
+        total += i
+        yield total, sorted(locals().keys())
+for t in gen(3):
+    print t
+
+# Long-running loops, to get the locals handed over to the baseline jit and then to the compiled code:
+def loop(n):
+    a = 0
+    b = None
+    for i in xrange(n):
+        a += i
+        if i % 2:
+            b = i
+        else:
+            c = i
+    return a, b, c
+for i in xrange(3):
+    print loop(20000)
+
+def many_locals():
+    v0 = v1 = v2 = v3 = v4 = v5 = v6 = v7 = v8 = v9 = 0
+    for i in xrange(20000):
+        v0 += 1; v1 += 2; v2 += 3; v3 += 4; v4 += 5
+        v5 += 6; v6 += 7; v7 += 8; v8 += 9; v9 += 10
+    return v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7 + v8 + v9
+print many_locals()
+
+def exec_locals(x):
+    exec "y = x + 1"
+    return x, y
+print exec_locals(1)
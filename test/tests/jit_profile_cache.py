@@ -0,0 +1,73 @@
+# Run some code twice with the jit profile cache turned on: the first run should write out a
+# profile at exit, and the second run should load it and start jitting the hot blocks right away.
+# The runs use their own HOME so that they get an empty cache directory.
+
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+child_source = """
+def f(l):
+    t = 0
+    for x in l:
+        t += x * 2
+    return t
+
+def g(s):
+    return s.upper() + s.lower()
+
+ints = range(100)
+for i in xrange(200):
+    r = f(ints)
+    s = g("Hello")
+print r, s
+
+h = lambda x: x + 1.5
+print sum(h(i) for i in xrange(1000))
+"""
+
+tmpdir = tempfile.mkdtemp()
+try:
+    script = os.path.join(tmpdir, "jit_profile_cache_child.py")
+    with open(script, "w") as f:
+        f.write(child_source)
+
+    env = dict(os.environ)
+    env["HOME"] = tmpdir
+
+    def run():
+        p = subprocess.Popen([sys.executable, "-s", "-L", script], stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                             env=env)
+        out, err = p.communicate()
+        assert p.returncode == 0, err
+        stats = {}
+        for l in err.split('\n'):
+            if ':' in l:
+                k, v = l.rsplit(':', 1)
+                if v.strip().isdigit():
+                    stats[k.strip()] = int(v)
+        return out, stats
+
+    def profile_mentions_f():
+        profile_dir = os.path.join(tmpdir, ".cache", "pyston", "jit_profiles")
+        if not os.path.isdir(profile_dir):
+            return False
+        for fn in os.listdir(profile_dir):
+            for l in open(os.path.join(profile_dir, fn)):
+                if l.startswith("function ") and l.rstrip().endswith(" f"):
+                    return True
+        return False
+
+    out, stats = run()
+    print out.strip()
+    print "first run: saved", stats.get("num_jit_profiles_saved", 0) >= 1, "loaded", stats.get("num_jit_profiles_loaded", 0)
+    print "profile written:", profile_mentions_f()
+
+    out, stats = run()
+    print out.strip()
+    print "second run: loaded", stats.get("num_jit_profiles_loaded", 0) >= 1,
+    print "eager blocks", stats.get("num_jit_profile_eager_blocks", 0) > 0
+finally:
+    shutil.rmtree(tmpdir)
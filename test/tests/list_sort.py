@@ -0,0 +1,134 @@
+# Exercise list.sort(): the homogeneous fast paths, stability, keys, cmp, reverse, and lists
+# that get modified while they're being sorted.
+
+import random
+random.seed(12345)
+
+def check(l, **kw):
+    expected = sorted(l, **kw)
+    l2 = list(l)
+    l2.sort(**kw)
+    return l2 == expected
+
+# All ints, all floats, all strs, and mixed:
+ints = [random.randrange(1000) for i in xrange(2000)]
+l = list(ints)
+l.sort()
+print l[:10], l[-5:]
+floats = [random.random() * 100 - 50 for i in xrange(2000)]
+l = list(floats)
+l.sort()
+print all(l[i] <= l[i + 1] for i in xrange(len(l) - 1))
+strs = [str(random.randrange(1000)) for i in xrange(2000)]
+l = list(strs)
+l.sort()
+print l[:10], l[-5:]
+print sorted(["b", "a\xff", "a", "", "a\x00", "ab"])
+print sorted([3, 1.5, 2L, True, -1, 0.0])
+
+# Already-sorted and partially-sorted inputs, which have long runs to take advantage of:
+l = range(1000) + range(500) + range(1000, 0, -1) + [5] * 100
+l.sort()
+print l[::250], len(l)
+l = range(10000)
+for i in xrange(0, 10000, 37):
+    l[i] = -i
+l.sort()
+print l[:5], l[-5:]
+
+# Stability, also with reverse=True:
+pairs = [(random.randrange(10), i) for i in xrange(500)]
+l = list(pairs)
+l.sort(key=lambda p: p[0])
+print l[:8]
+l = list(pairs)
+l.sort(key=lambda p: p[0], reverse=True)
+print l[:8]
+l = [1, 1.0, 1L, True]
+l.sort()
+print l
+l.sort(reverse=True)
+print l
+
+# Keys, cmp, and both:
+words = "the quick brown fox jumps over the lazy dog".split()
+print sorted(words, key=len)
+print sorted(words, key=len, reverse=True)
+print sorted(words, cmp=lambda a, b: cmp(a[-1], b[-1]))
+print sorted(words, cmp=lambda a, b: cmp(b, a), key=lambda w: w[1:])
+print sorted(range(20), key=lambda x: (x % 3, -x))
+
+# Lots of random lists of different shapes:
+ok = True
+for i in xrange(50):
+    n = random.randrange(300)
+    l = [random.randrange(max(1, n // 3) + 1) for j in xrange(n)]
+    if i % 3 == 0:
+        l.sort()
+        for j in xrange(n // 10):
+            l[random.randrange(n)] = random.randrange(n)
+    ok = ok and check(l) and check(l, reverse=True) and check(l, key=lambda x: -x)
+    ok = ok and check([float(x) for x in l]) and check([str(x) for x in l])
+    ok = ok and check([(x, str(x)) for x in l])
+print ok
+
+# Subclasses don't get the fast path, since they could override comparisons:
+class MyInt(int):
+    def __lt__(self, other):
+        return int(self) > int(other)
+print sorted([MyInt(3), MyInt(1), MyInt(2)])
+
+class Weird(object):
+    def __init__(self, n):
+        self.n = n
+    def __lt__(self, other):
+        return self.n < other.n
+    def __repr__(self):
+        return "W%d" % self.n
+print sorted([Weird(3), Weird(1), Weird(2)])
+
+# Exceptions during sorting leave the list with all of its elements:
+def bad_cmp(a, b):
+    if a == 7 or b == 7:
+        raise ValueError("can't compare 7")
+    return cmp(a, b)
+l = range(20)
+random.shuffle(l)
+try:
+    l.sort(cmp=bad_cmp)
+except ValueError as e:
+    print e
+print sorted(l) == range(20)
+
+def bad_key(x):
+    if x == 13:
+        raise KeyError(x)
+    return x
+try:
+    l.sort(key=bad_key)
+except KeyError as e:
+    print "KeyError", e
+print sorted(l) == range(20)
+
+try:
+    l.sort(cmp=lambda a, b: "x")
+except TypeError as e:
+    print e
+print sorted(l) == range(20)
+
+# The list looks empty while it's being sorted, and modifying it is an error:
+l = [3, 1, 2]
+def peek(x):
+    print "during sort:", l
+    return x
+l.sort(key=peek)
+print l
+
+def mutate(x):
+    l.append(x)
+    return x
+try:
+    l.sort(key=mutate)
+except ValueError as e:
+    print e
+print l
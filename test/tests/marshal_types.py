@@ -0,0 +1,89 @@
+# Check that we read and write the same marshal format as CPython, including the less common types and versions.
+import marshal
+
+values = [0, 1, -1, 2 ** 31 - 1, -2 ** 31, 2 ** 31, -2 ** 31 - 1, 2 ** 62, -2 ** 63]
+values += [0L, 1L, -1L, 2L ** 15, 2L ** 15 - 1, 2L ** 100, -(2L ** 100), 3L ** 500]
+values += [0.0, -0.0, 1.5, 1e300, float("inf"), complex(-1.5, 2.25)]
+values += ["", "a" * 1000, u"", u"caf\xe9", u"\u20ac", u"\U0001f600"]
+values += [(), (1, (2, (3, ()))), [[], [[]]], {1: {2: 3}}, set([1, 2]), frozenset(), None, Ellipsis, StopIteration]
+
+for v in values:
+    for version in (0, 1, 2):
+        s = marshal.dumps(v, version)
+        r = marshal.loads(s)
+        assert r == v or (v != v and r != r), (v, r)
+        assert type(r) is type(v), (v, r)
+        # Set iteration order isn't guaranteed to match CPython's:
+        if isinstance(v, (set, frozenset)):
+            print version, len(s)
+        else:
+            print version, repr(s)
+
+# Interned strings get written once and then referred to by index:
+a = intern("interned_string")
+for version in (0, 1, 2):
+    s = marshal.dumps([a, a, "not interned"], version)
+    print version, repr(s), marshal.loads(s)
+
+# loads() accepts anything that supports the buffer interface, and ignores trailing data:
+print marshal.loads(buffer(marshal.dumps((1, 2)) + "trailing"))
+
+print marshal.version
+
+# Pyston's loads_from() lets you walk through concatenated values without slicing:
+def loads_from(data, offset=0):
+    if hasattr(marshal, "loads_from"):
+        return marshal.loads_from(data, offset)
+    v = marshal.loads(data[offset:])
+    return v, offset + len(marshal.dumps(v))
+data = "".join(marshal.dumps(v) for v in [1, "two", [3.0], None])
+offset = 0
+while offset < len(data):
+    v, offset = loads_from(data, offset)
+    print v, offset
+
+# Reading and writing files:
+import tempfile
+import os
+fd, fn = tempfile.mkstemp()
+os.close(fd)
+with open(fn, "wb") as f:
+    marshal.dump({"a": [1, 2L]}, f)
+    marshal.dump(u"second", f, 0)
+with open(fn, "rb") as f:
+    print marshal.load(f)
+    print marshal.load(f)
+    try:
+        marshal.load(f)
+    except EOFError as e:
+        print e
+os.unlink(fn)
+
+for bad in ["", "l\x01\x00\x00\x00\x00\x00", "l\x01\x00\x00\x00\x00\x80", "s\xff\xff\xff\xff", "Z",
+            "R\x00\x00\x00\x00", "(\x01\x00\x00\x000"]:
+    try:
+        marshal.loads(bad)
+        print "no error?"
+    except Exception as e:
+        print type(e).__name__, e
+
+for bad in [object(), [object()], lambda: 0]:
+    try:
+        marshal.dumps(bad)
+        print "no error?"
+    except ValueError as e:
+        print e
+
+l = []
+for i in xrange(3000):
+    l = [l]
+try:
+    marshal.dumps(l)
+    print "no error?"
+except ValueError as e:
+    print e
+
+try:
+    marshal.dump(1, "not a file")
+except TypeError as e:
+    print e
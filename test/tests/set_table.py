@@ -0,0 +1,55 @@
+# Exercise the insert / delete / resize paths of the set hash table and the set-set operations.
+
+s = set()
+for i in xrange(10000):
+    s.add(str(i))
+print len(s), "0" in s, "9999" in s, "10000" in s
+
+for i in xrange(0, 10000, 2):
+    s.remove(str(i))
+print len(s), "0" in s, "1" in s
+for i in xrange(0, 10000, 4):
+    s.add(str(i))
+print len(s)
+
+t = set(str(i) for i in xrange(5000, 15000))
+print len(s | t), len(s & t), len(t & s), len(s - t), len(t - s), len(s ^ t)
+print len(s.union(t, ["a", "b"])), len(s.intersection(t, t)), len(s.difference(t, ["1", "3"]))
+print s.issubset(s | t), (s | t).issuperset(t), s.issubset(t), s == set(s), s == t
+
+f = frozenset(s)
+print len(f), f == s, len(f & t), type(f & t).__name__, type(t & f).__name__
+
+u = set(t)
+u.difference_update(s, frozenset(["5000", "5001"]))
+print len(u)
+u.update(s, ["x"])
+print len(u)
+
+n = 0
+while u:
+    u.pop()
+    n += 1
+print n, len(u)
+
+u.add(1)
+u.discard(1)
+u.discard(2)
+print u, len(u)
+
+# A key whose __eq__ mutates the set being probed:
+class Mutator(object):
+    def __init__(self, s):
+        self.s = s
+
+    def __hash__(self):
+        return 1
+
+    def __eq__(self, rhs):
+        self.s.clear()
+        return False
+
+s = set()
+s.add(Mutator(s))
+s.add(Mutator(s))
+print len(s)
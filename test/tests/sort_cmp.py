@@ -1,6 +1,4 @@
-# expected: fail
-# - we don't support the cmp= keyword yet
-# (apparently it's removed in Python 3)
+# When both cmp and key are given, cmp gets called on the keys:
 
 printed = False
 def mycmp(x, y):
@@ -0,0 +1,134 @@
+# Generators that don't yield inside of a try block get run in their interpreter frame instead of on
+# a stack of their own; make sure they behave the same as the ones that get a stack.
+
+print sum(i * i for i in xrange(100))
+print any(x > 5 for x in [1, 2, 7])
+print ",".join(str(i) for i in range(5))
+print list(x for x in "abc" if x != "b")
+
+def counter(n):
+    i = 0
+    while i < n:
+        got = yield i
+        if got is not None:
+            i = got
+        else:
+            i += 1
+
+g = counter(10)
+print g.next(), g.next(), g.send(7), g.next(), list(g)
+
+def echo():
+    x = None
+    while True:
+        x = yield x
+
+g = echo()
+print g.next()
+for i in range(3):
+    print g.send(i)
+g.close()
+try:
+    g.next()
+except StopIteration:
+    print "stopped"
+
+# Exceptions thrown into a suspended generator without a try block just propagate:
+g = counter(3)
+g.next()
+try:
+    g.throw(ValueError, "thrown")
+except ValueError as e:
+    print "caught", e
+print list(g)
+
+# Generators that handle exceptions at their yields run on a stack:
+def handler():
+    for i in range(3):
+        try:
+            yield i
+        except KeyError:
+            print "handled KeyError"
+    yield "done"
+
+g = handler()
+print g.next()
+print g.throw(KeyError)
+print list(g)
+
+def with_finally():
+    try:
+        yield 1
+        yield 2
+    finally:
+        print "finally"
+
+g = with_finally()
+print g.next()
+g.close()
+print list(with_finally())
+
+# Exceptions raised inside of the generator:
+def raiser(n):
+    for i in range(n):
+        yield i
+    raise IndexError("done raising")
+
+try:
+    for x in raiser(3):
+        print x
+except IndexError as e:
+    print e
+
+# Closures and locals:
+def make_gen(k):
+    def inner():
+        for i in range(k):
+            yield i * k
+    return inner
+
+print list(make_gen(3)())
+
+def gen_locals(a, b=2, *args, **kw):
+    c = a + b
+    yield sorted(locals().items())
+    d = c * 2
+    yield sorted(locals().items())
+
+for l in gen_locals(1, 3, 4, x=5):
+    print l
+
+# Long-running generators get moved onto a stack partway through:
+def long_gen(n):
+    total = 0
+    for i in xrange(n):
+        total += i
+        yield total
+
+t = 0
+for x in long_gen(100000):
+    t = x
+print t
+
+def long_loop():
+    total = 0
+    for i in xrange(100000):
+        total += i
+    yield total
+    for i in xrange(100000):
+        total -= i
+    yield total
+
+print list(long_loop())
+
+# Lots of live generators at once:
+gens = [counter(5) for i in xrange(1000)]
+print sum(sum(g) for g in gens)
+
+# Nested generators:
+def outer():
+    for i in range(3):
+        for j in (x * 10 for x in range(i)):
+            yield i, j
+
+print list(outer())
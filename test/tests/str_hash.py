@@ -0,0 +1,32 @@
+# Strings cache their hash, and str and ascii unicode objects have to agree on it.
+
+s = "x" * 1000 + "y"
+h = hash(s)
+print h == hash(s), h == hash("x" * 1000 + "y")
+
+for l in xrange(20):
+    a = "abcdefghijklmnopqrstuvwxyz"[:l]
+    print l, hash(a) == hash(unicode(a)), hash(a) == hash(str(bytearray(a)))
+
+print hash("") == hash(u"") == 0
+
+d = {}
+keys = ["http://example.com/some/long/path/%d?query=%d" % (i, i * 7) for i in xrange(500)]
+for i, k in enumerate(keys):
+    d[k] = i
+print all(d[k] == i for i, k in enumerate(keys))
+print all(d[unicode(k)] == i for i, k in enumerate(keys))
+print len(set(keys)), len(set(map(hash, keys))) > 490
+
+# Keys that only differ past the first word:
+d = dict(("prefix__%d" % i, i) for i in xrange(100))
+print sorted(d.values()) == range(100)
+
+class S(str):
+    pass
+print hash(S("hello")) == hash("hello")
+
+class H(str):
+    def __hash__(self):
+        return 5
+print hash(H("hello"))
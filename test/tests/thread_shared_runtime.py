@@ -0,0 +1,30 @@
+# Threads that all take the same hidden class transitions and run generators and interpreted
+# frames at the same time, going through the locks around the runtime structures that they share.
+
+import threading
+
+class C(object):
+    pass
+
+def gen(n):
+    for i in xrange(n):
+        yield i
+
+results = []
+def work(tid):
+    total = 0
+    for i in xrange(2000):
+        c = C()
+        c.a = i
+        c.b = tid
+        setattr(c, "attr%d" % (i % 10), i)
+        del c.a
+        total += c.b + sum(gen(5))
+    results.append(total)
+
+threads = [threading.Thread(target=work, args=(i,)) for i in xrange(4)]
+for t in threads:
+    t.start()
+for t in threads:
+    t.join()
+print sorted(results)
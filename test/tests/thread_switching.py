@@ -0,0 +1,42 @@
+# A thread that keeps blocking (here, on a queue) should still get to run promptly while
+# another thread is busy running Python code.
+
+import sys
+import threading
+import time
+import Queue
+
+print sys.getcheckinterval()
+sys.setcheckinterval(200)
+print sys.getcheckinterval()
+sys.setcheckinterval(100)
+
+done = False
+def spin():
+    n = 0
+    while not done:
+        n += 1
+
+q = Queue.Queue()
+def consumer():
+    for i in xrange(20):
+        q.get()
+
+spinner = threading.Thread(target=spin)
+spinner.start()
+
+c = threading.Thread(target=consumer)
+c.start()
+
+start = time.time()
+for i in xrange(20):
+    q.put(i)
+    time.sleep(0.001)
+c.join()
+elapsed = time.time() - start
+
+done = True
+spinner.join()
+
+# With 5ms switch intervals, this should take well under a second:
+print elapsed < 2.0
@@ -0,0 +1,33 @@
+# Tracebacks only record where each frame was, and compute their lines once they get looked at;
+# make sure that this still gives the right answers when that happens long after the frames are gone.
+
+import sys
+import traceback
+
+def inner(n):
+    if n == 0:
+        raise ValueError("inner")
+    return inner(n - 1)
+
+def outer():
+    inner(3)
+
+saved = []
+for i in xrange(1000):
+    try:
+        outer()
+    except ValueError:
+        if i % 250 == 0:
+            saved.append(sys.exc_info()[2])
+
+for tb in saved:
+    print [(t[1], t[2], t[3]) for t in traceback.extract_tb(tb)]
+
+def lambda_user():
+    return map(lambda x: 1 / x, [1, 0])
+
+try:
+    lambda_user()
+except ZeroDivisionError:
+    tb = sys.exc_info()[2]
+print [(t[1], t[2]) for t in traceback.extract_tb(tb)]
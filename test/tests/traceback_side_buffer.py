@@ -0,0 +1,44 @@
+# Traceback entries get buffered several frames to an object; make sure that deep tracebacks still
+# come out right, and that a traceback someone has saved doesn't grow when it gets re-raised.
+
+import sys
+import traceback
+
+def f(n):
+    if n == 0:
+        raise KeyError(n)
+    f(n - 1)
+
+try:
+    f(20)
+except KeyError:
+    tb = sys.exc_info()[2]
+lines = traceback.extract_tb(tb)
+print len(lines), lines[0][2], set(l[2] for l in lines[1:])
+
+saved = []
+def bare_reraiser():
+    try:
+        f(2)
+    except KeyError:
+        saved.append(sys.exc_info()[2])
+        raise
+
+def three_arg_reraiser():
+    try:
+        f(2)
+    except KeyError:
+        t, v, tb = sys.exc_info()
+        saved.append(tb)
+        raise t, v, tb
+
+def caller(g):
+    g()
+
+for g in (bare_reraiser, three_arg_reraiser):
+    del saved[:]
+    try:
+        caller(g)
+    except KeyError:
+        outer = sys.exc_info()[2]
+    print g.__name__, [l[2] for l in traceback.extract_tb(saved[0])], [l[2] for l in traceback.extract_tb(outer)]
@@ -0,0 +1,85 @@
+# Make sure that cached class attribute lookups get invalidated when classes change.
+
+class A(object):
+    x = 1
+
+class B(A):
+    pass
+
+class C(B):
+    pass
+
+def f(o):
+    return o.x
+
+c = C()
+for i in xrange(1000):
+    f(c)
+print f(c)
+
+# Changing a base class should be visible through the subclasses:
+A.x = 2
+print f(c), C.x
+B.x = 3
+print f(c), C.x
+del B.x
+print f(c), C.x
+del A.x
+try:
+    f(c)
+except AttributeError as e:
+    print e
+
+# Adding an attribute after we've looked it up and not found it:
+A.y = 4
+print c.y, getattr(C, "y")
+
+# Changing __bases__:
+class D(object):
+    x = 5
+C.__bases__ = (D,)
+print f(c), C.x
+D.x = 6
+print f(c), C.x
+
+# Negative lookups that fall back to __getattr__:
+class E(object):
+    def __getattr__(self, attr):
+        return "fallback"
+e = E()
+print e.foo
+E.foo = "real"
+print e.foo
+del E.foo
+print e.foo
+
+# A megamorphic site that sees lots of classes:
+classes = []
+for i in xrange(50):
+    classes.append(type("K%d" % i, (object,), {"v": i}))
+for rep in xrange(3):
+    total = 0
+    for k in classes:
+        total += k().v
+    print total
+    for k in classes:
+        k.v += 1
+
+# Old-style classes in the mro:
+class Old:
+    z = 7
+class New(object, Old):
+    pass
+n = New()
+print n.z
+Old.z = 8
+print n.z
+
+# Special methods get looked up on the type:
+class L(object):
+    def __len__(self):
+        return 1
+l = L()
+print len(l)
+L.__len__ = lambda self: 2
+print len(l)
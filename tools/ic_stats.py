@@ -4,6 +4,59 @@ import subprocess
 import sys
 import time
 
+def parse_ic_stats(out):
+    """
+    Parses the per-IC dump that pyston prints with -K.  Returns a list of dicts, one per IC,
+    where "hits" is a list with one entry per slot (None for an empty slot).
+    """
+    ics = []
+    in_section = False
+    for l in out.split('\n'):
+        if l == "IC stats:":
+            in_section = True
+            continue
+        if l == "(End of IC stats)":
+            in_section = False
+            continue
+        if not in_section or not l.startswith("ic "):
+            continue
+
+        fields = l.split(' ')
+        ic = {"addr": fields[1]}
+        for f in fields[2:]:
+            k, v = f.split('=', 1)
+            if k == "hits":
+                ic[k] = [None if h == '-' else int(h) for h in v.split(',')]
+            elif k == "name":
+                ic[k] = v
+            else:
+                ic[k] = int(v)
+        ics.append(ic)
+    return ics
+
+def output_slot_stats(ics):
+    if not ics:
+        return
+
+    total_hits = sum(sum(h for h in ic["hits"] if h) for ic in ics)
+    print "\n\n%80s  %d" % ("ic_slot_hits", total_hits)
+
+    # How much of the traffic goes to ICs that would have liked more room:
+    cramped = [ic for ic in ics if ic["too_large"] or ic["no_free_slot"] or ic["evictions"]]
+    cramped.sort(key=lambda ic: (ic["too_large"] + ic["no_free_slot"] + ic["evictions"]), reverse=True)
+    for ic in cramped[:10]:
+        hits = ",".join('-' if h is None else str(h) for h in ic["hits"])
+        print "%40s %s: %d x %d bytes, %d too large, %d without a free slot, %d evictions, hits %s" % (
+                ic["name"], ic["addr"], ic["slots"], ic["slot_size"], ic["too_large"], ic["no_free_slot"],
+                ic["evictions"], hits)
+
+    # For polymorphic ICs, how concentrated the hits are in the hottest slot:
+    poly = [ic for ic in ics if len([h for h in ic["hits"] if h]) > 1]
+    if poly:
+        hottest = sum(max(ic["hits"]) for ic in poly)
+        total = sum(sum(h for h in ic["hits"] if h) for ic in poly)
+        print "%d polymorphic ics; %.0f%% of their hits go to the hottest slot" % (len(poly), 100.0 * hottest / total)
+
 def output_stats(stats, total_count):
     if total_count is 0:
         return
@@ -12,7 +65,7 @@ def output_stats(stats, total_count):
         print "%80s  %d (%.0f%%)" % (name, s, 100.0 * s / total_count)
 
 if __name__ == "__main__":
-    cmd = ["./pyston_release", "-Ts", sys.argv[1]]
+    cmd = ["./pyston_release", "-TsK", sys.argv[1]]
 
     start = time.time()
     p = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
@@ -57,3 +110,5 @@ if __name__ == "__main__":
 
     if len(stats) > 0:
         output_stats(stats, current_count)
+
+    output_slot_stats(parse_ic_stats(out))
@@ -19,6 +19,8 @@ from __future__ import division
 import subprocess
 import os
 
+from ic_stats import parse_ic_stats
+
 BASE_DIR = os.path.join(os.path.dirname(__file__), "..")
 TEST_DIR = os.path.join(BASE_DIR, "test/tests/")
 EXTMODULE_DIR_PYSTON = os.path.abspath(os.path.join(BASE_DIR, "test/test_extension/"))
@@ -29,22 +31,33 @@ def main():
             test.endswith(".py") and "ics" in test]
 
     results = []
-    results.append(['test', 'ics', 'total ic size', 'average ic size'])
+    results.append(['test', 'ics', 'total ic size', 'average ic size', 'slot hits', 'no space', 'evictions'])
     totalNumIcs = 0
     totalSizeIcs = 0
+    totalHits = 0
+    totalNoSpace = 0
+    totalEvictions = 0
     asm_log = []
     for ics_test in ics_tests:
-        stats, assembly_logging = runTest(ics_test)
+        stats, ic_stats, assembly_logging = runTest(ics_test)
         numIcs = stats['ic_rewrites_committed']
         sizeIcs = stats['ic_rewrites_total_bytes']
-        results.append([ics_test, str(numIcs), str(sizeIcs), div(sizeIcs, numIcs)])
+        hits = sum(sum(h for h in ic['hits'] if h) for ic in ic_stats)
+        noSpace = sum(ic['too_large'] + ic['no_free_slot'] for ic in ic_stats)
+        evictions = sum(ic['evictions'] for ic in ic_stats)
+        results.append([ics_test, str(numIcs), str(sizeIcs), div(sizeIcs, numIcs), str(hits), str(noSpace),
+                        str(evictions)])
         totalNumIcs += numIcs
         totalSizeIcs += sizeIcs
+        totalHits += hits
+        totalNoSpace += noSpace
+        totalEvictions += evictions
         asm_log.append(assembly_logging)
 
     print "\n".join(asm_log)
 
-    results.append(['TOTAL', str(totalNumIcs), str(totalSizeIcs), div(totalSizeIcs, totalNumIcs)])
+    results.append(['TOTAL', str(totalNumIcs), str(totalSizeIcs), div(totalSizeIcs, totalNumIcs), str(totalHits),
+                    str(totalNoSpace), str(totalEvictions)])
 
     printTable(results)
 
@@ -62,7 +75,7 @@ def runTest(filename):
 
     env["PYTHONPATH"] = EXTMODULE_DIR_PYSTON
 
-    proc = subprocess.Popen([pyston, "-a", "-s", filename],
+    proc = subprocess.Popen([pyston, "-a", "-s", "-K", filename],
             stdout=subprocess.PIPE,
             stderr=subprocess.PIPE,
             stdin=subprocess.PIPE,
@@ -71,6 +84,8 @@ def runTest(filename):
     if proc.wait() != 0:
         raise Exception("%s failed" % filename)
 
+    ic_stats = parse_ic_stats(stderr)
+
     stderr, stats_str = stderr.split("Stats:")
     stats_str, stderr_tail = stats_str.split("(End of stats)\n")
     other_stats_str, counter_str = stats_str.split("Counters:")
@@ -82,7 +97,7 @@ def runTest(filename):
 
     assembly_logging = stderr
 
-    return (stats, assembly_logging)
+    return (stats, ic_stats, assembly_logging)
 
 def printTable(table):
     widths = [3 + max(len(table[i][j]) for i in xrange(len(table))) for j in xrange(len(table[0]))]